@@ -0,0 +1,37 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+  \file terraradar/library/common/CancellationToken.cpp
+  \brief A thread safe cooperative cancellation request.
+  */
+
+// TerraRadar includes
+#include "CancellationToken.hpp"
+
+namespace teradar {
+  namespace common {
+    CancellationToken::CancellationToken()
+      : m_cancelled( false ) {
+    }
+
+    CancellationToken::~CancellationToken() {
+    }
+
+    void CancellationToken::cancel() {
+      m_cancelled.store( true, boost::memory_order_release );
+    }
+
+    bool CancellationToken::isCancelled() const {
+      return m_cancelled.load( boost::memory_order_acquire );
+    }
+
+    void CancellationToken::reset() {
+      m_cancelled.store( false, boost::memory_order_release );
+    }
+  } // end namespace common
+} // end namespace teradar
@@ -0,0 +1,68 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+  \file terraradar/library/common/CancellationToken.hpp
+  \brief A thread safe cooperative cancellation request.
+  */
+
+#ifndef TERRARADAR_LIB_COMMON_INTERNAL_CANCELLATIONTOKEN_HPP_
+#define TERRARADAR_LIB_COMMON_INTERNAL_CANCELLATIONTOKEN_HPP_
+
+// TerraRadar includes
+#include "config.hpp"
+
+// Boost includes
+#include <boost/atomic.hpp>
+
+namespace teradar {
+  namespace common {
+    /*!
+      \class CancellationToken
+      \brief Cooperative cancellation request.
+
+      \details The token is cancelled by any thread and checked by the
+      cancellable tasks, which stop at their next check point.
+    */
+    class TERADARCOMMONEXPORT CancellationToken
+    {
+      public:
+        /// Constructor.
+        CancellationToken();
+
+        /// Destructor.
+        ~CancellationToken();
+
+        /*!
+          \brief Request the cancellation.
+        */
+        void cancel();
+
+        /*!
+          \brief Return if the cancellation was requested.
+          \return True if cancelled. False otherwise.
+        */
+        bool isCancelled() const;
+
+        /*!
+          \brief Clear the cancellation request, so the token may be reused.
+        */
+        void reset();
+
+      private:
+        /// Not copyable.
+        CancellationToken( const CancellationToken& );
+
+        /// Not copyable.
+        const CancellationToken& operator=( const CancellationToken& );
+
+        boost::atomic< bool > m_cancelled; //!< Cancellation requested.
+    };
+  } // end namespace common
+} // end namespace teradar
+
+#endif // TERRARADAR_LIB_COMMON_INTERNAL_CANCELLATIONTOKEN_HPP_
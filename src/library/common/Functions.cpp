@@ -17,8 +17,36 @@ TerraRadar is under development.
 #include <terralib/rp/Functions.h>
 #include <terralib/rp/RasterHandler.h>
 
+// STL Includes
+#include <algorithm>
+#include <vector>
+
 //#include <string>
 
+namespace
+{
+  /*!
+    \brief Copy the region part of a raster block buffer into a band plane.
+  */
+  template< class BlockValueT >
+  void CopyBlockRegion( const BlockValueT* blockBuffer, const unsigned int blockWidth,
+    const unsigned int blockXOffset, const unsigned int blockYOffset,
+    const unsigned int colStart, const unsigned int colBound,
+    const unsigned int rowStart, const unsigned int rowBound,
+    const unsigned int xStart, const unsigned int yStart, const unsigned int width,
+    std::complex< double >* planePtr )
+  {
+    for( unsigned int row = rowStart; row < rowBound; ++row ) {
+      const BlockValueT* blockLinePtr = blockBuffer + ( row - blockYOffset ) * blockWidth;
+      std::complex< double >* planeLinePtr = planePtr + ( row - yStart ) * width;
+
+      for( unsigned int col = colStart; col < colBound; ++col ) {
+        planeLinePtr[col - xStart] = std::complex< double >( blockLinePtr[col - blockXOffset] );
+      }
+    }
+  }
+}
+
 namespace teradar {
   namespace common {
     bool CopyComplex2DiskRaster( const te::rst::Raster& inputRaster,
@@ -65,5 +93,320 @@ namespace teradar {
 
       return true;
     }
+
+    bool FillRasterBandWithZeros( te::rst::Raster& raster, const unsigned int band )
+    {
+      if( band >= raster.getNumberOfBands() ) {
+        return false;
+      }
+
+      te::rst::Band& rasterBand = *raster.getBand( band );
+      const te::rst::BandProperty& bandProperty = *rasterBand.getProperty();
+
+      // all bits set to zero is the zero value of every band data type
+      std::vector< unsigned char > blockBuffer( rasterBand.getBlockSize(), 0 );
+
+      for( int blockY = 0; blockY < bandProperty.m_nblocksy; ++blockY ) {
+        for( int blockX = 0; blockX < bandProperty.m_nblocksx; ++blockX ) {
+          rasterBand.write( blockX, blockY, &blockBuffer[0] );
+        }
+      }
+
+      return true;
+    }
+
+    bool WriteLabelsRegion( const te::rp::Matrix< unsigned int >& labels,
+      const unsigned int xStart, const unsigned int yStart,
+      te::rst::Raster& raster, const unsigned int band )
+    {
+      const unsigned int labelsRows = labels.getLinesNumber();
+      const unsigned int labelsCols = labels.getColumnsNumber();
+
+      if( ( band >= raster.getNumberOfBands() ) ||
+        ( xStart + labelsCols > raster.getNumberOfColumns() ) ||
+        ( yStart + labelsRows > raster.getNumberOfRows() ) ) {
+        return false;
+      }
+
+      if( ( labelsRows == 0 ) || ( labelsCols == 0 ) ) {
+        return true;
+      }
+
+      te::rst::Band& rasterBand = *raster.getBand( band );
+      const te::rst::BandProperty& bandProperty = *rasterBand.getProperty();
+      unsigned int row = 0;
+      unsigned int col = 0;
+
+      if( ( bandProperty.m_type != te::dt::UINT32_TYPE ) ||
+        ( bandProperty.m_blkw <= 0 ) || ( bandProperty.m_blkh <= 0 ) ) {
+        for( row = 0; row < labelsRows; ++row ) {
+          const unsigned int* labelsLinePtr = labels[row];
+
+          for( col = 0; col < labelsCols; ++col ) {
+            if( labelsLinePtr[col] ) {
+              rasterBand.setValue( xStart + col, yStart + row, (double)labelsLinePtr[col] );
+            }
+          }
+        }
+
+        return true;
+      }
+
+      const unsigned int blockWidth = (unsigned int)bandProperty.m_blkw;
+      const unsigned int blockHeight = (unsigned int)bandProperty.m_blkh;
+      const unsigned int blockXStart = xStart / blockWidth;
+      const unsigned int blockXEnd = ( xStart + labelsCols - 1 ) / blockWidth;
+      const unsigned int blockYStart = yStart / blockHeight;
+      const unsigned int blockYEnd = ( yStart + labelsRows - 1 ) / blockHeight;
+
+      std::vector< unsigned int > blockBuffer( blockWidth * blockHeight );
+
+      for( unsigned int blockY = blockYStart; blockY <= blockYEnd; ++blockY ) {
+        // region lines inside this blocks line
+        const unsigned int rowStart = std::max( yStart, blockY * blockHeight );
+        const unsigned int rowBound = std::min( yStart + labelsRows, ( blockY + 1 ) * blockHeight );
+
+        for( unsigned int blockX = blockXStart; blockX <= blockXEnd; ++blockX ) {
+          const unsigned int colStart = std::max( xStart, blockX * blockWidth );
+          const unsigned int colBound = std::min( xStart + labelsCols, ( blockX + 1 ) * blockWidth );
+
+          // other regions may share this block, its current values are kept
+          rasterBand.read( (int)blockX, (int)blockY, &blockBuffer[0] );
+
+          for( row = rowStart; row < rowBound; ++row ) {
+            const unsigned int* labelsLinePtr = labels[row - yStart];
+            unsigned int* blockLinePtr = &blockBuffer[( row - blockY * blockHeight ) * blockWidth];
+
+            for( col = colStart; col < colBound; ++col ) {
+              if( labelsLinePtr[col - xStart] ) {
+                blockLinePtr[col - blockX * blockWidth] = labelsLinePtr[col - xStart];
+              }
+            }
+          }
+
+          rasterBand.write( (int)blockX, (int)blockY, &blockBuffer[0] );
+        }
+      }
+
+      return true;
+    }
+
+    bool ReadLabelsRegion( const te::rst::Raster& raster, const unsigned int band,
+      const unsigned int xStart, const unsigned int yStart,
+      te::rp::Matrix< unsigned int >& labels )
+    {
+      const unsigned int labelsRows = labels.getLinesNumber();
+      const unsigned int labelsCols = labels.getColumnsNumber();
+
+      if( ( band >= raster.getNumberOfBands() ) ||
+        ( xStart + labelsCols > raster.getNumberOfColumns() ) ||
+        ( yStart + labelsRows > raster.getNumberOfRows() ) ) {
+        return false;
+      }
+
+      if( ( labelsRows == 0 ) || ( labelsCols == 0 ) ) {
+        return true;
+      }
+
+      const te::rst::Band& rasterBand = *raster.getBand( band );
+      const te::rst::BandProperty& bandProperty = *rasterBand.getProperty();
+      unsigned int row = 0;
+      unsigned int col = 0;
+
+      if( ( bandProperty.m_type != te::dt::UINT32_TYPE ) ||
+        ( bandProperty.m_blkw <= 0 ) || ( bandProperty.m_blkh <= 0 ) ) {
+        double value = 0;
+
+        for( row = 0; row < labelsRows; ++row ) {
+          unsigned int* labelsLinePtr = labels[row];
+
+          for( col = 0; col < labelsCols; ++col ) {
+            rasterBand.getValue( xStart + col, yStart + row, value );
+            labelsLinePtr[col] = (unsigned int)value;
+          }
+        }
+
+        return true;
+      }
+
+      const unsigned int blockWidth = (unsigned int)bandProperty.m_blkw;
+      const unsigned int blockHeight = (unsigned int)bandProperty.m_blkh;
+      const unsigned int blockXStart = xStart / blockWidth;
+      const unsigned int blockXEnd = ( xStart + labelsCols - 1 ) / blockWidth;
+      const unsigned int blockYStart = yStart / blockHeight;
+      const unsigned int blockYEnd = ( yStart + labelsRows - 1 ) / blockHeight;
+
+      std::vector< unsigned int > blockBuffer( blockWidth * blockHeight );
+
+      for( unsigned int blockY = blockYStart; blockY <= blockYEnd; ++blockY ) {
+        // region lines inside this blocks line
+        const unsigned int rowStart = std::max( yStart, blockY * blockHeight );
+        const unsigned int rowBound = std::min( yStart + labelsRows, ( blockY + 1 ) * blockHeight );
+
+        for( unsigned int blockX = blockXStart; blockX <= blockXEnd; ++blockX ) {
+          const unsigned int colStart = std::max( xStart, blockX * blockWidth );
+          const unsigned int colBound = std::min( xStart + labelsCols, ( blockX + 1 ) * blockWidth );
+
+          rasterBand.read( (int)blockX, (int)blockY, &blockBuffer[0] );
+
+          for( row = rowStart; row < rowBound; ++row ) {
+            unsigned int* labelsLinePtr = labels[row - yStart];
+            const unsigned int* blockLinePtr = &blockBuffer[( row - blockY * blockHeight ) * blockWidth];
+
+            for( col = colStart; col < colBound; ++col ) {
+              labelsLinePtr[col - xStart] = blockLinePtr[col - blockX * blockWidth];
+            }
+          }
+        }
+      }
+
+      return true;
+    }
+
+    bool RelabelBlock( const std::vector< std::pair< unsigned int, unsigned int > >& newLabels,
+      const unsigned int blockX, const unsigned int blockY,
+      te::rst::Raster& raster, const unsigned int band )
+    {
+      if( band >= raster.getNumberOfBands() ) {
+        return false;
+      }
+
+      te::rst::Band& rasterBand = *raster.getBand( band );
+      const te::rst::BandProperty& bandProperty = *rasterBand.getProperty();
+
+      if( ( bandProperty.m_type != te::dt::UINT32_TYPE ) ||
+        ( bandProperty.m_blkw <= 0 ) || ( bandProperty.m_blkh <= 0 ) ||
+        ( (int)blockX >= bandProperty.m_nblocksx ) || ( (int)blockY >= bandProperty.m_nblocksy ) ) {
+        return false;
+      }
+
+      if( newLabels.empty() ) {
+        return true;
+      }
+
+      std::vector< unsigned int > blockBuffer( bandProperty.m_blkw * bandProperty.m_blkh );
+      std::vector< std::pair< unsigned int, unsigned int > >::const_iterator newLabelsIt;
+      const std::vector< std::pair< unsigned int, unsigned int > >::const_iterator newLabelsEnd =
+        newLabels.end();
+      bool blockChanged = false;
+
+      rasterBand.read( (int)blockX, (int)blockY, &blockBuffer[0] );
+
+      for( std::vector< unsigned int >::iterator blockIt = blockBuffer.begin();
+        blockIt != blockBuffer.end(); ++blockIt ) {
+        // labels out of the replacements range are skipped without a search
+        if( ( *blockIt < newLabels.front().first ) || ( *blockIt > newLabels.back().first ) ) {
+          continue;
+        }
+
+        newLabelsIt = std::lower_bound( newLabels.begin(), newLabelsEnd,
+          std::pair< unsigned int, unsigned int >( *blockIt, 0 ) );
+
+        if( ( newLabelsIt != newLabelsEnd ) && ( newLabelsIt->first == *blockIt ) ) {
+          *blockIt = newLabelsIt->second;
+          blockChanged = true;
+        }
+      }
+
+      if( blockChanged ) {
+        rasterBand.write( (int)blockX, (int)blockY, &blockBuffer[0] );
+      }
+
+      return true;
+    }
+
+    bool ReadBandsRegion( const te::rst::Raster& raster,
+      const std::vector< unsigned int >& bands,
+      const unsigned int xStart, const unsigned int yStart,
+      const unsigned int width, const unsigned int height,
+      std::complex< double >* values )
+    {
+      if( ( xStart + width > raster.getNumberOfColumns() ) ||
+        ( yStart + height > raster.getNumberOfRows() ) ) {
+        return false;
+      }
+
+      if( ( width == 0 ) || ( height == 0 ) ) {
+        return true;
+      }
+
+      const std::size_t planeSize = ((std::size_t)width) * ((std::size_t)height);
+      std::vector< unsigned char > blockBuffer;
+      unsigned int row = 0;
+      unsigned int col = 0;
+
+      for( unsigned int bandIdx = 0; bandIdx < bands.size(); ++bandIdx ) {
+        if( bands[bandIdx] >= raster.getNumberOfBands() ) {
+          return false;
+        }
+
+        const te::rst::Band& rasterBand = *raster.getBand( bands[bandIdx] );
+        const te::rst::BandProperty& bandProperty = *rasterBand.getProperty();
+        std::complex< double >* planePtr = values + bandIdx * planeSize;
+
+        const bool isBlockReadable = ( bandProperty.m_blkw > 0 ) && ( bandProperty.m_blkh > 0 ) &&
+          ( ( bandProperty.m_type == te::dt::FLOAT_TYPE ) ||
+          ( bandProperty.m_type == te::dt::DOUBLE_TYPE ) ||
+          ( bandProperty.m_type == te::dt::CFLOAT_TYPE ) ||
+          ( bandProperty.m_type == te::dt::CDOUBLE_TYPE ) );
+
+        if( !isBlockReadable ) {
+          for( row = 0; row < height; ++row ) {
+            for( col = 0; col < width; ++col ) {
+              rasterBand.getValue( xStart + col, yStart + row, planePtr[row * width + col] );
+            }
+          }
+
+          continue;
+        }
+
+        const unsigned int blockWidth = (unsigned int)bandProperty.m_blkw;
+        const unsigned int blockHeight = (unsigned int)bandProperty.m_blkh;
+        const unsigned int blockXStart = xStart / blockWidth;
+        const unsigned int blockXEnd = ( xStart + width - 1 ) / blockWidth;
+        const unsigned int blockYStart = yStart / blockHeight;
+        const unsigned int blockYEnd = ( yStart + height - 1 ) / blockHeight;
+
+        blockBuffer.resize( (std::size_t)rasterBand.getBlockSize() );
+
+        for( unsigned int blockY = blockYStart; blockY <= blockYEnd; ++blockY ) {
+          // region lines inside this blocks line
+          const unsigned int rowStart = std::max( yStart, blockY * blockHeight );
+          const unsigned int rowBound = std::min( yStart + height, ( blockY + 1 ) * blockHeight );
+
+          for( unsigned int blockX = blockXStart; blockX <= blockXEnd; ++blockX ) {
+            const unsigned int colStart = std::max( xStart, blockX * blockWidth );
+            const unsigned int colBound = std::min( xStart + width, ( blockX + 1 ) * blockWidth );
+
+            rasterBand.read( (int)blockX, (int)blockY, &blockBuffer[0] );
+
+            switch( bandProperty.m_type ) {
+              case te::dt::FLOAT_TYPE:
+                CopyBlockRegion( (const float*)&blockBuffer[0], blockWidth, blockX * blockWidth,
+                  blockY * blockHeight, colStart, colBound, rowStart, rowBound, xStart, yStart,
+                  width, planePtr );
+                break;
+              case te::dt::DOUBLE_TYPE:
+                CopyBlockRegion( (const double*)&blockBuffer[0], blockWidth, blockX * blockWidth,
+                  blockY * blockHeight, colStart, colBound, rowStart, rowBound, xStart, yStart,
+                  width, planePtr );
+                break;
+              case te::dt::CFLOAT_TYPE:
+                CopyBlockRegion( (const std::complex< float >*)&blockBuffer[0], blockWidth,
+                  blockX * blockWidth, blockY * blockHeight, colStart, colBound, rowStart,
+                  rowBound, xStart, yStart, width, planePtr );
+                break;
+              default:
+                CopyBlockRegion( (const std::complex< double >*)&blockBuffer[0], blockWidth,
+                  blockX * blockWidth, blockY * blockHeight, colStart, colBound, rowStart,
+                  rowBound, xStart, yStart, width, planePtr );
+                break;
+            }
+          }
+        }
+      }
+
+      return true;
+    }
   }
 }
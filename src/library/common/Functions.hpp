@@ -15,6 +15,12 @@ TerraRadar is under development.
 
 // TerraLib Includes
 #include <terralib/raster.h>
+#include <terralib/rp/Matrix.h>
+
+// STL Includes
+#include <complex>
+#include <utility>
+#include <vector>
 
 // TerraRadar Includes
 #include "config.hpp"
@@ -31,6 +37,95 @@ namespace teradar {
       bool CopyComplex2DiskRaster( const te::rst::Raster& inputRaster,
         const std::string& fileName );
 
+    /*!
+      \brief Fill a raster band with zeros, writing whole blocks at once.
+      \param raster The raster to fill.
+      \param band The band index.
+      \return true if OK, false on errors.
+    */
+    TERADARCOMMONEXPORT
+      bool FillRasterBandWithZeros( te::rst::Raster& raster, const unsigned int band );
+
+    /*!
+      \brief Write the non-zero labels of a labels matrix into a raster band region.
+
+      \details Each raster block intersecting the region is read, updated
+      and written once. Labels equal to zero keep the current raster values.
+      Bands whose data type is not te::dt::UINT32_TYPE are written pixel by pixel.
+
+      \param labels The labels matrix.
+      \param xStart The raster column of the first matrix column.
+      \param yStart The raster line of the first matrix line.
+      \param raster The output raster.
+      \param band The output band index.
+      \return true if OK, false on errors.
+    */
+    TERADARCOMMONEXPORT
+      bool WriteLabelsRegion( const te::rp::Matrix< unsigned int >& labels,
+        const unsigned int xStart, const unsigned int yStart,
+        te::rst::Raster& raster, const unsigned int band );
+
+    /*!
+      \brief Read the labels of a raster band region into a labels matrix.
+
+      \details Each raster block intersecting the region is read once.
+      Bands whose data type is not te::dt::UINT32_TYPE are read pixel by pixel.
+
+      \param raster The input raster.
+      \param band The input band index.
+      \param xStart The raster column of the first matrix column.
+      \param yStart The raster line of the first matrix line.
+      \param labels The labels matrix (output), its size is the region size.
+      \return true if OK, false on errors.
+    */
+    TERADARCOMMONEXPORT
+      bool ReadLabelsRegion( const te::rst::Raster& raster, const unsigned int band,
+        const unsigned int xStart, const unsigned int yStart,
+        te::rp::Matrix< unsigned int >& labels );
+
+    /*!
+      \brief Replace the labels of a raster band block.
+
+      \details The block is read, updated and written once. Labels not found
+      in the replacements keep their values. Only bands whose data type is
+      te::dt::UINT32_TYPE and with a known block size are supported.
+
+      \param newLabels The (current label, new label) replacements, sorted by the current labels.
+      \param blockX The block column index.
+      \param blockY The block line index.
+      \param raster The labels raster.
+      \param band The labels band index.
+      \return true if OK, false on errors.
+    */
+    TERADARCOMMONEXPORT
+      bool RelabelBlock( const std::vector< std::pair< unsigned int, unsigned int > >& newLabels,
+        const unsigned int blockX, const unsigned int blockY,
+        te::rst::Raster& raster, const unsigned int band );
+
+    /*!
+      \brief Read a region of many raster bands into band sequential planes.
+
+      \details Each raster block intersecting the region is read once per
+      band. Bands whose data type is not a float or complex float type are
+      read pixel by pixel.
+
+      \param raster The input raster.
+      \param bands The bands indexes.
+      \param xStart The first region column.
+      \param yStart The first region line.
+      \param width The region width.
+      \param height The region height.
+      \param values The output values, values[ ( bandIdx * height + line ) * width + column ],
+      it must hold bands.size() * width * height values.
+      \return true if OK, false on errors.
+    */
+    TERADARCOMMONEXPORT
+      bool ReadBandsRegion( const te::rst::Raster& raster,
+        const std::vector< unsigned int >& bands,
+        const unsigned int xStart, const unsigned int yStart,
+        const unsigned int width, const unsigned int height,
+        std::complex< double >* values );
+
     /*!
       \brief Convert to string.
       \param t What to convert.
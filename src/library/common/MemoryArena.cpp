@@ -0,0 +1,176 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+  \file terraradar/library/common/MemoryArena.cpp
+  \brief A memory arena that holds many buffers in a single allocation.
+  */
+
+// TerraRadar includes
+#include "MemoryArena.hpp"
+
+// System includes
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+  const std::size_t HugePageSize = 2 * 1024 * 1024;
+
+  std::size_t RoundUp( const std::size_t value, const std::size_t multiple ) {
+    return ( ( value + multiple - 1 ) / multiple ) * multiple;
+  }
+
+  /*!
+    \brief Allocate page aligned memory directly from the system.
+    \param bytes Requested size, updated to the allocated size.
+    \param useHugePages Try to use huge pages.
+    \param hugePagesInUse True if huge pages were obtained.
+    \return A pointer to the memory or NULL on errors.
+  */
+  unsigned char* SystemAllocate( std::size_t& bytes, const bool useHugePages, bool& hugePagesInUse ) {
+    hugePagesInUse = false;
+
+#ifdef WIN32
+    if( useHugePages ) {
+      // requires the SeLockMemoryPrivilege, regular pages are used otherwise
+      const std::size_t largePageSize = GetLargePageMinimum();
+
+      if( largePageSize > 0 ) {
+        const std::size_t largeBytes = RoundUp( bytes, largePageSize );
+        void* data = VirtualAlloc( NULL, largeBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+          PAGE_READWRITE );
+
+        if( data != NULL ) {
+          bytes = largeBytes;
+          hugePagesInUse = true;
+          return static_cast<unsigned char*>( data );
+        }
+      }
+    }
+
+    return static_cast<unsigned char*>( VirtualAlloc( NULL, bytes, MEM_RESERVE | MEM_COMMIT,
+      PAGE_READWRITE ) );
+#else
+    if( useHugePages ) {
+      bytes = RoundUp( bytes, HugePageSize );
+
+#ifdef MAP_HUGETLB
+      // explicit huge pages, only available if reserved by the administrator
+      void* data = mmap( NULL, bytes, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+
+      if( data != MAP_FAILED ) {
+        hugePagesInUse = true;
+        return static_cast<unsigned char*>( data );
+      }
+#endif
+    }
+
+    void* data = mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+
+    if( data == MAP_FAILED ) {
+      return NULL;
+    }
+
+#ifdef MADV_HUGEPAGE
+    if( useHugePages ) {
+      // transparent huge pages
+      hugePagesInUse = ( madvise( data, bytes, MADV_HUGEPAGE ) == 0 );
+    }
+#endif
+
+    return static_cast<unsigned char*>( data );
+#endif
+  }
+
+  void SystemFree( unsigned char* data, const std::size_t bytes ) {
+#ifdef WIN32
+    VirtualFree( data, 0, MEM_RELEASE );
+#else
+    munmap( data, bytes );
+#endif
+  }
+}
+
+namespace teradar {
+  namespace common {
+    MemoryArena::MemoryArena( const bool useHugePages )
+      : m_useHugePages( useHugePages ),
+      m_hugePagesInUse( false ),
+      m_data( NULL ),
+      m_capacity( 0 ),
+      m_used( 0 ) {
+    }
+
+    MemoryArena::~MemoryArena() {
+      release();
+    }
+
+    bool MemoryArena::reserve( const std::size_t bytes ) {
+      if( bytes <= m_capacity ) {
+        return true;
+      }
+
+      release();
+
+      std::size_t allocatedBytes = bytes;
+      m_data = SystemAllocate( allocatedBytes, m_useHugePages, m_hugePagesInUse );
+
+      if( m_data == NULL ) {
+        m_hugePagesInUse = false;
+        return false;
+      }
+
+      m_capacity = allocatedBytes;
+
+      return true;
+    }
+
+    void* MemoryArena::allocate( const std::size_t bytes, const std::size_t alignment ) {
+      // the arena start is page aligned, so aligning the offset aligns the address
+      const std::size_t start = RoundUp( m_used, alignment );
+
+      if( ( m_data == NULL ) || ( start > m_capacity ) || ( bytes > m_capacity - start ) ) {
+        return NULL;
+      }
+
+      m_used = start + bytes;
+
+      return m_data + start;
+    }
+
+    void MemoryArena::reset() {
+      m_used = 0;
+    }
+
+    void MemoryArena::release() {
+      if( m_data != NULL ) {
+        SystemFree( m_data, m_capacity );
+      }
+
+      m_data = NULL;
+      m_capacity = 0;
+      m_used = 0;
+      m_hugePagesInUse = false;
+    }
+
+    std::size_t MemoryArena::getCapacity() const {
+      return m_capacity;
+    }
+
+    std::size_t MemoryArena::getUsed() const {
+      return m_used;
+    }
+
+    bool MemoryArena::usesHugePages() const {
+      return m_hugePagesInUse;
+    }
+  } // end namespace common
+} // end namespace teradar
@@ -0,0 +1,112 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+  \file terraradar/library/common/MemoryArena.hpp
+  \brief A memory arena that holds many buffers in a single allocation.
+  */
+
+#ifndef TERRARADAR_LIB_COMMON_INTERNAL_MEMORYARENA_HPP_
+#define TERRARADAR_LIB_COMMON_INTERNAL_MEMORYARENA_HPP_
+
+// TerraRadar includes
+#include "config.hpp"
+
+// STL includes
+#include <cstddef>
+
+namespace teradar {
+  namespace common {
+    /*!
+      \class MemoryArena
+      \brief Memory arena facility class.
+
+      \details Buffers are taken sequentially from one large aligned
+      allocation and are all given back at once by reset(). The allocation
+      is kept between resets, so the same arena may be reused by many
+      consecutive users without new system allocations. The memory is
+      released by release() or by the destructor.
+    */
+    class TERADARCOMMONEXPORT MemoryArena
+    {
+      public:
+        /*!
+          \brief Constructor.
+          \param useHugePages Try to back the arena with huge pages. If the
+          system does not provide them, regular pages are used.
+        */
+        MemoryArena( const bool useHugePages = false );
+
+        /// Destructor.
+        ~MemoryArena();
+
+        /*!
+          \brief Ensure the arena capacity.
+
+          \details If the current allocation is smaller than @a bytes, it is
+          replaced by a new one. All buffers previously taken from the arena
+          become invalid in this case.
+
+          \param bytes The required capacity, in bytes.
+          \return True if OK. False if the memory could not be allocated.
+        */
+        bool reserve( const std::size_t bytes );
+
+        /*!
+          \brief Take a buffer from the arena.
+          \param bytes The buffer size, in bytes.
+          \param alignment The buffer alignment, a power of 2 (default: 64 - cache line).
+          \return A pointer to the buffer, or NULL if the arena is exhausted.
+        */
+        void* allocate( const std::size_t bytes, const std::size_t alignment = 64 );
+
+        /*!
+          \brief Give back all the buffers taken from the arena, keeping its memory.
+        */
+        void reset();
+
+        /*!
+          \brief Release the arena memory.
+        */
+        void release();
+
+        /*!
+          \brief Return the arena capacity.
+          \return The arena capacity, in bytes.
+        */
+        std::size_t getCapacity() const;
+
+        /*!
+          \brief Return the number of bytes taken from the arena, including the alignment padding.
+          \return The used bytes.
+        */
+        std::size_t getUsed() const;
+
+        /*!
+          \brief Return if the arena memory is backed by huge pages.
+          \return True if huge pages were obtained or, for transparent huge
+          pages, successfully requested.
+        */
+        bool usesHugePages() const;
+
+      private:
+        /// Not copyable.
+        MemoryArena( const MemoryArena& );
+
+        /// Not copyable.
+        const MemoryArena& operator=( const MemoryArena& );
+
+        bool m_useHugePages; //!< Try to use huge pages.
+        bool m_hugePagesInUse; //!< The current allocation is backed by huge pages.
+        unsigned char* m_data; //!< The arena memory.
+        std::size_t m_capacity; //!< The arena memory size.
+        std::size_t m_used; //!< Number of bytes already taken.
+    };
+  } // end namespace common
+} // end namespace teradar
+
+#endif // TERRARADAR_LIB_COMMON_INTERNAL_MEMORYARENA_HPP_
@@ -13,8 +13,455 @@ TerraRadar is under development.
 // TerraRadar includes
 #include "MultiResolution.hpp"
 
+// TerraLib includes
+#include <terralib/raster/Utils.h>
+#include <terralib/rp/Macros.h>
+
+// STL includes
+#include <algorithm>
+
+namespace {
+  // Alignment of each level data inside the levels arena.
+  const size_t LevelsAlignment = 64;
+
+  /*
+   * Multilook helpers
+   */
+
+  // Reads lines from a multi resolution level, all bands at once.
+  // Values are band sequential: values[ band * columns + column - colStart ].
+  class LinesReader {
+    public:
+      virtual ~LinesReader() {}
+
+      virtual void read( unsigned int row, unsigned int colStart,
+        unsigned int colBound, std::vector< std::complex<double> >& values ) const = 0;
+  };
+
+  // Writes lines into a multi resolution level, all bands at once.
+  class LinesWriter {
+    public:
+      virtual ~LinesWriter() {}
+
+      virtual void write( unsigned int row, unsigned int colStart,
+        unsigned int colBound, const std::vector< std::complex<double> >& values ) = 0;
+  };
+
+  class RasterLinesReader : public LinesReader {
+    public:
+      RasterLinesReader( const te::rst::Raster& raster ) : m_raster( raster ) {}
+
+      void read( unsigned int row, unsigned int colStart,
+        unsigned int colBound, std::vector< std::complex<double> >& values ) const {
+        const unsigned int cols = colBound - colStart;
+        const unsigned int bands = (unsigned int)m_raster.getNumberOfBands();
+
+        values.resize( bands * cols );
+
+        for( unsigned int b = 0; b < bands; ++b ) {
+          const te::rst::Band& band = *m_raster.getBand( b );
+          std::complex<double>* valuesPtr = &values[ b * cols ];
+
+          for( unsigned int c = colStart; c < colBound; ++c ) {
+            band.getValue( c, row, *valuesPtr++ );
+          }
+        }
+      }
+
+    private:
+      const te::rst::Raster& m_raster;
+  };
+
+  class RasterLinesWriter : public LinesWriter {
+    public:
+      RasterLinesWriter( te::rst::Raster& raster ) : m_raster( raster ) {}
+
+      void write( unsigned int row, unsigned int colStart,
+        unsigned int colBound, const std::vector< std::complex<double> >& values ) {
+        const unsigned int cols = colBound - colStart;
+        const unsigned int bands = (unsigned int)m_raster.getNumberOfBands();
+
+        for( unsigned int b = 0; b < bands; ++b ) {
+          te::rst::Band& band = *m_raster.getBand( b );
+          const std::complex<double>* valuesPtr = &values[ b * cols ];
+
+          for( unsigned int c = colStart; c < colBound; ++c ) {
+            band.setValue( c, row, *valuesPtr++ );
+          }
+        }
+      }
+
+    private:
+      te::rst::Raster& m_raster;
+  };
+
+  // Reads lines from a set of tiles covering the lines and columns to be read.
+  class TilesLinesReader : public LinesReader {
+    public:
+      TilesLinesReader( const std::vector< teradar::common::MultiResolution::TilePtr >& tiles,
+        unsigned int tilesCols, unsigned int tileSize, unsigned int bands )
+        : m_tiles( tiles ), m_tilesCols( tilesCols ), m_tileSize( tileSize ),
+        m_bands( bands ) {}
+
+      void read( unsigned int row, unsigned int colStart,
+        unsigned int colBound, std::vector< std::complex<double> >& values ) const {
+        const unsigned int cols = colBound - colStart;
+        const teradar::common::MultiResolution::Tile& firstTile = *m_tiles[0];
+        const unsigned int tileY = ( row - firstTile.m_rowStart ) / m_tileSize;
+
+        values.resize( m_bands * cols );
+
+        unsigned int c = colStart;
+
+        while( c < colBound ) {
+          const unsigned int tileX = ( c - firstTile.m_colStart ) / m_tileSize;
+          const teradar::common::MultiResolution::Tile& tile =
+            *m_tiles[ tileY * m_tilesCols + tileX ];
+          const unsigned int tileRow = row - tile.m_rowStart;
+          const unsigned int tileColBound = std::min( colBound, tile.m_colStart + tile.m_cols );
+
+          for( unsigned int b = 0; b < m_bands; ++b ) {
+            std::copy( tile.getBandValues( b ) + tileRow * tile.m_cols + c - tile.m_colStart,
+              tile.getBandValues( b ) + tileRow * tile.m_cols + tileColBound - tile.m_colStart,
+              values.begin() + b * cols + c - colStart );
+          }
+
+          c = tileColBound;
+        }
+      }
+
+    private:
+      const std::vector< teradar::common::MultiResolution::TilePtr >& m_tiles;
+      unsigned int m_tilesCols;
+      unsigned int m_tileSize;
+      unsigned int m_bands;
+  };
+
+  // Writes lines into a tile.
+  class TileLinesWriter : public LinesWriter {
+    public:
+      TileLinesWriter( teradar::common::MultiResolution::Tile& tile ) : m_tile( tile ) {}
+
+      void write( unsigned int row, unsigned int colStart,
+        unsigned int colBound, const std::vector< std::complex<double> >& values ) {
+        const unsigned int cols = colBound - colStart;
+
+        for( unsigned int b = 0; b < m_tile.m_bands; ++b ) {
+          std::copy( values.begin() + b * cols, values.begin() + ( b + 1 ) * cols,
+            m_tile.m_values.begin() + ( b * m_tile.m_rows + row - m_tile.m_rowStart ) *
+            m_tile.m_cols + colStart - m_tile.m_colStart );
+        }
+      }
+
+    private:
+      teradar::common::MultiResolution::Tile& m_tile;
+  };
+
+  // Returns the clipped parent window [ start, bound ) of the level element
+  // idx, and the index of the first window weight inside the image.
+  void GetMultilookWindow( unsigned int idx, unsigned int factor,
+    unsigned int windowSize, unsigned int parentSize, unsigned int& start,
+    unsigned int& bound, unsigned int& weightsOffset ) {
+    const long int unclippedStart = (long int)idx * (long int)factor -
+      (long int)( ( windowSize - factor ) / 2 );
+
+    start = (unsigned int)std::max( 0l, unclippedStart );
+    bound = (unsigned int)std::min( (long int)parentSize,
+      unclippedStart + (long int)windowSize );
+    weightsOffset = (unsigned int)( (long int)start - unclippedStart );
+  }
+
+  // Returns the level elements [ start, bound ) whose windows intersect the
+  // parent elements [ parentStart, parentBound ).
+  void GetMultilookAffectedRange( unsigned int parentStart, unsigned int parentBound,
+    unsigned int factor, unsigned int windowSize, unsigned int levelSize,
+    unsigned int& start, unsigned int& bound ) {
+    const long int pad = (long int)( ( windowSize - factor ) / 2 );
+
+    // window [ idx * factor - pad, idx * factor - pad + windowSize ) intersects
+    // [ parentStart, parentBound ) when idx * factor > parentStart + pad - windowSize
+    // and idx * factor < parentBound + pad
+    const long int lowerLimit = (long int)parentStart + pad - (long int)windowSize;
+    const long int firstIdx = lowerLimit < 0 ? 0 : lowerLimit / (long int)factor + 1;
+    const long int lastIdx = ( (long int)parentBound + pad - 1 ) / (long int)factor;
+
+    start = (unsigned int)std::min( firstIdx, (long int)levelSize );
+    bound = (unsigned int)std::max( (long int)start, std::min( lastIdx + 1, (long int)levelSize ) );
+  }
+
+  // Computes the level lines [ rowStart, rowBound ) and columns
+  // [ colStart, colBound ) from the parent level lines given by reader.
+  // Both kernel directions are applied separately. Overlapping boxcar windows
+  // use running sums, so the cost per level pixel does not depend on the
+  // window size, non-overlapping ones (window size up to the factor) are
+  // summed directly. Each parent line is read only once.
+  void Multilook( const teradar::common::MultiResolution::Parameters& parameters,
+    const LinesReader& reader, unsigned int parentRows, unsigned int parentCols,
+    unsigned int bands, unsigned int rowStart, unsigned int rowBound,
+    unsigned int colStart, unsigned int colBound, LinesWriter& writer ) {
+    if( ( rowStart >= rowBound ) || ( colStart >= colBound ) ) {
+      return;
+    }
+
+    const unsigned int rowsWindowSize = parameters.getRowsWindowSize();
+    const unsigned int colsWindowSize = parameters.getColsWindowSize();
+    const bool rowsBoxcar = parameters.m_rowsWeights.empty();
+    const bool colsBoxcar = parameters.m_colsWeights.empty();
+    const bool rowsRunningSums = rowsBoxcar && ( rowsWindowSize > parameters.m_rowsFactor );
+    const bool colsPrefixSums = colsBoxcar && ( colsWindowSize > parameters.m_colsFactor );
+    const unsigned int cols = colBound - colStart;
+
+    // columns windows
+
+    std::vector< unsigned int > colsStarts( cols );
+    std::vector< unsigned int > colsBounds( cols );
+    std::vector< unsigned int > colsWeightsOffsets( cols );
+    std::vector< double > colsWeightsSums( cols );
+
+    for( unsigned int c = 0; c < cols; ++c ) {
+      GetMultilookWindow( colStart + c, parameters.m_colsFactor, colsWindowSize,
+        parentCols, colsStarts[c], colsBounds[c], colsWeightsOffsets[c] );
+
+      if( colsBoxcar ) {
+        colsWeightsSums[c] = (double)( colsBounds[c] - colsStarts[c] );
+      } else {
+        colsWeightsSums[c] = 0.;
+
+        for( unsigned int k = 0; k < colsBounds[c] - colsStarts[c]; ++k ) {
+          colsWeightsSums[c] += parameters.m_colsWeights[ colsWeightsOffsets[c] + k ];
+        }
+      }
+    }
+
+    const unsigned int parentColStart = colsStarts[0];
+    const unsigned int parentCols2Read = colsBounds[ cols - 1 ] - parentColStart;
+
+    // Horizontally reduced parent lines, one slot per window line.
+    std::vector< std::vector< std::complex<double> > > reducedLines( rowsWindowSize,
+      std::vector< std::complex<double> >( bands * cols ) );
+
+    // Running sums of the reduced lines inside the current window.
+    std::vector< std::complex<double> > runningSums( rowsRunningSums ? bands * cols : 0, 0. );
+
+    std::vector< std::complex<double> > parentLine;
+    std::vector< std::complex<double> > prefixSums( colsPrefixSums ? parentCols2Read + 1 : 0 );
+    std::vector< std::complex<double> > levelLine( bands * cols );
+
+    unsigned int windowStart = 0;
+    unsigned int windowBound = 0;
+    unsigned int weightsOffset = 0;
+    GetMultilookWindow( rowStart, parameters.m_rowsFactor, rowsWindowSize,
+      parentRows, windowStart, windowBound, weightsOffset );
+
+    // parent lines already added to the running sums: [ sumsStart, sumsBound )
+    unsigned int sumsStart = windowStart;
+    unsigned int sumsBound = windowStart;
+
+    for( unsigned int r = rowStart; r < rowBound; ++r ) {
+      GetMultilookWindow( r, parameters.m_rowsFactor, rowsWindowSize,
+        parentRows, windowStart, windowBound, weightsOffset );
+
+      // lines leaving the window
+
+      for( ; sumsStart < windowStart; ++sumsStart ) {
+        if( rowsRunningSums && ( sumsStart < sumsBound ) ) {
+          const std::vector< std::complex<double> >& reducedLine =
+            reducedLines[ sumsStart % rowsWindowSize ];
+
+          for( unsigned int i = 0; i < bands * cols; ++i ) {
+            runningSums[i] -= reducedLine[i];
+          }
+        }
+      }
+
+      sumsBound = std::max( sumsBound, sumsStart );
+
+      // lines entering the window
+
+      for( ; sumsBound < windowBound; ++sumsBound ) {
+        std::vector< std::complex<double> >& reducedLine =
+          reducedLines[ sumsBound % rowsWindowSize ];
+
+        reader.read( sumsBound, parentColStart, parentColStart + parentCols2Read,
+          parentLine );
+
+        for( unsigned int b = 0; b < bands; ++b ) {
+          const std::complex<double>* inPtr = &parentLine[ b * parentCols2Read ];
+          std::complex<double>* outPtr = &reducedLine[ b * cols ];
+
+          if( colsPrefixSums ) {
+            prefixSums[0] = 0.;
+
+            for( unsigned int i = 0; i < parentCols2Read; ++i ) {
+              prefixSums[ i + 1 ] = prefixSums[i] + inPtr[i];
+            }
+
+            for( unsigned int c = 0; c < cols; ++c ) {
+              outPtr[c] = prefixSums[ colsBounds[c] - parentColStart ] -
+                prefixSums[ colsStarts[c] - parentColStart ];
+            }
+          } else if( colsBoxcar ) {
+            for( unsigned int c = 0; c < cols; ++c ) {
+              const std::complex<double>* windowPtr = inPtr + colsStarts[c] - parentColStart;
+              std::complex<double> sum = 0.;
+
+              for( unsigned int k = 0; k < colsBounds[c] - colsStarts[c]; ++k ) {
+                sum += windowPtr[k];
+              }
+
+              outPtr[c] = sum;
+            }
+          } else {
+            for( unsigned int c = 0; c < cols; ++c ) {
+              const double* weightsPtr = &parameters.m_colsWeights[ colsWeightsOffsets[c] ];
+              const std::complex<double>* windowPtr = inPtr + colsStarts[c] - parentColStart;
+              std::complex<double> sum = 0.;
+
+              for( unsigned int k = 0; k < colsBounds[c] - colsStarts[c]; ++k ) {
+                sum += weightsPtr[k] * windowPtr[k];
+              }
+
+              outPtr[c] = sum;
+            }
+          }
+        }
+
+        if( rowsRunningSums ) {
+          for( unsigned int i = 0; i < bands * cols; ++i ) {
+            runningSums[i] += reducedLine[i];
+          }
+        }
+      }
+
+      // the level line
+
+      double rowsWeightsSum = 0.;
+
+      if( rowsRunningSums ) {
+        rowsWeightsSum = (double)( windowBound - windowStart );
+        levelLine = runningSums;
+      } else {
+        std::fill( levelLine.begin(), levelLine.end(), std::complex<double>( 0. ) );
+
+        for( unsigned int k = windowStart; k < windowBound; ++k ) {
+          const double weight = rowsBoxcar ? 1. :
+            parameters.m_rowsWeights[ weightsOffset + k - windowStart ];
+          const std::vector< std::complex<double> >& reducedLine =
+            reducedLines[ k % rowsWindowSize ];
+
+          rowsWeightsSum += weight;
+
+          for( unsigned int i = 0; i < bands * cols; ++i ) {
+            levelLine[i] += weight * reducedLine[i];
+          }
+        }
+      }
+
+      for( unsigned int b = 0; b < bands; ++b ) {
+        std::complex<double>* linePtr = &levelLine[ b * cols ];
+
+        for( unsigned int c = 0; c < cols; ++c ) {
+          linePtr[c] /= ( colsWeightsSums[c] * rowsWeightsSum );
+        }
+      }
+
+      writer.write( r, colStart, colBound, levelLine );
+    }
+  }
+} // end namespace
+
 namespace teradar {
   namespace common {
+    /*
+     * MultiResolution::Parameters
+     */
+    MultiResolution::Parameters::Parameters() {
+      reset();
+    }
+
+    MultiResolution::Parameters::~Parameters() {
+    }
+
+    void MultiResolution::Parameters::reset() {
+      m_rowsFactor = 2;
+      m_colsFactor = 2;
+      m_rowsWindowSize = 0;
+      m_colsWindowSize = 0;
+      m_rowsWeights.clear();
+      m_colsWeights.clear();
+      m_createLevels = true;
+      m_tileSize = 256;
+      m_maxCachedTiles = 256;
+      m_useHugePages = false;
+    }
+
+    unsigned int MultiResolution::Parameters::getRowsWindowSize() const {
+      return m_rowsWindowSize == 0 ? m_rowsFactor : m_rowsWindowSize;
+    }
+
+    unsigned int MultiResolution::Parameters::getColsWindowSize() const {
+      return m_colsWindowSize == 0 ? m_colsFactor : m_colsWindowSize;
+    }
+
+    bool MultiResolution::Parameters::isValid() const {
+      if( ( m_rowsFactor == 0 ) || ( m_colsFactor == 0 ) ) {
+        return false;
+      }
+
+      if( ( getRowsWindowSize() < m_rowsFactor ) || ( getColsWindowSize() < m_colsFactor ) ) {
+        return false;
+      }
+
+      if( m_tileSize == 0 ) {
+        return false;
+      }
+
+      if( !m_rowsWeights.empty() && ( m_rowsWeights.size() != getRowsWindowSize() ) ) {
+        return false;
+      }
+
+      if( !m_colsWeights.empty() && ( m_colsWeights.size() != getColsWindowSize() ) ) {
+        return false;
+      }
+
+      for( size_t i = 0; i < m_rowsWeights.size(); ++i ) {
+        if( m_rowsWeights[i] <= 0. ) {
+          return false;
+        }
+      }
+
+      for( size_t i = 0; i < m_colsWeights.size(); ++i ) {
+        if( m_colsWeights[i] <= 0. ) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    /*
+     * MultiResolution::Tile
+     */
+    const std::complex<double>* MultiResolution::Tile::getBandValues( unsigned int band ) const {
+      assert( band < m_bands );
+      return &m_values[ band * m_rows * m_cols ];
+    }
+
+    /*
+     * MultiResolution::TileKey
+     */
+    bool MultiResolution::TileKey::operator<( const TileKey& other ) const {
+      if( m_level != other.m_level ) {
+        return m_level < other.m_level;
+      }
+
+      if( m_tileY != other.m_tileY ) {
+        return m_tileY < other.m_tileY;
+      }
+
+      return m_tileX < other.m_tileX;
+    }
+
     /*
      * MultiResolution
      */
@@ -45,99 +492,110 @@ namespace teradar {
 
       createLevels();
     }
+
+    MultiResolution::MultiResolution( const te::rst::Raster& inputRaster,
+      size_t levels,
+      const Parameters& parameters,
+      const bool enableProgressInterface )
+      : m_parameters( parameters ),
+      m_enableProgress( enableProgressInterface ) {
+      TERP_TRUE_OR_THROW( m_parameters.isValid(), "Invalid multilook parameters" );
+
+      m_levels.resize( levels + 1 );
+      m_levels[0] = const_cast<te::rst::Raster*>(&inputRaster);
+
+      createLevels();
+    }
 	
+    MultiResolution::MultiResolution( const te::rst::Raster& inputRaster,
+      size_t levels,
+      const Parameters& parameters,
+      const boost::shared_ptr< MemoryArena >& arena,
+      const bool enableProgressInterface )
+      : m_parameters( parameters ),
+      m_enableProgress( enableProgressInterface ),
+      m_arena( arena ) {
+      TERP_TRUE_OR_THROW( m_parameters.isValid(), "Invalid multilook parameters" );
+      TERP_TRUE_OR_THROW( m_arena.get(), "Invalid memory arena" );
+
+      m_levels.resize( levels + 1 );
+      m_levels[0] = const_cast<te::rst::Raster*>(&inputRaster);
+
+      createLevels();
+    }
+
     MultiResolution::~MultiResolution() {
-      // @todo - etore - complete
+      remove();
     }
 
     void MultiResolution::createLevel( const te::rst::Raster& srcRaster,
       te::rst::Raster& dstRaster ) {
       // this code assumes that the dstRaster have been created in the correct size
-      // that is the half number of columns and lines from srcRaster, and same
-      // number of bands
+      // that is the number of columns and lines from srcRaster divided by the
+      // multilook factors, and same number of bands
 
-      // Each pixel in the dstRaster has the mean between 4 pixels from srcRaster,
-      // if applicable. If in the border, the number can be lower than 4.
+      // Each pixel in the dstRaster has the (weighted) mean of a window of
+      // pixels from srcRaster. If in the border, the window is clipped.
 
-      // For instance:
+      // For instance, with the default 2x2 boxcar:
       // pixel dstRaster(0,0) contains the mean of srcRaster pixels (0,0), (0,1), (1,0) and (1,1)
       //
       // pixel dstRaster(0,1) contains the mean of srcRaster pixels (0,2), (0,3), (1,2) and (1,3)
       //
       // pixel dstRaster(1,0) contains the mean of srcRaster pixels (2,0), (2,1), (3,0) and (3,1)
 
-      // @todo - etore - should we check it?
-      size_t bands = dstRaster.getNumberOfBands();
-
-      unsigned int srcCols = srcRaster.getNumberOfColumns();
-      unsigned int srcRows = srcRaster.getNumberOfRows();
-
-      unsigned int dstCols = dstRaster.getNumberOfColumns();
-      unsigned int dstRows = dstRaster.getNumberOfRows();
-
-      std::complex<double> value = 0.;
+      RasterLinesReader reader( srcRaster );
+      RasterLinesWriter writer( dstRaster );
 
-      for( unsigned int c = 0; c < dstCols; ++c ) {
-        unsigned int cr = c * 2;
-
-        for( unsigned int r = 0; r < dstRows; ++r ) {
-          unsigned int rr = r * 2;
-
-          for( unsigned int b = 0; b < bands; ++b ) {
-            std::complex<double> mean = 0.;
-            unsigned int pixelCount = 0;
-
-            unsigned int colToRead = cr;
-            unsigned int rowToRead = rr;
+      Multilook( m_parameters, reader, srcRaster.getNumberOfRows(),
+        srcRaster.getNumberOfColumns(), (unsigned int)dstRaster.getNumberOfBands(),
+        0, dstRaster.getNumberOfRows(), 0, dstRaster.getNumberOfColumns(),
+        writer );
+    }
 
-            if( colToRead < srcCols && rowToRead < srcRows ) {
-              srcRaster.getValue( colToRead, rowToRead, value, b );
-              mean += value;
-              ++pixelCount;
-            }
+    void MultiResolution::createLevels() {
+      m_levelsRows.resize( m_levels.size() );
+      m_levelsCols.resize( m_levels.size() );
 
-            rowToRead = rr + 1;
+      m_levelsRows[0] = m_levels[0]->getNumberOfRows();
+      m_levelsCols[0] = m_levels[0]->getNumberOfColumns();
 
-            if( colToRead < srcCols && rowToRead < srcRows ) {
-              srcRaster.getValue( colToRead, rowToRead, value, b );
-              mean += value;
-              ++pixelCount;
-            }
+      for( size_t l = 1; l < m_levels.size(); ++l ) {
+        m_levelsRows[l] = m_levelsRows[l - 1] / m_parameters.m_rowsFactor;
+        m_levelsCols[l] = m_levelsCols[l - 1] / m_parameters.m_colsFactor;
+        m_levels[l] = NULL;
+      }
 
-            colToRead = cr + 1;
+      if( ( m_levels.size() == 1 ) || !m_parameters.m_createLevels ) {
+        // nothing to be done
+        return;
+      }
 
-            if( colToRead < srcCols && rowToRead < srcRows ) {
-              srcRaster.getValue( colToRead, rowToRead, value, b );
-              mean += value;
-              ++pixelCount;
-            }
+      // All levels data are held by one arena allocation, each level
+      // raster stores its bands contiguously, one block per band
 
-            rowToRead = rr;
+      const size_t bandsNumber = m_levels[0]->getNumberOfBands();
+      size_t pixelBytes = 0;
 
-            if( colToRead < srcCols && rowToRead < srcRows ) {
-              srcRaster.getValue( colToRead, rowToRead, value, b );
-              mean += value;
-              ++pixelCount;
-            }
+      for( size_t b = 0; b < bandsNumber; ++b ) {
+        pixelBytes += (size_t)te::rst::GetPixelSize( m_levels[0]->getBandDataType( b ) );
+      }
 
-            if( pixelCount == 0 ) {
-              // @todo - etore - create a message ou anything to warn
-              assert( false );
-            }
+      std::vector< size_t > levelsBytes( m_levels.size(), 0 );
+      size_t totalBytes = 0;
 
-            mean /= (double)pixelCount;
-            dstRaster.setValue( c, r, mean, b );
-          }
-        }
+      for( size_t l = 1; l < m_levels.size(); ++l ) {
+        levelsBytes[l] = pixelBytes * (size_t)m_levelsRows[l] * (size_t)m_levelsCols[l];
+        totalBytes += levelsBytes[l] + LevelsAlignment;
       }
-    }
 
-    void MultiResolution::createLevels() {
-      if( m_levels.size() == 1 ) {
-        // nothing to be done
-        return;
+      if( m_arena.get() == NULL ) {
+        m_arena.reset( new MemoryArena( m_parameters.m_useHugePages ) );
       }
 
+      m_arena->reset();
+      TERP_TRUE_OR_THROW( m_arena->reserve( totalBytes ), "Levels memory allocation error" );
+
       // @todo - etore - handle progress
 
       for( size_t l = 1; l < m_levels.size(); ++l ) {
@@ -152,22 +610,30 @@ namespace teradar {
         for( size_t b = 0; b < srcRasterBands; ++b ) {
           bandsProperties.push_back( new te::rst::BandProperty
             ( *(srcRaster->getBand( b )->getProperty()) ) );
+
+          bandsProperties[b]->m_blkw = m_levelsCols[l];
+          bandsProperties[b]->m_blkh = m_levelsRows[l];
+          bandsProperties[b]->m_nblocksx = 1;
+          bandsProperties[b]->m_nblocksy = 1;
         }
 
         // read the grid
         te::rst::Grid* dstGrid = new te::rst::Grid( *(srcRaster->getGrid()) );
 
         // change the size
-        unsigned int nCols = dstGrid->getNumberOfColumns() / 2;
-        unsigned int nRows = dstGrid->getNumberOfRows() / 2;
-        dstGrid->setNumberOfRows( nRows );
-        dstGrid->setNumberOfColumns( nCols );
+        dstGrid->setNumberOfRows( m_levelsRows[l] );
+        dstGrid->setNumberOfColumns( m_levelsCols[l] );
 
         // read the raster info
         std::map<std::string, std::string> dstInfo = srcRaster->getInfo();
 
+        void* levelData = m_arena->allocate( levelsBytes[l], LevelsAlignment );
+        TERP_TRUE_OR_THROW( levelData, "Levels memory allocation error" );
+
+        // the arena keeps the data ownership, no deleter is given
         te::rst::Raster* levelRaster( te::rst::RasterFactory::make
-          ( "MEM", dstGrid, bandsProperties, dstInfo ) );
+          ( "MEM", dstGrid, bandsProperties, dstInfo, levelData, 0 ) );
+        TERP_TRUE_OR_THROW( levelRaster, "Level raster creation error" );
 
         createLevel( *srcRaster, *levelRaster );
 
@@ -175,6 +641,101 @@ namespace teradar {
       }
     }
 
+    MultiResolution::TilePtr MultiResolution::createTile( size_t level,
+      unsigned int tileX, unsigned int tileY ) const {
+      const unsigned int tileSize = m_parameters.m_tileSize;
+
+      Tile* tilePtr = new Tile;
+      TilePtr tile( tilePtr );
+
+      tilePtr->m_level = level;
+      tilePtr->m_rowStart = tileY * tileSize;
+      tilePtr->m_colStart = tileX * tileSize;
+      tilePtr->m_rows = std::min( tileSize, m_levelsRows[level] - tilePtr->m_rowStart );
+      tilePtr->m_cols = std::min( tileSize, m_levelsCols[level] - tilePtr->m_colStart );
+      tilePtr->m_bands = (unsigned int)m_levels[0]->getNumberOfBands();
+      tilePtr->m_values.resize( tilePtr->m_bands * tilePtr->m_rows * tilePtr->m_cols );
+
+      TileLinesWriter writer( *tilePtr );
+
+      if( m_levels[level] != NULL ) {
+        // copy from the level raster
+
+        boost::unique_lock<boost::mutex> lock( m_inputRasterMutex, boost::defer_lock );
+
+        if( level == 0 ) {
+          lock.lock();
+        }
+
+        RasterLinesReader reader( *m_levels[level] );
+        std::vector< std::complex<double> > values;
+
+        for( unsigned int r = tilePtr->m_rowStart; r < tilePtr->m_rowStart + tilePtr->m_rows; ++r ) {
+          reader.read( r, tilePtr->m_colStart, tilePtr->m_colStart + tilePtr->m_cols, values );
+          writer.write( r, tilePtr->m_colStart, tilePtr->m_colStart + tilePtr->m_cols, values );
+        }
+      } else if( m_levels[level - 1] != NULL ) {
+        // multilook from the parent level raster
+
+        boost::unique_lock<boost::mutex> lock( m_inputRasterMutex, boost::defer_lock );
+
+        if( level == 1 ) {
+          lock.lock();
+        }
+
+        RasterLinesReader reader( *m_levels[level - 1] );
+
+        Multilook( m_parameters, reader, m_levelsRows[level - 1], m_levelsCols[level - 1],
+          tilePtr->m_bands, tilePtr->m_rowStart, tilePtr->m_rowStart + tilePtr->m_rows,
+          tilePtr->m_colStart, tilePtr->m_colStart + tilePtr->m_cols, writer );
+      } else {
+        // multilook from the parent level tiles covering the tile windows
+
+        unsigned int parentRowStart = 0;
+        unsigned int parentRowBound = 0;
+        unsigned int parentColStart = 0;
+        unsigned int parentColBound = 0;
+        unsigned int start = 0;
+        unsigned int bound = 0;
+        unsigned int weightsOffset = 0;
+
+        GetMultilookWindow( tilePtr->m_rowStart, m_parameters.m_rowsFactor,
+          m_parameters.getRowsWindowSize(), m_levelsRows[level - 1], parentRowStart,
+          bound, weightsOffset );
+        GetMultilookWindow( tilePtr->m_rowStart + tilePtr->m_rows - 1, m_parameters.m_rowsFactor,
+          m_parameters.getRowsWindowSize(), m_levelsRows[level - 1], start,
+          parentRowBound, weightsOffset );
+        GetMultilookWindow( tilePtr->m_colStart, m_parameters.m_colsFactor,
+          m_parameters.getColsWindowSize(), m_levelsCols[level - 1], parentColStart,
+          bound, weightsOffset );
+        GetMultilookWindow( tilePtr->m_colStart + tilePtr->m_cols - 1, m_parameters.m_colsFactor,
+          m_parameters.getColsWindowSize(), m_levelsCols[level - 1], start,
+          parentColBound, weightsOffset );
+
+        const unsigned int parentTileXStart = parentColStart / tileSize;
+        const unsigned int parentTileXBound = ( parentColBound - 1 ) / tileSize + 1;
+        const unsigned int parentTileYStart = parentRowStart / tileSize;
+        const unsigned int parentTileYBound = ( parentRowBound - 1 ) / tileSize + 1;
+
+        std::vector< TilePtr > parentTiles;
+
+        for( unsigned int ty = parentTileYStart; ty < parentTileYBound; ++ty ) {
+          for( unsigned int tx = parentTileXStart; tx < parentTileXBound; ++tx ) {
+            parentTiles.push_back( getTile( level - 1, tx, ty ) );
+          }
+        }
+
+        TilesLinesReader reader( parentTiles, parentTileXBound - parentTileXStart,
+          tileSize, tilePtr->m_bands );
+
+        Multilook( m_parameters, reader, m_levelsRows[level - 1], m_levelsCols[level - 1],
+          tilePtr->m_bands, tilePtr->m_rowStart, tilePtr->m_rowStart + tilePtr->m_rows,
+          tilePtr->m_colStart, tilePtr->m_colStart + tilePtr->m_cols, writer );
+      }
+
+      return tile;
+    }
+
     size_t MultiResolution::getNumberOfLevels() const
     {
       return m_levels.size();
@@ -199,6 +760,147 @@ namespace teradar {
           m_levels[i] = NULL;
         }
       }
+
+      // no level raster references the arena memory anymore
+      if( m_arena.get() != NULL ) {
+        m_arena->reset();
+      }
+    }
+
+    MultiResolution::TilePtr MultiResolution::getTile( size_t level,
+      unsigned int tileX, unsigned int tileY ) const
+    {
+      unsigned int tilesX = 0;
+      unsigned int tilesY = 0;
+
+      if( !getNumberOfTiles( level, tilesX, tilesY ) || ( tileX >= tilesX ) ||
+        ( tileY >= tilesY ) ) {
+        return TilePtr();
+      }
+
+      TileKey key;
+      key.m_level = level;
+      key.m_tileX = tileX;
+      key.m_tileY = tileY;
+
+      {
+        boost::lock_guard<boost::mutex> lock( m_tilesMutex );
+
+        TilesCacheT::iterator it = m_tiles.find( key );
+
+        if( it != m_tiles.end() ) {
+          m_tilesUsage.splice( m_tilesUsage.begin(), m_tilesUsage, it->second.second );
+          return it->second.first;
+        }
+      }
+
+      // The tile is created without locking the cache, concurrent callers
+      // asking for the same tile may create it twice, the first one is kept.
+
+      TilePtr tile = createTile( level, tileX, tileY );
+
+      boost::lock_guard<boost::mutex> lock( m_tilesMutex );
+
+      TilesCacheT::iterator it = m_tiles.find( key );
+
+      if( it != m_tiles.end() ) {
+        return it->second.first;
+      }
+
+      m_tilesUsage.push_front( key );
+      m_tiles[ key ] = std::make_pair( tile, m_tilesUsage.begin() );
+
+      while( m_tiles.size() > m_parameters.m_maxCachedTiles ) {
+        m_tiles.erase( m_tilesUsage.back() );
+        m_tilesUsage.pop_back();
+      }
+
+      return tile;
+    }
+
+    bool MultiResolution::update( unsigned int xStart, unsigned int yStart,
+      unsigned int xBound, unsigned int yBound )
+    {
+      if( ( xStart >= xBound ) || ( yStart >= yBound ) ||
+        ( xBound > m_levelsCols[0] ) || ( yBound > m_levelsRows[0] ) ) {
+        return false;
+      }
+
+      invalidateTiles( 0, xStart, yStart, xBound, yBound );
+
+      for( size_t l = 1; l < m_levels.size(); ++l ) {
+        // the previous level region becomes the touched level pixels
+        unsigned int levelXStart = 0;
+        unsigned int levelXBound = 0;
+        unsigned int levelYStart = 0;
+        unsigned int levelYBound = 0;
+
+        GetMultilookAffectedRange( xStart, xBound, m_parameters.m_colsFactor,
+          m_parameters.getColsWindowSize(), m_levelsCols[l], levelXStart, levelXBound );
+        GetMultilookAffectedRange( yStart, yBound, m_parameters.m_rowsFactor,
+          m_parameters.getRowsWindowSize(), m_levelsRows[l], levelYStart, levelYBound );
+
+        if( ( levelXStart == levelXBound ) || ( levelYStart == levelYBound ) ) {
+          break;
+        }
+
+        if( ( m_levels[l] != NULL ) && ( m_levels[l - 1] != NULL ) ) {
+          RasterLinesReader reader( *m_levels[l - 1] );
+          RasterLinesWriter writer( *m_levels[l] );
+
+          Multilook( m_parameters, reader, m_levelsRows[l - 1], m_levelsCols[l - 1],
+            (unsigned int)m_levels[l]->getNumberOfBands(), levelYStart, levelYBound,
+            levelXStart, levelXBound, writer );
+        }
+
+        invalidateTiles( l, levelXStart, levelYStart, levelXBound, levelYBound );
+
+        xStart = levelXStart;
+        xBound = levelXBound;
+        yStart = levelYStart;
+        yBound = levelYBound;
+      }
+
+      return true;
+    }
+
+    void MultiResolution::invalidateTiles( size_t level, unsigned int xStart,
+      unsigned int yStart, unsigned int xBound, unsigned int yBound )
+    {
+      const unsigned int tileSize = m_parameters.m_tileSize;
+      const unsigned int tileXStart = xStart / tileSize;
+      const unsigned int tileXBound = ( xBound - 1 ) / tileSize + 1;
+      const unsigned int tileYStart = yStart / tileSize;
+      const unsigned int tileYBound = ( yBound - 1 ) / tileSize + 1;
+
+      boost::lock_guard<boost::mutex> lock( m_tilesMutex );
+
+      TileKey key;
+      key.m_level = level;
+
+      for( key.m_tileY = tileYStart; key.m_tileY < tileYBound; ++key.m_tileY ) {
+        for( key.m_tileX = tileXStart; key.m_tileX < tileXBound; ++key.m_tileX ) {
+          TilesCacheT::iterator it = m_tiles.find( key );
+
+          if( it != m_tiles.end() ) {
+            m_tilesUsage.erase( it->second.second );
+            m_tiles.erase( it );
+          }
+        }
+      }
+    }
+
+    bool MultiResolution::getNumberOfTiles( size_t level, unsigned int& tilesX,
+      unsigned int& tilesY ) const
+    {
+      if( level >= m_levels.size() ) {
+        return false;
+      }
+
+      tilesX = ( m_levelsCols[level] + m_parameters.m_tileSize - 1 ) / m_parameters.m_tileSize;
+      tilesY = ( m_levelsRows[level] + m_parameters.m_tileSize - 1 ) / m_parameters.m_tileSize;
+
+      return true;
     }
 
     bool MultiResolution::getNumberOfLinesAndColumns( size_t level, size_t& lines, size_t& cols ) const
@@ -207,10 +909,15 @@ namespace teradar {
         return false;
       }
      
-      lines = m_levels[level]->getNumberOfRows();
-      cols = m_levels[level]->getNumberOfColumns();
+      lines = m_levelsRows[level];
+      cols = m_levelsCols[level];
       
       return true;
     }
+
+    const MultiResolution::Parameters& MultiResolution::getParameters() const
+    {
+      return m_parameters;
+    }
   } // end namespace common
 } // end namespace teradar
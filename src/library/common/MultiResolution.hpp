@@ -15,10 +15,19 @@ TerraRadar is under development.
 
 // TerraRadar includes
 #include "config.hpp"
+#include "MemoryArena.hpp"
 
 // TerraLib includes
 #include <terralib/Raster.h>
 
+// Boost includes
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+// STL includes
+#include <list>
+#include <map>
+
 namespace teradar {
   namespace common {
     /*!
@@ -31,6 +40,101 @@ namespace teradar {
     class TERADARCOMMONEXPORT MultiResolution
     {
       public:
+        /*!
+          \class Parameters
+          \brief Parameters used to create each level from its parent.
+
+          \details Each level pixel is the (weighted) mean of a window of
+          m_rowsWindowSize x m_colsWindowSize parent pixels, and consecutive
+          windows are m_rowsFactor lines and m_colsFactor columns apart.
+          Windows larger than the factors overlap, windows crossing the image
+          border are clipped and normalized by the remaining weights.
+        */
+        class TERADARCOMMONEXPORT Parameters
+        {
+          public:
+            unsigned int m_rowsFactor; //!< Number of parent lines merged into each level line - azimuth looks (default: 2).
+
+            unsigned int m_colsFactor; //!< Number of parent columns merged into each level column - range looks (default: 2).
+
+            unsigned int m_rowsWindowSize; //!< Window height, in parent lines. Must not be lower than m_rowsFactor (default: 0 - same as m_rowsFactor).
+
+            unsigned int m_colsWindowSize; //!< Window width, in parent columns. Must not be lower than m_colsFactor (default: 0 - same as m_colsFactor).
+
+            std::vector< double > m_rowsWeights; //!< Positive weights of each window line, the kernel is separable (default: empty - boxcar window).
+
+            std::vector< double > m_colsWeights; //!< Positive weights of each window column, the kernel is separable (default: empty - boxcar window).
+
+            bool m_createLevels; //!< Create the levels rasters at construction. If false, the levels are only available through tiles (default: true).
+
+            unsigned int m_tileSize; //!< Number of lines and columns of each tile (default: 256).
+
+            unsigned int m_maxCachedTiles; //!< Maximum number of tiles kept in cache, the least recently used are discarded (default: 256).
+
+            bool m_useHugePages; //!< Back the levels memory arena with huge pages, when available (default: false).
+
+            Parameters();
+
+            ~Parameters();
+
+            /*!
+              \brief Reset to the default 2x2 boxcar multilook.
+            */
+            void reset();
+
+            /*!
+              \brief Return the effective window height.
+              \return The window height, in parent lines.
+            */
+            unsigned int getRowsWindowSize() const;
+
+            /*!
+              \brief Return the effective window width.
+              \return The window width, in parent columns.
+            */
+            unsigned int getColsWindowSize() const;
+
+            /*!
+              \brief Check the parameters consistency.
+              \return True if the parameters are valid. False otherwise.
+            */
+            bool isValid() const;
+        };
+
+        /*!
+          \class Tile
+          \brief A tile of a multi resolution level.
+
+          \details Tiles cover m_tileSize x m_tileSize level pixels, tiles
+          in the last tiles line or column are clipped to the level size.
+        */
+        class TERADARCOMMONEXPORT Tile
+        {
+          public:
+            size_t m_level; //!< Multi resolution level.
+
+            unsigned int m_rowStart; //!< Level line of the first tile line.
+
+            unsigned int m_colStart; //!< Level column of the first tile column.
+
+            unsigned int m_rows; //!< Number of tile lines.
+
+            unsigned int m_cols; //!< Number of tile columns.
+
+            unsigned int m_bands; //!< Number of bands.
+
+            std::vector< std::complex<double> > m_values; //!< Band sequential values, m_values[ ( band * m_rows + line ) * m_cols + column ].
+
+            /*!
+              \brief Return a pointer to the contiguous values of a tile band.
+              \param band Band index.
+              \return A pointer to the first band value.
+            */
+            const std::complex<double>* getBandValues( unsigned int band ) const;
+        };
+
+        typedef boost::shared_ptr< const Tile > TilePtr;
+
         /*!
           \brief Given the number of @a lines and @a columns, computes the max
           compression level.
@@ -62,7 +166,38 @@ namespace teradar {
           const std::vector<size_t>& bandsNumbers,
           const bool enableProgressInterface = false );
 
-        /// Descructor.
+        /*!
+          \brief Constructor.
+          \param inputRaster Input raster.
+          \param levels Number of levels to be created in the multi resolution,
+          plus the level 0.
+          \param parameters Multilook parameters used to create each level.
+          \param enableProgressInterface Enable/disable the use of a progress.
+          \note Throws te::rp::Exception if the parameters are not valid.
+        */
+        MultiResolution( const te::rst::Raster& inputRaster, size_t levels,
+          const Parameters& parameters,
+          const bool enableProgressInterface = false );
+
+        /*!
+          \brief Constructor.
+          \param inputRaster Input raster.
+          \param levels Number of levels to be created in the multi resolution,
+          plus the level 0.
+          \param parameters Multilook parameters used to create each level.
+          \param arena Memory arena that will hold the levels data. It is reset
+          by this instance, so it may be reused by consecutive instances but
+          not shared by living ones.
+          \param enableProgressInterface Enable/disable the use of a progress.
+          \note Throws te::rp::Exception if the parameters are not valid or the
+          levels memory could not be allocated.
+        */
+        MultiResolution( const te::rst::Raster& inputRaster, size_t levels,
+          const Parameters& parameters,
+          const boost::shared_ptr< MemoryArena >& arena,
+          const bool enableProgressInterface = false );
+
+        /// Destructor. The created levels are removed and the arena memory is given back.
         ~MultiResolution();
 
         /*!
@@ -74,12 +209,13 @@ namespace teradar {
         /*!
           \brief Return the desired multi resolution @a level.
           \param level Desired multi resolution level.
-          \return The raster of the given level.
+          \return The raster of the given level, or NULL if the level raster
+          was not created or was removed.
         */
         te::rst::Raster* getLevel( size_t level ) const;
 
         /*!
-          \!brief Remove all multi resolution stored rasters.
+          \brief Remove all multi resolution stored rasters, giving back their arena memory.
         */
         void remove();
 
@@ -92,6 +228,53 @@ namespace teradar {
         */
         bool getNumberOfLinesAndColumns( size_t level, size_t& lines, size_t& cols ) const;
 
+        /*!
+          \brief Return the multilook parameters used to create the levels.
+          \return The multilook parameters.
+        */
+        const Parameters& getParameters() const;
+
+        /*!
+          \brief Return a tile of a multi resolution level.
+
+          \details Cached tiles are returned directly. Missing tiles are
+          copied from the level raster when it was created, or computed on
+          demand from the parent level otherwise. This method may be
+          called by concurrent threads.
+
+          \param level Multi resolution level.
+          \param tileX Tile column index.
+          \param tileY Tile line index.
+          \return The tile or an empty pointer if the tile is outside the level.
+        */
+        TilePtr getTile( size_t level, unsigned int tileX, unsigned int tileY ) const;
+
+        /*!
+          \brief Return the number of tiles of a level.
+          \param level Multi resolution level.
+          \param tilesX Number of tiles columns.
+          \param tilesY Number of tiles lines.
+          \return True if the level exists. False otherwise.
+        */
+        bool getNumberOfTiles( size_t level, unsigned int& tilesX, unsigned int& tilesY ) const;
+
+        /*!
+          \brief Update the multi resolution after a level 0 region change.
+
+          \details Only the levels pixels whose multilook windows touch the
+          modified region are recomputed, and only the cached tiles covering
+          them are discarded (they will be recreated by the next getTile call).
+          This method must not be called concurrently with getTile.
+
+          \param xStart First modified level 0 column.
+          \param yStart First modified level 0 line.
+          \param xBound Level 0 column after the last modified one.
+          \param yBound Level 0 line after the last modified one.
+          \return True if OK. False if the region is not valid.
+        */
+        bool update( unsigned int xStart, unsigned int yStart, unsigned int xBound,
+          unsigned int yBound );
+
       protected:
         /*!
           \brief Create the multi resolution levels.
@@ -99,19 +282,65 @@ namespace teradar {
         void createLevels();
 
         /*!
-          \brief Create a new multi resolution level based on the original one.
-          The new level must have a half number of lines and columns when compared to
-          the original one.
+          \brief Create a new multi resolution level based on the original one,
+          using the multilook parameters.
+          The new level must have the number of lines and columns of the
+          original one divided by the respective multilook factors.
 
           \param srcRaster Source raster, to read information from.
           \param dstRaster Destination raster, to write information into.
         */
         void createLevel( const te::rst::Raster& srcRaster, te::rst::Raster& dstRaster );
 
+        /*!
+          \brief Create a tile, without using the tiles cache for the
+          requested tile.
+          \param level Multi resolution level.
+          \param tileX Tile column index.
+          \param tileY Tile line index.
+          \return The created tile.
+        */
+        TilePtr createTile( size_t level, unsigned int tileX, unsigned int tileY ) const;
+
+        /*!
+          \brief Discard the cached tiles intersecting a level region.
+          \param level Multi resolution level.
+          \param xStart First region column.
+          \param yStart First region line.
+          \param xBound Column after the last region one.
+          \param yBound Line after the last region one.
+        */
+        void invalidateTiles( size_t level, unsigned int xStart, unsigned int yStart,
+          unsigned int xBound, unsigned int yBound );
+
       private:
+        /*!
+          \brief Tiles cache key.
+        */
+        struct TileKey
+        {
+          size_t m_level;
+          unsigned int m_tileX;
+          unsigned int m_tileY;
+
+          bool operator<( const TileKey& other ) const;
+        };
+
+        typedef std::list< TileKey > TilesUsageListT;
+
+        typedef std::map< TileKey, std::pair< TilePtr, TilesUsageListT::iterator > > TilesCacheT;
+
+        Parameters m_parameters; //!< Multilook parameters.
         std::vector<size_t> m_bandsNumbers; //!< Bands used in the multi resolution creation.
         std::vector<te::rst::Raster*> m_levels; //!< Internal levels.
+        std::vector<unsigned int> m_levelsRows; //!< Number of lines of each level.
+        std::vector<unsigned int> m_levelsCols; //!< Number of columns of each level.
         bool m_enableProgress; //!< Enable/Disable the progress interface.
+        boost::shared_ptr< MemoryArena > m_arena; //!< Arena holding the levels rasters data.
+        mutable TilesCacheT m_tiles; //!< Cached tiles.
+        mutable TilesUsageListT m_tilesUsage; //!< Cached tiles keys, most recently used first.
+        mutable boost::mutex m_tilesMutex; //!< Tiles cache mutex.
+        mutable boost::mutex m_inputRasterMutex; //!< Serializes the tiles reads of the input raster.
     };
   } // end namespace common
 } // end namespace teradar
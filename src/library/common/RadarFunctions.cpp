@@ -33,8 +33,8 @@ namespace teradar {
 
       size_t inputRasterBandsSize = inputRasterPtr->getNumberOfBands();
 
-      // only 3 and 4 bands are supported.
-      if( inputRasterBandsSize != 9 && inputRasterBandsSize != 16 ) {
+      // only 2, 3 and 4 bands are supported.
+      if( inputRasterBandsSize != 4 && inputRasterBandsSize != 9 && inputRasterBandsSize != 16 ) {
         return false;
       }
 
@@ -80,7 +80,11 @@ namespace teradar {
         std::vector< size_t > intensityBands;
         std::complex< double > value = 0.;
 
-        if( inputRasterBandsSize == 9 ) {
+        if( inputRasterBandsSize == 4 ) {
+          intensityBands.push_back( 0 );
+          intensityBands.push_back( 3 );
+
+        } else if( inputRasterBandsSize == 9 ) {
           intensityBands.push_back( 0 );
           intensityBands.push_back( 4 );
           intensityBands.push_back( 8 );
@@ -121,7 +125,7 @@ namespace teradar {
     {
 
 		//CovInputRasterPtrs  -> vector of raster pointer with the images organaized in bands
-		//CovInputRasterBands -> vector that has the number of bands, which can be 4 (HH,HV,VH,VV) or 3 (HH,VV,HV), 6 (Matriz de covariancia monoestica incompleta) or 10 (Matriz de cvariancia biestatica incompleta)
+		//CovInputRasterBands -> vector that has the number of bands, which can be 2 (dual-pol), 4 (HH,HV,VH,VV) or 3 (HH,VV,HV), 6 (Matriz de covariancia monoestica incompleta) or 10 (Matriz de cvariancia biestatica incompleta)
 		//CovOutputRasterInfo -> path 
 		//CovOutputDataSourceType ->  ??????
 		//CovOutputRasterPtr  -> output raster pinter
@@ -337,6 +341,25 @@ namespace teradar {
 				}// end for k
 			}//end for j
 		}// end if inputRasterBandsSize == 4
+
+		else if (CovInputRasterPtr.size() == 2){
+			// [C2] (dual-pol, e.g. HH/HV or VV/VH):
+			//	  |S1|²		(S1.S2*)
+			//  (S2.S1*)	  |S2|²
+
+			// for each pixel (line,column), compute the values
+			for (unsigned int j = 0; j < nOutRows; ++j) {
+				for (unsigned int k = 0; k < nOutCols; ++k) {
+					CovInputRasterPtr[0]->getBand(CovInputRasterBands[0])->getValue(k, j, inputComplex[0]); // S1
+					CovInputRasterPtr[1]->getBand(CovInputRasterBands[1])->getValue(k, j, inputComplex[1]); // S2
+
+					CovOutputRasterPtr->getBand(0)->setValue(k, j, std::norm(inputComplex[0]));						// |S1|²
+					CovOutputRasterPtr->getBand(1)->setValue(k, j, inputComplex[0] * std::conj(inputComplex[1]));	// (S1.S2*)
+					CovOutputRasterPtr->getBand(2)->setValue(k, j, inputComplex[1] * std::conj(inputComplex[0]));	// (S2.S1*)
+					CovOutputRasterPtr->getBand(3)->setValue(k, j, std::norm(inputComplex[1]));						// |S2|²
+				}// end for k
+			}//end for j
+		}// end if inputRasterBandsSize == 2
 		else return false;
 
 		return true;
@@ -898,6 +921,19 @@ namespace teradar {
       return true;
     }
 
+    double ComputeCompressionLevelENL( unsigned int level, const double& imageENL,
+      const double& autoCorrelation1, const double& autoCorrelation2,
+      const double& autoCorrelation3 ) {
+      if( level == 0 ) {
+        return imageENL;
+      }
+
+      double p1 = pow( imageENL * 2, 2 * level );
+      double p2 = 1 - (1 / pow( 2, level ));
+
+      return p1 / (1 + 2 * p2 * (autoCorrelation1 + autoCorrelation2 + (autoCorrelation3*p2)));
+    }
+
     unsigned int ComputeMinCompressionLevel( unsigned int maxLevel, const double& imageENL,
       const double& minENL, const double& autoCorrelation1, const double& autoCorrelation2,
       const double& autoCorrelation3 ) {
@@ -907,10 +943,8 @@ namespace teradar {
       while( (levelENL < minENL) && (minLevel != maxLevel) ) {
         minLevel++;
 
-        double p1 = pow( imageENL * 2, 2 * minLevel );
-        double p2 = 1 - (1 / pow( 2, minLevel ));
-
-        levelENL = p1 / (1 + 2 * p2 * (autoCorrelation1 + autoCorrelation2 + (autoCorrelation3*p2)));
+        levelENL = ComputeCompressionLevelENL( minLevel, imageENL, autoCorrelation1,
+          autoCorrelation2, autoCorrelation3 );
       }
 
       return minLevel;
@@ -34,7 +34,7 @@ namespace teradar {
     /*!
       \brief Create a one band raster representing the intensity matrix.
       The input raster must be a covariance matrix raster, containing (n ^ 2) bands.
-      Actualy, supported values of n is 3 and 4.
+      Actualy, supported values of n is 2, 3 and 4.
       \param inputRasterPtr Input raster pointer, containing the covariance matrix.
       \param intensityRasterInfo Intensity raster connection info.
       \param outputDataSourceType Output raster datasource type.
@@ -54,6 +54,8 @@ namespace teradar {
     /*!
       \brief Create a multi-band raster representing the covariance matrix.
       The number of bands is based on the number of input rasters.
+      If the number of input rasters is 2, the method assumes that the input
+      is dual-pol (e.g. HH and HV, or VV and VH), and creates a 2x2 matrix.
       If the number of input rasters is 3, the method assumes that the input
       is a scattering vector, and the rasters contain data for HH, HV(VH) and
       VV polarizations.
@@ -76,6 +78,7 @@ namespace teradar {
       \note The number of bands in output raster is based on input. For the
       scattering vector, the output raster will contain 9 bands and, for the
       complete input (scattering matrix), the output will contain 16 bands.
+      The dual-pol output contains 4 bands.
     */
     TERADARCOMMONEXPORT bool CreateCovarianceRaster( const std::vector<te::rst::Raster*>& inputRasterPointers,
       const std::vector<unsigned int>& inputRasterBands,
@@ -191,6 +194,20 @@ namespace teradar {
       double& covariance, double& correlation, 
       const bool enableProgressInterface = false );
 
+    /*!
+      \brief This method computes the Equivalent Number of Looks of the image compressed
+      @a level times.
+      \param level Compression level (0 - no compression).
+      \param imageENL Equivalent Number of Looks of the image without compression.
+      \param autoCorrelation1 First element of autoCorrelation vector. Default is 0.8.
+      \param autoCorrelation2 Second element of autoCorrelation vector. Default is 0.8.
+      \param autoCorrelation3 Third element of autoCorrelation vector. Default is 0.8.
+      \return The Equivalent Number of Looks of the compressed image.
+    */
+    TERADARCOMMONEXPORT double ComputeCompressionLevelENL( unsigned int level, const double& imageENL,
+      const double& autoCorrelation1 = 0.8, const double& autoCorrelation2 = 0.8,
+      const double& autoCorrelation3 = 0.8 );
+
     /*!
       \brief This method computes the minimal compression level needed to allow the data being
       submitted in the Segmentation Process.
@@ -15,7 +15,19 @@ TerraRadar is under development.
 #include <terralib/common/PlatformUtils.h>
 
 // STL Includes
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
 #include <string>
+#include <vector>
+
+// System Includes
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 // TerraRadar Includes
 #include "Utils.hpp"
@@ -33,3 +45,237 @@ void teradar::common::loadTerraLibDrivers() {
 
   te::plugin::PluginManager::getInstance().loadAll();
 }
+
+// Last level cache size
+unsigned long long teradar::common::GetLastLevelCacheSize() {
+  unsigned long long cacheSize = 0;
+
+#ifdef WIN32
+  DWORD bufferSize = 0;
+  GetLogicalProcessorInformation( NULL, &bufferSize );
+
+  if( bufferSize == 0 ) {
+    return 0;
+  }
+
+  std::vector< SYSTEM_LOGICAL_PROCESSOR_INFORMATION > info( bufferSize /
+    sizeof( SYSTEM_LOGICAL_PROCESSOR_INFORMATION ) + 1 );
+
+  if( !GetLogicalProcessorInformation( &info[0], &bufferSize ) ) {
+    return 0;
+  }
+
+  const std::size_t infoSize = bufferSize / sizeof( SYSTEM_LOGICAL_PROCESSOR_INFORMATION );
+  BYTE lastLevel = 0;
+
+  for( std::size_t infoIdx = 0; infoIdx < infoSize; ++infoIdx ) {
+    if( ( info[infoIdx].Relationship == RelationCache ) &&
+      ( info[infoIdx].Cache.Type != CacheInstruction ) &&
+      ( info[infoIdx].Cache.Level >= lastLevel ) ) {
+      lastLevel = info[infoIdx].Cache.Level;
+      cacheSize = info[infoIdx].Cache.Size;
+    }
+  }
+#else
+  // the caches seen by the first processor, as described by sysfs
+  unsigned int lastLevel = 0;
+
+  for( unsigned int index = 0; ; ++index ) {
+    std::ostringstream cachePath;
+    cachePath << "/sys/devices/system/cpu/cpu0/cache/index" << index << "/";
+
+    std::ifstream levelFile( ( cachePath.str() + "level" ).c_str() );
+    std::ifstream typeFile( ( cachePath.str() + "type" ).c_str() );
+    std::ifstream sizeFile( ( cachePath.str() + "size" ).c_str() );
+
+    if( !levelFile.is_open() || !typeFile.is_open() || !sizeFile.is_open() ) {
+      break;
+    }
+
+    unsigned int level = 0;
+    std::string type;
+    std::string size;
+
+    levelFile >> level;
+    typeFile >> type;
+    sizeFile >> size;
+
+    if( ( type == "Instruction" ) || size.empty() || ( level < lastLevel ) ) {
+      continue;
+    }
+
+    // sizes are given as "32768K" or "8M"
+    unsigned long long levelSize = std::strtoull( size.c_str(), NULL, 10 );
+    const char unit = size[size.size() - 1];
+
+    if( unit == 'K' ) {
+      levelSize *= 1024ULL;
+    } else if( unit == 'M' ) {
+      levelSize *= 1024ULL * 1024ULL;
+    } else if( unit == 'G' ) {
+      levelSize *= 1024ULL * 1024ULL * 1024ULL;
+    }
+
+    lastLevel = level;
+    cacheSize = levelSize;
+  }
+#endif
+
+  return cacheSize;
+}
+
+namespace {
+#ifndef WIN32
+  // Parse a sysfs cpu list, as "0-3,8-11"
+  void ParseCpuList( const std::string& cpuList, std::vector< unsigned int >& cpus ) {
+    std::istringstream listStream( cpuList );
+    std::string range;
+
+    while( std::getline( listStream, range, ',' ) ) {
+      if( range.empty() ) {
+        continue;
+      }
+
+      const std::string::size_type separatorPos = range.find( '-' );
+      const unsigned int first = (unsigned int)std::strtoul( range.c_str(), NULL, 10 );
+      const unsigned int last = ( separatorPos == std::string::npos ) ? first :
+        (unsigned int)std::strtoul( range.c_str() + separatorPos + 1, NULL, 10 );
+
+      for( unsigned int cpu = first; cpu <= last; ++cpu ) {
+        cpus.push_back( cpu );
+      }
+    }
+  }
+#endif
+}
+
+// NUMA nodes processors
+bool teradar::common::GetNumaNodesCpus( std::vector< std::vector< unsigned int > >& nodesCpus ) {
+  nodesCpus.clear();
+
+#ifdef WIN32
+  ULONG highestNode = 0;
+
+  if( !GetNumaHighestNodeNumber( &highestNode ) ) {
+    return false;
+  }
+
+  for( ULONG node = 0; node <= highestNode; ++node ) {
+    ULONGLONG nodeMask = 0;
+
+    if( !GetNumaNodeProcessorMask( (UCHAR)node, &nodeMask ) || ( nodeMask == 0 ) ) {
+      continue;
+    }
+
+    nodesCpus.push_back( std::vector< unsigned int >() );
+
+    for( unsigned int cpu = 0; cpu < 64; ++cpu ) {
+      if( nodeMask & ( 1ULL << cpu ) ) {
+        nodesCpus.back().push_back( cpu );
+      }
+    }
+  }
+#else
+  // nodes may be sparsely numbered, a few missing nodes are tolerated
+  const unsigned int maxMissingNodes = 8;
+  unsigned int missingNodes = 0;
+
+  for( unsigned int node = 0; missingNodes < maxMissingNodes; ++node ) {
+    std::ostringstream cpuListPath;
+    cpuListPath << "/sys/devices/system/node/node" << node << "/cpulist";
+
+    std::ifstream cpuListFile( cpuListPath.str().c_str() );
+
+    if( !cpuListFile.is_open() ) {
+      ++missingNodes;
+      continue;
+    }
+
+    std::string cpuList;
+    cpuListFile >> cpuList;
+
+    std::vector< unsigned int > cpus;
+    ParseCpuList( cpuList, cpus );
+
+    if( !cpus.empty() ) {
+      nodesCpus.push_back( cpus );
+    }
+  }
+#endif
+
+  return !nodesCpus.empty();
+}
+
+// Thread affinity
+bool teradar::common::BindCurrentThreadToCpus( const std::vector< unsigned int >& cpus ) {
+  if( cpus.empty() ) {
+    return false;
+  }
+
+#ifdef WIN32
+  DWORD_PTR mask = 0;
+
+  for( std::size_t cpuIdx = 0; cpuIdx < cpus.size(); ++cpuIdx ) {
+    if( cpus[cpuIdx] < 8 * sizeof( DWORD_PTR ) ) {
+      mask |= ( ( (DWORD_PTR)1 ) << cpus[cpuIdx] );
+    }
+  }
+
+  return ( mask != 0 ) && ( SetThreadAffinityMask( GetCurrentThread(), mask ) != 0 );
+#else
+  cpu_set_t cpuSet;
+  CPU_ZERO( &cpuSet );
+
+  for( std::size_t cpuIdx = 0; cpuIdx < cpus.size(); ++cpuIdx ) {
+    if( cpus[cpuIdx] < CPU_SETSIZE ) {
+      CPU_SET( cpus[cpuIdx], &cpuSet );
+    }
+  }
+
+  return pthread_setaffinity_np( pthread_self(), sizeof( cpu_set_t ), &cpuSet ) == 0;
+#endif
+}
+
+bool teradar::common::GetCurrentThreadCpus( std::vector< unsigned int >& cpus ) {
+  cpus.clear();
+
+#ifdef WIN32
+  // there is no thread affinity query, the previous mask is returned when
+  // setting a new one
+  DWORD_PTR processMask = 0;
+  DWORD_PTR systemMask = 0;
+
+  if( !GetProcessAffinityMask( GetCurrentProcess(), &processMask, &systemMask ) ) {
+    return false;
+  }
+
+  const DWORD_PTR threadMask = SetThreadAffinityMask( GetCurrentThread(), processMask );
+
+  if( threadMask == 0 ) {
+    return false;
+  }
+
+  SetThreadAffinityMask( GetCurrentThread(), threadMask );
+
+  for( unsigned int cpu = 0; cpu < 8 * sizeof( DWORD_PTR ); ++cpu ) {
+    if( threadMask & ( ( (DWORD_PTR)1 ) << cpu ) ) {
+      cpus.push_back( cpu );
+    }
+  }
+#else
+  cpu_set_t cpuSet;
+  CPU_ZERO( &cpuSet );
+
+  if( pthread_getaffinity_np( pthread_self(), sizeof( cpu_set_t ), &cpuSet ) != 0 ) {
+    return false;
+  }
+
+  for( unsigned int cpu = 0; cpu < CPU_SETSIZE; ++cpu ) {
+    if( CPU_ISSET( cpu, &cpuSet ) ) {
+      cpus.push_back( cpu );
+    }
+  }
+#endif
+
+  return !cpus.empty();
+}
@@ -16,6 +16,9 @@ TerraRadar is under development.
 // TerraRadar Includes
 #include "config.hpp"
 
+// STL Includes
+#include <vector>
+
 namespace teradar {
 	namespace common {
     /*!
@@ -28,6 +31,37 @@ namespace teradar {
 
     /*! \brief Load TerraLib Modules needed */
     TERADARCOMMONEXPORT void loadTerraLibDrivers();
+
+    /*!
+      \brief Return the size of the processor last level cache.
+      \return The last level cache size, in bytes, or 0 if it could not be found.
+    */
+    TERADARCOMMONEXPORT unsigned long long GetLastLevelCacheSize();
+
+    /*!
+      \brief Return the processors of each NUMA node.
+      \param nodesCpus The processors indexes of each node, nodes without processors are not included.
+      \return True if the NUMA topology was found. False otherwise (nodesCpus will be empty).
+    */
+    TERADARCOMMONEXPORT bool GetNumaNodesCpus( std::vector< std::vector< unsigned int > >& nodesCpus );
+
+    /*!
+      \brief Restrict the calling thread to the given processors.
+      \details The memory first touched by the thread afterwards is usually
+      allocated by the system on the NUMA node of these processors.
+      \param cpus The processors indexes.
+      \return True if OK. False if the affinity could not be set.
+    */
+    TERADARCOMMONEXPORT bool BindCurrentThreadToCpus( const std::vector< unsigned int >& cpus );
+
+    /*!
+      \brief Return the processors the calling thread is restricted to.
+      \details Used to restore a thread affinity after BindCurrentThreadToCpus.
+      The threads created afterwards by the thread inherit this affinity.
+      \param cpus The processors indexes.
+      \return True if OK. False if the affinity could not be found (cpus will be empty).
+    */
+    TERADARCOMMONEXPORT bool GetCurrentThreadCpus( std::vector< unsigned int >& cpus );
   }  // end namespace common
 }  // end namespace teradar
 
@@ -12,8 +12,17 @@ TerraRadar is under development.
 
 // TerraRadar includes
 #include "MultiLevelSegmenter.hpp"
+#include "SegmenterAbortableStrategy.hpp"
+#include "SegmenterBorderStatisticsProvider.hpp"
+#include "SegmenterMultiThreadedStrategy.hpp"
+#include "SegmenterRegionGrowingWishartStrategy.hpp"
+#include "../common/Functions.hpp"
+#include "../common/MultiResolution.hpp"
+#include "../common/RadarFunctions.hpp"
+#include "../common/Utils.hpp"
 
 // TerraLib includes
+#include <terralib/common/MatrixUtils.h>
 #include <terralib/common/progress/TaskProgress.h>
 #include <terralib/memory/CachedRaster.h>
 #include <terralib/raster/BandProperty.h>
@@ -22,6 +31,674 @@ TerraRadar is under development.
 #include <terralib/raster/SynchronizedRaster.h>
 #include <terralib/rp/SegmenterStrategyFactory.h>
 
+// Boost includes
+#include <boost/bind.hpp>
+#include <boost/numeric/ublas/matrix.hpp>
+#include <boost/scoped_array.hpp>
+
+// STL includes
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <sstream>
+
+namespace
+{
+  /*!
+    \brief Read the covariance matrices of a raster line.
+    \param raster The input raster.
+    \param bands The covariance matrix elements bands.
+    \param row The line to read.
+    \param values The line values, values[ column * bands.size() + band ].
+  */
+  void ReadCovarianceLine( const te::rst::Raster& raster, const std::vector< unsigned int >& bands,
+    const unsigned int row, std::vector< std::complex< double > >& values )
+  {
+    const unsigned int nCols = raster.getNumberOfColumns();
+    const unsigned int bandsNumber = (unsigned int)bands.size();
+
+    values.resize( nCols * bandsNumber );
+
+    for( unsigned int band = 0; band < bandsNumber; ++band )
+    {
+      const te::rst::Band& rasterBand = *raster.getBand( bands[band] );
+
+      for( unsigned int col = 0; col < nCols; ++col )
+      {
+        rasterBand.getValue( col, row, values[col * bandsNumber + band] );
+      }
+    }
+  }
+
+  /*!
+    \brief Compute the Wishart classifier parameters of a class covariance matrix.
+    \param covMatrix The class covariance matrix (singular matrices are regularized).
+    \param logDet The logarithm of the covariance matrix determinant.
+    \param invMatrix The covariance matrix inverse, line by line.
+    \return true if OK, false if the matrix could not be inverted.
+  */
+  bool GetWishartClassParameters( boost::numeric::ublas::matrix< std::complex< double > >& covMatrix,
+    double& logDet, std::vector< std::complex< double > >& invMatrix )
+  {
+    const unsigned int order = (unsigned int)covMatrix.size1();
+    double noise = 1e-10;
+    std::complex< double > det = 0.;
+
+    te::common::GetDeterminant< std::complex< double > >( covMatrix, det );
+
+    for( unsigned int trial = 0; ( std::abs( std::real( det ) ) < DBL_MIN ) && ( trial < 10 ); ++trial )
+    {
+      for( unsigned int idx = 0; idx < order; ++idx )
+      {
+        covMatrix( idx, idx ) += noise;
+      }
+
+      te::common::GetDeterminant< std::complex< double > >( covMatrix, det );
+      noise *= 10.;
+    }
+
+    if( std::abs( std::real( det ) ) < DBL_MIN )
+    {
+      return false;
+    }
+
+    boost::numeric::ublas::matrix< std::complex< double > > inverse( order, order );
+
+    if( !te::common::GetInverseMatrix< std::complex< double > >( covMatrix, inverse ) )
+    {
+      return false;
+    }
+
+    logDet = std::log( std::abs( std::real( det ) ) );
+
+    invMatrix.resize( order * order );
+
+    for( unsigned int line = 0; line < order; ++line )
+    {
+      for( unsigned int col = 0; col < order; ++col )
+      {
+        invMatrix[line * order + col] = inverse( line, col );
+      }
+    }
+
+    return true;
+  }
+
+  /*!
+    \brief Blocks queue ordering, higher costs first.
+  */
+  bool HigherBlockCost( const std::pair< unsigned int, unsigned int >& block1,
+    const std::pair< unsigned int, unsigned int >& block2 )
+  {
+    return block1.first > block2.first;
+  }
+
+  /*!
+    \brief Blocks queue grouping by NUMA node, lower nodes first.
+  */
+  bool LowerBlockNode( const std::pair< unsigned int, unsigned int >& block1,
+    const std::pair< unsigned int, unsigned int >& block2 )
+  {
+    return block1.first < block2.first;
+  }
+
+  /*!
+    \brief Take the next blocks queue element, from the home node group first
+    and from the other nodes groups when it is over.
+    \param nodesQueuesOffsets The blocks queue offset of each node group, followed by the queue size.
+    \param nextBlockCursors The per node group indexes of the next element to be taken.
+    \param homeNode The node group to take from first.
+    \param blocksQueueIdx The taken blocks queue element index.
+    \return True if an element was taken. False if all groups are over.
+  */
+  bool TakeNextQueuedBlock( const std::vector< unsigned int >& nodesQueuesOffsets,
+    boost::atomic< unsigned int >* nextBlockCursors, const unsigned int homeNode,
+    unsigned int& blocksQueueIdx )
+  {
+    const unsigned int nodesNumber = (unsigned int)nodesQueuesOffsets.size() - 1;
+
+    for( unsigned int nodeOffset = 0; nodeOffset < nodesNumber; ++nodeOffset )
+    {
+      const unsigned int node = ( homeNode + nodeOffset ) % nodesNumber;
+      const unsigned int groupSize = nodesQueuesOffsets[node + 1] - nodesQueuesOffsets[node];
+
+      // exhausted groups are skipped without touching their shared cursor
+      if( nextBlockCursors[node].load( boost::memory_order_relaxed ) >= groupSize )
+      {
+        continue;
+      }
+
+      const unsigned int groupIdx = nextBlockCursors[node].fetch_add( 1,
+        boost::memory_order_relaxed );
+
+      if( groupIdx < groupSize )
+      {
+        blocksQueueIdx = nodesQueuesOffsets[node] + groupIdx;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  /*!
+    \brief Dilate a mask along lines or columns using a sliding window count.
+    \param nRows Number of mask lines.
+    \param nCols Number of mask columns.
+    \param radius Dilation radius.
+    \param alongLines If true, dilate along each line, otherwise along each column.
+    \param mask The mask to dilate.
+  */
+  void DilateMask( const unsigned int nRows, const unsigned int nCols, const unsigned int radius,
+    const bool alongLines, std::vector< unsigned char >& mask )
+  {
+    const unsigned int linesNumber = alongLines ? nRows : nCols;
+    const unsigned int lineSize = alongLines ? nCols : nRows;
+    const unsigned int step = alongLines ? 1 : nCols;
+    std::vector< unsigned char > lineMask( lineSize );
+
+    for( unsigned int line = 0; line < linesNumber; ++line )
+    {
+      const unsigned int first = alongLines ? ( line * nCols ) : line;
+      unsigned int count = 0;
+      unsigned int idx = 0;
+
+      for( idx = 0; idx < lineSize; ++idx )
+      {
+        lineMask[idx] = mask[first + idx * step];
+      }
+
+      for( idx = 0; ( idx < radius ) && ( idx < lineSize ); ++idx )
+      {
+        count += lineMask[idx];
+      }
+
+      for( idx = 0; idx < lineSize; ++idx )
+      {
+        if( idx + radius < lineSize ) count += lineMask[idx + radius];
+        if( idx > radius ) count -= lineMask[idx - radius - 1];
+
+        mask[first + idx * step] = ( count > 0 ) ? 1 : 0;
+      }
+    }
+  }
+
+  typedef te::rp::SegmenterSegmentsBlock::SegmentIdDataType SegmentIdT;
+
+  typedef teradar::segmenter::SegmenterBorderStatisticsProvider::SegmentsStatisticsT
+    SegmentsStatisticsT;
+
+  typedef std::pair< SegmentIdT, SegmentIdT > LabelsPairT;
+
+  /*!
+    \brief The segments facing each other across the seam of two blocks.
+  */
+  class BlocksSeam
+  {
+    public:
+      unsigned int m_block1Idx; //!< Segments blocks matrix linear index of the left (or top) block.
+      unsigned int m_block2Idx; //!< Segments blocks matrix linear index of the right (or bottom) block.
+      std::vector< LabelsPairT > m_labelsPairs; //!< Distinct pairs of facing labels (block 1 label, block 2 label).
+  };
+
+  /*!
+    \brief Add a seam, keeping only the distinct labels pairs.
+    \param block1Idx Segments blocks matrix linear index of the left (or top) block.
+    \param block2Idx Segments blocks matrix linear index of the right (or bottom) block.
+    \param labelsPairs The facing labels pairs (will be sorted).
+    \param seams The seams.
+  */
+  void AddBlocksSeam( const unsigned int block1Idx, const unsigned int block2Idx,
+    std::vector< LabelsPairT >& labelsPairs, std::vector< BlocksSeam >& seams )
+  {
+    if( labelsPairs.empty() )
+    {
+      return;
+    }
+
+    std::sort( labelsPairs.begin(), labelsPairs.end() );
+
+    seams.push_back( BlocksSeam() );
+    seams.back().m_block1Idx = block1Idx;
+    seams.back().m_block2Idx = block2Idx;
+    seams.back().m_labelsPairs.assign( labelsPairs.begin(),
+      std::unique( labelsPairs.begin(), labelsPairs.end() ) );
+  }
+
+  /*!
+    \brief Return the merged statistics of a labels set.
+    \param rootsStatistics The merged statistics of the sets with more than one label, by root label.
+    \param root The set root label.
+    \param rootStatistics The root label own statistics, used when the set has only the root label.
+    \return The set merged statistics.
+  */
+  teradar::segmenter::SegmenterBorderStatisticsProvider::SegmentStatistics& GetRootStatistics(
+    SegmentsStatisticsT& rootsStatistics, const SegmentIdT root,
+    const teradar::segmenter::SegmenterBorderStatisticsProvider::SegmentStatistics& rootStatistics )
+  {
+    SegmentsStatisticsT::iterator rootsStatisticsIt = rootsStatistics.find( root );
+
+    if( rootsStatisticsIt == rootsStatistics.end() )
+    {
+      rootsStatisticsIt = rootsStatistics.insert( SegmentsStatisticsT::value_type(
+        root, rootStatistics ) ).first;
+    }
+
+    return rootsStatisticsIt->second;
+  }
+
+  /*!
+    \brief The parameters of the parallel relabeling of the merged segments.
+  */
+  class RelabelingParams
+  {
+    public:
+      te::rst::Raster* m_rasterPtr; //!< Labels raster written directly, or NULL to write through m_rasterSyncPtr.
+      te::rst::RasterSynchronizer* m_rasterSyncPtr; //!< Labels raster synchronizer.
+      std::vector< LabelsPairT > const* m_newLabelsPtr; //!< The (label, new label) pairs, sorted by label.
+      std::vector< unsigned int > const* m_rasterBlocksPtr; //!< Linear indexes of the raster blocks to relabel.
+      unsigned int m_rasterBlocksCols; //!< Number of raster blocks per line.
+      boost::atomic< unsigned int >* m_nextRasterBlockCursorPtr; //!< Index of the next raster block to process, shared by all threads.
+      boost::atomic< bool >* m_errorFlagPtr; //!< Set on relabeling errors.
+  };
+
+  /*!
+    \brief Relabel the pending raster blocks.
+    \param paramsPtr The relabeling parameters.
+  */
+  void RelabelRasterBlocks( RelabelingParams* paramsPtr )
+  {
+    const std::vector< unsigned int >& rasterBlocks = *paramsPtr->m_rasterBlocksPtr;
+
+    std::auto_ptr< te::rst::SynchronizedRaster > syncRasterPtr;
+    te::rst::Raster* rasterPtr = paramsPtr->m_rasterPtr;
+
+    if( rasterPtr == 0 )
+    {
+      syncRasterPtr.reset( new te::rst::SynchronizedRaster( 1, *paramsPtr->m_rasterSyncPtr ) );
+      rasterPtr = syncRasterPtr.get();
+    }
+
+    unsigned int rasterBlocksIdx = 0;
+
+    while( ( rasterBlocksIdx = paramsPtr->m_nextRasterBlockCursorPtr->fetch_add( 1 ) ) <
+      rasterBlocks.size() )
+    {
+      if( !teradar::common::RelabelBlock( *paramsPtr->m_newLabelsPtr,
+        rasterBlocks[rasterBlocksIdx] % paramsPtr->m_rasterBlocksCols,
+        rasterBlocks[rasterBlocksIdx] / paramsPtr->m_rasterBlocksCols, *rasterPtr, 0 ) )
+      {
+        paramsPtr->m_errorFlagPtr->store( true );
+        return;
+      }
+    }
+  }
+
+  /*!
+    \brief Find the representative label of a merged labels set.
+    \param parents The parent of each merged label, labels not present are their own parents.
+    \param label The label.
+    \return The representative label.
+  */
+  SegmentIdT FindMergedLabelRoot( std::map< SegmentIdT, SegmentIdT >& parents,
+    const SegmentIdT label )
+  {
+    SegmentIdT root = label;
+    std::map< SegmentIdT, SegmentIdT >::iterator parentIt;
+
+    while( ( ( parentIt = parents.find( root ) ) != parents.end() ) &&
+      ( parentIt->second != root ) )
+    {
+      root = parentIt->second;
+    }
+
+    // path compression
+    SegmentIdT current = label;
+
+    while( current != root )
+    {
+      SegmentIdT& parent = parents[current];
+      current = parent;
+      parent = root;
+    }
+
+    return root;
+  }
+
+  const unsigned int MinPlannedBlockSide = 128; //!< Blocks planned for load balance or cache fitting are not smaller than this side.
+
+  const unsigned int CutOffProfileChunkSize = 256; //!< Number of profile elements loaded at once.
+
+  /*!
+    \brief Generate a chunk of a cut off profile.
+    \param chunkValues The strip values around the profile center, transposed so
+    the values crossing each profile element are contiguous:
+    chunkValues[ ( ( element - chunkStart ) * bandsNumber + band ) * stripSize + ( crossIdx - stripStart ) ].
+    \param chunkStart The first chunk profile element.
+    \param chunkBound The profile element after the last chunk one.
+    \param bandsNumber The number of bands.
+    \param stripStart The first strip line (or column) crossing the profile.
+    \param stripSize The strip size.
+    \param pixelNeighborhoodSize The pixel neighborhood size over the line transverse to the profile.
+    \param profileAntiSmoothingFactor A positive profile anti-smoothing factor.
+    \param profile The profile, with the elements before chunkStart already generated.
+  */
+  void GenCutOffProfileChunk( const std::vector< double >& chunkValues,
+    const int chunkStart, const int chunkBound, const int bandsNumber,
+    const int stripStart, const int stripSize, const int pixelNeighborhoodSize,
+    const int profileAntiSmoothingFactor, std::vector< unsigned int >& profile )
+  {
+    const int minCrossProfileStartIdx = stripStart + pixelNeighborhoodSize;
+    const int maxCrossProfileBoundIdx = stripStart + stripSize - pixelNeighborhoodSize;
+    const double neighborhoodPixels = (double)( 2 * pixelNeighborhoodSize + 1 );
+
+    for( int profileElementIdx = chunkStart; profileElementIdx < chunkBound;
+      ++profileElementIdx )
+    {
+      int crossProfileStartIdx = minCrossProfileStartIdx;
+      int crossProfileBoundIdx = maxCrossProfileBoundIdx;
+
+      if( profileElementIdx )
+      {
+        crossProfileStartIdx = MAX( ((int)profile[profileElementIdx - 1]) -
+          profileAntiSmoothingFactor, minCrossProfileStartIdx );
+        crossProfileBoundIdx = MIN( ((int)profile[profileElementIdx - 1]) + 1 +
+          profileAntiSmoothingFactor, maxCrossProfileBoundIdx );
+      }
+
+      const double* elementValues = &chunkValues[ ( profileElementIdx - chunkStart ) *
+        bandsNumber * stripSize ];
+      double higherDiffSum = 0;
+      int higherDiffSumIdx = crossProfileStartIdx;
+
+      for( int crossProfileIdx = crossProfileStartIdx; crossProfileIdx <
+        crossProfileBoundIdx; ++crossProfileIdx )
+      {
+        // look for the higher diff using all bands
+        // within the defined neighborhood. The pixels are paired
+        // symmetrically around the candidate, so the sums can not be
+        // taken from running (prefix) sums.
+
+        double diffSum = 0;
+
+        for( int bandIdx = 0; bandIdx < bandsNumber; ++bandIdx )
+        {
+          const double* pixel1Ptr = elementValues + bandIdx * stripSize +
+            ( crossProfileIdx - pixelNeighborhoodSize - stripStart );
+          const double* pixel2Ptr = elementValues + bandIdx * stripSize +
+            ( crossProfileIdx + pixelNeighborhoodSize - stripStart );
+          double currBandDiffSum = 0;
+
+          for( int pixelNBOffset = 0; pixelNBOffset < pixelNeighborhoodSize;
+            ++pixelNBOffset )
+          {
+            currBandDiffSum += ABS( pixel1Ptr[pixelNBOffset] - pixel2Ptr[-pixelNBOffset] );
+          }
+
+          diffSum += ( currBandDiffSum / neighborhoodPixels );
+        }
+
+        if( diffSum > higherDiffSum )
+        {
+          higherDiffSum = diffSum;
+          higherDiffSumIdx = crossProfileIdx;
+        }
+      }
+
+      profile[profileElementIdx] = higherDiffSumIdx;
+    }
+  }
+
+  /*!
+    \brief The rows stripe of a parallel min/max pass.
+  */
+  class MinMaxStripe
+  {
+    public:
+      te::rst::Raster const* m_rasterPtr; //!< Raster read directly, or NULL to read through m_rasterSyncPtr.
+      te::rst::RasterSynchronizer* m_rasterSyncPtr; //!< Input raster synchronizer.
+      unsigned int m_maxCachedBlocks; //!< Maximum number of synchronized raster cached blocks.
+      std::vector< unsigned int > const* m_bandsPtr; //!< Bands to scan.
+      std::vector< std::complex< double > > const* m_noDataValuesPtr; //!< Bands no-data values.
+      unsigned int m_rowStart; //!< First stripe line.
+      unsigned int m_rowBound; //!< Line after the last stripe line.
+      std::vector< double > m_minValues; //!< Stripe bands minimum values.
+      std::vector< double > m_maxValues; //!< Stripe bands maximum values.
+  };
+
+  /*!
+    \brief Compute the min/max values of all bands of a rows stripe in a single sweep.
+    \param stripePtr The stripe, its min/max values are updated.
+  */
+  void ComputeStripeMinMax( MinMaxStripe* stripePtr )
+  {
+    const std::vector< unsigned int >& bands = *stripePtr->m_bandsPtr;
+    const std::vector< std::complex< double > >& noDataValues = *stripePtr->m_noDataValuesPtr;
+    const unsigned int bandsNumber = (unsigned int)bands.size();
+
+    std::auto_ptr< te::rst::SynchronizedRaster > syncRasterPtr;
+    te::rst::Raster const* rasterPtr = stripePtr->m_rasterPtr;
+
+    if( rasterPtr == 0 )
+    {
+      syncRasterPtr.reset( new te::rst::SynchronizedRaster( stripePtr->m_maxCachedBlocks,
+        *stripePtr->m_rasterSyncPtr ) );
+      rasterPtr = syncRasterPtr.get();
+    }
+
+    const unsigned int nCols = rasterPtr->getNumberOfColumns();
+    std::vector< double > lineValues( nCols );
+    std::vector< te::rst::Band const* > bandsPtrs( bandsNumber );
+    unsigned int bandIdx = 0;
+
+    for( bandIdx = 0; bandIdx < bandsNumber; ++bandIdx )
+    {
+      bandsPtrs[bandIdx] = rasterPtr->getBand( bands[bandIdx] );
+    }
+
+    stripePtr->m_minValues.assign( bandsNumber, DBL_MAX );
+    stripePtr->m_maxValues.assign( bandsNumber, -1.0 * DBL_MAX );
+
+    for( unsigned int row = stripePtr->m_rowStart; row < stripePtr->m_rowBound; ++row )
+    {
+      for( bandIdx = 0; bandIdx < bandsNumber; ++bandIdx )
+      {
+        const te::rst::Band& band = *bandsPtrs[bandIdx];
+        unsigned int col = 0;
+
+        for( col = 0; col < nCols; ++col )
+        {
+          band.getValue( col, row, lineValues[col] );
+        }
+
+        // real values never match a no-data value with an imaginary part
+        const bool hasNoData = ( noDataValues[bandIdx].imag() == 0.0 );
+        const double noDataValue = noDataValues[bandIdx].real();
+        const double* valuesPtr = &lineValues[0];
+        double bandMin = stripePtr->m_minValues[bandIdx];
+        double bandMax = stripePtr->m_maxValues[bandIdx];
+
+        // branch free masked min/max, so the compiler may vectorize it
+        for( col = 0; col < nCols; ++col )
+        {
+          const double value = valuesPtr[col];
+          const bool valid = !( hasNoData && ( value == noDataValue ) );
+
+          bandMin = ( valid && ( value < bandMin ) ) ? value : bandMin;
+          bandMax = ( valid && ( value > bandMax ) ) ? value : bandMax;
+        }
+
+        stripePtr->m_minValues[bandIdx] = bandMin;
+        stripePtr->m_maxValues[bandIdx] = bandMax;
+      }
+    }
+  }
+
+  const unsigned int StopWatchdogPeriodMilliseconds = 10; //!< Cancellation token polling period.
+
+  /*!
+    \brief Check a cancellation token and a deadline.
+    \param cancellationTokenPtr The cancellation token (may be empty).
+    \param deadline The deadline (may be not_a_date_time).
+    \return CompletedStatus if the execution may go on, or the stop reason.
+  */
+  teradar::segmenter::MultiLevelSegmenter::ExecutionStatus GetStopStatus(
+    const boost::shared_ptr< teradar::common::CancellationToken >& cancellationTokenPtr,
+    const boost::posix_time::ptime& deadline )
+  {
+    if( cancellationTokenPtr.get() && cancellationTokenPtr->isCancelled() )
+    {
+      return teradar::segmenter::MultiLevelSegmenter::CancelledStatus;
+    }
+
+    if( ( !deadline.is_special() ) &&
+      ( boost::posix_time::microsec_clock::universal_time() >= deadline ) )
+    {
+      return teradar::segmenter::MultiLevelSegmenter::DeadlineExceededStatus;
+    }
+
+    return teradar::segmenter::MultiLevelSegmenter::CompletedStatus;
+  }
+
+  /*!
+    \brief Watches a cancellation token and a deadline, raising an abort flag
+    when the execution must stop.
+    \details The watching thread only exists when there is a token or a
+    deadline, so the segmentation threads only check the abort flag.
+  */
+  class StopWatchdog
+  {
+    public:
+      StopWatchdog( const boost::shared_ptr< teradar::common::CancellationToken >& cancellationTokenPtr,
+        const boost::posix_time::ptime& deadline, boost::atomic< bool >& abortFlag )
+        : m_cancellationTokenPtr( cancellationTokenPtr ),
+        m_deadline( deadline ),
+        m_abortFlag( abortFlag ),
+        m_status( teradar::segmenter::MultiLevelSegmenter::CompletedStatus ),
+        m_finish( false )
+      {
+        // an already stopped execution is reported before any processing step
+
+        const teradar::segmenter::MultiLevelSegmenter::ExecutionStatus status =
+          GetStopStatus( m_cancellationTokenPtr, m_deadline );
+
+        if( status != teradar::segmenter::MultiLevelSegmenter::CompletedStatus )
+        {
+          m_status = (int)status;
+          m_abortFlag = true;
+        }
+        else if( m_cancellationTokenPtr.get() || ( !m_deadline.is_special() ) )
+        {
+          m_threadPtr.reset( new boost::thread( boost::bind( &StopWatchdog::run, this ) ) );
+        }
+      }
+
+      ~StopWatchdog()
+      {
+        if( m_threadPtr.get() )
+        {
+          {
+            boost::lock_guard< boost::mutex > lock( m_mutex );
+            m_finish = true;
+          }
+
+          m_finishSignal.notify_one();
+          m_threadPtr->join();
+        }
+      }
+
+      /*!
+        \brief Return the stop reason.
+        \return CompletedStatus if the abort flag was not raised by the watchdog.
+      */
+      teradar::segmenter::MultiLevelSegmenter::ExecutionStatus getStatus() const
+      {
+        return (teradar::segmenter::MultiLevelSegmenter::ExecutionStatus)m_status.load();
+      }
+
+    private:
+      StopWatchdog( const StopWatchdog& );
+
+      const StopWatchdog& operator=( const StopWatchdog& );
+
+      void run()
+      {
+        boost::unique_lock< boost::mutex > lock( m_mutex );
+
+        while( !m_finish )
+        {
+          const teradar::segmenter::MultiLevelSegmenter::ExecutionStatus status =
+            GetStopStatus( m_cancellationTokenPtr, m_deadline );
+
+          if( status != teradar::segmenter::MultiLevelSegmenter::CompletedStatus )
+          {
+            m_status = (int)status;
+            m_abortFlag = true;
+
+            return;
+          }
+
+          m_finishSignal.timed_wait( lock,
+            boost::posix_time::milliseconds( StopWatchdogPeriodMilliseconds ) );
+        }
+      }
+
+      boost::shared_ptr< teradar::common::CancellationToken > m_cancellationTokenPtr;
+      boost::posix_time::ptime m_deadline;
+      boost::atomic< bool >& m_abortFlag;
+      boost::atomic< int > m_status;
+      bool m_finish;
+      boost::mutex m_mutex;
+      boost::condition_variable m_finishSignal;
+      std::auto_ptr< boost::thread > m_threadPtr;
+  };
+
+  /*!
+    \brief Binds the calling thread to the given processors while alive,
+    restoring its previous affinity on destruction.
+    \details The engine workers run many jobs, a job binding must not be
+    carried into the next ones.
+  */
+  class ThreadCpusBinding
+  {
+    public:
+      ThreadCpusBinding( const std::vector< unsigned int >& cpus )
+      {
+        if( cpus.empty() )
+        {
+          return;
+        }
+
+        if( !teradar::common::GetCurrentThreadCpus( m_previousCpus ) )
+        {
+          TERP_LOGWARN( "Unable to get the segmentation thread affinity" );
+          return;
+        }
+
+        if( !teradar::common::BindCurrentThreadToCpus( cpus ) )
+        {
+          TERP_LOGWARN( "Unable to bind the segmentation thread" );
+          m_previousCpus.clear();
+        }
+      }
+
+      ~ThreadCpusBinding()
+      {
+        if( !m_previousCpus.empty() )
+        {
+          teradar::common::BindCurrentThreadToCpus( m_previousCpus );
+        }
+      }
+
+    private:
+      ThreadCpusBinding( const ThreadCpusBinding& );
+
+      const ThreadCpusBinding& operator=( const ThreadCpusBinding& );
+
+      std::vector< unsigned int > m_previousCpus; //!< The affinity to restore, empty if the thread was not bound.
+  };
+}
+
 namespace teradar {
   namespace segmenter {
     // Input parameters
@@ -52,10 +729,19 @@ namespace teradar {
       m_maxSegThreads = 0;
       m_enableBlockProcessing = false;
       m_maxBlockSize = 0;
+      m_blocksPerThread = 4;
       m_blocksOverlapPercent = 10;
       m_strategyName.clear();
       m_enableProgress = false;
       m_enableRasterCache = true;
+      m_enableMultiLevelProcessing = false;
+      m_multiLevelRefinementRadius = 1;
+      m_enableBlocksSeamsMerging = true;
+      m_enableNumaAwareness = false;
+      m_enginePtr = 0;
+      m_cancellationTokenPtr.reset();
+      m_deadline = boost::posix_time::ptime( boost::posix_time::not_a_date_time );
+      m_progressCallback.clear();
 
       if( m_segStratParamsPtr )
       {
@@ -76,10 +762,19 @@ namespace teradar {
       m_maxSegThreads = params.m_maxSegThreads;
       m_enableBlockProcessing = params.m_enableBlockProcessing;
       m_maxBlockSize = params.m_maxBlockSize;
+      m_blocksPerThread = params.m_blocksPerThread;
       m_blocksOverlapPercent = params.m_blocksOverlapPercent;
       m_strategyName = params.m_strategyName;
       m_enableProgress = params.m_enableProgress;
       m_enableRasterCache = params.m_enableRasterCache;
+      m_enableMultiLevelProcessing = params.m_enableMultiLevelProcessing;
+      m_multiLevelRefinementRadius = params.m_multiLevelRefinementRadius;
+      m_enableBlocksSeamsMerging = params.m_enableBlocksSeamsMerging;
+      m_enableNumaAwareness = params.m_enableNumaAwareness;
+      m_enginePtr = params.m_enginePtr;
+      m_cancellationTokenPtr = params.m_cancellationTokenPtr;
+      m_deadline = params.m_deadline;
+      m_progressCallback = params.m_progressCallback;
 
       m_segStratParamsPtr = params.m_segStratParamsPtr ?
         (te::rp::SegmenterStrategyParameters*)params.m_segStratParamsPtr->clone()
@@ -111,6 +806,57 @@ namespace teradar {
         return m_segStratParamsPtr;
     }
   
+    // Progress information
+    MultiLevelSegmenter::ProgressInfo::ProgressInfo()
+    {
+      m_segmentedBlocks = 0;
+      m_totalBlocks = 0;
+      m_segmentedPixels = 0;
+      m_totalPixels = 0;
+      m_elapsedSeconds = 0;
+      m_etaSeconds = -1;
+    }
+
+    // Blocks plan
+    MultiLevelSegmenter::BlocksPlan::BlocksPlan()
+    {
+      m_nonExpandedBlockWidth = 0;
+      m_nonExpandedBlockHeight = 0;
+      m_expandedBlockWidth = 0;
+      m_expandedBlockHeight = 0;
+      m_blocksHOverlapSize = 0;
+      m_blocksVOverlapSize = 0;
+      m_hBlocksNumber = 0;
+      m_vBlocksNumber = 0;
+      m_threadsNumber = 0;
+      m_alignmentWidth = 1;
+      m_alignmentHeight = 1;
+      m_pixelRequiredMemory = 0;
+      m_memoryBlockPixels = 0;
+      m_lastLevelCacheSize = 0;
+      m_cacheBlockPixels = 0;
+      m_balanceBlockPixels = 0;
+    }
+
+    std::string MultiLevelSegmenter::BlocksPlan::toString() const
+    {
+      std::ostringstream planStream;
+
+      planStream << "Blocks: " << m_hBlocksNumber << " x " << m_vBlocksNumber << std::endl;
+      planStream << "Block size: " << m_nonExpandedBlockWidth << " x " << m_nonExpandedBlockHeight << std::endl;
+      planStream << "Expanded block size: " << m_expandedBlockWidth << " x " << m_expandedBlockHeight << std::endl;
+      planStream << "Overlap: " << m_blocksHOverlapSize << " x " << m_blocksVOverlapSize << std::endl;
+      planStream << "Alignment: " << m_alignmentWidth << " x " << m_alignmentHeight << std::endl;
+      planStream << "Threads: " << m_threadsNumber << std::endl;
+      planStream << "Pixel memory (bytes): " << m_pixelRequiredMemory << std::endl;
+      planStream << "Memory block pixels: " << m_memoryBlockPixels << std::endl;
+      planStream << "Last level cache (bytes): " << m_lastLevelCacheSize << std::endl;
+      planStream << "Cache block pixels: " << m_cacheBlockPixels << std::endl;
+      planStream << "Balance block pixels: " << m_balanceBlockPixels << std::endl;
+
+      return planStream.str();
+    }
+
     // Output parameters
     MultiLevelSegmenter::OutputParameters::OutputParameters()
     {
@@ -133,6 +879,10 @@ namespace teradar {
       m_rType.clear();
       m_rInfo.clear();
       m_outputRasterPtr.reset();
+      m_blocksPlan = BlocksPlan();
+      m_status = CompletedStatus;
+      m_segmentedBlocksNumber = 0;
+      m_totalBlocksNumber = 0;
     }
 
     const MultiLevelSegmenter::OutputParameters& MultiLevelSegmenter::OutputParameters::operator=(
@@ -142,6 +892,10 @@ namespace teradar {
 
       m_rType = params.m_rType;
       m_rInfo = params.m_rInfo;
+      m_blocksPlan = params.m_blocksPlan;
+      m_status = params.m_status;
+      m_segmentedBlocksNumber = params.m_segmentedBlocksNumber;
+      m_totalBlocksNumber = params.m_totalBlocksNumber;
 
       return *this;
     }
@@ -170,12 +924,54 @@ namespace teradar {
       m_inputRasterNoDataValues.clear();
       m_enableStrategyProgress = false;
       m_maxInputRasterCachedBlocks = 0;
+      m_blocksQueuePtr = 0;
+      m_nodesQueuesOffsetsPtr = 0;
+      m_nextBlockCursorPtr = 0;
+      m_numaNode = 0;
+      m_threadCpus.clear();
+      m_strategyPtr = 0;
+      m_blocksSegmentsStatisticsPtr = 0;
+      m_strategyMaxThreads = 0;
+      m_segmentedBlocksCounterPtr = 0;
+      m_segmentedPixelsCounterPtr = 0;
+      m_totalBlocksPixels = 0;
     }
 
     MultiLevelSegmenter::SegmenterThreadEntryParams::~SegmenterThreadEntryParams()
     {
     }
 
+    // Cut off profiles generation
+    MultiLevelSegmenter::CutOffProfileTask::CutOffProfileTask()
+    {
+      m_horizontal = true;
+      m_profileCenter = 0;
+      m_generated = false;
+    }
+
+    MultiLevelSegmenter::CutOffProfileTask::~CutOffProfileTask()
+    {
+    }
+
+    MultiLevelSegmenter::CutOffProfilesThreadEntryParams::CutOffProfilesThreadEntryParams()
+    {
+      m_segmenterPtr = 0;
+      m_inputRasterPtr = 0;
+      m_inputRasterSyncPtr = 0;
+      m_maxInputRasterCachedBlocks = 0;
+      m_inputRasterBandsPtr = 0;
+      m_pixelNeighborhoodSize = 0;
+      m_horizontalProfilesNeighborhoodSize = 0;
+      m_verticalProfilesNeighborhoodSize = 0;
+      m_profileAntiSmoothingFactor = 0;
+      m_tasksPtr = 0;
+      m_nextTaskCursorPtr = 0;
+    }
+
+    MultiLevelSegmenter::CutOffProfilesThreadEntryParams::~CutOffProfilesThreadEntryParams()
+    {
+    }
+
     // MultiLevel Segmenter
     MultiLevelSegmenter::MultiLevelSegmenter()
     {
@@ -197,44 +993,50 @@ namespace teradar {
           MultiLevelSegmenter::OutputParameters* >(&outputParams);
         TERP_TRUE_OR_RETURN_FALSE( outputParamsPtr, "Invalid parameters" );
 
+        outputParamsPtr->m_status = CompletedStatus;
+        outputParamsPtr->m_segmentedBlocksNumber = 0;
+        outputParamsPtr->m_totalBlocksNumber = 0;
+
+        if( m_inputParameters.m_enableMultiLevelProcessing )
         {
-          std::vector< te::rst::BandProperty* > bandsProperties;
-          bandsProperties.push_back( new te::rst::BandProperty(
-            *(m_inputParameters.m_inputRasterPtr->getBand(
-            m_inputParameters.m_inputRasterBands[0] )->getProperty()) ) );
-          bandsProperties[0]->m_colorInterp = te::rst::GrayIdxCInt;
-          bandsProperties[0]->m_noDataValue = 0;
-          bandsProperties[0]->m_type = te::dt::UINT32_TYPE;
-
-          outputParamsPtr->m_outputRasterPtr.reset(
-            te::rst::RasterFactory::make(
-            outputParamsPtr->m_rType,
-            new te::rst::Grid( *(m_inputParameters.m_inputRasterPtr->getGrid()) ),
-            bandsProperties,
-            outputParamsPtr->m_rInfo,
-            0,
-            0 ) );
-          TERP_TRUE_OR_RETURN_FALSE( outputParamsPtr->m_outputRasterPtr.get(),
-            "Output raster creation error" );
+          return executeMultiLevel( *outputParamsPtr );
+        }
 
-          // Fill with zeroes
+        {
+          TERP_TRUE_OR_RETURN_FALSE( createOutputRaster( *outputParamsPtr ),
+            "Output raster creation error" );
 
-          te::rst::Raster& outRaster = (*outputParamsPtr->m_outputRasterPtr);
-          te::rst::Band& outBand = (*outRaster.getBand( 0 ));
-          const unsigned int nRows = outRaster.getNumberOfRows();
-          const unsigned int nCols = outRaster.getNumberOfColumns();
-          unsigned int row = 0;
-          unsigned int col = 0;
+          // Fill with zeroes (the no-data value)
 
-          for( row = 0; row < nRows; ++row )
-          {
-            for( col = 0; col < nCols; ++col )
-            {
-              outBand.setValue( col, row, 0.0 );
-            }
-          }
+          TERP_TRUE_OR_RETURN_FALSE( teradar::common::FillRasterBandWithZeros(
+            *outputParamsPtr->m_outputRasterPtr, 0 ), "Output raster initialization error" );
         }
         
+        // The cancellation token and the deadline raise the abort flag,
+        // checked between the processing steps and by the segmentation
+        // threads. The labels produced until the stop are kept
+
+        boost::atomic< bool > abortSegmentationFlag( false );
+
+        StopWatchdog stopWatchdog( m_inputParameters.m_cancellationTokenPtr,
+          m_inputParameters.m_deadline, abortSegmentationFlag );
+
+        // the engine runs one segmentation at a time
+
+        std::auto_ptr< boost::lock_guard< boost::mutex > > engineLockPtr;
+
+        if( m_inputParameters.m_enginePtr )
+        {
+          engineLockPtr.reset( new boost::lock_guard< boost::mutex >(
+            m_inputParameters.m_enginePtr->getExecutionMutex() ) );
+        }
+
+        if( stopWatchdog.getStatus() != CompletedStatus )
+        {
+          outputParamsPtr->m_status = stopWatchdog.getStatus();
+          return true;
+        }
+
         // instantiating the segmentation strategy
         std::auto_ptr< te::rp::SegmenterStrategy > strategyPtr(
           te::rp::SegmenterStrategyFactory::make( m_inputParameters.m_strategyName ) );
@@ -278,30 +1080,52 @@ namespace teradar {
           cachedRasterPtr = cachedRasterHandler.get();
         }
 
-        // Finding the input raster normalization parameters
+        // defining the number of processing threads
 
-        std::vector< std::complex< double > > inputRasterBandMinValues(
-          m_inputParameters.m_inputRasterBands.size(), 0.0 );
-        std::vector< std::complex< double > > inputRasterBandMaxValues(
-          m_inputParameters.m_inputRasterBands.size(), 0.0 );
+        unsigned int maxSegThreads = 0;
 
-        if( strategyPtr->shouldComputeMinMaxValues() )
+        if( m_inputParameters.m_enableBlockProcessing &&
+          m_inputParameters.m_enableThreadedProcessing )
         {
-          const unsigned int nRows =
-            cachedRasterPtr->getNumberOfRows();
-          const unsigned int nCols =
-            cachedRasterPtr->getNumberOfColumns();
-          unsigned int row = 0;
-          unsigned int col = 0;
-          double bandMin = DBL_MAX;
-          double bandMax = -1.0 * DBL_MAX;
-          double value = 0;
+          if( m_inputParameters.m_maxSegThreads )
+          {
+            maxSegThreads = m_inputParameters.m_maxSegThreads;
+          }
+          else
+          {
+            maxSegThreads = te::common::GetPhysProcNumber();
+            if( maxSegThreads == 1 )
+            {
+              maxSegThreads = 0;
+            }
+          }
+
+          if( m_inputParameters.m_enginePtr )
+          {
+            maxSegThreads = std::min( maxSegThreads,
+              m_inputParameters.m_enginePtr->getWorkersNumber() );
+          }
+        }
+
+        // Finding the input raster normalization parameters
+
+        std::vector< std::complex< double > > inputRasterBandMinValues(
+          m_inputParameters.m_inputRasterBands.size(), 0.0 );
+        std::vector< std::complex< double > > inputRasterBandMaxValues(
+          m_inputParameters.m_inputRasterBands.size(), 0.0 );
+
+        if( strategyPtr->shouldComputeMinMaxValues() )
+        {
+          const unsigned int inputRasterBandsNumber =
+            (unsigned int)m_inputParameters.m_inputRasterBands.size();
+          const unsigned int nRows =
+            cachedRasterPtr->getNumberOfRows();
 
           std::vector< std::complex< double > > noDataValues;
           if( m_inputParameters.m_inputRasterNoDataValues.empty() )
           {
             for( unsigned int inputRasterBandsIdx = 0; inputRasterBandsIdx <
-              m_inputParameters.m_inputRasterBands.size(); ++inputRasterBandsIdx )
+              inputRasterBandsNumber; ++inputRasterBandsIdx )
             {
               noDataValues.push_back(
                 m_inputParameters.m_inputRasterPtr->getBand(
@@ -314,63 +1138,80 @@ namespace teradar {
             noDataValues = m_inputParameters.m_inputRasterNoDataValues;
           }
 
-          for( unsigned int inputRasterBandsIdx = 0; inputRasterBandsIdx <
-            m_inputParameters.m_inputRasterBands.size(); ++inputRasterBandsIdx )
+          // All bands are scanned in a single sweep over rows stripes, one
+          // stripe per thread. Stripes are aligned to the input blocks lines
+          // so each input block is read by only one thread.
+
+          const te::rst::BandProperty& inputBandProp =
+            *( m_inputParameters.m_inputRasterPtr->getBand(
+            m_inputParameters.m_inputRasterBands[0] )->getProperty() );
+          const unsigned int blockHeight = (unsigned int)std::max( 1,
+            inputBandProp.m_blkh );
+          const unsigned int blocksLinesNumber = ( nRows + blockHeight - 1 ) /
+            blockHeight;
+          const unsigned int stripesNumber = std::max( 1u,
+            std::min( maxSegThreads, blocksLinesNumber ) );
+          const unsigned int stripeHeight = ( ( blocksLinesNumber +
+            stripesNumber - 1 ) / stripesNumber ) * blockHeight;
+
+          std::vector< MinMaxStripe > stripes( stripesNumber );
+
+          for( unsigned int stripeIdx = 0; stripeIdx < stripesNumber; ++stripeIdx )
+          {
+            MinMaxStripe& stripe = stripes[stripeIdx];
+            stripe.m_rasterPtr = ( stripesNumber == 1 ) ? cachedRasterPtr : 0;
+            stripe.m_rasterSyncPtr = 0;
+            // one blocks line per band is enough for the line by line sweep
+            stripe.m_maxCachedBlocks = inputRasterBandsNumber *
+              (unsigned int)std::max( 1, inputBandProp.m_nblocksx );
+            stripe.m_bandsPtr = &m_inputParameters.m_inputRasterBands;
+            stripe.m_noDataValuesPtr = &noDataValues;
+            stripe.m_rowStart = std::min( nRows, stripeIdx * stripeHeight );
+            stripe.m_rowBound = std::min( nRows, stripe.m_rowStart + stripeHeight );
+          }
+
+          if( stripesNumber == 1 )
+          {
+            ComputeStripeMinMax( &stripes[0] );
+          }
+          else
           {
-            const te::rst::Band& band =
-              *(cachedRasterPtr->getBand(
-              m_inputParameters.m_inputRasterBands[inputRasterBandsIdx] ));
-            bandMin = DBL_MAX;
-            bandMax = -1.0 * DBL_MAX;
+            te::rst::RasterSynchronizer minMaxRasterSync(
+              *((te::rst::Raster*)m_inputParameters.m_inputRasterPtr), te::common::RAccess );
+            boost::thread_group minMaxThreads;
 
-            for( row = 0; row < nRows; ++row )
+            for( unsigned int stripeIdx = 0; stripeIdx < stripesNumber; ++stripeIdx )
             {
-              for( col = 0; col < nCols; ++col )
-              {
-                band.getValue( col, row, value );
-
-                if( value != noDataValues[inputRasterBandsIdx] )
-                {
-                  if( bandMin > value ) bandMin = value;
-                  if( bandMax < value ) bandMax = value;
-                }
-              }
+              stripes[stripeIdx].m_rasterSyncPtr = &minMaxRasterSync;
+              minMaxThreads.add_thread( new boost::thread( ComputeStripeMinMax,
+                &stripes[stripeIdx] ) );
             }
 
-            inputRasterBandMinValues[inputRasterBandsIdx] = bandMin;
-            inputRasterBandMaxValues[inputRasterBandsIdx] = bandMax;
+            minMaxThreads.join_all();
           }
-        }
-
-        // defining the number of processing threads
 
-        unsigned int maxSegThreads = 0;
+          // reducing the stripes results
 
-        if( m_inputParameters.m_enableBlockProcessing &&
-          m_inputParameters.m_enableThreadedProcessing )
-        {
-          if( m_inputParameters.m_maxSegThreads )
-          {
-            maxSegThreads = m_inputParameters.m_maxSegThreads;
-          }
-          else
+          for( unsigned int inputRasterBandsIdx = 0; inputRasterBandsIdx <
+            inputRasterBandsNumber; ++inputRasterBandsIdx )
           {
-            maxSegThreads = te::common::GetPhysProcNumber();
-            if( maxSegThreads == 1 )
+            double bandMin = DBL_MAX;
+            double bandMax = -1.0 * DBL_MAX;
+
+            for( unsigned int stripeIdx = 0; stripeIdx < stripesNumber; ++stripeIdx )
             {
-              maxSegThreads = 0;
+              bandMin = std::min( bandMin, stripes[stripeIdx].m_minValues[inputRasterBandsIdx] );
+              bandMax = std::max( bandMax, stripes[stripeIdx].m_maxValues[inputRasterBandsIdx] );
             }
+
+            inputRasterBandMinValues[inputRasterBandsIdx] = bandMin;
+            inputRasterBandMaxValues[inputRasterBandsIdx] = bandMax;
           }
         }
 
-        // Calc the maximum block width & height
+        // Planning the blocks
 
-        unsigned int maxNonExpandedBlockWidth = 0;
-        unsigned int maxNonExpandedBlockHeight = 0;
-        unsigned int maxExpandedBlockWidth = 0;
-        unsigned int maxExpandedBlockHeight = 0;
-        unsigned int blocksHOverlapSize = 0;
-        unsigned int blocksVOverlapSize = 0;
+        BlocksPlan& blocksPlan = outputParamsPtr->m_blocksPlan;
 
         if( m_inputParameters.m_enableBlockProcessing &&
           (( maxSegThreads > 0 ) || ( maxSimultaneousMemoryPixels < ((double)totalRasterPixels) )
@@ -393,33 +1234,42 @@ namespace teradar {
               (static_cast<double>(maxSegThreads ? maxSegThreads : 1))));
           }
 
-          // updating maxBlockPixels considering the blocks overlap size
+          // the overlap is only used by the gradient merging
 
-          TERP_TRUE_OR_RETURN_FALSE( calcBestBlockSize(
-            200,
+          TERP_TRUE_OR_RETURN_FALSE( planBlocks(
+            pixelRequiredRam,
             maxBlockPixels,
-            blocksHOverlapSize,
-            blocksVOverlapSize,
-            maxNonExpandedBlockWidth,
-            maxNonExpandedBlockHeight,
-            maxExpandedBlockWidth,
-            maxExpandedBlockHeight ),
-            "Error calculating best block size" );
+            ( strategyPtr->getBlocksMergingMethod() == te::rp::SegmenterStrategy::GradientMerging ) ?
+            m_inputParameters.m_blocksOverlapPercent : 0,
+            maxSegThreads,
+            blocksPlan ),
+            "Error planning the blocks" );
         } else {
-          maxNonExpandedBlockWidth = maxExpandedBlockWidth =
+          blocksPlan = BlocksPlan();
+          blocksPlan.m_nonExpandedBlockWidth = blocksPlan.m_expandedBlockWidth =
             cachedRasterPtr->getNumberOfColumns();
-          maxNonExpandedBlockHeight = maxExpandedBlockHeight =
+          blocksPlan.m_nonExpandedBlockHeight = blocksPlan.m_expandedBlockHeight =
             cachedRasterPtr->getNumberOfRows();
+          blocksPlan.m_hBlocksNumber = 1;
+          blocksPlan.m_vBlocksNumber = 1;
+          blocksPlan.m_threadsNumber = maxSegThreads;
+          blocksPlan.m_pixelRequiredMemory = pixelRequiredRam;
         }
 
-        // Defining number of blocks
+        const unsigned int maxNonExpandedBlockWidth = blocksPlan.m_nonExpandedBlockWidth;
+        const unsigned int maxNonExpandedBlockHeight = blocksPlan.m_nonExpandedBlockHeight;
+        const unsigned int blocksHOverlapSize = blocksPlan.m_blocksHOverlapSize;
+        const unsigned int blocksVOverlapSize = blocksPlan.m_blocksVOverlapSize;
+        const unsigned int hBlocksNumber = blocksPlan.m_hBlocksNumber;
+        const unsigned int vBlocksNumber = blocksPlan.m_vBlocksNumber;
 
-        const unsigned int hBlocksNumber = (unsigned int)ceil(
-          ((double)cachedRasterPtr->getNumberOfColumns()) /
-          ((double)maxNonExpandedBlockWidth) );
-        const unsigned int vBlocksNumber = (unsigned int)ceil(
-          ((double)cachedRasterPtr->getNumberOfRows()) /
-          ((double)maxNonExpandedBlockHeight) );
+        outputParamsPtr->m_totalBlocksNumber = hBlocksNumber * vBlocksNumber;
+
+        if( stopWatchdog.getStatus() != CompletedStatus )
+        {
+          outputParamsPtr->m_status = stopWatchdog.getStatus();
+          return true;
+        }
 
         // Generating cut off profiles. When possible, an empty profile
         // vector is generated
@@ -439,45 +1289,96 @@ namespace teradar {
           const unsigned int profileAntiSmoothingFactor = 3;
           std::vector< unsigned int > imageHorizontalProfilesCenterLines;
           std::vector< unsigned int > imageVerticalProfilesCenterLines;
-          std::vector< unsigned int> profile;
+          std::vector< CutOffProfileTask > profilesTasks;
           unsigned int profileIdx = 0;
 
           for( profileIdx = 1; profileIdx < hBlocksNumber;
             ++profileIdx )
           {
-            profile.clear();
-
-            const unsigned int centerLine = std::min(
+            profilesTasks.push_back( CutOffProfileTask() );
+            profilesTasks.back().m_horizontal = true;
+            profilesTasks.back().m_profileCenter = std::min(
               (profileIdx * maxNonExpandedBlockHeight) - 1,
               cachedRasterPtr->getNumberOfRows() - 1 );
-
-            TERP_TRUE_OR_RETURN_FALSE( genImageHCutOffProfile( centerLine,
-              *(cachedRasterPtr), m_inputParameters.m_inputRasterBands,
-              pixelNeighborhoodSize, horizontalProfilesNeighborhoodSize,
-              profileAntiSmoothingFactor, profile ),
-              "Horizontal profile generation error" );
-
-            imageHorizontalProfiles.push_back( profile );
-            imageHorizontalProfilesCenterLines.push_back( centerLine );
           }
 
           for( profileIdx = 1; profileIdx < vBlocksNumber;
             ++profileIdx )
           {
-            profile.clear();
-
-            const unsigned int centerLine = std::min(
+            profilesTasks.push_back( CutOffProfileTask() );
+            profilesTasks.back().m_horizontal = false;
+            profilesTasks.back().m_profileCenter = std::min(
               (profileIdx * maxNonExpandedBlockWidth) - 1,
               cachedRasterPtr->getNumberOfColumns() - 1 );
+          }
+
+          // Each profile is independent, so they are generated by concurrent
+          // threads, each one taking the next pending profile.
+
+          boost::atomic< unsigned int > nextProfileCursor( 0 );
+
+          CutOffProfilesThreadEntryParams profilesParams;
+          profilesParams.m_segmenterPtr = this;
+          profilesParams.m_inputRasterBandsPtr = &m_inputParameters.m_inputRasterBands;
+          profilesParams.m_pixelNeighborhoodSize = pixelNeighborhoodSize;
+          profilesParams.m_horizontalProfilesNeighborhoodSize = horizontalProfilesNeighborhoodSize;
+          profilesParams.m_verticalProfilesNeighborhoodSize = verticalProfilesNeighborhoodSize;
+          profilesParams.m_profileAntiSmoothingFactor = profileAntiSmoothingFactor;
+          profilesParams.m_tasksPtr = &profilesTasks;
+          profilesParams.m_nextTaskCursorPtr = &nextProfileCursor;
+
+          const unsigned int profilesThreadsNumber = std::min( maxSegThreads,
+            (unsigned int)profilesTasks.size() );
+
+          if( profilesThreadsNumber > 1 )
+          {
+            te::rst::RasterSynchronizer profilesRasterSync(
+              *((te::rst::Raster*)m_inputParameters.m_inputRasterPtr), te::common::RAccess );
+
+            const int bandBlockSizeBytes =
+              m_inputParameters.m_inputRasterPtr->getBand(
+              m_inputParameters.m_inputRasterBands[0] )->getBlockSize();
+
+            profilesParams.m_inputRasterSyncPtr = &profilesRasterSync;
+            profilesParams.m_maxInputRasterCachedBlocks = std::max( 1u,
+              (unsigned int)( ( 0.05 * freeVMem ) / ((double)bandBlockSizeBytes) /
+              ((double)profilesThreadsNumber) ) );
+
+            boost::thread_group profilesThreads;
+
+            for( unsigned int threadIdx = 0; threadIdx < profilesThreadsNumber;
+              ++threadIdx )
+            {
+              profilesThreads.add_thread( new boost::thread( cutOffProfilesThreadEntry,
+                &profilesParams ) );
+            }
+
+            profilesThreads.join_all();
+          }
+          else
+          {
+            profilesParams.m_inputRasterPtr = cachedRasterPtr;
+
+            cutOffProfilesThreadEntry( &profilesParams );
+          }
 
-            TERP_TRUE_OR_RETURN_FALSE( genImageVCutOffProfile( centerLine,
-              *(cachedRasterPtr), m_inputParameters.m_inputRasterBands,
-              pixelNeighborhoodSize, verticalProfilesNeighborhoodSize,
-              profileAntiSmoothingFactor, profile ),
-              "Horizontal profile generation error" );
+          for( profileIdx = 0; profileIdx < profilesTasks.size(); ++profileIdx )
+          {
+            const CutOffProfileTask& task = profilesTasks[profileIdx];
+
+            TERP_TRUE_OR_RETURN_FALSE( task.m_generated,
+              "Cut off profile generation error" );
 
-            imageVerticalProfiles.push_back( profile );
-            imageVerticalProfilesCenterLines.push_back( centerLine );
+            if( task.m_horizontal )
+            {
+              imageHorizontalProfiles.push_back( task.m_profile );
+              imageHorizontalProfilesCenterLines.push_back( task.m_profileCenter );
+            }
+            else
+            {
+              imageVerticalProfiles.push_back( task.m_profile );
+              imageVerticalProfilesCenterLines.push_back( task.m_profileCenter );
+            }
           }
 
           // TERP_TRUE_OR_THROW( createCutOffLinesTiff( imageHorizontalProfiles,
@@ -563,6 +1464,99 @@ namespace teradar {
           }
         }
 
+        // Ordering the blocks by decreasing estimated cost (the block pixels
+        // number), so the most expensive ones are started first and all
+        // threads finish at nearly the same time
+
+        std::vector< unsigned int > blocksQueue;
+
+        {
+          std::vector< std::pair< unsigned int, unsigned int > > blocksCosts;
+
+          for( unsigned int segmentsMatrixLine = 0; segmentsMatrixLine <
+            segmentsblocksMatrix.getLinesNumber(); ++segmentsMatrixLine )
+          {
+            for( unsigned int segmentsMatrixCol = 0; segmentsMatrixCol <
+              segmentsblocksMatrix.getColumnsNumber(); ++segmentsMatrixCol )
+            {
+              const te::rp::SegmenterSegmentsBlock& segmentsBlock = segmentsblocksMatrix(
+                segmentsMatrixLine, segmentsMatrixCol );
+
+              blocksCosts.push_back( std::pair< unsigned int, unsigned int >(
+                segmentsBlock.m_width * segmentsBlock.m_height,
+                segmentsMatrixLine * segmentsblocksMatrix.getColumnsNumber() +
+                segmentsMatrixCol ) );
+            }
+          }
+
+          std::stable_sort( blocksCosts.begin(), blocksCosts.end(), HigherBlockCost );
+
+          for( unsigned int blockIdx = 0; blockIdx < blocksCosts.size(); ++blockIdx )
+          {
+            blocksQueue.push_back( blocksCosts[blockIdx].second );
+          }
+        }
+
+        // NUMA nodes: each node gets a contiguous range of blocks lines, so
+        // its threads read neighbour raster blocks, and its threads take the
+        // other nodes blocks only when its own are over
+
+        std::vector< std::vector< unsigned int > > numaNodesCpus;
+
+        if( m_inputParameters.m_enableNumaAwareness && maxSegThreads &&
+          ((vBlocksNumber * hBlocksNumber) > 1) )
+        {
+          if( !teradar::common::GetNumaNodesCpus( numaNodesCpus ) ||
+            ( numaNodesCpus.size() < 2 ) )
+          {
+            numaNodesCpus.clear();
+          }
+        }
+
+        const unsigned int numaNodesNumber = numaNodesCpus.empty() ? 1u :
+          (unsigned int)numaNodesCpus.size();
+        std::vector< unsigned int > nodesQueuesOffsets( numaNodesNumber + 1, 0 );
+
+        {
+          const unsigned int blocksNumber = (unsigned int)blocksQueue.size();
+          std::vector< std::pair< unsigned int, unsigned int > > nodesBlocks;
+
+          for( unsigned int blockIdx = 0; blockIdx < blocksNumber; ++blockIdx )
+          {
+            nodesBlocks.push_back( std::pair< unsigned int, unsigned int >(
+              (unsigned int)( ( ((unsigned long long)blocksQueue[blockIdx]) * numaNodesNumber ) /
+              blocksNumber ), blocksQueue[blockIdx] ) );
+          }
+
+          // the decreasing cost order is kept inside each node group
+          std::stable_sort( nodesBlocks.begin(), nodesBlocks.end(), LowerBlockNode );
+
+          for( unsigned int blockIdx = 0; blockIdx < blocksNumber; ++blockIdx )
+          {
+            blocksQueue[blockIdx] = nodesBlocks[blockIdx].second;
+            ++nodesQueuesOffsets[nodesBlocks[blockIdx].first + 1];
+          }
+
+          for( unsigned int node = 0; node < numaNodesNumber; ++node )
+          {
+            nodesQueuesOffsets[node + 1] += nodesQueuesOffsets[node];
+          }
+        }
+
+        boost::scoped_array< boost::atomic< unsigned int > > nextBlockCursors(
+          new boost::atomic< unsigned int >[ numaNodesNumber ] );
+
+        for( unsigned int node = 0; node < numaNodesNumber; ++node )
+        {
+          nextBlockCursors[node] = 0;
+        }
+
+        if( stopWatchdog.getStatus() != CompletedStatus )
+        {
+          outputParamsPtr->m_status = stopWatchdog.getStatus();
+          return true;
+        }
+
         // Disabling de raster cache
         // since it will be not used during segmentation
 
@@ -593,13 +1587,26 @@ namespace teradar {
         te::rst::RasterSynchronizer outputRasterSync( *(outputParamsPtr->m_outputRasterPtr),
           te::common::WAccess );
 
-        volatile bool abortSegmentationFlag = false;
-
         te::rp::SegmenterIdsManager segmenterIdsManager;
 
         boost::condition_variable blockProcessedSignal;
 
-        volatile unsigned int runningThreadsCounter = 0;
+        boost::atomic< unsigned int > runningThreadsCounter( 0 );
+
+        boost::atomic< unsigned int > segmentedBlocksCounter( 0 );
+
+        boost::atomic< unsigned long long > segmentedPixelsCounter( 0 );
+
+        unsigned long long totalBlocksPixels = 0;
+
+        for( unsigned int blockIdx = 0; blockIdx < blocksQueue.size(); ++blockIdx )
+        {
+          const te::rp::SegmenterSegmentsBlock& segmentsBlock = segmentsblocksMatrix(
+            blocksQueue[blockIdx] / hBlocksNumber, blocksQueue[blockIdx] % hBlocksNumber );
+
+          totalBlocksPixels += ((unsigned long long)segmentsBlock.m_width) *
+            ((unsigned long long)segmentsBlock.m_height);
+        }
 
         SegmenterThreadEntryParams baseSegThreadParams;
         baseSegThreadParams.m_inputParameters = m_inputParameters;
@@ -620,6 +1627,13 @@ namespace teradar {
         baseSegThreadParams.m_inputRasterBandMinValues = inputRasterBandMinValues;
         baseSegThreadParams.m_inputRasterBandMaxValues = inputRasterBandMaxValues;
         baseSegThreadParams.m_enableStrategyProgress = enableStrategyProgress;
+        baseSegThreadParams.m_blocksQueuePtr = &blocksQueue;
+        baseSegThreadParams.m_nodesQueuesOffsetsPtr = &nodesQueuesOffsets;
+        baseSegThreadParams.m_nextBlockCursorPtr = nextBlockCursors.get();
+        baseSegThreadParams.m_segmentedBlocksCounterPtr = &segmentedBlocksCounter;
+        baseSegThreadParams.m_segmentedPixelsCounterPtr = &segmentedPixelsCounter;
+        baseSegThreadParams.m_totalBlocksPixels = totalBlocksPixels;
+        baseSegThreadParams.m_startTime = boost::posix_time::microsec_clock::universal_time();
 
         if( m_inputParameters.m_inputRasterNoDataValues.empty() )
         {
@@ -637,6 +1651,24 @@ namespace teradar {
           baseSegThreadParams.m_inputRasterNoDataValues = m_inputParameters.m_inputRasterNoDataValues;
         }
 
+        // The segments crossing the blocks seams are merged when the strategy
+        // provides their statistics and the blocks do not overlap
+
+        std::vector< SegmenterBorderStatisticsProvider::SegmentsStatisticsT >
+          blocksSegmentsStatistics;
+
+        SegmenterBorderStatisticsProvider const* const statisticsProviderPtr =
+          dynamic_cast< SegmenterBorderStatisticsProvider const* >( strategyPtr.get() );
+
+        if( m_inputParameters.m_enableBlocksSeamsMerging &&
+          ((vBlocksNumber * hBlocksNumber) > 1) &&
+          (blocksHOverlapSize == 0) && (blocksVOverlapSize == 0) &&
+          statisticsProviderPtr )
+        {
+          blocksSegmentsStatistics.resize( vBlocksNumber * hBlocksNumber );
+          baseSegThreadParams.m_blocksSegmentsStatisticsPtr = &blocksSegmentsStatistics;
+        }
+
         if( m_inputParameters.m_enableRasterCache )
         {
           int bandBlockSizeBytes =
@@ -660,187 +1692,1100 @@ namespace teradar {
           baseSegThreadParams.m_maxInputRasterCachedBlocks = 1;
         }
 
-        if( maxSegThreads && ((vBlocksNumber * hBlocksNumber) > 1) )
-        { // threaded segmentation mode
+        // the engine strategies keep their segments pools and IDs matrices
+        // from previous executions
+
+        if( m_inputParameters.m_enginePtr )
+        {
+          baseSegThreadParams.m_strategyPtr = m_inputParameters.m_enginePtr->getWorkerStrategy(
+            0, m_inputParameters.m_strategyName );
+          TERP_TRUE_OR_RETURN_FALSE( baseSegThreadParams.m_strategyPtr,
+            "Unable to create an segmentation strategy" );
+        }
+
+        // the blocks threads already use the processors, the strategies
+        // threads inside each block are limited to the remaining ones
+
+        if( maxSegThreads && ((vBlocksNumber * hBlocksNumber) > 1) )
+        {
+          baseSegThreadParams.m_strategyMaxThreads = std::max( 1u,
+            (unsigned int)te::common::GetPhysProcNumber() / maxSegThreads );
+        }
+
+        if( maxSegThreads && ((vBlocksNumber * hBlocksNumber) > 1) )
+        { // threaded segmentation mode
+
+          std::vector< SegmenterThreadEntryParams > threadsParams( maxSegThreads );
+
+          for( unsigned int threadIdx = 0; threadIdx < maxSegThreads;
+            ++threadIdx )
+          {
+            threadsParams[threadIdx] = baseSegThreadParams;
+
+            if( !numaNodesCpus.empty() )
+            {
+              // threads are spread over the nodes, each one bound to all its
+              // node processors, the strategy threads it creates (inheriting
+              // its affinity) run on the other node processors
+              threadsParams[threadIdx].m_numaNode = threadIdx % numaNodesNumber;
+              threadsParams[threadIdx].m_threadCpus =
+                numaNodesCpus[ threadIdx % numaNodesNumber ];
+            }
+
+            if( m_inputParameters.m_enginePtr )
+            {
+              threadsParams[threadIdx].m_strategyPtr =
+                m_inputParameters.m_enginePtr->getWorkerStrategy( threadIdx,
+                m_inputParameters.m_strategyName );
+              TERP_TRUE_OR_RETURN_FALSE( threadsParams[threadIdx].m_strategyPtr,
+                "Unable to create an segmentation strategy" );
+            }
+          }
+
+          // spawning the segmentation threads, or waking up the engine workers
+
+          runningThreadsCounter = maxSegThreads;
+
+          boost::thread_group threads;
+
+          if( m_inputParameters.m_enginePtr )
+          {
+            TERP_TRUE_OR_RETURN_FALSE( m_inputParameters.m_enginePtr->start( boost::bind(
+              &MultiLevelSegmenter::engineJobEntry, &threadsParams, _1 ), maxSegThreads ),
+              "Unable to start the segmentation engine job" );
+          }
+          else
+          {
+            for( unsigned int threadIdx = 0; threadIdx < maxSegThreads;
+              ++threadIdx )
+            {
+              threads.add_thread( new boost::thread( segmenterThreadEntry,
+                &(threadsParams[threadIdx]) ) );
+            }
+          }
+
+          // waiting all threads to finish, waking up each time a block is
+          // segmented or a thread exits
+
+          unsigned int prevSegmentedBlocksNmb = 0;
+
+          {
+            boost::unique_lock<boost::mutex> lock( blockProcessedSignalMutex );
+
+            while( (!abortSegmentationFlag) && (runningThreadsCounter > 0) )
+            {
+              if( segmentedBlocksCounter == prevSegmentedBlocksNmb )
+              {
+                if( progressPtr.get() )
+                {
+                  // the user may cancel the progress without any block
+                  // being segmented
+                  blockProcessedSignal.timed_wait( lock,
+                    boost::posix_time::seconds( 1 ) );
+                }
+                else
+                {
+                  blockProcessedSignal.wait( lock );
+                }
+              }
+
+              //            std::cout << std::endl << "Woke up" << std::endl;
+
+              const unsigned int segmentedBlocksNmb = segmentedBlocksCounter;
+
+              if( progressPtr.get() )
+              {
+                for( ; prevSegmentedBlocksNmb < segmentedBlocksNmb; ++prevSegmentedBlocksNmb )
+                {
+                  progressPtr->pulse();
+                }
+
+                if( !progressPtr->isActive() )
+                {
+                  abortSegmentationFlag = true;
+                }
+
+                //              std::cout << std::endl << "segmentedBlocksNmb:" << segmentedBlocksNmb << std::endl;
+              }
+
+              prevSegmentedBlocksNmb = segmentedBlocksNmb;
+            }
+          }
+
+          // joining all threads
+
+          if( m_inputParameters.m_enginePtr )
+          {
+            m_inputParameters.m_enginePtr->join();
+          }
+          else
+          {
+            threads.join_all();
+          }
+          /*
+          globalMutex.lock();
+          std::cout << std::endl << "Threads joined." << std::endl;
+          globalMutex.unlock();
+          */
+        }
+        else
+        { // non-threaded segmentation mode 
+          runningThreadsCounter = 1;
+          segmenterThreadEntry( &baseSegThreadParams );
+        }
+
+        outputParamsPtr->m_segmentedBlocksNumber = segmentedBlocksCounter;
+
+        if( (!abortSegmentationFlag) && (!blocksSegmentsStatistics.empty()) )
+        {
+          TERP_TRUE_OR_RETURN_FALSE( mergeBlocksSeams( segmentsblocksMatrix,
+            blocksSegmentsStatistics, *statisticsProviderPtr, maxSegThreads,
+            outputRasterSync, *(outputParamsPtr->m_outputRasterPtr) ),
+            "Blocks seams merging error" );
+        }
+
+        // a stop requested by the token or the deadline is not an error, the
+        // segmented blocks labels are kept (without the seams merging)
+
+        if( stopWatchdog.getStatus() != CompletedStatus )
+        {
+          outputParamsPtr->m_status = stopWatchdog.getStatus();
+          return true;
+        }
+
+        return (!abortSegmentationFlag);
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    void MultiLevelSegmenter::reset() throw(te::rp::Exception)
+    {
+      m_instanceInitialized = false;
+      m_inputParameters.reset();
+    }
+    
+    // @todo - etore - Verify under this line
+    bool MultiLevelSegmenter::initialize( const te::rp::AlgorithmInputParameters& inputParams )
+      throw(te::rp::Exception)
+    {
+      reset();
+
+      MultiLevelSegmenter::InputParameters const* inputParamsPtr = dynamic_cast<
+        MultiLevelSegmenter::InputParameters const* >(&inputParams);
+
+      TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr, "Invalid parameters" );
+      TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr->m_inputRasterPtr, "Invalid raster pointer" );
+      TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr->m_inputRasterPtr->getAccessPolicy() & te::common::RAccess,
+        "Invalid raster" );
+
+      TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr->m_inputRasterBands.size() > 0,
+        "Invalid raster bands number" );
+      for( unsigned int inputRasterBandsIdx = 0; inputRasterBandsIdx <
+        inputParamsPtr->m_inputRasterBands.size(); ++inputRasterBandsIdx )
+      {
+        TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr->m_inputRasterBands[
+          inputRasterBandsIdx] < inputParamsPtr->m_inputRasterPtr->getNumberOfBands(),
+            "Invalid raster band number" );
+      }
+
+      TERP_TRUE_OR_RETURN_FALSE( (inputParamsPtr->m_inputRasterNoDataValues.empty() ?
+        true : (inputParamsPtr->m_inputRasterNoDataValues.size() ==
+        inputParamsPtr->m_inputRasterBands.size())),
+        "Invalid no-data values" );
+
+      TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr->m_blocksPerThread > 0,
+        "Invalid blocks per thread number" );
+
+      TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr->m_blocksOverlapPercent <= 25,
+        "Invalid blocks overlapped area percentage" );
+
+      TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr->m_multiLevelRefinementRadius > 0,
+        "Invalid multi level refinement radius" );
+
+      m_inputParameters = *inputParamsPtr;
+      m_instanceInitialized = true;
+
+      return true;
+    }
+
+    bool MultiLevelSegmenter::isInitialized() const
+    {
+      return m_instanceInitialized;
+    }
+
+    bool MultiLevelSegmenter::createOutputRaster(
+      MultiLevelSegmenter::OutputParameters& outputParams ) const
+    {
+      std::vector< te::rst::BandProperty* > bandsProperties;
+      bandsProperties.push_back( new te::rst::BandProperty(
+        *(m_inputParameters.m_inputRasterPtr->getBand(
+        m_inputParameters.m_inputRasterBands[0] )->getProperty()) ) );
+      bandsProperties[0]->m_colorInterp = te::rst::GrayIdxCInt;
+      bandsProperties[0]->m_noDataValue = 0;
+      bandsProperties[0]->m_type = te::dt::UINT32_TYPE;
+
+      outputParams.m_outputRasterPtr.reset(
+        te::rst::RasterFactory::make(
+        outputParams.m_rType,
+        new te::rst::Grid( *(m_inputParameters.m_inputRasterPtr->getGrid()) ),
+        bandsProperties,
+        outputParams.m_rInfo,
+        0,
+        0 ) );
+
+      return ( outputParams.m_outputRasterPtr.get() != 0 );
+    }
+
+    MultiLevelSegmenter::ExecutionStatus MultiLevelSegmenter::getStopStatus() const
+    {
+      return GetStopStatus( m_inputParameters.m_cancellationTokenPtr,
+        m_inputParameters.m_deadline );
+    }
+
+    bool MultiLevelSegmenter::executeMultiLevel(
+      MultiLevelSegmenter::OutputParameters& outputParams )
+    {
+      SegmenterRegionGrowingWishartStrategy::Parameters const* strategyParamsPtr =
+        dynamic_cast< SegmenterRegionGrowingWishartStrategy::Parameters const* >(
+        m_inputParameters.getSegStrategyParams() );
+      TERP_TRUE_OR_RETURN_FALSE( strategyParamsPtr,
+        "Multi level processing requires the Wishart strategy parameters" );
+      TERP_TRUE_OR_RETURN_FALSE( strategyParamsPtr->m_dataType == teradar::common::CovarianceMatrixT,
+        "Multi level processing requires covariance matrix data" );
+
+      const unsigned int bandsNumber = (unsigned int)m_inputParameters.m_inputRasterBands.size();
+      const unsigned int covMatrixOrder = (unsigned int)std::floor(
+        std::sqrt( (double)bandsNumber ) + 0.5 );
+      TERP_TRUE_OR_RETURN_FALSE( covMatrixOrder * covMatrixOrder == bandsNumber,
+        "Invalid covariance matrix bands number" );
+
+      // Choosing the coarsest level, the first one with enough looks to allow
+      // the Wishart hypothesis tests
+
+      const unsigned int nRows = m_inputParameters.m_inputRasterPtr->getNumberOfRows();
+      const unsigned int nCols = m_inputParameters.m_inputRasterPtr->getNumberOfColumns();
+      const teradar::common::MultiResolution::Parameters multiResParams;
+
+      unsigned int level = teradar::common::ComputeMinCompLevelENL(
+        strategyParamsPtr->m_dataType, bandsNumber,
+        teradar::common::MultiResolution::computeMaxCompressionLevel( nRows, nCols ),
+        strategyParamsPtr->m_enlLZero ).first;
+
+      {
+        // the computed level may round the levels sizes down to zero
+        unsigned int levelRows = nRows;
+        unsigned int levelCols = nCols;
+        unsigned int validLevel = 0;
+
+        while( ( validLevel < level ) && ( levelRows >= multiResParams.m_rowsFactor ) &&
+          ( levelCols >= multiResParams.m_colsFactor ) )
+        {
+          levelRows /= multiResParams.m_rowsFactor;
+          levelCols /= multiResParams.m_colsFactor;
+          ++validLevel;
+        }
+
+        level = validLevel;
+      }
+
+      teradar::common::MultiResolution multiResolution( *m_inputParameters.m_inputRasterPtr,
+        level, multiResParams );
+
+      // Segmenting the coarsest level. When no compression is needed,
+      // the input raster is directly segmented into the output raster
+
+      MultiLevelSegmenter::InputParameters coarseInputParams = m_inputParameters;
+      coarseInputParams.m_inputRasterPtr = multiResolution.getLevel( level );
+      coarseInputParams.m_enableMultiLevelProcessing = false;
+
+      SegmenterRegionGrowingWishartStrategy::Parameters coarseStrategyParams = *strategyParamsPtr;
+      coarseStrategyParams.m_compressionLevel += (double)level;
+      coarseStrategyParams.m_minSegmentSize = std::max( 1u, (unsigned int)(
+        ((double)strategyParamsPtr->m_minSegmentSize) / std::pow( (double)(
+        multiResParams.m_rowsFactor * multiResParams.m_colsFactor ), (int)level ) ) );
+      coarseInputParams.setSegStrategyParams( coarseStrategyParams );
+
+      MultiLevelSegmenter::OutputParameters coarseOutputParams;
+      coarseOutputParams.m_rType = "MEM";
+
+      {
+        MultiLevelSegmenter coarseSegmenter;
+        TERP_TRUE_OR_RETURN_FALSE( coarseSegmenter.initialize( coarseInputParams ),
+          "Coarse level segmenter initialization error" );
+        TERP_TRUE_OR_RETURN_FALSE( coarseSegmenter.execute( ( level == 0 ) ?
+          outputParams : coarseOutputParams ), "Coarse level segmentation error" );
+      }
+
+      if( level == 0 )
+      {
+        return true;
+      }
+
+      // A stopped coarse segmentation is still projected to the input
+      // raster resolution, without refinement
+
+      outputParams.m_status = coarseOutputParams.m_status;
+      outputParams.m_segmentedBlocksNumber = coarseOutputParams.m_segmentedBlocksNumber;
+      outputParams.m_totalBlocksNumber = coarseOutputParams.m_totalBlocksNumber;
+
+      // Reading the coarsest level labels
+
+      size_t levelRows = 0;
+      size_t levelCols = 0;
+      TERP_TRUE_OR_RETURN_FALSE( multiResolution.getNumberOfLinesAndColumns( level,
+        levelRows, levelCols ), "Invalid multi resolution level" );
+
+      LabelsVectorT labels( levelRows * levelCols, 0 );
+
+      {
+        te::rp::Matrix< te::rp::SegmenterSegmentsBlock::SegmentIdDataType > coarseLabels;
+        TERP_TRUE_OR_RETURN_FALSE( coarseLabels.reset( (unsigned int)levelRows, (unsigned int)levelCols,
+          te::rp::Matrix< te::rp::SegmenterSegmentsBlock::SegmentIdDataType >::RAMMemPol ),
+          "Coarse level labels allocation error" );
+        TERP_TRUE_OR_RETURN_FALSE( teradar::common::ReadLabelsRegion(
+          *coarseOutputParams.m_outputRasterPtr, 0, 0, 0, coarseLabels ),
+          "Coarse level labels read error" );
+
+        for( unsigned int row = 0; row < levelRows; ++row )
+        {
+          std::copy( coarseLabels[row], coarseLabels[row] + levelCols,
+            labels.begin() + row * levelCols );
+        }
+
+        coarseOutputParams.reset();
+      }
+
+      std::auto_ptr< te::common::TaskProgress > progressPtr;
+      if( m_inputParameters.m_enableProgress )
+      {
+        progressPtr.reset( new te::common::TaskProgress );
+        progressPtr->setTotalSteps( (int)level );
+        progressPtr->setMessage( "Multi level refinement" );
+      }
+
+      // Projecting the labels to each finer level and refining the boundaries
+
+      LabelsVectorT parentLabels;
+
+      for( unsigned int currLevel = level; currLevel > 0; --currLevel )
+      {
+        const size_t parentRows = levelRows;
+        const size_t parentCols = levelCols;
+        TERP_TRUE_OR_RETURN_FALSE( multiResolution.getNumberOfLinesAndColumns( currLevel - 1,
+          levelRows, levelCols ), "Invalid multi resolution level" );
+
+        parentLabels.swap( labels );
+        labels.resize( levelRows * levelCols );
+
+        for( size_t row = 0; row < levelRows; ++row )
+        {
+          const size_t parentRow = std::min( row / multiResParams.m_rowsFactor, parentRows - 1 );
+
+          for( size_t col = 0; col < levelCols; ++col )
+          {
+            labels[row * levelCols + col] = parentLabels[parentRow * parentCols +
+              std::min( col / multiResParams.m_colsFactor, parentCols - 1 )];
+          }
+        }
+
+        const te::rst::Raster* levelRasterPtr = multiResolution.getLevel( currLevel - 1 );
+        TERP_TRUE_OR_RETURN_FALSE( levelRasterPtr, "Invalid multi resolution level" );
+
+        if( outputParams.m_status == CompletedStatus )
+        {
+          outputParams.m_status = getStopStatus();
+        }
+
+        if( outputParams.m_status == CompletedStatus )
+        {
+          TERP_TRUE_OR_RETURN_FALSE( refineLevelLabels( *levelRasterPtr, covMatrixOrder, labels ),
+            "Level labels refinement error" );
+        }
+
+        if( progressPtr.get() )
+        {
+          progressPtr->pulse();
+
+          if( !progressPtr->isActive() )
+          {
+            return false;
+          }
+        }
+      }
+
+      // Writing the input raster resolution labels, by strips of raster
+      // blocks lines
+
+      TERP_TRUE_OR_RETURN_FALSE( createOutputRaster( outputParams ),
+        "Output raster creation error" );
+      TERP_TRUE_OR_RETURN_FALSE( teradar::common::FillRasterBandWithZeros(
+        *outputParams.m_outputRasterPtr, 0 ), "Output raster initialization error" );
+
+      const unsigned int stripLines = std::min( nRows, (unsigned int)std::max( 1,
+        outputParams.m_outputRasterPtr->getBand( 0 )->getProperty()->m_blkh ) );
+      te::rp::Matrix< te::rp::SegmenterSegmentsBlock::SegmentIdDataType > stripLabels;
+
+      for( unsigned int stripStart = 0; stripStart < nRows; stripStart += stripLines )
+      {
+        const unsigned int stripHeight = std::min( stripLines, nRows - stripStart );
+
+        if( stripLabels.getLinesNumber() != stripHeight )
+        {
+          TERP_TRUE_OR_RETURN_FALSE( stripLabels.reset( stripHeight, nCols,
+            te::rp::Matrix< te::rp::SegmenterSegmentsBlock::SegmentIdDataType >::RAMMemPol ),
+            "Labels strip allocation error" );
+        }
+
+        for( unsigned int row = 0; row < stripHeight; ++row )
+        {
+          std::copy( labels.begin() + ( stripStart + row ) * nCols,
+            labels.begin() + ( stripStart + row + 1 ) * nCols, stripLabels[row] );
+        }
+
+        TERP_TRUE_OR_RETURN_FALSE( teradar::common::WriteLabelsRegion( stripLabels, 0,
+          stripStart, *outputParams.m_outputRasterPtr, 0 ), "Output raster write error" );
+      }
+
+      return true;
+    }
+
+    bool MultiLevelSegmenter::refineLevelLabels( const te::rst::Raster& levelRaster,
+      const unsigned int covMatrixOrder, LabelsVectorT& labels ) const
+    {
+      const unsigned int nRows = levelRaster.getNumberOfRows();
+      const unsigned int nCols = levelRaster.getNumberOfColumns();
+      const std::vector< unsigned int >& bands = m_inputParameters.m_inputRasterBands;
+      const unsigned int bandsNumber = (unsigned int)bands.size();
+      const int radius = (int)m_inputParameters.m_multiLevelRefinementRadius;
+      TERP_TRUE_OR_RETURN_FALSE( labels.size() == ( nRows * nCols ), "Invalid labels" );
+
+      int row = 0;
+      int col = 0;
+      int nbRow = 0;
+      int nbCol = 0;
+      unsigned int idx = 0;
+      unsigned int elemIdx = 0;
+
+      // Finding the pixels near the segments boundaries
+
+      std::vector< unsigned char > boundaryMask( labels.size(), 0 );
+      unsigned int boundaryPixels = 0;
+
+      for( row = 0; row < (int)nRows; ++row )
+      {
+        for( col = 0; col < (int)nCols; ++col )
+        {
+          idx = row * nCols + col;
+
+          for( nbRow = std::max( 0, row - 1 ); ( nbRow <= row + 1 ) && ( nbRow < (int)nRows )
+            && ( !boundaryMask[idx] ); ++nbRow )
+          {
+            for( nbCol = std::max( 0, col - 1 ); ( nbCol <= col + 1 ) && ( nbCol < (int)nCols ); ++nbCol )
+            {
+              if( labels[nbRow * nCols + nbCol] != labels[idx] )
+              {
+                boundaryMask[idx] = 1;
+                ++boundaryPixels;
+                break;
+              }
+            }
+          }
+        }
+      }
+
+      if( boundaryPixels == 0 )
+      {
+        return true;
+      }
+
+      if( radius > 1 )
+      {
+        DilateMask( nRows, nCols, radius - 1, true, boundaryMask );
+        DilateMask( nRows, nCols, radius - 1, false, boundaryMask );
+      }
+
+      // Computing the segments mean covariance matrices. Interior pixels are
+      // preferred, since the boundary ones may belong to the neighbor segments
+
+      typedef std::map< te::rp::SegmenterSegmentsBlock::SegmentIdDataType, unsigned int > LabelsIndexesT;
+
+      LabelsIndexesT labelsIndexes;
+      LabelsVectorT segmentsLabels;
+      std::vector< std::complex< double > > interiorSums;
+      std::vector< std::complex< double > > allSums;
+      std::vector< unsigned int > interiorCounts;
+      std::vector< unsigned int > allCounts;
+      std::vector< std::complex< double > > lineValues;
+
+      for( row = 0; row < (int)nRows; ++row )
+      {
+        ReadCovarianceLine( levelRaster, bands, row, lineValues );
+
+        for( col = 0; col < (int)nCols; ++col )
+        {
+          idx = row * nCols + col;
+
+          if( labels[idx] == 0 )
+          {
+            continue;
+          }
+
+          LabelsIndexesT::iterator it = labelsIndexes.find( labels[idx] );
+
+          if( it == labelsIndexes.end() )
+          {
+            it = labelsIndexes.insert( LabelsIndexesT::value_type( labels[idx],
+              (unsigned int)allCounts.size() ) ).first;
+
+            interiorSums.resize( interiorSums.size() + bandsNumber, 0. );
+            allSums.resize( allSums.size() + bandsNumber, 0. );
+            interiorCounts.push_back( 0 );
+            allCounts.push_back( 0 );
+            segmentsLabels.push_back( labels[idx] );
+          }
+
+          const unsigned int segIdx = it->second;
+          const std::complex< double >* valuesPtr = &lineValues[col * bandsNumber];
+
+          for( elemIdx = 0; elemIdx < bandsNumber; ++elemIdx )
+          {
+            allSums[segIdx * bandsNumber + elemIdx] += valuesPtr[elemIdx];
+          }
+          ++allCounts[segIdx];
+
+          if( !boundaryMask[idx] )
+          {
+            for( elemIdx = 0; elemIdx < bandsNumber; ++elemIdx )
+            {
+              interiorSums[segIdx * bandsNumber + elemIdx] += valuesPtr[elemIdx];
+            }
+            ++interiorCounts[segIdx];
+          }
+        }
+      }
+
+      const unsigned int segmentsNumber = (unsigned int)allCounts.size();
+      std::vector< double > logDets( segmentsNumber, 0. );
+      std::vector< std::complex< double > > invMatrices( segmentsNumber * bandsNumber, 0. );
+      std::vector< unsigned char > validSegments( segmentsNumber, 0 );
+      boost::numeric::ublas::matrix< std::complex< double > > covMatrix( covMatrixOrder, covMatrixOrder );
+      std::vector< std::complex< double > > invMatrix;
+
+      for( unsigned int segIdx = 0; segIdx < segmentsNumber; ++segIdx )
+      {
+        const bool useInterior = ( interiorCounts[segIdx] > 0 );
+        const std::complex< double >* sumsPtr = useInterior ?
+          &interiorSums[segIdx * bandsNumber] : &allSums[segIdx * bandsNumber];
+        const double count = (double)( useInterior ? interiorCounts[segIdx] : allCounts[segIdx] );
+
+        for( elemIdx = 0; elemIdx < bandsNumber; ++elemIdx )
+        {
+          covMatrix( elemIdx / covMatrixOrder, elemIdx % covMatrixOrder ) = sumsPtr[elemIdx] / count;
+        }
+
+        if( GetWishartClassParameters( covMatrix, logDets[segIdx], invMatrix ) )
+        {
+          std::copy( invMatrix.begin(), invMatrix.end(), invMatrices.begin() + segIdx * bandsNumber );
+          validSegments[segIdx] = 1;
+        }
+      }
+
+      // Reclassifying the boundary pixels to the nearest neighbor segment,
+      // the new labels are applied after all pixels are reclassified
+
+      std::vector< std::pair< unsigned int, te::rp::SegmenterSegmentsBlock::SegmentIdDataType > > refinedPixels;
+      std::vector< unsigned int > candidates;
+
+      for( row = 0; row < (int)nRows; ++row )
+      {
+        bool lineRead = false;
+
+        for( col = 0; col < (int)nCols; ++col )
+        {
+          idx = row * nCols + col;
+
+          if( ( !boundaryMask[idx] ) || ( labels[idx] == 0 ) )
+          {
+            continue;
+          }
+
+          if( !lineRead )
+          {
+            ReadCovarianceLine( levelRaster, bands, row, lineValues );
+            lineRead = true;
+          }
+
+          candidates.clear();
+
+          for( nbRow = std::max( 0, row - radius ); ( nbRow <= row + radius ) && ( nbRow < (int)nRows ); ++nbRow )
+          {
+            for( nbCol = std::max( 0, col - radius ); ( nbCol <= col + radius ) && ( nbCol < (int)nCols ); ++nbCol )
+            {
+              const te::rp::SegmenterSegmentsBlock::SegmentIdDataType nbLabel = labels[nbRow * nCols + nbCol];
+
+              if( nbLabel != 0 )
+              {
+                const unsigned int segIdx = labelsIndexes[nbLabel];
+
+                if( validSegments[segIdx] &&
+                  ( std::find( candidates.begin(), candidates.end(), segIdx ) == candidates.end() ) )
+                {
+                  candidates.push_back( segIdx );
+                }
+              }
+            }
+          }
+
+          const std::complex< double >* valuesPtr = &lineValues[col * bandsNumber];
+          double minDistance = DBL_MAX;
+          te::rp::SegmenterSegmentsBlock::SegmentIdDataType refinedLabel = labels[idx];
+
+          for( unsigned int candIdx = 0; candIdx < candidates.size(); ++candIdx )
+          {
+            const unsigned int segIdx = candidates[candIdx];
+            const std::complex< double >* invPtr = &invMatrices[segIdx * bandsNumber];
+
+            // tr( C^-1 Z ) = sum( C^-1(i,j) * Z(j,i) )
+            double trace = 0.;
+
+            for( unsigned int line = 0; line < covMatrixOrder; ++line )
+            {
+              for( unsigned int column = 0; column < covMatrixOrder; ++column )
+              {
+                trace += std::real( invPtr[line * covMatrixOrder + column] *
+                  valuesPtr[column * covMatrixOrder + line] );
+              }
+            }
+
+            const double distance = logDets[segIdx] + trace;
+
+            if( distance < minDistance )
+            {
+              minDistance = distance;
+              refinedLabel = segmentsLabels[segIdx];
+            }
+          }
+
+          if( refinedLabel != labels[idx] )
+          {
+            refinedPixels.push_back( std::pair< unsigned int,
+              te::rp::SegmenterSegmentsBlock::SegmentIdDataType >( idx, refinedLabel ) );
+          }
+        }
+      }
+
+      for( std::size_t pixelIdx = 0; pixelIdx < refinedPixels.size(); ++pixelIdx )
+      {
+        labels[refinedPixels[pixelIdx].first] = refinedPixels[pixelIdx].second;
+      }
+
+      return true;
+    }
+
+    bool MultiLevelSegmenter::mergeBlocksSeams( const SegmentsBlocksMatrixT& segmentsBlocksMatrix,
+      const std::vector< SegmenterBorderStatisticsProvider::SegmentsStatisticsT >& blocksSegmentsStatistics,
+      const SegmenterBorderStatisticsProvider& statisticsProvider,
+      const unsigned int threadsNumber, te::rst::RasterSynchronizer& outputRasterSync,
+      te::rst::Raster& outputRaster ) const
+    {
+      const unsigned int blocksLines = segmentsBlocksMatrix.getLinesNumber();
+      const unsigned int blocksCols = segmentsBlocksMatrix.getColumnsNumber();
+      TERP_TRUE_OR_RETURN_FALSE( blocksSegmentsStatistics.size() == ( blocksLines * blocksCols ),
+        "Invalid blocks segments statistics" );
+
+      // Reading the labels facing each other across each seam
+
+      std::vector< BlocksSeam > seams;
+      std::vector< LabelsPairT > labelsPairs;
+      double label1 = 0;
+      double label2 = 0;
+      unsigned int blockLine = 0;
+      unsigned int blockCol = 0;
+      unsigned int idx = 0;
+
+      for( blockLine = 0; blockLine < blocksLines; ++blockLine )
+      {
+        for( blockCol = 0; blockCol < blocksCols; ++blockCol )
+        {
+          const te::rp::SegmenterSegmentsBlock& block = segmentsBlocksMatrix( blockLine, blockCol );
+          const unsigned int blockIdx = blockLine * blocksCols + blockCol;
+
+          if( blockCol > 0 )
+          {
+            labelsPairs.clear();
+
+            for( idx = block.m_startY; idx < block.m_startY + block.m_height; ++idx )
+            {
+              outputRaster.getValue( block.m_startX - 1, idx, label1, 0 );
+              outputRaster.getValue( block.m_startX, idx, label2, 0 );
+
+              if( ( label1 != 0 ) && ( label2 != 0 ) && ( label1 != label2 ) )
+              {
+                labelsPairs.push_back( LabelsPairT( (SegmentIdT)label1, (SegmentIdT)label2 ) );
+              }
+            }
+
+            AddBlocksSeam( blockIdx - 1, blockIdx, labelsPairs, seams );
+          }
+
+          if( blockLine > 0 )
+          {
+            labelsPairs.clear();
+
+            for( idx = block.m_startX; idx < block.m_startX + block.m_width; ++idx )
+            {
+              outputRaster.getValue( idx, block.m_startY - 1, label1, 0 );
+              outputRaster.getValue( idx, block.m_startY, label2, 0 );
+
+              if( ( label1 != 0 ) && ( label2 != 0 ) && ( label1 != label2 ) )
+              {
+                labelsPairs.push_back( LabelsPairT( (SegmentIdT)label1, (SegmentIdT)label2 ) );
+              }
+            }
+
+            AddBlocksSeam( blockIdx - blocksCols, blockIdx, labelsPairs, seams );
+          }
+        }
+      }
+
+      if( seams.empty() )
+      {
+        return true;
+      }
+
+      // Merging the facing segments seam by seam, in the blocks order. Each
+      // merged labels set is represented by its lowest label, which keeps the
+      // set merged statistics, so every pair is tested set against set and
+      // a chain of pairs is only merged if each link passes the test
+
+      std::auto_ptr< SegmenterBorderStatisticsProvider::StatisticsMerger > mergerPtr(
+        statisticsProvider.createStatisticsMerger(
+        (unsigned int)m_inputParameters.m_inputRasterBands.size() ) );
+      TERP_TRUE_OR_RETURN_FALSE( mergerPtr.get(), "Statistics merger creation error" );
+
+      std::map< SegmentIdT, SegmentIdT > parents;
+      SegmentsStatisticsT rootsStatistics;
+      std::map< SegmentIdT, unsigned int > labelsBlocks;
+
+      for( unsigned int seamIdx = 0; seamIdx < seams.size(); ++seamIdx )
+      {
+        const BlocksSeam& seam = seams[seamIdx];
+        const SegmentsStatisticsT& statistics1 = blocksSegmentsStatistics[seam.m_block1Idx];
+        const SegmentsStatisticsT& statistics2 = blocksSegmentsStatistics[seam.m_block2Idx];
+
+        for( idx = 0; idx < seam.m_labelsPairs.size(); ++idx )
+        {
+          const LabelsPairT& labelsPair = seam.m_labelsPairs[idx];
+          SegmentsStatisticsT::const_iterator statistics1It = statistics1.find( labelsPair.first );
+          SegmentsStatisticsT::const_iterator statistics2It = statistics2.find( labelsPair.second );
+
+          if( ( statistics1It == statistics1.end() ) || ( statistics2It == statistics2.end() ) )
+          {
+            continue;
+          }
+
+          const SegmentIdT root1 = FindMergedLabelRoot( parents, labelsPair.first );
+          const SegmentIdT root2 = FindMergedLabelRoot( parents, labelsPair.second );
+
+          if( root1 == root2 )
+          {
+            continue;
+          }
+
+          // a label without merged statistics was never merged, it is its own root
+
+          SegmenterBorderStatisticsProvider::SegmentStatistics& root1Statistics =
+            GetRootStatistics( rootsStatistics, root1, statistics1It->second );
+          SegmenterBorderStatisticsProvider::SegmentStatistics& root2Statistics =
+            GetRootStatistics( rootsStatistics, root2, statistics2It->second );
+
+          if( !mergerPtr->shouldMerge( root1Statistics, root2Statistics ) )
+          {
+            continue;
+          }
+
+          if( root1 < root2 )
+          {
+            mergerPtr->merge( root1Statistics, root2Statistics );
+            rootsStatistics.erase( root2 );
+            parents[root2] = root1;
+          }
+          else
+          {
+            mergerPtr->merge( root2Statistics, root1Statistics );
+            rootsStatistics.erase( root1 );
+            parents[root1] = root2;
+          }
+
+          labelsBlocks[labelsPair.first] = seam.m_block1Idx;
+          labelsBlocks[labelsPair.second] = seam.m_block2Idx;
+        }
+      }
+
+      // Relabeling the merged segments, only inside their bounding boxes.
+      // The labels blocks map is sorted, so are the new labels
+
+      std::vector< LabelsPairT > newLabels;
+      std::vector< unsigned int > blocksXStart( blocksSegmentsStatistics.size(), UINT_MAX );
+      std::vector< unsigned int > blocksYStart( blocksSegmentsStatistics.size(), UINT_MAX );
+      std::vector< unsigned int > blocksXBound( blocksSegmentsStatistics.size(), 0 );
+      std::vector< unsigned int > blocksYBound( blocksSegmentsStatistics.size(), 0 );
+
+      for( std::map< SegmentIdT, unsigned int >::const_iterator labelsBlocksIt =
+        labelsBlocks.begin(); labelsBlocksIt != labelsBlocks.end(); ++labelsBlocksIt )
+      {
+        const SegmentIdT root = FindMergedLabelRoot( parents, labelsBlocksIt->first );
+
+        if( root != labelsBlocksIt->first )
+        {
+          const unsigned int blockIdx = labelsBlocksIt->second;
+          const SegmenterBorderStatisticsProvider::SegmentStatistics& statistics =
+            blocksSegmentsStatistics[blockIdx].find( labelsBlocksIt->first )->second;
+
+          newLabels.push_back( LabelsPairT( labelsBlocksIt->first, root ) );
+
+          blocksXStart[blockIdx] = std::min( blocksXStart[blockIdx], statistics.m_xStart );
+          blocksYStart[blockIdx] = std::min( blocksYStart[blockIdx], statistics.m_yStart );
+          blocksXBound[blockIdx] = std::max( blocksXBound[blockIdx], statistics.m_xBound );
+          blocksYBound[blockIdx] = std::max( blocksYBound[blockIdx], statistics.m_yBound );
+        }
+      }
+
+      if( newLabels.empty() )
+      {
+        return true;
+      }
+
+      const te::rst::BandProperty& bandProperty = *outputRaster.getBand( 0 )->getProperty();
+      unsigned int blockIdx = 0;
+
+      if( ( bandProperty.m_type == te::dt::UINT32_TYPE ) &&
+        ( bandProperty.m_blkw > 0 ) && ( bandProperty.m_blkh > 0 ) )
+      {
+        // The raster blocks intersecting the bounding boxes, each one is
+        // read, relabeled and written once, by one thread
+
+        const unsigned int rasterBlockWidth = (unsigned int)bandProperty.m_blkw;
+        const unsigned int rasterBlockHeight = (unsigned int)bandProperty.m_blkh;
+        const unsigned int rasterBlocksCols = (unsigned int)bandProperty.m_nblocksx;
+        std::vector< unsigned int > rasterBlocks;
+
+        for( blockIdx = 0; blockIdx < blocksSegmentsStatistics.size(); ++blockIdx )
+        {
+          if( blocksXStart[blockIdx] >= blocksXBound[blockIdx] )
+          {
+            continue;
+          }
+
+          for( blockLine = blocksYStart[blockIdx] / rasterBlockHeight;
+            blockLine <= ( blocksYBound[blockIdx] - 1 ) / rasterBlockHeight; ++blockLine )
+          {
+            for( blockCol = blocksXStart[blockIdx] / rasterBlockWidth;
+              blockCol <= ( blocksXBound[blockIdx] - 1 ) / rasterBlockWidth; ++blockCol )
+            {
+              rasterBlocks.push_back( blockLine * rasterBlocksCols + blockCol );
+            }
+          }
+        }
+
+        std::sort( rasterBlocks.begin(), rasterBlocks.end() );
+        rasterBlocks.erase( std::unique( rasterBlocks.begin(), rasterBlocks.end() ),
+          rasterBlocks.end() );
 
-          // spawning the segmentation threads
+        boost::atomic< unsigned int > nextRasterBlockCursor( 0 );
+        boost::atomic< bool > relabelingErrorFlag( false );
 
-          runningThreadsCounter = maxSegThreads;
+        RelabelingParams relabelingParams;
+        relabelingParams.m_rasterPtr = 0;
+        relabelingParams.m_rasterSyncPtr = &outputRasterSync;
+        relabelingParams.m_newLabelsPtr = &newLabels;
+        relabelingParams.m_rasterBlocksPtr = &rasterBlocks;
+        relabelingParams.m_rasterBlocksCols = rasterBlocksCols;
+        relabelingParams.m_nextRasterBlockCursorPtr = &nextRasterBlockCursor;
+        relabelingParams.m_errorFlagPtr = &relabelingErrorFlag;
 
-          boost::thread_group threads;
-          std::vector< SegmenterThreadEntryParams > threadsParams( maxSegThreads );
+        const unsigned int relabelingThreadsNumber = std::min( threadsNumber,
+          (unsigned int)rasterBlocks.size() );
 
-          for( unsigned int threadIdx = 0; threadIdx < maxSegThreads;
-            ++threadIdx )
+        if( relabelingThreadsNumber > 1 )
+        {
+          boost::thread_group relabelingThreads;
+
+          for( unsigned int threadIdx = 0; threadIdx < relabelingThreadsNumber; ++threadIdx )
           {
-            threadsParams[threadIdx] = baseSegThreadParams;
+            relabelingThreads.add_thread( new boost::thread( RelabelRasterBlocks,
+              &relabelingParams ) );
+          }
 
-            threads.add_thread( new boost::thread( segmenterThreadEntry,
-              &(threadsParams[threadIdx]) ) );
-          };
+          relabelingThreads.join_all();
+        }
+        else
+        {
+          relabelingParams.m_rasterPtr = &outputRaster;
 
-          // waiting all threads to finish
+          RelabelRasterBlocks( &relabelingParams );
+        }
 
-          int prevSegmentedBlocksNmb = 0;
+        TERP_TRUE_OR_RETURN_FALSE( !relabelingErrorFlag, "Raster blocks relabeling error" );
+      }
+      else
+      {
+        std::vector< LabelsPairT >::const_iterator newLabelsIt;
 
-          while( (!abortSegmentationFlag) && (runningThreadsCounter > 0) )
+        for( blockIdx = 0; blockIdx < blocksSegmentsStatistics.size(); ++blockIdx )
+        {
+          for( unsigned int row = blocksYStart[blockIdx]; row < blocksYBound[blockIdx]; ++row )
           {
-            boost::unique_lock<boost::mutex> lock( blockProcessedSignalMutex );
-            blockProcessedSignal.timed_wait( lock,
-              boost::posix_time::seconds( 1 ) );
-
-            //            std::cout << std::endl << "Woke up" << std::endl;
-
-            if( progressPtr.get() )
+            for( unsigned int col = blocksXStart[blockIdx]; col < blocksXBound[blockIdx]; ++col )
             {
-              int segmentedBlocksNmb = 0;
-              for( unsigned int segmentsMatrixLine = 0; segmentsMatrixLine <
-                segmentsblocksMatrix.getLinesNumber(); ++segmentsMatrixLine )
-              {
-                for( unsigned int segmentsMatrixCol = 0; segmentsMatrixCol <
-                  segmentsblocksMatrix.getColumnsNumber(); ++segmentsMatrixCol )
-                {
-                  if( segmentsblocksMatrix[segmentsMatrixLine][segmentsMatrixCol].m_status
-                    == te::rp::SegmenterSegmentsBlock::BlockSegmented )
-                  {
-                    ++segmentedBlocksNmb;
-                  }
-                }
-              }
+              outputRaster.getValue( col, row, label1, 0 );
 
-              if( segmentedBlocksNmb != prevSegmentedBlocksNmb )
-              {
-                progressPtr->pulse();
-                prevSegmentedBlocksNmb = segmentedBlocksNmb;
-              }
+              newLabelsIt = std::lower_bound( newLabels.begin(), newLabels.end(),
+                LabelsPairT( (SegmentIdT)label1, 0 ) );
 
-              if( !progressPtr->isActive() )
+              if( ( newLabelsIt != newLabels.end() ) && ( newLabelsIt->first == (SegmentIdT)label1 ) )
               {
-                abortSegmentationFlag = true;
+                outputRaster.setValue( col, row, (double)newLabelsIt->second, 0 );
               }
-
-              //              std::cout << std::endl << "segmentedBlocksNmb:" << segmentedBlocksNmb << std::endl;
             }
           }
-
-          // joining all threads
-
-          threads.join_all();
-          /*
-          globalMutex.lock();
-          std::cout << std::endl << "Threads joined." << std::endl;
-          globalMutex.unlock();
-          */
-        }
-        else
-        { // non-threaded segmentation mode 
-          runningThreadsCounter = 1;
-          segmenterThreadEntry( &baseSegThreadParams );
         }
-
-        return (!abortSegmentationFlag);
-      }
-      else
-      {
-        return false;
       }
-    }
 
-    void MultiLevelSegmenter::reset() throw(te::rp::Exception)
-    {
-      m_instanceInitialized = false;
-      m_inputParameters.reset();
+      return true;
     }
-    
-    // @todo - etore - Verify under this line
-    bool MultiLevelSegmenter::initialize( const te::rp::AlgorithmInputParameters& inputParams )
-      throw(te::rp::Exception)
+
+    bool MultiLevelSegmenter::planBlocks( const double pixelRequiredMemory,
+      const unsigned int memoryBlockPixels,
+      const unsigned int overlapPercent,
+      const unsigned int threadsNumber,
+      BlocksPlan& plan ) const
     {
-      reset();
+      TERP_TRUE_OR_RETURN_FALSE( pixelRequiredMemory > 0.0, "Invalid pixel memory estimation" );
+      TERP_TRUE_OR_RETURN_FALSE( memoryBlockPixels > 0, "Invalid max block pixels number" );
+
+      const unsigned int nRows = m_inputParameters.m_inputRasterPtr->getNumberOfRows();
+      const unsigned int nCols = m_inputParameters.m_inputRasterPtr->getNumberOfColumns();
+      const double totalPixels = ((double)nRows) * ((double)nCols);
+      const double threadsFactor = (double)( threadsNumber ? threadsNumber : 1 );
+
+      // the expanded block area grows with the overlap at both sides
+      const double overlapFactor = ( 1.0 + ( 2.0 * ((double)overlapPercent) / 100.0 ) ) *
+        ( 1.0 + ( 2.0 * ((double)overlapPercent) / 100.0 ) );
+
+      plan = BlocksPlan();
+      plan.m_threadsNumber = threadsNumber;
+      plan.m_pixelRequiredMemory = pixelRequiredMemory;
+      plan.m_memoryBlockPixels = memoryBlockPixels;
+      plan.m_lastLevelCacheSize = teradar::common::GetLastLevelCacheSize();
+      plan.m_balanceBlockPixels = (unsigned int)std::min( (double)UINT_MAX, std::ceil(
+        overlapFactor * totalPixels / ( threadsFactor * ((double)m_inputParameters.m_blocksPerThread) ) ) );
+
+      if( plan.m_lastLevelCacheSize )
+      {
+        plan.m_cacheBlockPixels = (unsigned int)std::min( (double)UINT_MAX,
+          ((double)plan.m_lastLevelCacheSize) / threadsFactor / pixelRequiredMemory );
+      }
 
-      MultiLevelSegmenter::InputParameters const* inputParamsPtr = dynamic_cast<
-        MultiLevelSegmenter::InputParameters const* >(&inputParams);
+      // Choosing the expanded block pixels: the memory limit is mandatory, the
+      // load balance and cache targets are bounded by a minimum block size
 
-      TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr, "Invalid parameters" );
-      TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr->m_inputRasterPtr, "Invalid raster pointer" );
-      TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr->m_inputRasterPtr->getAccessPolicy() & te::common::RAccess,
-        "Invalid raster" );
+      double targetPixels = std::min( (double)memoryBlockPixels, (double)plan.m_balanceBlockPixels );
 
-      TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr->m_inputRasterBands.size() > 0,
-        "Invalid raster bands number" );
-      for( unsigned int inputRasterBandsIdx = 0; inputRasterBandsIdx <
-        inputParamsPtr->m_inputRasterBands.size(); ++inputRasterBandsIdx )
+      if( plan.m_cacheBlockPixels )
       {
-        TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr->m_inputRasterBands[
-          inputRasterBandsIdx] < inputParamsPtr->m_inputRasterPtr->getNumberOfBands(),
-            "Invalid raster band number" );
+        targetPixels = std::min( targetPixels, (double)plan.m_cacheBlockPixels );
       }
 
-      TERP_TRUE_OR_RETURN_FALSE( (inputParamsPtr->m_inputRasterNoDataValues.empty() ?
-        true : (inputParamsPtr->m_inputRasterNoDataValues.size() ==
-        inputParamsPtr->m_inputRasterBands.size())),
-        "Invalid no-data values" );
+      targetPixels = std::max( targetPixels, std::min( (double)memoryBlockPixels,
+        (double)( MinPlannedBlockSide * MinPlannedBlockSide ) ) );
 
-      TERP_TRUE_OR_RETURN_FALSE( inputParamsPtr->m_blocksOverlapPercent <= 25,
-        "Invalid blocks overlapped area percentage" );
+      const double nonExpandedTargetPixels = std::max( 1.0, targetPixels / overlapFactor );
 
-      m_inputParameters = *inputParamsPtr;
-      m_instanceInitialized = true;
+      // Aligning to the input raster native blocks, when they are small enough
 
-      return true;
-    }
+      const te::rst::BandProperty& bandProp = *( m_inputParameters.m_inputRasterPtr->getBand(
+        m_inputParameters.m_inputRasterBands[0] )->getProperty() );
 
-    bool MultiLevelSegmenter::isInitialized() const
-    {
-      return m_instanceInitialized;
-    }
+      plan.m_alignmentWidth = std::min( nCols, (unsigned int)std::max( 1, bandProp.m_blkw ) );
+      plan.m_alignmentHeight = std::min( nRows, (unsigned int)std::max( 1, bandProp.m_blkh ) );
 
-    bool MultiLevelSegmenter::calcBestBlockSize(
-      const unsigned int minExapandedBlockPixels,
-      const unsigned int maxExapandedBlockPixels,
-      unsigned int& blocksHOverlapSize,
-      unsigned int& blocksVOverlapSize,
-      unsigned int& nonExpandedBlockWidth,
-      unsigned int& nonExpandedBlockHeight,
-      unsigned int& expandedBlockWidth,
-      unsigned int& expandedBlockHeight ) const
-    {
-      TERP_TRUE_OR_THROW( minExapandedBlockPixels <= maxExapandedBlockPixels,
-        "Invalid min and mas block pixels number" );
+      if( ((double)plan.m_alignmentWidth) * ((double)plan.m_alignmentHeight) > nonExpandedTargetPixels )
+      {
+        plan.m_alignmentWidth = 1;
+        plan.m_alignmentHeight = 1;
+      }
 
-      const double totalImageLines = (double)m_inputParameters.m_inputRasterPtr->getNumberOfRows();
-      const double totalImageCols = (double)m_inputParameters.m_inputRasterPtr->getNumberOfColumns();
+      const unsigned int alignW = plan.m_alignmentWidth;
+      const unsigned int alignH = plan.m_alignmentHeight;
 
-      const double maxScaleFactor = (totalImageLines * totalImageCols) /
-        ((double)minExapandedBlockPixels);
+      // Nearly square blocks, whole lines blocks for line strip rasters
+
+      unsigned int width = nCols;
+
+      if( alignW < nCols )
+      {
+        width = (unsigned int)std::min( (double)nCols, std::sqrt( nonExpandedTargetPixels ) );
+        width = std::max( alignW, ( width / alignW ) * alignW );
+      }
 
-      unsigned int rescaledAndExpandedBlockPixelsNmb = 0;
+      unsigned int height = (unsigned int)std::min( (double)nRows,
+        nonExpandedTargetPixels / ((double)width) );
+      height = std::min( nRows, std::max( alignH, ( height / alignH ) * alignH ) );
 
-      for( double scaleFactor = 1.0; scaleFactor <= maxScaleFactor;
-        scaleFactor += 1.0 )
+      if( ( height == nRows ) && ( width < nCols ) )
       {
-        nonExpandedBlockHeight = (unsigned int)std::ceil( ((double)totalImageLines) / scaleFactor );
-        nonExpandedBlockWidth = (unsigned int)std::ceil( ((double)totalImageCols) / scaleFactor );
+        width = (unsigned int)std::min( (double)nCols, nonExpandedTargetPixels / ((double)height) );
+        width = std::min( nCols, std::max( alignW, ( width / alignW ) * alignW ) );
+      }
 
-        blocksHOverlapSize = (unsigned int)(((double)m_inputParameters.m_blocksOverlapPercent) *
-          ((double)nonExpandedBlockWidth) / 100.0);
-        blocksVOverlapSize = (unsigned int)(((double)m_inputParameters.m_blocksOverlapPercent) *
-          ((double)nonExpandedBlockHeight) / 100.0);
+      // Thin blocks would create too many seams
 
-        expandedBlockHeight = nonExpandedBlockHeight + blocksVOverlapSize +
-          blocksVOverlapSize;
-        expandedBlockWidth = nonExpandedBlockWidth + blocksHOverlapSize +
-          blocksHOverlapSize;
+      width = std::max( width, std::min( nCols,
+        ( ( MinPlannedBlockSide + alignW - 1 ) / alignW ) * alignW ) );
+      height = std::max( height, std::min( nRows,
+        ( ( MinPlannedBlockSide + alignH - 1 ) / alignH ) * alignH ) );
 
-        rescaledAndExpandedBlockPixelsNmb = expandedBlockHeight * expandedBlockWidth;
+      // Shrinking the blocks until the expanded ones fit the memory limit
 
-        if( rescaledAndExpandedBlockPixelsNmb <= maxExapandedBlockPixels )
+      for( ; ; )
+      {
+        plan.m_nonExpandedBlockWidth = width;
+        plan.m_nonExpandedBlockHeight = height;
+        plan.m_blocksHOverlapSize = (unsigned int)( ((double)overlapPercent) *
+          ((double)width) / 100.0 );
+        plan.m_blocksVOverlapSize = (unsigned int)( ((double)overlapPercent) *
+          ((double)height) / 100.0 );
+        plan.m_expandedBlockWidth = width + ( 2 * plan.m_blocksHOverlapSize );
+        plan.m_expandedBlockHeight = height + ( 2 * plan.m_blocksVOverlapSize );
+
+        if( ((double)plan.m_expandedBlockWidth) * ((double)plan.m_expandedBlockHeight) <=
+          ((double)memoryBlockPixels) )
         {
-          return true;
+          break;
+        }
+
+        if( ( height > 1 ) && ( height >= width ) )
+        {
+          height = ( height > alignH ) ? ( height - alignH ) : ( height - 1 );
+        }
+        else if( width > 1 )
+        {
+          width = ( width > alignW ) ? ( width - alignW ) : ( width - 1 );
+        }
+        else
+        {
+          return false;
         }
       }
 
-      return false;
+      plan.m_hBlocksNumber = ( nCols + width - 1 ) / width;
+      plan.m_vBlocksNumber = ( nRows + height - 1 ) / height;
+
+      return true;
     }
 
     void MultiLevelSegmenter::segmenterThreadEntry( SegmenterThreadEntryParams* paramsPtr )
@@ -872,32 +2817,55 @@ namespace teradar {
         "Invalid parameter" );
       TERP_DEBUG_TRUE_OR_THROW( paramsPtr->m_maxInputRasterCachedBlocks,
         "Invalid parameter" );
+      TERP_DEBUG_TRUE_OR_THROW( paramsPtr->m_blocksQueuePtr,
+        "Invalid parameter" );
+      TERP_DEBUG_TRUE_OR_THROW( paramsPtr->m_nodesQueuesOffsetsPtr,
+        "Invalid parameter" );
+      TERP_DEBUG_TRUE_OR_THROW( paramsPtr->m_nextBlockCursorPtr,
+        "Invalid parameter" );
+
+      TERP_DEBUG_TRUE_OR_THROW( paramsPtr->m_segmentedBlocksCounterPtr,
+        "Invalid parameter" );
+      TERP_DEBUG_TRUE_OR_THROW( paramsPtr->m_segmentedPixelsCounterPtr,
+        "Invalid parameter" );
+
+      // Binding the thread to its NUMA node before any allocation, so the
+      // memory first touched by it (raster cache, strategy segments pool and
+      // IDs matrix) is taken from the node. The previous affinity is restored
+      // on every exit (engine workers run later jobs)
+
+      ThreadCpusBinding threadCpusBinding( paramsPtr->m_threadCpus );
 
       // Creating the input raster instance
 
       te::rst::SynchronizedRaster inputRaster( paramsPtr->m_maxInputRasterCachedBlocks,
         *(paramsPtr->m_inputRasterSyncPtr) );
 
-      // Creating the segmentation strategy instance
+      // Creating the segmentation strategy instance, or reusing the given one
 
       paramsPtr->m_generalMutexPtr->lock();
 
-      boost::shared_ptr< te::rp::SegmenterStrategy > strategyPtr(
-        te::rp::SegmenterStrategyFactory::make(
-        paramsPtr->m_inputParameters.m_strategyName ) );
-      TERP_TRUE_OR_THROW( strategyPtr.get(),
+      boost::shared_ptr< te::rp::SegmenterStrategy > ownStrategyPtr;
+      te::rp::SegmenterStrategy* strategyPtr = paramsPtr->m_strategyPtr;
+
+      if( strategyPtr == 0 )
+      {
+        ownStrategyPtr.reset( te::rp::SegmenterStrategyFactory::make(
+          paramsPtr->m_inputParameters.m_strategyName ) );
+        strategyPtr = ownStrategyPtr.get();
+      }
+
+      TERP_TRUE_OR_THROW( strategyPtr,
         "Unable to create an segmentation strategy" );
       if( !strategyPtr->initialize(
         paramsPtr->m_inputParameters.getSegStrategyParams() ) )
       {
-        *(paramsPtr->m_runningThreadsCounterPtr) =
-          *(paramsPtr->m_runningThreadsCounterPtr) - 1;
-        *(paramsPtr->m_abortSegmentationFlagPtr) = true;
+        paramsPtr->m_generalMutexPtr->unlock();
 
         //                std::cout << std::endl<< "Thread exit (error)"
         //                  << std::endl;                
 
-        paramsPtr->m_generalMutexPtr->unlock();
+        threadExit( paramsPtr, true );
 
         return;
       }
@@ -906,127 +2874,242 @@ namespace teradar {
         paramsPtr->m_generalMutexPtr->unlock();
       }
 
-      // Looking for a non processed segments block
+      SegmenterMultiThreadedStrategy* const multiThreadedStrategyPtr =
+        dynamic_cast< SegmenterMultiThreadedStrategy* >( strategyPtr );
+
+      if( multiThreadedStrategyPtr )
+      {
+        multiThreadedStrategyPtr->setMaxThreadsNumber( paramsPtr->m_strategyMaxThreads );
+      }
+
+      // Taking the next non processed segments block from the blocks queue
+
+      const unsigned int blocksMatrixCols =
+        paramsPtr->m_segsBlocksMatrixPtr->getColumnsNumber();
+      const unsigned int blocksQueueSize =
+        (unsigned int)paramsPtr->m_blocksQueuePtr->size();
+      unsigned int blocksQueueIdx = 0;
+      unsigned int blockIdx = 0;
 
-      for( unsigned int sBMLine = 0; sBMLine <
-        paramsPtr->m_segsBlocksMatrixPtr->getLinesNumber(); ++sBMLine )
+      while( TakeNextQueuedBlock( *(paramsPtr->m_nodesQueuesOffsetsPtr),
+        paramsPtr->m_nextBlockCursorPtr, paramsPtr->m_numaNode, blocksQueueIdx ) )
       {
-        for( unsigned int sBMCol = 0; sBMCol <
-          paramsPtr->m_segsBlocksMatrixPtr->getColumnsNumber();  ++sBMCol )
+        if( *(paramsPtr->m_abortSegmentationFlagPtr) )
         {
-          if( *(paramsPtr->m_abortSegmentationFlagPtr) )
-          {
-            paramsPtr->m_generalMutexPtr->lock();
+          //          std::cout << std::endl<< "Thread exit (error)"
+          //            << std::endl;
 
-            *(paramsPtr->m_runningThreadsCounterPtr) =
-              *(paramsPtr->m_runningThreadsCounterPtr) - 1;
+          threadExit( paramsPtr, false );
 
-            //            std::cout << std::endl<< "Thread exit (error)"
-            //              << std::endl;
+          return;
+        }
 
-            paramsPtr->m_generalMutexPtr->unlock();
+        blockIdx = paramsPtr->m_blocksQueuePtr->operator[]( blocksQueueIdx );
 
-            return;
-          }
-          else
-          {
-            paramsPtr->m_generalMutexPtr->lock();
+        te::rp::SegmenterSegmentsBlock& segsBlk =
+          paramsPtr->m_segsBlocksMatrixPtr->operator()( blockIdx / blocksMatrixCols,
+          blockIdx % blocksMatrixCols );
 
-            te::rp::SegmenterSegmentsBlock& segsBlk =
-              paramsPtr->m_segsBlocksMatrixPtr->operator()( sBMLine, sBMCol );
+        //         TERP_LOGMSG( "Thread:" + boost::lexical_cast< std::string >( 
+        //           boost::this_thread::get_id() ) + " - Processing block:[" +
+        //           boost::lexical_cast< std::string >( segsBlk.m_segmentsMatrixYIndex ) + "," +
+        //           boost::lexical_cast< std::string >( segsBlk.m_segmentsMatrixXIndex ) + "]" );
 
-            if( segsBlk.m_status == te::rp::SegmenterSegmentsBlock::BlockNotProcessed )
-            {
-              //               TERP_LOGMSG( "Thread:" + boost::lexical_cast< std::string >( 
-              //                 boost::this_thread::get_id() ) + " - Processing block:[" +
-              //                 boost::lexical_cast< std::string >( sBMLine ) + "," +
-              //                 boost::lexical_cast< std::string >( sBMCol ) + "]" );
-
-              segsBlk.m_status = te::rp::SegmenterSegmentsBlock::BlockUnderSegmentation;
-              /*
-              std::cout << std::endl<< "Start block processing [" +
-              te::common::Convert2String( sBMCol ) + "," +
-              te::common::Convert2String( sBMLine ) + "]"
-              << std::endl;
-              */
-              paramsPtr->m_generalMutexPtr->unlock();
-
-              // Creating the output raster instance
-
-              te::rst::SynchronizedRaster outputRaster( 1, *(paramsPtr->m_outputRasterSyncPtr) );
-
-              // Executing the strategy
-
-              if( !strategyPtr->execute(
-                *paramsPtr->m_segmentsIdsManagerPtr,
-                segsBlk,
-                inputRaster,
-                paramsPtr->m_inputParameters.m_inputRasterBands,
-                paramsPtr->m_inputRasterNoDataValues,
-                paramsPtr->m_inputRasterBandMinValues,
-                paramsPtr->m_inputRasterBandMaxValues,
-                outputRaster,
-                0,
-                paramsPtr->m_enableStrategyProgress ) )
-              {
-                paramsPtr->m_generalMutexPtr->lock();
+        paramsPtr->m_generalMutexPtr->lock();
+        segsBlk.m_status = te::rp::SegmenterSegmentsBlock::BlockUnderSegmentation;
+        paramsPtr->m_generalMutexPtr->unlock();
 
-                *(paramsPtr->m_runningThreadsCounterPtr) =
-                  *(paramsPtr->m_runningThreadsCounterPtr) - 1;
-                *(paramsPtr->m_abortSegmentationFlagPtr) = true;
+        // Creating the output raster instance
 
-                //                std::cout << std::endl<< "Thread exit (error)"
-                //                  << std::endl;                
+        te::rst::SynchronizedRaster outputRaster( 1, *(paramsPtr->m_outputRasterSyncPtr) );
 
-                paramsPtr->m_generalMutexPtr->unlock();
+        // Executing the strategy, abortable strategies also check the abort
+        // flag inside the block (the flag is detached after the execution
+        // since the strategy may outlive it)
 
-                return;
-              }
+        SegmenterAbortableStrategy* const abortableStrategyPtr =
+          dynamic_cast< SegmenterAbortableStrategy* >( strategyPtr );
+
+        if( abortableStrategyPtr )
+        {
+          abortableStrategyPtr->setAbortFlag( paramsPtr->m_abortSegmentationFlagPtr );
+        }
+
+        const bool blockSegmented = strategyPtr->execute(
+          *paramsPtr->m_segmentsIdsManagerPtr,
+          segsBlk,
+          inputRaster,
+          paramsPtr->m_inputParameters.m_inputRasterBands,
+          paramsPtr->m_inputRasterNoDataValues,
+          paramsPtr->m_inputRasterBandMinValues,
+          paramsPtr->m_inputRasterBandMaxValues,
+          outputRaster,
+          0,
+          paramsPtr->m_enableStrategyProgress );
+
+        if( abortableStrategyPtr )
+        {
+          abortableStrategyPtr->setAbortFlag( 0 );
+        }
 
-              // updating block status
+        if( !blockSegmented )
+        {
+          //                std::cout << std::endl<< "Thread exit (error)"
+          //                  << std::endl;                
 
-              paramsPtr->m_generalMutexPtr->lock();
+          threadExit( paramsPtr, true );
 
-              segsBlk.m_status = te::rp::SegmenterSegmentsBlock::BlockSegmented;
-              /*
-              std::cout << std::endl<< "Block processed [" +
-              te::common::Convert2String( sBMCol ) + "," +
-              te::common::Convert2String( sBMLine ) + "]"
-              << std::endl;
-              */
-              paramsPtr->m_generalMutexPtr->unlock();
+          return;
+        }
 
-              // notifying the main thread with the block processed signal
+        // keeping the block borders segments statistics, each block has its
+        // own statistics container
 
-              boost::lock_guard<boost::mutex> blockProcessedSignalLockGuard(
-                *(paramsPtr->m_blockProcessedSignalMutexPtr) );
+        if( paramsPtr->m_blocksSegmentsStatisticsPtr )
+        {
+          SegmenterBorderStatisticsProvider const* statisticsProviderPtr =
+            dynamic_cast< SegmenterBorderStatisticsProvider const* >( strategyPtr );
 
-              paramsPtr->m_blockProcessedSignalPtr->notify_one();
+          if( ( statisticsProviderPtr == 0 ) || ( !statisticsProviderPtr->getBorderSegmentsStatistics(
+            paramsPtr->m_blocksSegmentsStatisticsPtr->operator[]( blockIdx ) ) ) )
+          {
+            threadExit( paramsPtr, true );
 
-            }
-            else
-            {
-              paramsPtr->m_generalMutexPtr->unlock();
-            }
+            return;
           }
         }
-      }
 
-      // Destroying the strategy object
+        // updating block status and counters
 
-      strategyPtr.reset();
+        paramsPtr->m_generalMutexPtr->lock();
 
-      // ending tasks
+        segsBlk.m_status = te::rp::SegmenterSegmentsBlock::BlockSegmented;
 
-      paramsPtr->m_generalMutexPtr->lock();
+        paramsPtr->m_generalMutexPtr->unlock();
+
+        paramsPtr->m_segmentedPixelsCounterPtr->fetch_add(
+          ((unsigned long long)segsBlk.m_width) * ((unsigned long long)segsBlk.m_height) );
+        paramsPtr->m_segmentedBlocksCounterPtr->fetch_add( 1 );
 
-      *(paramsPtr->m_runningThreadsCounterPtr) =
-        *(paramsPtr->m_runningThreadsCounterPtr) - 1;
+        // reporting the progress and notifying the main thread with the
+        // block processed signal. The counters are read under the signal
+        // mutex, so the reported values never decrease
+
+        boost::lock_guard<boost::mutex> blockProcessedSignalLockGuard(
+          *(paramsPtr->m_blockProcessedSignalMutexPtr) );
+
+        if( paramsPtr->m_inputParameters.m_progressCallback )
+        {
+          ProgressInfo progressInfo;
+          progressInfo.m_segmentedBlocks = paramsPtr->m_segmentedBlocksCounterPtr->load();
+          progressInfo.m_totalBlocks = blocksQueueSize;
+          progressInfo.m_segmentedPixels = paramsPtr->m_segmentedPixelsCounterPtr->load();
+          progressInfo.m_totalPixels = paramsPtr->m_totalBlocksPixels;
+          progressInfo.m_elapsedSeconds = ((double)( boost::posix_time::microsec_clock::universal_time()
+            - paramsPtr->m_startTime ).total_microseconds()) / 1000000.0;
+
+          if( progressInfo.m_segmentedPixels > 0 )
+          {
+            progressInfo.m_etaSeconds = progressInfo.m_elapsedSeconds *
+              ((double)( progressInfo.m_totalPixels - progressInfo.m_segmentedPixels )) /
+              ((double)progressInfo.m_segmentedPixels);
+          }
+
+          if( !paramsPtr->m_inputParameters.m_progressCallback( progressInfo ) )
+          {
+            *(paramsPtr->m_abortSegmentationFlagPtr) = true;
+          }
+        }
+
+        paramsPtr->m_blockProcessedSignalPtr->notify_one();
+      }
+
+      // Destroying the strategy object, if not given
+
+      ownStrategyPtr.reset();
+
+      // ending tasks
 
       //      std::cout << std::endl<< "Thread exit (OK)"
       //        << std::endl;        
 
-      paramsPtr->m_generalMutexPtr->unlock();
+      threadExit( paramsPtr, false );
+    }
+
+    void MultiLevelSegmenter::engineJobEntry( std::vector< SegmenterThreadEntryParams >* threadsParamsPtr,
+      const unsigned int workerIndex )
+    {
+      TERP_DEBUG_TRUE_OR_THROW( threadsParamsPtr, "Invalid pointer" );
+      TERP_DEBUG_TRUE_OR_THROW( workerIndex < threadsParamsPtr->size(), "Invalid worker index" );
+
+      segmenterThreadEntry( &( threadsParamsPtr->operator[]( workerIndex ) ) );
+    }
+
+    void MultiLevelSegmenter::threadExit( SegmenterThreadEntryParams* paramsPtr,
+      const bool abortSegmentation )
+    {
+      if( abortSegmentation )
+      {
+        *(paramsPtr->m_abortSegmentationFlagPtr) = true;
+      }
+
+      paramsPtr->m_runningThreadsCounterPtr->fetch_sub( 1 );
+
+      // the main thread checks the counters holding the signal mutex,
+      // notifying under it avoids lost wakeups
+
+      boost::lock_guard<boost::mutex> blockProcessedSignalLockGuard(
+        *(paramsPtr->m_blockProcessedSignalMutexPtr) );
+
+      paramsPtr->m_blockProcessedSignalPtr->notify_one();
+    }
+
+    void MultiLevelSegmenter::cutOffProfilesThreadEntry(
+      CutOffProfilesThreadEntryParams* paramsPtr )
+    {
+      assert( paramsPtr );
+      assert( paramsPtr->m_segmenterPtr );
+      assert( paramsPtr->m_inputRasterPtr || paramsPtr->m_inputRasterSyncPtr );
+      assert( paramsPtr->m_inputRasterBandsPtr );
+      assert( paramsPtr->m_tasksPtr );
+      assert( paramsPtr->m_nextTaskCursorPtr );
+
+      std::auto_ptr< te::rst::SynchronizedRaster > inputRasterPtr;
+      te::rst::Raster const* rasterPtr = paramsPtr->m_inputRasterPtr;
+
+      if( rasterPtr == 0 )
+      {
+        inputRasterPtr.reset( new te::rst::SynchronizedRaster(
+          paramsPtr->m_maxInputRasterCachedBlocks, *(paramsPtr->m_inputRasterSyncPtr) ) );
+        rasterPtr = inputRasterPtr.get();
+      }
+
+      std::vector< CutOffProfileTask >& tasks = *(paramsPtr->m_tasksPtr);
+      unsigned int taskIdx = paramsPtr->m_nextTaskCursorPtr->fetch_add( 1 );
+
+      while( taskIdx < tasks.size() )
+      {
+        CutOffProfileTask& task = tasks[taskIdx];
+
+        if( task.m_horizontal )
+        {
+          task.m_generated = paramsPtr->m_segmenterPtr->genImageHCutOffProfile(
+            task.m_profileCenter, *rasterPtr, *(paramsPtr->m_inputRasterBandsPtr),
+            paramsPtr->m_pixelNeighborhoodSize,
+            paramsPtr->m_horizontalProfilesNeighborhoodSize,
+            paramsPtr->m_profileAntiSmoothingFactor, task.m_profile );
+        }
+        else
+        {
+          task.m_generated = paramsPtr->m_segmenterPtr->genImageVCutOffProfile(
+            task.m_profileCenter, *rasterPtr, *(paramsPtr->m_inputRasterBandsPtr),
+            paramsPtr->m_pixelNeighborhoodSize,
+            paramsPtr->m_verticalProfilesNeighborhoodSize,
+            paramsPtr->m_profileAntiSmoothingFactor, task.m_profile );
+        }
+
+        taskIdx = paramsPtr->m_nextTaskCursorPtr->fetch_add( 1 );
+      }
     }
 
     bool MultiLevelSegmenter::genImageHCutOffProfile( const unsigned int profileCenter,
@@ -1066,108 +3149,53 @@ namespace teradar {
       if( tilesBufferSize < (1 + (2 * ((int)(pixelNeighborhoodSize)))) )
         return false;
 
-      const int minCrossProfileStartIdx = tilesBufferStartIdx +
-        (int)pixelNeighborhoodSize;
-      const int maxCrossProfileBoundIdx = tilesBufferBoundIdx -
-        (int)pixelNeighborhoodSize;
-
-      int crossProfileIdx = 0;
-      int crossProfileStartIdx = 0;
-      int crossProfileBoundIdx = 0;
-
-      int pixelNBStartIdx = 0;
-      int pixelNBEndIdx = 0;
-      int pixel1NBIdx = 0;
-      int pixel2NBIdx = 0;
-      int pixelNBOffset = 0;
-
-      double diffSum = 0;
-      double currBandDiffSum = 0;
-      double higherDiffSum = 0;
-      int higherDiffSumIdx = 0;
-
       int inRasterBandsIdx = 0;
-      unsigned int bandIdx = 0;
 
-      double pixel1Value = 0;
-      double pixel2Value = 0;
+      for( inRasterBandsIdx = 0; inRasterBandsIdx < inRasterBandsSize;
+        ++inRasterBandsIdx )
+      {
+        TERP_DEBUG_TRUE_OR_THROW( inRasterBands[inRasterBandsIdx] <
+          inRaster.getNumberOfBands(), "Invalid band" )
+      }
 
       profile.resize( inRasterColsNmb, 0 );
 
-      for( int profileElementIdx = 0; profileElementIdx < inRasterColsNmb;
-        ++profileElementIdx )
-      {
-        if( profileElementIdx )
-        {
-          crossProfileStartIdx = profile[profileElementIdx - 1] -
-            (int)profileAntiSmoothingFactor;
-          crossProfileStartIdx = MAX( crossProfileStartIdx,
-            minCrossProfileStartIdx );
-
-          crossProfileBoundIdx = profile[profileElementIdx - 1] + 1 +
-            ((int)profileAntiSmoothingFactor);
-          crossProfileBoundIdx = MIN( crossProfileBoundIdx,
-            maxCrossProfileBoundIdx );
-        }
-        else
-        {
-          crossProfileStartIdx = minCrossProfileStartIdx;
-          crossProfileBoundIdx = maxCrossProfileBoundIdx;
-        }
+      // The tiles buffer is loaded in chunks of profile elements, transposed
+      // so the values crossing each profile element are contiguous.
 
-        higherDiffSum = 0;
-        higherDiffSumIdx = crossProfileStartIdx;
+      std::vector< double > chunkValues( CutOffProfileChunkSize *
+        inRasterBandsSize * tilesBufferSize );
+      double value = 0;
 
-        for( crossProfileIdx = crossProfileStartIdx; crossProfileIdx <
-          crossProfileBoundIdx; ++crossProfileIdx )
-        {
-          // look for the higher diff using all bands
-          // within the defined neighborhood
+      for( int chunkStart = 0; chunkStart < inRasterColsNmb;
+        chunkStart += (int)CutOffProfileChunkSize )
+      {
+        const int chunkBound = MIN( inRasterColsNmb,
+          chunkStart + (int)CutOffProfileChunkSize );
 
-          diffSum = 0;
+        // reading line by line, the raster natural order
 
+        for( int row = tilesBufferStartIdx; row < tilesBufferBoundIdx; ++row )
+        {
           for( inRasterBandsIdx = 0; inRasterBandsIdx < inRasterBandsSize;
             ++inRasterBandsIdx )
           {
-            bandIdx = inRasterBands[inRasterBandsIdx];
-            TERP_DEBUG_TRUE_OR_THROW( bandIdx < inRaster.getNumberOfBands(),
-              "Invalid band" )
+            const te::rst::Band& band = *inRaster.getBand(
+              inRasterBands[inRasterBandsIdx] );
+            double* valuesPtr = &chunkValues[ inRasterBandsIdx * tilesBufferSize +
+              ( row - tilesBufferStartIdx ) ];
 
-              pixelNBStartIdx = crossProfileIdx - ((int)pixelNeighborhoodSize);
-            pixelNBEndIdx = crossProfileIdx + ((int)pixelNeighborhoodSize);
-            currBandDiffSum = 0;
-
-            for( pixelNBOffset = 0; pixelNBOffset < ((int)pixelNeighborhoodSize);
-              ++pixelNBOffset )
+            for( int col = chunkStart; col < chunkBound; ++col )
             {
-              pixel1NBIdx = pixelNBStartIdx + pixelNBOffset;
-              pixel2NBIdx = pixelNBEndIdx - pixelNBOffset;
-
-              TERP_DEBUG_TRUE_OR_THROW( (pixel1NBIdx >= 0) &&
-                (pixel1NBIdx < inRasterRowsNmb), "Invalid pixel2Idx" )
-                TERP_DEBUG_TRUE_OR_THROW( (pixel2NBIdx >= 0) &&
-                (pixel2NBIdx < inRasterRowsNmb), "Invalid pixel2Idx" )
-
-                inRaster.getValue( profileElementIdx,
-                pixel1NBIdx, pixel1Value, bandIdx );
-              inRaster.getValue( profileElementIdx,
-                pixel2NBIdx, pixel2Value, bandIdx );
-
-              currBandDiffSum += ABS( pixel1Value - pixel2Value );
+              band.getValue( col, row, value );
+              valuesPtr[ ( col - chunkStart ) * inRasterBandsSize * tilesBufferSize ] = value;
             }
-
-            diffSum += (currBandDiffSum / ((double)(pixelNBEndIdx -
-              pixelNBStartIdx + 1)));
-          }
-
-          if( diffSum > higherDiffSum )
-          {
-            higherDiffSum = diffSum;
-            higherDiffSumIdx = crossProfileIdx;
           }
         }
 
-        profile[profileElementIdx] = higherDiffSumIdx;
+        GenCutOffProfileChunk( chunkValues, chunkStart, chunkBound,
+          inRasterBandsSize, tilesBufferStartIdx, tilesBufferSize,
+          (int)pixelNeighborhoodSize, (int)profileAntiSmoothingFactor, profile );
       }
 
       return true;
@@ -1210,108 +3238,51 @@ namespace teradar {
       if( tilesBufferSize < (1 + (2 * ((int)(pixelNeighborhoodSize)))) )
         return false;
 
-      const int minCrossProfileStartIdx = tilesBufferStartIdx +
-        (int)pixelNeighborhoodSize;
-      const int maxCrossProfileBoundIdx = tilesBufferBoundIdx -
-        (int)pixelNeighborhoodSize;
-
-      int crossProfileIdx = 0;
-      int crossProfileStartIdx = 0;
-      int crossProfileBoundIdx = 0;
-
-      int pixelNBStartIdx = 0;
-      int pixelNBEndIdx = 0;
-      int pixel1NBIdx = 0;
-      int pixel2NBIdx = 0;
-      int pixelNBOffset = 0;
-
-      double diffSum = 0;
-      double currBandDiffSum = 0;
-      double higherDiffSum = 0;
-      int higherDiffSumIdx = 0;
-
       int inRasterBandsIdx = 0;
-      unsigned int bandIdx = 0;
 
-      double pixel1Value = 0;
-      double pixel2Value = 0;
+      for( inRasterBandsIdx = 0; inRasterBandsIdx < inRasterBandsSize;
+        ++inRasterBandsIdx )
+      {
+        TERP_DEBUG_TRUE_OR_THROW( inRasterBands[inRasterBandsIdx] <
+          inRaster.getNumberOfBands(), "Invalid band" )
+      }
 
       profile.resize( inRasterRowsNmb, 0 );
 
-      for( int profileElementIdx = 0; profileElementIdx < inRasterRowsNmb;
-        ++profileElementIdx )
-      {
-        if( profileElementIdx )
-        {
-          crossProfileStartIdx = profile[profileElementIdx - 1] -
-            (int)profileAntiSmoothingFactor;
-          crossProfileStartIdx = MAX( crossProfileStartIdx,
-            minCrossProfileStartIdx );
+      // The tiles buffer is loaded in chunks of profile elements, transposed
+      // so the values crossing each profile element are contiguous.
 
-          crossProfileBoundIdx = profile[profileElementIdx - 1] + 1 +
-            ((int)profileAntiSmoothingFactor);
-          crossProfileBoundIdx = MIN( crossProfileBoundIdx,
-            maxCrossProfileBoundIdx );
-        }
-        else
-        {
-          crossProfileStartIdx = minCrossProfileStartIdx;
-          crossProfileBoundIdx = maxCrossProfileBoundIdx;
-        }
+      std::vector< double > chunkValues( CutOffProfileChunkSize *
+        inRasterBandsSize * tilesBufferSize );
+      double value = 0;
 
-        higherDiffSum = 0;
-        higherDiffSumIdx = crossProfileStartIdx;
+      for( int chunkStart = 0; chunkStart < inRasterRowsNmb;
+        chunkStart += (int)CutOffProfileChunkSize )
+      {
+        const int chunkBound = MIN( inRasterRowsNmb,
+          chunkStart + (int)CutOffProfileChunkSize );
 
-        for( crossProfileIdx = crossProfileStartIdx; crossProfileIdx <
-          crossProfileBoundIdx; ++crossProfileIdx )
+        for( int row = chunkStart; row < chunkBound; ++row )
         {
-          // look for the higher diff using all bands
-          // within the defined neighborhood
-
-          diffSum = 0;
-
           for( inRasterBandsIdx = 0; inRasterBandsIdx < inRasterBandsSize;
             ++inRasterBandsIdx )
           {
-            bandIdx = inRasterBands[inRasterBandsIdx];
-            TERP_DEBUG_TRUE_OR_THROW( bandIdx < inRaster.getNumberOfBands(),
-              "Invalid band" )
+            const te::rst::Band& band = *inRaster.getBand(
+              inRasterBands[inRasterBandsIdx] );
+            double* valuesPtr = &chunkValues[ ( ( row - chunkStart ) *
+              inRasterBandsSize + inRasterBandsIdx ) * tilesBufferSize ];
 
-              pixelNBStartIdx = crossProfileIdx - ((int)pixelNeighborhoodSize);
-            pixelNBEndIdx = crossProfileIdx + ((int)pixelNeighborhoodSize);
-            currBandDiffSum = 0;
-
-            for( pixelNBOffset = 0; pixelNBOffset < ((int)pixelNeighborhoodSize);
-              ++pixelNBOffset )
+            for( int col = tilesBufferStartIdx; col < tilesBufferBoundIdx; ++col )
             {
-              pixel1NBIdx = pixelNBStartIdx + pixelNBOffset;
-              pixel2NBIdx = pixelNBEndIdx - pixelNBOffset;
-
-              TERP_DEBUG_TRUE_OR_THROW( (pixel1NBIdx >= 0) &&
-                (pixel1NBIdx < inRasterColsNmb), "Invalid pixel2Idx" )
-                TERP_DEBUG_TRUE_OR_THROW( (pixel2NBIdx >= 0) &&
-                (pixel2NBIdx < inRasterColsNmb), "Invalid pixel2Idx" )
-
-                inRaster.getValue( pixel1NBIdx, profileElementIdx,
-                pixel1Value, bandIdx );
-              inRaster.getValue( pixel2NBIdx, profileElementIdx,
-                pixel2Value, bandIdx );
-
-              currBandDiffSum += ABS( pixel1Value - pixel2Value );
+              band.getValue( col, row, value );
+              valuesPtr[ col - tilesBufferStartIdx ] = value;
             }
-
-            diffSum += (currBandDiffSum / ((double)(pixelNBEndIdx -
-              pixelNBStartIdx + 1)));
-          }
-
-          if( diffSum > higherDiffSum )
-          {
-            higherDiffSum = diffSum;
-            higherDiffSumIdx = crossProfileIdx;
           }
         }
 
-        profile[profileElementIdx] = higherDiffSumIdx;
+        GenCutOffProfileChunk( chunkValues, chunkStart, chunkBound,
+          inRasterBandsSize, tilesBufferStartIdx, tilesBufferSize,
+          (int)pixelNeighborhoodSize, (int)profileAntiSmoothingFactor, profile );
       }
 
       return true;
@@ -15,6 +15,9 @@ TerraRadar is under development.
 
 // TerraRadar includes
 #include "config.hpp"
+#include "SegmenterBorderStatisticsProvider.hpp"
+#include "SegmenterEngine.hpp"
+#include "../common/CancellationToken.hpp"
 
 // TerraLib includes
 #include <terralib/raster/RasterSynchronizer.h>
@@ -24,6 +27,15 @@ TerraRadar is under development.
 #include <terralib/rp/SegmenterIdsManager.h>
 #include <terralib/rp/SegmenterStrategyParameters.h>
 
+// Boost includes
+#include <boost/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+// STL includes
+#include <string>
+
 namespace teradar {
   namespace segmenter {
     /*!
@@ -40,6 +52,89 @@ namespace teradar {
     class TERADARSEGMEXPORT MultiLevelSegmenter : public te::rp::Algorithm
     {
       public:
+        /*!
+          \brief Segmentation execution status.
+        */
+        enum ExecutionStatus
+        {
+          CompletedStatus = 0, //!< The segmentation was completed.
+          CancelledStatus = 1, //!< Stopped by the cancellation token, the output holds the labels produced so far.
+          DeadlineExceededStatus = 2 //!< Stopped by the deadline, the output holds the labels produced so far.
+        };
+
+        /*!
+          \class ProgressInfo
+          \brief Segmentation progress, reported each time a block is segmented.
+        */
+        class TERADARSEGMEXPORT ProgressInfo
+        {
+          public:
+            unsigned int m_segmentedBlocks; //!< Number of segmented blocks.
+
+            unsigned int m_totalBlocks; //!< Total number of blocks.
+
+            unsigned long long m_segmentedPixels; //!< Number of pixels of the segmented blocks, overlaps included.
+
+            unsigned long long m_totalPixels; //!< Total number of pixels of all blocks, overlaps included.
+
+            double m_elapsedSeconds; //!< Time elapsed since the blocks segmentation start, in seconds.
+
+            double m_etaSeconds; //!< Estimated remaining time from the segmented pixels rate, in seconds (-1 when unknown).
+
+            ProgressInfo();
+        };
+
+        /*!
+          \class BlocksPlan
+          \brief The blocks partition chosen for a segmentation, reported for tuning.
+        */
+        class TERADARSEGMEXPORT BlocksPlan
+        {
+          public:
+            unsigned int m_nonExpandedBlockWidth; //!< Block width, without the overlap.
+
+            unsigned int m_nonExpandedBlockHeight; //!< Block height, without the overlap.
+
+            unsigned int m_expandedBlockWidth; //!< Block width, including the overlap at both sides.
+
+            unsigned int m_expandedBlockHeight; //!< Block height, including the overlap at both sides.
+
+            unsigned int m_blocksHOverlapSize; //!< Blocks horizontal overlap size (number of columns).
+
+            unsigned int m_blocksVOverlapSize; //!< Blocks vertical overlap size (number of rows).
+
+            unsigned int m_hBlocksNumber; //!< Number of blocks along each line.
+
+            unsigned int m_vBlocksNumber; //!< Number of blocks along each column.
+
+            unsigned int m_threadsNumber; //!< Number of segmentation threads (0 - no threads).
+
+            unsigned int m_alignmentWidth; //!< Blocks widths are multiples of this value, the input raster native block width when possible.
+
+            unsigned int m_alignmentHeight; //!< Blocks heights are multiples of this value, the input raster native block height when possible.
+
+            double m_pixelRequiredMemory; //!< Strategy memory estimation per pixel, in bytes.
+
+            unsigned int m_memoryBlockPixels; //!< Maximum expanded block pixels allowed by the available memory or by m_maxBlockSize.
+
+            unsigned long long m_lastLevelCacheSize; //!< Processor last level cache size, in bytes (0 - unknown).
+
+            unsigned int m_cacheBlockPixels; //!< Expanded block pixels fitting each thread share of the last level cache (0 - unknown).
+
+            unsigned int m_balanceBlockPixels; //!< Expanded block pixels giving m_blocksPerThread blocks to each thread.
+
+            BlocksPlan();
+
+            /*!
+              \brief Return the plan as text, one item per line.
+              \return The plan description.
+            */
+            std::string toString() const;
+        };
+
+        /*! Progress callback type definition - returning false aborts the segmentation */
+        typedef boost::function< bool ( const ProgressInfo& ) > ProgressCallbackT;
+
         /*!
           \class InputParameters
           \brief Segmenter Input Parameters
@@ -61,6 +156,8 @@ namespace teradar {
 
             unsigned int m_maxBlockSize; //!< The input image will be split into blocks with this width for processing, this parameter tells the maximum block lateral size (width or height), the default: 0 - the size will be defined following the current system resources and physical processors number).
 
+            unsigned int m_blocksPerThread; //!< Target number of blocks per segmentation thread, smaller blocks balance the threads load (default:4).
+
             unsigned char m_blocksOverlapPercent; //!< The percentage of blocks overlapped area (valid range:0-25, defaul:0).
 
             std::string m_strategyName; //!< The segmenter strategy name see each te::rp::SegmenterStrategyFactory inherited classes documentation for reference.
@@ -69,6 +166,22 @@ namespace teradar {
 
             bool m_enableRasterCache; //!< Enable/Disable the use of raster data cache (default:true).
 
+            bool m_enableMultiLevelProcessing; //!< If true, the multi resolution level chosen by teradar::common::ComputeMinCompLevelENL is segmented first and the labels are projected and refined level by level up to the input raster resolution. Requires the Wishart strategy over covariance matrix data. The labels of each level are kept in memory, about 5 bytes per input raster pixel, the blocks processing memory limits do not apply to them (default:false).
+
+            unsigned int m_multiLevelRefinementRadius; //!< At each finer level, only pixels up to this distance (pixels number) from the projected segments boundaries are reclassified (default:1).
+
+            bool m_enableBlocksSeamsMerging; //!< If true and the strategy provides the blocks borders segments statistics (see SegmenterBorderStatisticsProvider), the segments crossing the blocks seams are merged by the strategy statistics merger (default:true).
+
+            SegmenterEngine* m_enginePtr; //!< A long-lived engine whose workers and strategies are used instead of creating new ones, it must outlive the execution (default:0 - threads and strategies are created by each execution).
+
+            bool m_enableNumaAwareness; //!< If true and the system has more than one NUMA node, each segmentation thread is bound to the processors of a node and processes first the blocks of its node image region, so its segments pool, IDs matrix and raster buffers stay on its local memory (default:false).
+
+            ProgressCallbackT m_progressCallback; //!< Optional callback called from the segmentation threads each time a block is segmented, calls are serialized (default:empty).
+
+            boost::shared_ptr< teradar::common::CancellationToken > m_cancellationTokenPtr; //!< Optional cancellation token, checked between processing steps, between blocks and inside each block. A cancelled execution keeps the labels produced so far (default:empty).
+
+            boost::posix_time::ptime m_deadline; //!< Optional wall-clock deadline (UTC), handled as the cancellation token (default:not_a_date_time - no deadline).
+
             InputParameters();
 
             InputParameters( const InputParameters& other );
@@ -119,6 +232,14 @@ namespace teradar {
 
             std::auto_ptr< te::rst::Raster > m_outputRasterPtr; //!< A pointer the ge generated output raster (label image).
 
+            BlocksPlan m_blocksPlan; //!< The blocks plan used by the segmentation.
+
+            ExecutionStatus m_status; //!< The execution status, execute returns true for cancelled or expired executions (default:CompletedStatus).
+
+            unsigned int m_segmentedBlocksNumber; //!< Number of blocks fully segmented (default:0).
+
+            unsigned int m_totalBlocksNumber; //!< Total number of blocks (default:0).
+
             OutputParameters();
 
             OutputParameters( const OutputParameters& other );
@@ -189,7 +310,7 @@ namespace teradar {
             boost::mutex* m_blockProcessedSignalMutexPtr;
 
             //! Pointer to the abort segmentation flag (default:0).
-            bool volatile* m_abortSegmentationFlagPtr;
+            boost::atomic< bool >* m_abortSegmentationFlagPtr;
 
             //! Pointer to the segments Ids manager - (default 0).
             te::rp::SegmenterIdsManager* m_segmentsIdsManagerPtr;
@@ -198,7 +319,19 @@ namespace teradar {
             boost::condition_variable* m_blockProcessedSignalPtr;
 
             //! Pointer to the running threads counter - default 0).
-            unsigned int volatile* m_runningThreadsCounterPtr;
+            boost::atomic< unsigned int >* m_runningThreadsCounterPtr;
+
+            //! Pointer to the segmented blocks counter (default:0).
+            boost::atomic< unsigned int >* m_segmentedBlocksCounterPtr;
+
+            //! Pointer to the segmented blocks pixels counter (default:0).
+            boost::atomic< unsigned long long >* m_segmentedPixelsCounterPtr;
+
+            //! Total number of pixels of all blocks (default:0).
+            unsigned long long m_totalBlocksPixels;
+
+            //! The blocks segmentation start time.
+            boost::posix_time::ptime m_startTime;
 
             //! A vector of input raster bands minimum values.
             std::vector< std::complex< double > > m_inputRasterBandMinValues;
@@ -215,37 +348,190 @@ namespace teradar {
             //! The maximum number of input raster cached blocks per-thread.
             unsigned int m_maxInputRasterCachedBlocks;
 
+            //! Pointer to the blocks to process, segments blocks matrix linear indexes grouped by NUMA node, each group ordered by decreasing cost (default:0).
+            std::vector< unsigned int > const* m_blocksQueuePtr;
+
+            //! Pointer to the blocks queue offset of each NUMA node group, followed by the blocks queue size (default:0).
+            std::vector< unsigned int > const* m_nodesQueuesOffsetsPtr;
+
+            //! Pointer to the per NUMA node group indexes of the next element to be processed, shared by all threads (default:0).
+            boost::atomic< unsigned int >* m_nextBlockCursorPtr;
+
+            //! The NUMA node whose blocks are processed first, the other nodes blocks are taken when they are over (default:0).
+            unsigned int m_numaNode;
+
+            //! The processors the thread is bound to, empty to not bind the thread (default:empty).
+            std::vector< unsigned int > m_threadCpus;
+
+            //! Pointer to a strategy instance to be used, not owned, or null to create a new instance (default:0).
+            te::rp::SegmenterStrategy* m_strategyPtr;
+
+            //! Pointer to the per block borders segments statistics, indexed by the segments blocks matrix linear indexes, or null to disable their collection (default:0).
+            std::vector< SegmenterBorderStatisticsProvider::SegmentsStatisticsT >* m_blocksSegmentsStatisticsPtr;
+
+            //! The maximum number of threads of each multi threaded strategy execution, see SegmenterMultiThreadedStrategy (default:0 - no limit).
+            unsigned int m_strategyMaxThreads;
+
             SegmenterThreadEntryParams();
 
             ~SegmenterThreadEntryParams();
         };
         
+        /*!
+          \brief A cut off profile to be generated.
+        */
+        class CutOffProfileTask
+        {
+          public:
+            //! true for a horizontal profile (crossing the image columns), false for a vertical one (default:true).
+            bool m_horizontal;
+
+            //! The profile center line (horizontal profile) or column (vertical profile) (default:0).
+            unsigned int m_profileCenter;
+
+            //! The generated profile.
+            std::vector< unsigned int > m_profile;
+
+            //! The profile generation status (default:false).
+            bool m_generated;
+
+            CutOffProfileTask();
+
+            ~CutOffProfileTask();
+        };
+
+        /*!
+          \brief The parameters passed to the Segmenter::cutOffProfilesThreadEntry method.
+        */
+        class CutOffProfilesThreadEntryParams
+        {
+          public:
+            //! Pointer to the segmenter instance (default:0).
+            MultiLevelSegmenter const* m_segmenterPtr;
+
+            //! Pointer to an input raster to be used directly, when there is only one thread (default:0).
+            te::rst::Raster const* m_inputRasterPtr;
+
+            //! Pointer to the input raster synchronizer, used when m_inputRasterPtr is null (default:0).
+            te::rst::RasterSynchronizer* m_inputRasterSyncPtr;
+
+            //! The maximum number of input raster cached blocks per-thread (default:0).
+            unsigned int m_maxInputRasterCachedBlocks;
+
+            //! Pointer to the input raster bands (default:0).
+            std::vector< unsigned int > const* m_inputRasterBandsPtr;
+
+            //! The pixel neighborhood size over the line transverse to each profile (default:0).
+            unsigned int m_pixelNeighborhoodSize;
+
+            //! The buffer size around each horizontal profile center line (default:0).
+            unsigned int m_horizontalProfilesNeighborhoodSize;
+
+            //! The buffer size around each vertical profile center column (default:0).
+            unsigned int m_verticalProfilesNeighborhoodSize;
+
+            //! A positive profile anti-smoothing factor (default:0).
+            unsigned int m_profileAntiSmoothingFactor;
+
+            //! Pointer to the profiles to generate (default:0).
+            std::vector< CutOffProfileTask >* m_tasksPtr;
+
+            //! Pointer to the index of the next profile to be generated, shared by all threads (default:0).
+            boost::atomic< unsigned int >* m_nextTaskCursorPtr;
+
+            CutOffProfilesThreadEntryParams();
+
+            ~CutOffProfilesThreadEntryParams();
+        };
+
+        /*! Segments ids (labels) vector type definition */
+        typedef std::vector< te::rp::SegmenterSegmentsBlock::SegmentIdDataType > LabelsVectorT;
+
         bool m_instanceInitialized; //"< Is this instance already initialized ?
 
         MultiLevelSegmenter::InputParameters m_inputParameters; //!< Segmenter execution parameters.
 
         /*!
-          \brief Calc the best sub-image block size for each thread to
-          process.
-          \param minBlockPixels The minimun allowed pixels number for each block (expanded block).
-          \param maxBlockPixels The maximum allowed pixels number for each block (expanded block).
-          \param blocksHOverlapSize The blocks horizontal overlap size (number of columns).
-          \param blocksVOverlapSize The blocks vertical overlap size (number of rows).
-          \param nonExpandedBlockWidth The calculated non-expanded block width (non-expanded block).
-          \param nonExpandedBlockHeight The calculated non-expanded block height (non-expanded block).
-          \param expandedBlockWidth The calculated expanded block width (non-expanded block).
-          \param expandedBlockHeight The calculated expanded block height (non-expanded block).
+          \brief Create the output label raster, following the input raster grid.
+          \param outputParams The output parameters where the raster will be created.
+          \return true if OK, false on errors.
+        */
+        bool createOutputRaster( MultiLevelSegmenter::OutputParameters& outputParams ) const;
+
+        /*!
+          \brief Check the cancellation token and the deadline.
+          \return CompletedStatus if the execution may go on, or the stop reason.
+        */
+        ExecutionStatus getStopStatus() const;
+
+        /*!
+          \brief Coarse to fine segmentation.
+          \details The coarsest multi resolution level is segmented, then the labels
+          are projected to each finer level, where only the pixels near the segments
+          boundaries are reclassified.
+          \param outputParams The output parameters.
+          \return true if OK, false on errors.
+        */
+        bool executeMultiLevel( MultiLevelSegmenter::OutputParameters& outputParams );
+
+        /*!
+          \brief Reclassify the pixels near the segments boundaries of a level labels.
+          \details Each pixel up to m_multiLevelRefinementRadius pixels from a boundary
+          is assigned to the neighbor segment with the minimum Wishart distance
+          ln|C| + tr(C^-1 Z), where C is the mean covariance matrix of the segment
+          interior pixels and Z is the pixel covariance matrix.
+          \param levelRaster The level raster (same bands as the input raster).
+          \param covMatrixOrder The covariance matrix order.
+          \param labels The level labels, line by line (will be updated).
+          \return true if OK, false on errors.
+          \note The labels and the boundary pixels mask of the whole level are
+          kept in memory (about 5 bytes per pixel), the level is not split into blocks.
+        */
+        bool refineLevelLabels( const te::rst::Raster& levelRaster,
+          const unsigned int covMatrixOrder, LabelsVectorT& labels ) const;
+
+        /*!
+          \brief Merge the segments crossing the blocks seams.
+          \details The pairs of labels facing each other across each seam are
+          tested by the strategy statistics merger, seam by seam in the blocks
+          order, so the result does not depend on the threads scheduling. Each
+          merged labels set keeps its merged statistics and the pairs are
+          tested set against set. The merged segments are then relabeled in
+          the output raster, one raster block per thread.
+          \param segmentsBlocksMatrix The segmented blocks.
+          \param blocksSegmentsStatistics The per block borders segments statistics.
+          \param statisticsProvider The initialized strategy providing the statistics mergers.
+          \param threadsNumber The maximum number of relabeling threads (0 - no threads).
+          \param outputRasterSync The output raster synchronizer, used by the relabeling threads.
+          \param outputRaster The output labels raster (band 0).
+          \return true if OK, false on errors.
+        */
+        bool mergeBlocksSeams( const SegmentsBlocksMatrixT& segmentsBlocksMatrix,
+          const std::vector< SegmenterBorderStatisticsProvider::SegmentsStatisticsT >& blocksSegmentsStatistics,
+          const SegmenterBorderStatisticsProvider& statisticsProvider,
+          const unsigned int threadsNumber, te::rst::RasterSynchronizer& outputRasterSync,
+          te::rst::Raster& outputRaster ) const;
+
+        /*!
+          \brief Plan the blocks partition.
+          \details The expanded blocks never exceed the available memory share
+          of each thread. Within this limit, blocks are sized so each thread
+          gets about m_blocksPerThread blocks and, when the last level cache
+          size is known, so each block working set fits the thread cache share,
+          but never lower than a minimum size. The blocks dimensions are
+          multiples of the input raster native block dimensions when possible.
+          \param pixelRequiredMemory Strategy memory estimation per pixel, in bytes.
+          \param memoryBlockPixels The maximum expanded block pixels.
+          \param overlapPercent The percentage of blocks overlapped area.
+          \param threadsNumber Number of segmentation threads (0 - no threads).
+          \param plan The blocks plan.
           \return true if OK, false on errors.
         */
-        bool calcBestBlockSize(
-          const unsigned int minExapandedBlockPixels,
-          const unsigned int maxExapandedBlockPixels,
-          unsigned int& blocksHOverlapSize,
-          unsigned int& blocksVOverlapSize,
-          unsigned int& nonExpandedBlockWidth,
-          unsigned int& nonExpandedBlockHeight,
-          unsigned int& expandedBlockWidth,
-          unsigned int& expandedBlockHeight ) const;
+        bool planBlocks( const double pixelRequiredMemory,
+          const unsigned int memoryBlockPixels,
+          const unsigned int overlapPercent,
+          const unsigned int threadsNumber,
+          BlocksPlan& plan ) const;
 
         /*!
           \brief Segmenter thread entry.
@@ -253,6 +539,29 @@ namespace teradar {
         */
         static void segmenterThreadEntry( SegmenterThreadEntryParams* paramsPtr );
 
+        /*!
+          \brief Segmentation engine job entry, running the segmenter thread entry of a worker.
+          \param threadsParamsPtr A pointer to the per worker segmenter thread parameters.
+          \param workerIndex The engine worker index.
+        */
+        static void engineJobEntry( std::vector< SegmenterThreadEntryParams >* threadsParamsPtr,
+          const unsigned int workerIndex );
+
+        /*!
+          \brief Segmenter thread exit, updating the running threads counter
+          and waking up the main thread.
+          \param paramsPtr A pointer to the segmenter thread parameters.
+          \param abortSegmentation If true, the segmentation will be aborted.
+        */
+        static void threadExit( SegmenterThreadEntryParams* paramsPtr,
+          const bool abortSegmentation );
+
+        /*!
+          \brief Cut off profiles generation thread entry.
+          \param paramsPtr A pointer to the thread parameters.
+        */
+        static void cutOffProfilesThreadEntry( CutOffProfilesThreadEntryParams* paramsPtr );
+
         /*!
           \brief Generate the horizontal cutOff prifles for the entire image..
           \param profileCenter The profile center line.
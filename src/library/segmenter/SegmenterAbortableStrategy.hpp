@@ -0,0 +1,48 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+  \file terraradar/library/segmenter/SegmenterAbortableStrategy.hpp
+  \brief Interface of the segmenter strategies that can abort a running block segmentation.
+*/
+
+#ifndef TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERABORTABLESTRATEGY_HPP_
+#define TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERABORTABLESTRATEGY_HPP_
+
+// TerraRadar includes
+#include "config.hpp"
+
+// Boost includes
+#include <boost/atomic.hpp>
+
+namespace teradar {
+  namespace segmenter {
+    /*!
+      \class SegmenterAbortableStrategy
+      \brief A segmenter strategy that checks an abort flag inside the block processing.
+      \details Implemented by the strategies (besides te::rp::SegmenterStrategy)
+      so the segmenter can stop a running block without knowing the strategy type.
+    */
+    class TERADARSEGMEXPORT SegmenterAbortableStrategy
+    {
+      public:
+        /*!
+          \brief Destructor.
+        */
+        virtual ~SegmenterAbortableStrategy() {}
+
+        /*!
+          \brief Set the flag that aborts the running execute call.
+          \details An aborted execute call returns false without writing the block labels.
+          \param abortFlagPtr A pointer to the abort flag, or null to disable the checks.
+        */
+        virtual void setAbortFlag( boost::atomic< bool > const* abortFlagPtr ) = 0;
+    };
+  }  // end namespace segmenter
+}  // end namespace teradar
+
+#endif  // TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERABORTABLESTRATEGY_HPP_
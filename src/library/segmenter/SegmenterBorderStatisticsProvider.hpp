@@ -0,0 +1,121 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+  \file terraradar/library/segmenter/SegmenterBorderStatisticsProvider.hpp
+  \brief Interface of the segmenter strategies providing the blocks borders segments statistics.
+*/
+
+#ifndef TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERBORDERSTATISTICSPROVIDER_HPP_
+#define TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERBORDERSTATISTICSPROVIDER_HPP_
+
+// TerraRadar includes
+#include "config.hpp"
+
+// TerraLib includes
+#include <terralib/rp/SegmenterSegmentsBlock.h>
+
+// STL includes
+#include <map>
+#include <vector>
+
+namespace teradar {
+  namespace segmenter {
+    /*!
+      \class SegmenterBorderStatisticsProvider
+      \brief A segmenter strategy providing the statistics of the segments
+      touching the borders of each processed block.
+      \details Implemented by the strategies (besides te::rp::SegmenterStrategy)
+      so the segmenter can merge the segments crossing the blocks seams
+      without knowing the strategy type.
+    */
+    class TERADARSEGMEXPORT SegmenterBorderStatisticsProvider
+    {
+      public:
+        /*!
+          \class SegmentStatistics
+          \brief Statistics of a segment, used to merge segments across blocks seams.
+        */
+        class TERADARSEGMEXPORT SegmentStatistics
+        {
+          public:
+            unsigned int m_size; //!< Number of segment pixels.
+
+            unsigned int m_xStart; //!< First segment raster column.
+
+            unsigned int m_yStart; //!< First segment raster line.
+
+            unsigned int m_xBound; //!< Raster column after the last segment column.
+
+            unsigned int m_yBound; //!< Raster line after the last segment line.
+
+            std::vector< double > m_features; //!< The segment features, as kept by the strategy.
+        };
+
+        /*!
+          \brief Segments statistics indexed by segment id.
+        */
+        typedef std::map< te::rp::SegmenterSegmentsBlock::SegmentIdDataType, SegmentStatistics > SegmentsStatisticsT;
+
+        /*!
+          \class StatisticsMerger
+          \brief Decides and performs the merges of segments statistics.
+          \details An instance keeps intermediate values, each thread must use its own.
+        */
+        class TERADARSEGMEXPORT StatisticsMerger
+        {
+          public:
+            /*!
+              \brief Destructor.
+            */
+            virtual ~StatisticsMerger() {}
+
+            /*!
+              \brief Test if two segments should be merged.
+              \param statistics1 The first segment statistics.
+              \param statistics2 The second segment statistics.
+              \return true if the segments should be merged.
+            */
+            virtual bool shouldMerge( const SegmentStatistics& statistics1,
+              const SegmentStatistics& statistics2 ) = 0;
+
+            /*!
+              \brief Merge the second segment statistics into the first ones.
+              \param statistics1 The first segment statistics (input and output).
+              \param statistics2 The second segment statistics.
+            */
+            virtual void merge( SegmentStatistics& statistics1,
+              const SegmentStatistics& statistics2 ) = 0;
+        };
+
+        /*!
+          \brief Destructor.
+        */
+        virtual ~SegmenterBorderStatisticsProvider() {}
+
+        /*!
+          \brief Return the statistics of the segments touching the borders of the
+          last processed block.
+          \details Only valid after a successful execute call, before the next
+          execute or reset call.
+          \param statistics The segments statistics (output), with raster coordinates.
+          \return true if OK, false on errors.
+        */
+        virtual bool getBorderSegmentsStatistics( SegmentsStatisticsT& statistics ) const = 0;
+
+        /*!
+          \brief Create a merger of the segments statistics.
+          \details Only valid for an initialized instance.
+          \param bandsToProcess The number of processed input raster bands.
+          \return A new instance, owned by the caller, or null on errors.
+        */
+        virtual StatisticsMerger* createStatisticsMerger( const unsigned int bandsToProcess ) const = 0;
+    };
+  }  // end namespace segmenter
+}  // end namespace teradar
+
+#endif  // TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERBORDERSTATISTICSPROVIDER_HPP_
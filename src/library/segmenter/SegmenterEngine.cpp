@@ -0,0 +1,174 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+  \file terraradar/library/segmenter/SegmenterEngine.cpp
+  \brief Long-lived segmentation workers shared by consecutive segmentations.
+  */
+
+// TerraRadar includes
+#include "SegmenterEngine.hpp"
+
+// TerraLib includes
+#include <terralib/common/PlatformUtils.h>
+#include <terralib/rp/SegmenterStrategyFactory.h>
+
+// Boost includes
+#include <boost/bind.hpp>
+
+// STL includes
+#include <algorithm>
+
+namespace teradar {
+  namespace segmenter {
+    SegmenterEngine::SegmenterEngine( const unsigned int workersNumber )
+      : m_workersNumber( workersNumber ? workersNumber :
+          std::max( 1u, (unsigned int)te::common::GetPhysProcNumber() ) ),
+      m_jobWorkersNumber( 0 ),
+      m_pendingWorkers( 0 ),
+      m_jobsCounter( 0 ),
+      m_stopWorkers( false )
+    {
+      m_strategies.resize( m_workersNumber );
+      m_strategiesNames.resize( m_workersNumber );
+
+      for( unsigned int workerIndex = 0; workerIndex < m_workersNumber; ++workerIndex )
+      {
+        m_workers.add_thread( new boost::thread( boost::bind(
+          &SegmenterEngine::workerEntry, this, workerIndex ) ) );
+      }
+    }
+
+    SegmenterEngine::~SegmenterEngine()
+    {
+      join();
+
+      {
+        boost::lock_guard< boost::mutex > lock( m_stateMutex );
+        m_stopWorkers = true;
+      }
+
+      m_jobStartedSignal.notify_all();
+      m_workers.join_all();
+
+      // the strategies are destroyed after the workers, which may be using them
+      m_strategies.clear();
+    }
+
+    unsigned int SegmenterEngine::getWorkersNumber() const
+    {
+      return m_workersNumber;
+    }
+
+    te::rp::SegmenterStrategy* SegmenterEngine::getWorkerStrategy( const unsigned int workerIndex,
+      const std::string& strategyName )
+    {
+      if( workerIndex >= m_workersNumber )
+      {
+        return 0;
+      }
+
+      boost::lock_guard< boost::mutex > lock( m_strategiesMutex );
+
+      if( ( m_strategies[workerIndex].get() == 0 ) ||
+        ( m_strategiesNames[workerIndex] != strategyName ) )
+      {
+        m_strategies[workerIndex].reset( te::rp::SegmenterStrategyFactory::make( strategyName ) );
+        m_strategiesNames[workerIndex] = strategyName;
+      }
+
+      return m_strategies[workerIndex].get();
+    }
+
+    bool SegmenterEngine::start( const JobT& job, const unsigned int workersNumber )
+    {
+      if( job.empty() || ( workersNumber == 0 ) )
+      {
+        return false;
+      }
+
+      {
+        boost::lock_guard< boost::mutex > lock( m_stateMutex );
+
+        if( m_pendingWorkers || m_stopWorkers )
+        {
+          return false;
+        }
+
+        m_job = job;
+        m_jobWorkersNumber = std::min( workersNumber, m_workersNumber );
+        m_pendingWorkers = m_jobWorkersNumber;
+        ++m_jobsCounter;
+      }
+
+      m_jobStartedSignal.notify_all();
+
+      return true;
+    }
+
+    void SegmenterEngine::join()
+    {
+      boost::unique_lock< boost::mutex > lock( m_stateMutex );
+
+      while( m_pendingWorkers )
+      {
+        m_jobFinishedSignal.wait( lock );
+      }
+
+      m_job.clear();
+    }
+
+    boost::mutex& SegmenterEngine::getExecutionMutex()
+    {
+      return m_executionMutex;
+    }
+
+    void SegmenterEngine::workerEntry( const unsigned int workerIndex )
+    {
+      unsigned long long lastJobsCounter = 0;
+
+      while( true )
+      {
+        JobT job;
+
+        {
+          boost::unique_lock< boost::mutex > lock( m_stateMutex );
+
+          while( ( !m_stopWorkers ) && ( m_jobsCounter == lastJobsCounter ) )
+          {
+            m_jobStartedSignal.wait( lock );
+          }
+
+          if( m_stopWorkers )
+          {
+            return;
+          }
+
+          lastJobsCounter = m_jobsCounter;
+
+          if( workerIndex >= m_jobWorkersNumber )
+          {
+            continue;
+          }
+
+          job = m_job;
+        }
+
+        job( workerIndex );
+
+        {
+          boost::lock_guard< boost::mutex > lock( m_stateMutex );
+
+          if( ( --m_pendingWorkers ) == 0 )
+          {
+            m_jobFinishedSignal.notify_all();
+          }
+        }
+      }
+    }
+  } // end namespace segmenter
+} // end namespace teradar
@@ -0,0 +1,131 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+  \file terraradar/library/segmenter/SegmenterEngine.hpp
+  \brief Long-lived segmentation workers shared by consecutive segmentations.
+  */
+
+#ifndef TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERENGINE_HPP_
+#define TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERENGINE_HPP_
+
+// TerraRadar includes
+#include "config.hpp"
+
+// TerraLib includes
+#include <terralib/rp/SegmenterStrategy.h>
+
+// Boost includes
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+// STL includes
+#include <string>
+#include <vector>
+
+namespace teradar {
+  namespace segmenter {
+    /*!
+      \class SegmenterEngine
+      \brief Long-lived segmentation workers.
+
+      \details The worker threads and one segmentation strategy instance per
+      worker are kept alive between jobs, so consecutive segmentations (e.g.
+      many small chips) do not pay for threads creation, strategies creation
+      and segments pools and IDs matrices allocation. The strategies keep
+      their memory between jobs and only grow it when a larger block is
+      segmented.
+
+      \note An engine runs one job at a time, concurrent users must hold the
+      execution mutex (see getExecutionMutex) from start to join.
+    */
+    class TERADARSEGMEXPORT SegmenterEngine
+    {
+      public:
+        /*! Job type definition, called by each job worker with the worker index */
+        typedef boost::function< void ( const unsigned int workerIndex ) > JobT;
+
+        /*!
+          \brief Constructor.
+          \param workersNumber Number of worker threads (0 - the number of physical processors).
+        */
+        SegmenterEngine( const unsigned int workersNumber = 0 );
+
+        /// Destructor. Waits the running job and stops the workers.
+        ~SegmenterEngine();
+
+        /*!
+          \brief Return the number of worker threads.
+          \return The number of worker threads.
+        */
+        unsigned int getWorkersNumber() const;
+
+        /*!
+          \brief Return the strategy instance of a worker.
+          \details The instance is created on the first request and replaced
+          only when a different strategy name is requested. It is not
+          initialized, the caller initializes it for each job.
+          \param workerIndex The worker index.
+          \param strategyName The strategy factory key.
+          \return A pointer to the strategy, owned by the engine, or null on errors.
+        */
+        te::rp::SegmenterStrategy* getWorkerStrategy( const unsigned int workerIndex,
+          const std::string& strategyName );
+
+        /*!
+          \brief Start a job on the first @a workersNumber workers.
+          \param job The job, called once by each worker.
+          \param workersNumber The number of workers running the job (limited to the engine workers number).
+          \return True if OK. False if a job is already running or the parameters are invalid.
+        */
+        bool start( const JobT& job, const unsigned int workersNumber );
+
+        /*!
+          \brief Wait the running job, if any, to finish.
+        */
+        void join();
+
+        /*!
+          \brief Return the mutex that serializes the engine users.
+          \return The execution mutex.
+        */
+        boost::mutex& getExecutionMutex();
+
+      protected:
+        /*!
+          \brief Worker thread entry, waiting and running jobs until the engine is destroyed.
+          \param workerIndex The worker index.
+        */
+        void workerEntry( const unsigned int workerIndex );
+
+      private:
+        /// Not copyable.
+        SegmenterEngine( const SegmenterEngine& );
+
+        /// Not copyable.
+        const SegmenterEngine& operator=( const SegmenterEngine& );
+
+        boost::thread_group m_workers; //!< The worker threads.
+        unsigned int m_workersNumber; //!< Number of worker threads.
+        std::vector< boost::shared_ptr< te::rp::SegmenterStrategy > > m_strategies; //!< Per worker strategy instances.
+        std::vector< std::string > m_strategiesNames; //!< Per worker strategy instances factory keys.
+        JobT m_job; //!< The current job.
+        unsigned int m_jobWorkersNumber; //!< Number of workers running the current job.
+        unsigned int m_pendingWorkers; //!< Number of workers still running the current job.
+        unsigned long long m_jobsCounter; //!< Number of started jobs, workers wake up when it changes.
+        bool m_stopWorkers; //!< Workers stop request.
+        boost::mutex m_stateMutex; //!< Jobs state mutex.
+        boost::condition_variable m_jobStartedSignal; //!< Signal emitted when a job is started or the workers must stop.
+        boost::condition_variable m_jobFinishedSignal; //!< Signal emitted when all workers finished the current job.
+        boost::mutex m_strategiesMutex; //!< Strategies creation mutex.
+        boost::mutex m_executionMutex; //!< Engine users mutex.
+    };
+  } // end namespace segmenter
+} // end namespace teradar
+
+#endif // TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERENGINE_HPP_
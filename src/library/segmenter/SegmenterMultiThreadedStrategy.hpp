@@ -0,0 +1,47 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+  \file terraradar/library/segmenter/SegmenterMultiThreadedStrategy.hpp
+  \brief Interface of the segmenter strategies using many threads inside a block segmentation.
+*/
+
+#ifndef TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERMULTITHREADEDSTRATEGY_HPP_
+#define TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERMULTITHREADEDSTRATEGY_HPP_
+
+// TerraRadar includes
+#include "config.hpp"
+
+namespace teradar {
+  namespace segmenter {
+    /*!
+      \class SegmenterMultiThreadedStrategy
+      \brief A segmenter strategy that may use many threads to segment a block.
+      \details Implemented by the strategies (besides te::rp::SegmenterStrategy)
+      so the segmenter can limit their threads when many blocks are segmented
+      at the same time, without knowing the strategy type.
+    */
+    class TERADARSEGMEXPORT SegmenterMultiThreadedStrategy
+    {
+      public:
+        /*!
+          \brief Destructor.
+        */
+        virtual ~SegmenterMultiThreadedStrategy() {}
+
+        /*!
+          \brief Limit the number of threads used by each execute call.
+          \details The limit applies to the next execute calls, the strategy
+          parameters are not changed.
+          \param maxThreadsNumber The maximum number of threads (0 - no limit).
+        */
+        virtual void setMaxThreadsNumber( const unsigned int maxThreadsNumber ) = 0;
+    };
+  }  // end namespace segmenter
+}  // end namespace teradar
+
+#endif  // TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERMULTITHREADEDSTRATEGY_HPP_
@@ -0,0 +1,330 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+  \file terraradar/library/segmenter/SegmenterRegionAdjacencyGraph.cpp
+  \brief Region adjacency graph of the segments of a block.
+  */
+
+// TerraRadar includes
+#include "SegmenterRegionAdjacencyGraph.hpp"
+
+// STL includes
+#include <algorithm>
+
+namespace
+{
+  // neighbors lines and columns offsets, in raster order
+  const int VonNeumannLinesOffsets[] = { -1, 0, 0, 1 };
+  const int VonNeumannColsOffsets[] = { 0, -1, 1, 0 };
+  const int MooreLinesOffsets[] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+  const int MooreColsOffsets[] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+
+  // an invalid cache entry (null generations)
+  teradar::segmenter::SegmenterRegionAdjacencyGraph::EdgeCacheEntry InvalidEdgeCacheEntry()
+  {
+    teradar::segmenter::SegmenterRegionAdjacencyGraph::EdgeCacheEntry entry;
+    entry.m_value = 0;
+    entry.m_nodeGeneration = 0;
+    entry.m_neighborGeneration = 0;
+    return entry;
+  }
+}
+
+namespace teradar {
+  namespace segmenter {
+    SegmenterRegionAdjacencyGraph::SegmenterRegionAdjacencyGraph()
+      : m_abandonedSize( 0 )
+    {
+    }
+
+    SegmenterRegionAdjacencyGraph::~SegmenterRegionAdjacencyGraph()
+    {
+    }
+
+    bool SegmenterRegionAdjacencyGraph::build( const te::rp::Matrix< unsigned int >& idsMatrix,
+      const teradar::common::PixelConnectivityType connectivity,
+      const bool enableEdgesCache )
+    {
+      const unsigned int nLines = idsMatrix.getLinesNumber();
+      const unsigned int nCols = idsMatrix.getColumnsNumber();
+      const std::size_t nodesNumber = ((std::size_t)nLines) * ((std::size_t)nCols);
+
+      const unsigned int offsetsNumber = ( connectivity == teradar::common::MooreNT ) ? 8 : 4;
+      const int* linesOffsets = ( connectivity == teradar::common::MooreNT ) ?
+        MooreLinesOffsets : VonNeumannLinesOffsets;
+      const int* colsOffsets = ( connectivity == teradar::common::MooreNT ) ?
+        MooreColsOffsets : VonNeumannColsOffsets;
+
+      m_offsets.assign( nodesNumber, 0 );
+      m_sizes.assign( nodesNumber, 0 );
+      m_capacities.assign( nodesNumber, 0 );
+      m_generations.assign( nodesNumber, 1 );
+      m_neighbors.clear();
+      m_neighbors.reserve( nodesNumber * offsetsNumber );
+      m_abandonedSize = 0;
+
+      unsigned int line = 0;
+      unsigned int col = 0;
+      unsigned int offsetIdx = 0;
+      int neighborLine = 0;
+      int neighborCol = 0;
+      NodeIndexT node = 0;
+
+      for( line = 0; line < nLines; ++line )
+      {
+        for( col = 0; col < nCols; ++col )
+        {
+          if( idsMatrix( line, col ) == 0 )
+          {
+            continue;
+          }
+
+          node = line * nCols + col;
+          m_offsets[ node ] = m_neighbors.size();
+
+          for( offsetIdx = 0; offsetIdx < offsetsNumber; ++offsetIdx )
+          {
+            neighborLine = ((int)line) + linesOffsets[ offsetIdx ];
+            neighborCol = ((int)col) + colsOffsets[ offsetIdx ];
+
+            if( ( neighborLine >= 0 ) && ( neighborLine < (int)nLines ) &&
+              ( neighborCol >= 0 ) && ( neighborCol < (int)nCols ) &&
+              ( idsMatrix( (unsigned int)neighborLine, (unsigned int)neighborCol ) != 0 ) )
+            {
+              m_neighbors.push_back( ((NodeIndexT)neighborLine) * nCols + ((NodeIndexT)neighborCol) );
+            }
+          }
+
+          m_sizes[ node ] = (unsigned int)( m_neighbors.size() - m_offsets[ node ] );
+          m_capacities[ node ] = m_sizes[ node ];
+        }
+      }
+
+      if( enableEdgesCache )
+      {
+        m_edgesCache.assign( m_neighbors.size(), InvalidEdgeCacheEntry() );
+      }
+      else
+      {
+        std::vector< EdgeCacheEntry >().swap( m_edgesCache );
+      }
+
+      return true;
+    }
+
+    void SegmenterRegionAdjacencyGraph::merge( const NodeIndexT absorberNode,
+      const NodeIndexT absorbedNode )
+    {
+      reserveNeighbors( absorberNode, m_sizes[ absorberNode ] + m_sizes[ absorbedNode ] );
+
+      const bool cacheEnabled = !m_edgesCache.empty();
+      const std::size_t absorbedOffset = m_offsets[ absorbedNode ];
+      const unsigned int absorbedSize = m_sizes[ absorbedNode ];
+      NodeIndexT neighbor = 0;
+      std::size_t neighborOffset = 0;
+      unsigned int neighborIdx = 0;
+
+      for( unsigned int absorbedNeighborIdx = 0; absorbedNeighborIdx < absorbedSize; ++absorbedNeighborIdx )
+      {
+        neighbor = m_neighbors[ absorbedOffset + absorbedNeighborIdx ];
+
+        if( neighbor == absorberNode )
+        {
+          continue;
+        }
+
+        // the neighbor now points to the absorber, once
+        if( hasNeighbor( neighbor, absorberNode ) )
+        {
+          removeNeighbor( neighbor, absorbedNode );
+        }
+        else
+        {
+          neighborOffset = m_offsets[ neighbor ];
+
+          for( neighborIdx = 0; neighborIdx < m_sizes[ neighbor ]; ++neighborIdx )
+          {
+            if( m_neighbors[ neighborOffset + neighborIdx ] == absorbedNode )
+            {
+              m_neighbors[ neighborOffset + neighborIdx ] = absorberNode;
+
+              // the old value may carry the new absorber generation
+              if( cacheEnabled )
+              {
+                m_edgesCache[ neighborOffset + neighborIdx ] = InvalidEdgeCacheEntry();
+              }
+
+              break;
+            }
+          }
+
+          m_neighbors[ m_offsets[ absorberNode ] + m_sizes[ absorberNode ] ] = neighbor;
+
+          if( cacheEnabled )
+          {
+            m_edgesCache[ m_offsets[ absorberNode ] + m_sizes[ absorberNode ] ] = InvalidEdgeCacheEntry();
+          }
+
+          ++m_sizes[ absorberNode ];
+        }
+      }
+
+      removeNeighbor( absorberNode, absorbedNode );
+
+      // the absorber edges cached values are now stale
+      ++m_generations[ absorberNode ];
+
+      m_abandonedSize += m_capacities[ absorbedNode ];
+      m_sizes[ absorbedNode ] = 0;
+      m_capacities[ absorbedNode ] = 0;
+
+      if( m_abandonedSize > ( m_neighbors.size() / 2 ) )
+      {
+        compact();
+      }
+    }
+
+    void SegmenterRegionAdjacencyGraph::clear()
+    {
+      m_offsets.clear();
+      m_sizes.clear();
+      m_capacities.clear();
+      m_neighbors.clear();
+      m_edgesCache.clear();
+      m_generations.clear();
+      m_abandonedSize = 0;
+    }
+
+    double SegmenterRegionAdjacencyGraph::getMemUsageEstimation( const unsigned int nodesNumber,
+      const teradar::common::PixelConnectivityType connectivity,
+      const bool enableEdgesCache )
+    {
+      // the neighbors array may hold as many abandoned ranges as live ones
+      // before being compacted
+      const double neighborsNumber = ( connectivity == teradar::common::MooreNT ) ? 8.0 : 4.0;
+
+      return ((double)nodesNumber) * ( sizeof( std::size_t ) + 3.0 * sizeof( unsigned int ) +
+        2.0 * neighborsNumber * ( sizeof( NodeIndexT ) +
+        ( enableEdgesCache ? sizeof( EdgeCacheEntry ) : 0 ) ) );
+    }
+
+    void SegmenterRegionAdjacencyGraph::reserveNeighbors( const NodeIndexT node,
+      const unsigned int capacity )
+    {
+      if( capacity <= m_capacities[ node ] )
+      {
+        return;
+      }
+
+      const unsigned int newCapacity = std::max( capacity, 2 * m_capacities[ node ] );
+      const std::size_t newOffset = m_neighbors.size();
+
+      m_neighbors.resize( newOffset + newCapacity );
+
+      std::copy( m_neighbors.begin() + m_offsets[ node ],
+        m_neighbors.begin() + m_offsets[ node ] + m_sizes[ node ],
+        m_neighbors.begin() + newOffset );
+
+      if( !m_edgesCache.empty() )
+      {
+        m_edgesCache.resize( newOffset + newCapacity );
+
+        std::copy( m_edgesCache.begin() + m_offsets[ node ],
+          m_edgesCache.begin() + m_offsets[ node ] + m_sizes[ node ],
+          m_edgesCache.begin() + newOffset );
+      }
+
+      m_abandonedSize += m_capacities[ node ];
+      m_offsets[ node ] = newOffset;
+      m_capacities[ node ] = newCapacity;
+    }
+
+    bool SegmenterRegionAdjacencyGraph::removeNeighbor( const NodeIndexT node,
+      const NodeIndexT neighbor )
+    {
+      const std::size_t offset = m_offsets[ node ];
+      const unsigned int size = m_sizes[ node ];
+
+      for( unsigned int neighborIdx = 0; neighborIdx < size; ++neighborIdx )
+      {
+        if( m_neighbors[ offset + neighborIdx ] == neighbor )
+        {
+          m_neighbors[ offset + neighborIdx ] = m_neighbors[ offset + size - 1 ];
+
+          if( !m_edgesCache.empty() )
+          {
+            m_edgesCache[ offset + neighborIdx ] = m_edgesCache[ offset + size - 1 ];
+          }
+
+          --m_sizes[ node ];
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    bool SegmenterRegionAdjacencyGraph::hasNeighbor( const NodeIndexT node,
+      const NodeIndexT neighbor ) const
+    {
+      const std::size_t offset = m_offsets[ node ];
+      const unsigned int size = m_sizes[ node ];
+
+      for( unsigned int neighborIdx = 0; neighborIdx < size; ++neighborIdx )
+      {
+        if( m_neighbors[ offset + neighborIdx ] == neighbor )
+        {
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    void SegmenterRegionAdjacencyGraph::compact()
+    {
+      const bool cacheEnabled = !m_edgesCache.empty();
+
+      std::vector< NodeIndexT > neighbors;
+      neighbors.reserve( m_neighbors.size() - m_abandonedSize );
+
+      std::vector< EdgeCacheEntry > edgesCache;
+
+      if( cacheEnabled )
+      {
+        edgesCache.reserve( m_neighbors.size() - m_abandonedSize );
+      }
+
+      for( std::size_t node = 0; node < m_offsets.size(); ++node )
+      {
+        if( m_capacities[ node ] == 0 )
+        {
+          continue;
+        }
+
+        const std::size_t newOffset = neighbors.size();
+
+        neighbors.insert( neighbors.end(), m_neighbors.begin() + m_offsets[ node ],
+          m_neighbors.begin() + m_offsets[ node ] + m_sizes[ node ] );
+
+        if( cacheEnabled )
+        {
+          edgesCache.insert( edgesCache.end(), m_edgesCache.begin() + m_offsets[ node ],
+            m_edgesCache.begin() + m_offsets[ node ] + m_sizes[ node ] );
+        }
+
+        m_offsets[ node ] = newOffset;
+        m_capacities[ node ] = m_sizes[ node ];
+      }
+
+      m_neighbors.swap( neighbors );
+      m_edgesCache.swap( edgesCache );
+      m_abandonedSize = 0;
+    }
+  } // end namespace segmenter
+} // end namespace teradar
@@ -0,0 +1,190 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+  \file terraradar/library/segmenter/SegmenterRegionAdjacencyGraph.hpp
+  \brief Region adjacency graph of the segments of a block.
+  */
+
+#ifndef TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERREGIONADJACENCYGRAPH_HPP_
+#define TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERREGIONADJACENCYGRAPH_HPP_
+
+// TerraRadar includes
+#include "config.hpp"
+
+#include "../common/Utils.hpp"
+
+// TerraLib includes
+#include <terralib/rp/Matrix.h>
+
+// STL includes
+#include <cstddef>
+#include <vector>
+
+namespace teradar {
+  namespace segmenter {
+    /*!
+      \class SegmenterRegionAdjacencyGraph
+      \brief Region adjacency graph of the segments of a block.
+
+      \details There is one node per block pixel, the node index is the pixel
+      index (line * width + column), and the initial segments are the block
+      pixels. The neighbors lists are kept in compressed sparse row (CSR) form,
+      all of them in one array. A merge moves the absorbed node neighbors to
+      the absorber node, the absorber list is moved to the array end when it
+      does not fit its range anymore. The array is compacted when more than
+      half of it is made of abandoned ranges.
+
+      Optionally, a value (e.g. the dissimilarity) may be cached for each
+      node neighbor. Each node has a generation counter, incremented when the
+      node absorbs another one, and a cached value is valid only while the
+      generations of its node and neighbor are the ones it was computed with.
+    */
+    class TERADARSEGMEXPORT SegmenterRegionAdjacencyGraph
+    {
+      public:
+        /*! Node index type definition */
+        typedef unsigned int NodeIndexT;
+
+        /*!
+          \class EdgeCacheEntry
+          \brief A value cached for a node neighbor.
+        */
+        class TERADARSEGMEXPORT EdgeCacheEntry
+        {
+          public:
+            double m_value; //!< The cached value.
+
+            unsigned int m_nodeGeneration; //!< The node generation when the value was computed (0 - invalid).
+
+            unsigned int m_neighborGeneration; //!< The neighbor generation when the value was computed (0 - invalid).
+        };
+
+        SegmenterRegionAdjacencyGraph();
+
+        ~SegmenterRegionAdjacencyGraph();
+
+        /*!
+          \brief Build the graph of the block pixels, in one pass.
+          \details The neighbors of each node are listed in raster order.
+          \param idsMatrix The block segments ids, pixels with a null id have no node neighbors.
+          \param connectivity The pixels connectivity.
+          \param enableEdgesCache Enable the neighbors values cache.
+          \return true if OK, false on errors.
+        */
+        bool build( const te::rp::Matrix< unsigned int >& idsMatrix,
+          const teradar::common::PixelConnectivityType connectivity,
+          const bool enableEdgesCache = false );
+
+        /*!
+          \brief Return the number of neighbors of a node.
+          \param node The node index.
+          \return The number of neighbors.
+        */
+        inline unsigned int getNeighborsNumber( const NodeIndexT node ) const
+        {
+          return m_sizes[ node ];
+        };
+
+        /*!
+          \brief Return the neighbors of a node.
+          \param node The node index.
+          \return A pointer to the neighbors nodes, valid until the next merge.
+        */
+        inline NodeIndexT const* getNeighbors( const NodeIndexT node ) const
+        {
+          return m_neighbors.empty() ? 0 : ( &m_neighbors[0] + m_offsets[ node ] );
+        };
+
+        /*!
+          \brief Return the cache entries of a node neighbors, in the getNeighbors order.
+          \param node The node index.
+          \return A pointer to the cache entries, valid until the next merge, or null if the cache is disabled.
+        */
+        inline EdgeCacheEntry* getNeighborsCache( const NodeIndexT node )
+        {
+          return m_edgesCache.empty() ? 0 : ( &m_edgesCache[0] + m_offsets[ node ] );
+        };
+
+        /*!
+          \brief Return the generation of a node.
+          \param node The node index.
+          \return The node generation (starting at 1).
+        */
+        inline unsigned int getGeneration( const NodeIndexT node ) const
+        {
+          return m_generations[ node ];
+        };
+
+        /*!
+          \brief Merge two adjacent nodes.
+          \details The absorbed node neighbors become neighbors of the absorber
+          node, and the absorbed node is left without neighbors. The absorber
+          generation is incremented, invalidating the values cached for its edges.
+          \param absorberNode The absorber node.
+          \param absorbedNode The absorbed node.
+        */
+        void merge( const NodeIndexT absorberNode, const NodeIndexT absorbedNode );
+
+        /*!
+          \brief Release the graph memory.
+        */
+        void clear();
+
+        /*!
+          \brief Return the graph memory estimation.
+          \param nodesNumber The number of nodes (block pixels).
+          \param connectivity The pixels connectivity.
+          \param enableEdgesCache If the neighbors values cache is enabled.
+          \return The memory estimation, in bytes.
+        */
+        static double getMemUsageEstimation( const unsigned int nodesNumber,
+          const teradar::common::PixelConnectivityType connectivity,
+          const bool enableEdgesCache = false );
+
+      protected:
+        /*!
+          \brief Ensure a node neighbors range capacity, moving it to the array end if needed.
+          \param node The node index.
+          \param capacity The required capacity.
+        */
+        void reserveNeighbors( const NodeIndexT node, const unsigned int capacity );
+
+        /*!
+          \brief Remove a neighbor from a node neighbors list, if present.
+          \param node The node index.
+          \param neighbor The neighbor node index.
+          \return true if the neighbor was removed.
+        */
+        bool removeNeighbor( const NodeIndexT node, const NodeIndexT neighbor );
+
+        /*!
+          \brief Return if a node is a neighbor of another one.
+          \param node The node index.
+          \param neighbor The neighbor node index.
+          \return true if @a neighbor is in the @a node neighbors list.
+        */
+        bool hasNeighbor( const NodeIndexT node, const NodeIndexT neighbor ) const;
+
+        /*!
+          \brief Move all the neighbors ranges to a new array, without abandoned ranges.
+        */
+        void compact();
+
+      private:
+        std::vector< std::size_t > m_offsets; //!< The first neighbor position of each node.
+        std::vector< unsigned int > m_sizes; //!< The number of neighbors of each node.
+        std::vector< unsigned int > m_capacities; //!< The neighbors range capacity of each node.
+        std::vector< NodeIndexT > m_neighbors; //!< The neighbors ranges.
+        std::vector< EdgeCacheEntry > m_edgesCache; //!< The neighbors cache entries, same layout as m_neighbors (empty if disabled).
+        std::vector< unsigned int > m_generations; //!< The generation of each node.
+        std::size_t m_abandonedSize; //!< The size of the abandoned neighbors ranges.
+    };
+  } // end namespace segmenter
+} // end namespace teradar
+
+#endif // TERRARADAR_LIB_SEGM_INTERNAL_SEGMENTERREGIONADJACENCYGRAPH_HPP_
@@ -22,10 +22,18 @@ TerraRadar is under development.
 namespace teradar {
   namespace segmenter {
     SegmenterRegionGrowingWishartMerger::SegmenterRegionGrowingWishartMerger( const unsigned int featuresNumber,
-      const double& numberOfLooks )
+      const double& numberOfLooks, const bool enableAzimutalSimetry )
     {
       m_featuresNumber = featuresNumber;
+      m_covMatrixOrder = (unsigned int)( std::sqrt( (double)featuresNumber ) + 0.5 );
+
+      // only 3 x 3 (HH, HV, VV) covariance matrices may be reflection symmetric
+      m_enableAzimutalSimetry = enableAzimutalSimetry && ( m_covMatrixOrder == 3 );
+      m_segmentFeaturesSize = m_enableAzimutalSimetry ? 5 : featuresNumber;
+      m_degreesOfFreedom = m_enableAzimutalSimetry ? 5 : ( m_covMatrixOrder * m_covMatrixOrder );
+
       m_numberOfLooks = numberOfLooks;
+      m_rejectionBound = 0;
       m_getDissimilarity_noise = 1e-8;
     }
 
@@ -61,85 +69,103 @@ namespace teradar {
       assert( mergePreviewSegPtr->m_yBound > mergePreviewSegPtr->m_yStart );
 
       // fill the covariance matrix
-      unsigned int covMatrixOrder = (unsigned int)std::sqrt( m_featuresNumber );
+      const unsigned int covMatrixOrder = m_covMatrixOrder;
 
-      boost::numeric::ublas::matrix< WishartFeatureType > segment1Matrix( covMatrixOrder, covMatrixOrder );
-      boost::numeric::ublas::matrix< WishartFeatureType > segment2Matrix( covMatrixOrder, covMatrixOrder );
+      double seg1DetAbs = 0.;
+      double seg2DetAbs = 0.;
+      double segUDetAbs = 0.;
 
-      for( m_getDissimilarity_elemXIdx = 0; m_getDissimilarity_elemXIdx < covMatrixOrder; ++m_getDissimilarity_elemXIdx ) {
-        for( m_getDissimilarity_elemYIdx = 0; m_getDissimilarity_elemYIdx < covMatrixOrder; ++m_getDissimilarity_elemYIdx ) {
-          segment1Matrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) = segment1Ptr->m_features[3 * m_getDissimilarity_elemYIdx + m_getDissimilarity_elemXIdx];
-          segment2Matrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) = segment2Ptr->m_features[3 * m_getDissimilarity_elemYIdx + m_getDissimilarity_elemXIdx];
+      if( m_enableAzimutalSimetry || ( covMatrixOrder == 2 ) ) {
+        // the packed weighted mean is the merged covariance matrix
+        for( unsigned int featureIdx = 0; featureIdx < m_segmentFeaturesSize; ++featureIdx ) {
+          mergePreviewSegPtr->m_features[featureIdx] = ( ( segment1Ptr->m_features[featureIdx] * m_getDissimilarity_sizeSeg1D ) +
+            ( segment2Ptr->m_features[featureIdx] * m_getDissimilarity_sizeSeg2D ) ) / m_getDissimilarity_sizeUnionD;
         }
-      }
 
-      // Compute the union values.
-      boost::numeric::ublas::matrix< WishartFeatureType > segmentUMatrix( covMatrixOrder, covMatrixOrder );
-      boost::numeric::ublas::matrix< WishartFeatureType > segmentPUMatrix( covMatrixOrder, covMatrixOrder );
+        WishartFeatureType unionFeatures[5];
 
-      segmentPUMatrix = (segment1Matrix * m_getDissimilarity_sizeSeg1D) + (segment2Matrix * m_getDissimilarity_sizeSeg2D);
-      segmentPUMatrix /= m_getDissimilarity_sizeUnionD;
+        for( unsigned int featureIdx = 0; featureIdx < m_segmentFeaturesSize; ++featureIdx ) {
+          unionFeatures[featureIdx] = segment1Ptr->m_features[featureIdx] + segment2Ptr->m_features[featureIdx];
+        }
 
-      segmentUMatrix = segment1Matrix + segment2Matrix;
+        seg1DetAbs = std::fabs( getClosedFormDeterminant( segment1Ptr->m_features, m_getDissimilarity_noise ) );
+        seg2DetAbs = std::fabs( getClosedFormDeterminant( segment2Ptr->m_features, m_getDissimilarity_noise ) );
+        segUDetAbs = std::fabs( getClosedFormDeterminant( unionFeatures, 2 * m_getDissimilarity_noise ) );
+      } else {
+        boost::numeric::ublas::matrix< std::complex< double > > segment1Matrix( covMatrixOrder, covMatrixOrder );
+        boost::numeric::ublas::matrix< std::complex< double > > segment2Matrix( covMatrixOrder, covMatrixOrder );
 
+        unpackCovariance( segment1Ptr->m_features, segment1Matrix );
+        unpackCovariance( segment2Ptr->m_features, segment2Matrix );
 
-      // Update mergePreviewSegment
-      for( m_getDissimilarity_elemXIdx = 0; m_getDissimilarity_elemXIdx < covMatrixOrder; ++m_getDissimilarity_elemXIdx ) {
-        for( m_getDissimilarity_elemYIdx = 0; m_getDissimilarity_elemYIdx < covMatrixOrder; ++m_getDissimilarity_elemYIdx ) {
-          mergePreviewSegPtr->m_features[3 * m_getDissimilarity_elemYIdx + m_getDissimilarity_elemXIdx] =
-            segmentPUMatrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx );
-        }
-      }
+        // Compute the union values.
+        boost::numeric::ublas::matrix< std::complex< double > > segmentUMatrix( covMatrixOrder, covMatrixOrder );
+        boost::numeric::ublas::matrix< std::complex< double > > segmentPUMatrix( covMatrixOrder, covMatrixOrder );
 
-      WishartFeatureType seg1Det = 0.;
-      te::common::GetDeterminant< WishartFeatureType >( segment1Matrix, seg1Det );
+        segmentPUMatrix = (segment1Matrix * m_getDissimilarity_sizeSeg1D) + (segment2Matrix * m_getDissimilarity_sizeSeg2D);
+        segmentPUMatrix /= m_getDissimilarity_sizeUnionD;
 
-      if( std::real( seg1Det ) == 0 ) {
-        do {
-          for( m_getDissimilarity_elemXIdx = 0; m_getDissimilarity_elemXIdx < covMatrixOrder; ++m_getDissimilarity_elemXIdx ) {
-            for( m_getDissimilarity_elemYIdx = 0; m_getDissimilarity_elemYIdx < covMatrixOrder; ++m_getDissimilarity_elemYIdx ) {
-              segment1Matrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) =
-                segment1Matrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) + m_getDissimilarity_noise;
+        segmentUMatrix = segment1Matrix + segment2Matrix;
+
+
+        // Update mergePreviewSegment
+        packCovariance( segmentPUMatrix, mergePreviewSegPtr->m_features );
+
+        std::complex< double > seg1Det = 0.;
+        te::common::GetDeterminant< std::complex< double > >( segment1Matrix, seg1Det );
+
+        if( std::real( seg1Det ) == 0 ) {
+          do {
+            for( m_getDissimilarity_elemXIdx = 0; m_getDissimilarity_elemXIdx < covMatrixOrder; ++m_getDissimilarity_elemXIdx ) {
+              for( m_getDissimilarity_elemYIdx = 0; m_getDissimilarity_elemYIdx < covMatrixOrder; ++m_getDissimilarity_elemYIdx ) {
+                segment1Matrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) =
+                  segment1Matrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) + m_getDissimilarity_noise;
+              }
             }
-          }
 
-          te::common::GetDeterminant< WishartFeatureType >( segment1Matrix, seg1Det );
+            te::common::GetDeterminant< std::complex< double > >( segment1Matrix, seg1Det );
 
-        } while( std::real( seg1Det ) == 0 );
-      }
+          } while( std::real( seg1Det ) == 0 );
+        }
 
-      WishartFeatureType seg2Det = 0.;
-      te::common::GetDeterminant< WishartFeatureType >( segment2Matrix, seg2Det );
+        std::complex< double > seg2Det = 0.;
+        te::common::GetDeterminant< std::complex< double > >( segment2Matrix, seg2Det );
 
-      if( std::real( seg2Det ) == 0 ) {
-        do {
-          for( m_getDissimilarity_elemXIdx = 0; m_getDissimilarity_elemXIdx < covMatrixOrder; ++m_getDissimilarity_elemXIdx ) {
-            for( m_getDissimilarity_elemYIdx = 0; m_getDissimilarity_elemYIdx < covMatrixOrder; ++m_getDissimilarity_elemYIdx ) {
-              segment2Matrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) =
-                segment2Matrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) + m_getDissimilarity_noise;
+        if( std::real( seg2Det ) == 0 ) {
+          do {
+            for( m_getDissimilarity_elemXIdx = 0; m_getDissimilarity_elemXIdx < covMatrixOrder; ++m_getDissimilarity_elemXIdx ) {
+              for( m_getDissimilarity_elemYIdx = 0; m_getDissimilarity_elemYIdx < covMatrixOrder; ++m_getDissimilarity_elemYIdx ) {
+                segment2Matrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) =
+                  segment2Matrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) + m_getDissimilarity_noise;
+              }
             }
-          }
 
-          te::common::GetDeterminant< WishartFeatureType >( segment2Matrix, seg2Det );
+            te::common::GetDeterminant< std::complex< double > >( segment2Matrix, seg2Det );
 
-        } while( std::real( seg2Det ) == 0 );
-      }
+          } while( std::real( seg2Det ) == 0 );
+        }
 
-      WishartFeatureType segUDet = 0.;
-      te::common::GetDeterminant< WishartFeatureType >( segmentUMatrix, segUDet );
+        std::complex< double > segUDet = 0.;
+        te::common::GetDeterminant< std::complex< double > >( segmentUMatrix, segUDet );
 
-      if( std::real( segUDet ) == 0 ) {
-        do {
-          for( m_getDissimilarity_elemXIdx = 0; m_getDissimilarity_elemXIdx < covMatrixOrder; ++m_getDissimilarity_elemXIdx ) {
-            for( m_getDissimilarity_elemYIdx = 0; m_getDissimilarity_elemYIdx < covMatrixOrder; ++m_getDissimilarity_elemYIdx ) {
-              segmentUMatrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) =
-                segmentUMatrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) + 2 * m_getDissimilarity_noise;
+        if( std::real( segUDet ) == 0 ) {
+          do {
+            for( m_getDissimilarity_elemXIdx = 0; m_getDissimilarity_elemXIdx < covMatrixOrder; ++m_getDissimilarity_elemXIdx ) {
+              for( m_getDissimilarity_elemYIdx = 0; m_getDissimilarity_elemYIdx < covMatrixOrder; ++m_getDissimilarity_elemYIdx ) {
+                segmentUMatrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) =
+                  segmentUMatrix( m_getDissimilarity_elemXIdx, m_getDissimilarity_elemYIdx ) + 2 * m_getDissimilarity_noise;
+              }
             }
-          }
 
-          te::common::GetDeterminant< WishartFeatureType >( segmentUMatrix, segUDet );
+            te::common::GetDeterminant< std::complex< double > >( segmentUMatrix, segUDet );
+
+          } while( std::real( segUDet ) == 0 );
+        }
 
-        } while( std::real( segUDet ) == 0 );
+        // Get the real part of complex determinants.
+        seg1DetAbs = std::fabs( std::real( seg1Det ) );
+        seg2DetAbs = std::fabs( std::real( seg2Det ) );
+        segUDetAbs = std::fabs( std::real( segUDet ) );
       }
 
       // This values are defined according to Saldanha, 2014 - Um segmentador multinivel para imagens SAR polarimetricas baseado na distribuicao Wishart, pp. 21-23
@@ -147,18 +173,26 @@ namespace teradar {
       te::rp::DissimilarityTypeT n2 = m_getDissimilarity_sizeSeg2D * m_numberOfLooks;
       te::rp::DissimilarityTypeT nu = n1 + n2;
 
-      // Get the real part of complex determinants.
-      double seg1DetAbs = std::fabs( std::real( seg1Det ) );
-      double seg2DetAbs = std::fabs( std::real( seg2Det ) );
-      double segUDetAbs = std::fabs( std::real( segUDet ) );
-
-      te::rp::DissimilarityTypeT f = pow( covMatrixOrder, 2 ); // degree of freedom
-      te::rp::DissimilarityTypeT ro = 1. - ((2. * f - 1.) / (6. * covMatrixOrder)) * ((1. / n1) + (1. / n2) - (1. / nu));
-      te::rp::DissimilarityTypeT w2 = (-f / 4.) * pow( (1. - (1. / ro)), 2 ) + ((f * (f - 1.)) / 24.) * ((1. / pow( n2, 2 )) + (1. / pow( n1, 2 )) - (1. / pow( nu, 2 ))) * (1. / pow( ro, 2 ));
+      // The ro and w2 corrections are the ones of the unstructured p x p
+      // matrices, with p^2 parameters, even with azimutal simetry (no
+      // structured corrections are implemented). The azimutal simetry model
+      // only changes the chi-square degrees of freedom
+      te::rp::DissimilarityTypeT p2 = covMatrixOrder * covMatrixOrder; // unstructured model parameters
+      te::rp::DissimilarityTypeT f = m_degreesOfFreedom; // degree of freedom
+      te::rp::DissimilarityTypeT ro = 1. - ((2. * p2 - 1.) / (6. * covMatrixOrder)) * ((1. / n1) + (1. / n2) - (1. / nu));
+      te::rp::DissimilarityTypeT w2 = (-p2 / 4.) * pow( (1. - (1. / ro)), 2 ) + ((p2 * (p2 - 1.)) / 24.) * ((1. / pow( n2, 2 )) + (1. / pow( n1, 2 )) - (1. / pow( nu, 2 ))) * (1. / pow( ro, 2 ));
       te::rp::DissimilarityTypeT q1 = (covMatrixOrder * nu * log( nu )) - ((covMatrixOrder * n2 * log( n2 )) + (covMatrixOrder * n1 * log( n1 )));
       te::rp::DissimilarityTypeT Q = q1 + (n2 * log( seg1DetAbs )) + (n1 * log( seg2DetAbs )) - (nu * log( segUDetAbs ));
       te::rp::DissimilarityTypeT L = -2. * ro * Q;
 
+      // With 0 <= w2 <= 1 the dissimilarity is between both probabilities, and
+      // the f + 4 degrees of freedom one is the lower, so it is enough to know
+      // that one is above the rejection threshold
+      if( ( m_rejectionBound > 0 ) && ( L > m_rejectionBound ) && ( w2 >= 0 ) && ( w2 <= 1 ) ) {
+        m_getDissimilarity_dissValue = getRejectedDissimilarity();
+        return m_getDissimilarity_dissValue;
+      }
+
       te::rp::DissimilarityTypeT seg1Prob = 0.;
       te::rp::DissimilarityTypeT seg2Prob = 0.;
 
@@ -176,6 +210,49 @@ namespace teradar {
       return m_getDissimilarity_dissValue;
     }
 
+    double SegmenterRegionGrowingWishartMerger::getRejectionBound( const te::rp::DissimilarityTypeT threshold ) const
+    {
+      if( ( threshold <= 0 ) || ( threshold >= 1 ) ) {
+        return 0;
+      }
+
+      const double f = m_degreesOfFreedom; // degree of freedom
+
+      boost::math::chi_squared_distribution< te::rp::DissimilarityTypeT > seg2Distr( f + 4 );
+
+      return quantile( seg2Distr, threshold );
+    }
+
+    void SegmenterRegionGrowingWishartMerger::getMergePreview( te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > const * const segment1Ptr,
+      te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > const * const segment2Ptr,
+      te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > * const mergePreviewSegPtr ) const
+    {
+      assert( segment1Ptr );
+      assert( segment1Ptr->m_features );
+      assert( segment2Ptr );
+      assert( segment2Ptr->m_features );
+      assert( mergePreviewSegPtr );
+
+      const double sizeSeg1D = segment1Ptr->m_size;
+      const double sizeSeg2D = segment2Ptr->m_size;
+      const double sizeUnionD = sizeSeg1D + sizeSeg2D;
+
+      TERP_DEBUG_TRUE_OR_THROW( sizeUnionD != 0., "Internal error" );
+      mergePreviewSegPtr->m_size = (unsigned int)sizeUnionD;
+
+      mergePreviewSegPtr->m_xStart = std::min( segment1Ptr->m_xStart, segment2Ptr->m_xStart );
+      mergePreviewSegPtr->m_yStart = std::min( segment1Ptr->m_yStart, segment2Ptr->m_yStart );
+      mergePreviewSegPtr->m_xBound = std::max( segment1Ptr->m_xBound, segment2Ptr->m_xBound );
+      mergePreviewSegPtr->m_yBound = std::max( segment1Ptr->m_yBound, segment2Ptr->m_yBound );
+
+      // the packing is linear, the packed weighted mean is the packed
+      // weighted mean covariance matrix computed by getDissimilarity
+      for( unsigned int featureIdx = 0; featureIdx < m_segmentFeaturesSize; ++featureIdx ) {
+        mergePreviewSegPtr->m_features[featureIdx] = ( ( segment1Ptr->m_features[featureIdx] * sizeSeg1D ) +
+          ( segment2Ptr->m_features[featureIdx] * sizeSeg2D ) ) / sizeUnionD;
+      }
+    }
+
     void SegmenterRegionGrowingWishartMerger::mergeFeatures( te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > * const segment1Ptr,
       te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > const * const segment2Ptr,
       te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > const * const mergePreviewSegPtr ) const
@@ -202,5 +279,112 @@ namespace teradar {
     {
     }
 
+    void SegmenterRegionGrowingWishartMerger::packCovariance( std::complex< double > const* elements,
+      const std::size_t elementsStride, WishartFeatureType* features ) const
+    {
+      unsigned int row = 0;
+      unsigned int col = 0;
+      WishartFeatureType* upperPtr = features + m_covMatrixOrder;
+
+      if( m_enableAzimutalSimetry ) {
+        // |HH|^2, |HV|^2, |VV|^2 and HH.VV*, the co-/cross-pol correlations are null
+        features[0] = std::real( elements[0] );
+        features[1] = std::real( elements[4 * elementsStride] );
+        features[2] = std::real( elements[8 * elementsStride] );
+        features[3] = std::real( elements[6 * elementsStride] );
+        features[4] = std::imag( elements[6 * elementsStride] );
+        return;
+      }
+
+      for( row = 0; row < m_covMatrixOrder; ++row ) {
+        features[row] = std::real( elements[( row * m_covMatrixOrder + row ) * elementsStride] );
+
+        for( col = row + 1; col < m_covMatrixOrder; ++col ) {
+          const std::complex< double >& element = elements[( col * m_covMatrixOrder + row ) * elementsStride];
+          *(upperPtr++) = std::real( element );
+          *(upperPtr++) = std::imag( element );
+        }
+      }
+    }
+
+    double SegmenterRegionGrowingWishartMerger::getClosedFormDeterminant(
+      WishartFeatureType const* features, const double noise ) const
+    {
+      if( m_covMatrixOrder == 2 ) {
+        // | C11  C12 |
+        // | C12* C22 |  ->  det = C11 * C22 - |C12|^2
+        double c11 = features[0];
+        double c22 = features[1];
+        const double c12SquaredNorm = ( features[2] * features[2] ) + ( features[3] * features[3] );
+
+        double det = ( c11 * c22 ) - c12SquaredNorm;
+
+        while( det == 0 ) {
+          c11 += noise;
+          c22 += noise;
+
+          det = ( c11 * c22 ) - c12SquaredNorm;
+        }
+
+        return det;
+      }
+
+      // | C11  0   C13 |
+      // |  0  C22   0  |  ->  det = C22 * ( C11 * C33 - |C13|^2 )
+      // | C13* 0   C33 |
+      double c11 = features[0];
+      double c22 = features[1];
+      double c33 = features[2];
+      const double c13SquaredNorm = ( features[3] * features[3] ) + ( features[4] * features[4] );
+
+      double det = c22 * ( ( c11 * c33 ) - c13SquaredNorm );
+
+      while( det == 0 ) {
+        c11 += noise;
+        c22 += noise;
+        c33 += noise;
+
+        det = c22 * ( ( c11 * c33 ) - c13SquaredNorm );
+      }
+
+      return det;
+    }
+
+    void SegmenterRegionGrowingWishartMerger::unpackCovariance( WishartFeatureType const* features,
+      boost::numeric::ublas::matrix< std::complex< double > >& matrix ) const
+    {
+      unsigned int row = 0;
+      unsigned int col = 0;
+      WishartFeatureType const* upperPtr = features + m_covMatrixOrder;
+
+      for( row = 0; row < m_covMatrixOrder; ++row ) {
+        matrix( row, row ) = std::complex< double >( features[row], 0.0 );
+
+        for( col = row + 1; col < m_covMatrixOrder; ++col ) {
+          matrix( row, col ) = std::complex< double >( upperPtr[0], upperPtr[1] );
+          matrix( col, row ) = std::conj( matrix( row, col ) );
+          upperPtr += 2;
+        }
+      }
+    }
+
+    void SegmenterRegionGrowingWishartMerger::packCovariance(
+      const boost::numeric::ublas::matrix< std::complex< double > >& matrix,
+      WishartFeatureType* features ) const
+    {
+      unsigned int row = 0;
+      unsigned int col = 0;
+      WishartFeatureType* upperPtr = features + m_covMatrixOrder;
+
+      for( row = 0; row < m_covMatrixOrder; ++row ) {
+        features[row] = std::real( matrix( row, row ) );
+
+        for( col = row + 1; col < m_covMatrixOrder; ++col ) {
+          *(upperPtr++) = std::real( matrix( row, col ) );
+          *(upperPtr++) = std::imag( matrix( row, col ) );
+        }
+      }
+    }
+
   } // end namespace segmenter
 } // end namespace teradar
\ No newline at end of file
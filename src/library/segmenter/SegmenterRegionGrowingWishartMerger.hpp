@@ -20,15 +20,34 @@ TerraRadar is under development.
 #include <terralib/rp/SegmenterRegionGrowingFunctions.h>
 #include <terralib/rp/SegmenterRegionGrowingMerger.h>
 
+// Boost includes
+#include <boost/numeric/ublas/matrix.hpp>
+
 #include <complex>
+#include <cstddef>
+#include <limits>
 
 namespace teradar {
   namespace segmenter {
-    typedef std::complex<double> WishartFeatureType;
+    /*! Segment feature type, an element of the Hermitian-packed covariance matrix */
+    typedef double WishartFeatureType;
 
     /*!
       \class SegmenterRegionGrowingWishartMerger
       \brief Segments merger based on Wishart method.
+
+      \details The segments covariance matrices are Hermitian, so they are
+      kept packed: the n real diagonal elements, followed by the real and
+      imaginary parts of the n(n-1)/2 upper triangle elements in row order.
+      A n x n matrix takes n^2 doubles instead of n^2 complex values.
+
+      With azimutal (reflection) simetry, the co-/cross-pol correlations of a
+      3 x 3 (HH, HV, VV) covariance matrix are null, and only 5 values are kept:
+      |HH|^2, |HV|^2, |VV|^2 and the real and imaginary parts of HH.VV*. The
+      determinants of this block-diagonal structure are computed in closed form.
+
+      Dual-pol (e.g. HH, HV or VV, VH) 2 x 2 covariance matrices keep 4 values,
+      and their determinants are computed in closed form too.
       */
     class TERADARSEGMEXPORT SegmenterRegionGrowingWishartMerger : 
       public te::rp::SegmenterRegionGrowingMerger< WishartFeatureType >
@@ -36,11 +55,12 @@ namespace teradar {
       public:
         /*!
           \brief Constructor.
-          \param featuresNumber Number of features (elements in the covariance matrix).
+          \param featuresNumber Number of features (elements in the covariance matrix, also the packed features size).
           \param numberOfLooks Number of looks.
+          \param enableAzimutalSimetry Enable the azimutal simetry model (only for 3 x 3 covariance matrices).
         */
         SegmenterRegionGrowingWishartMerger( const unsigned int featuresNumber,
-          const double& numberOfLooks );
+          const double& numberOfLooks, const bool enableAzimutalSimetry = false );
 
         /*!
           \brief Destructor.
@@ -53,6 +73,19 @@ namespace teradar {
           te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > const * const segment2Ptr,
           te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > * const mergePreviewSegPtr ) const;
 
+        /*!
+          \brief Compute the merge preview of two segments, without the dissimilarity.
+          \details The preview is the same one filled by getDissimilarity, but
+          the determinants and chi-square evaluations are skipped. Used when the
+          dissimilarity of the pair is already known.
+          \param segment1Ptr The first segment.
+          \param segment2Ptr The second segment.
+          \param mergePreviewSegPtr The merge preview segment (output).
+        */
+        void getMergePreview( te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > const * const segment1Ptr,
+          te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > const * const segment2Ptr,
+          te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > * const mergePreviewSegPtr ) const;
+
         //overload                
         void mergeFeatures( te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > * const segment1Ptr,
           te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > const * const segment2Ptr,
@@ -63,12 +96,89 @@ namespace teradar {
 
         //overload
         inline unsigned int getSegmentFeaturesSize() const {
+          return m_segmentFeaturesSize;
+        };
+
+        /*!
+          \brief Return the number of elements in the covariance matrix (the number of input bands).
+          \return The number of elements in the covariance matrix.
+        */
+        inline unsigned int getCovarianceElementsNumber() const {
           return m_featuresNumber;
         };
 
+        /*!
+          \brief Return the likelihood-ratio statistic bound of a dissimilarity threshold.
+          \details The chi-square quantile of the threshold with f + 4 degrees of
+          freedom, above it the pair dissimilarity is higher than the threshold
+          whenever the second order correction weight is in [0, 1].
+          \param threshold The dissimilarity threshold (a probability).
+          \return The statistic bound, or 0 if the threshold is not in ]0, 1[.
+        */
+        double getRejectionBound( const te::rp::DissimilarityTypeT threshold ) const;
+
+        /*!
+          \brief Set the likelihood-ratio statistic bound above which pairs are rejected.
+          \details The rejected pairs get getRejectedDissimilarity instead of
+          their dissimilarity, skipping the chi-square evaluations.
+          \param rejectionBound The bound, from getRejectionBound (0 - disabled, the default).
+        */
+        inline void setRejectionBound( const double rejectionBound ) {
+          m_rejectionBound = rejectionBound;
+        };
+
+        /*!
+          \brief Return the dissimilarity of the rejected pairs, higher than any computed dissimilarity.
+          \return The rejected pairs dissimilarity.
+        */
+        inline static te::rp::DissimilarityTypeT getRejectedDissimilarity() {
+          return std::numeric_limits< te::rp::DissimilarityTypeT >::max();
+        };
+
+        /*!
+          \brief Pack a covariance matrix into segment features.
+          \param elements The covariance matrix elements, the element (row, column)
+          is elements[ ( column * order + row ) * elementsStride ] (the input bands order).
+          \param elementsStride The distance between consecutive elements.
+          \param features The packed features (output).
+          \note With azimutal simetry, the co-/cross-pol correlations are ignored.
+        */
+        void packCovariance( std::complex< double > const* elements,
+          const std::size_t elementsStride, WishartFeatureType* features ) const;
+
       protected:
+        /*!
+          \brief Return the determinant of a 2 x 2 or azimutal simetry covariance matrix.
+          \param features The packed features.
+          \param noise The noise added to the diagonal elements while the determinant is null.
+          \return The determinant.
+        */
+        double getClosedFormDeterminant( WishartFeatureType const* features,
+          const double noise ) const;
+
+        /*!
+          \brief Unpack segment features into a full covariance matrix.
+          \param features The packed features.
+          \param matrix The covariance matrix (output), already sized.
+        */
+        void unpackCovariance( WishartFeatureType const* features,
+          boost::numeric::ublas::matrix< std::complex< double > >& matrix ) const;
+
+        /*!
+          \brief Pack a full covariance matrix into segment features.
+          \param matrix The covariance matrix, only its diagonal and upper triangle are used.
+          \param features The packed features (output).
+        */
+        void packCovariance( const boost::numeric::ublas::matrix< std::complex< double > >& matrix,
+          WishartFeatureType* features ) const;
+
         unsigned int m_featuresNumber; //!< The number of elements in the covariance matrix.
+        unsigned int m_covMatrixOrder; //!< The covariance matrix order.
+        unsigned int m_segmentFeaturesSize; //!< The packed features size.
+        unsigned int m_degreesOfFreedom; //!< The chi-square degrees of freedom, the number of real parameters of the covariance model.
+        bool m_enableAzimutalSimetry; //!< If the azimutal simetry model is used.
         double m_numberOfLooks; //!< Number of looks.
+        double m_rejectionBound; //!< The likelihood-ratio statistic bound above which pairs are rejected (0 - disabled).
 
         // variables used by the method getDissimilarity
         mutable te::rp::DissimilarityTypeT m_getDissimilarity_dissValue;
@@ -12,13 +12,126 @@ TerraRadar is under development.
 
 #include "SegmenterRegionGrowingWishartStrategy.hpp"
 #include "SegmenterRegionGrowingWishartMerger.hpp"
+#include "../common/Functions.hpp"
 
 #include <terralib/common/progress/TaskProgress.h>
 
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
 namespace
 {
   static teradar::segmenter::SegmenterRegionGrowingWishartStrategyFactory
     segmenterRegionGrowingWishartStrategyFactoryInstance;
+
+  // no best neighbor mark, in the merging rounds
+  const teradar::segmenter::SegmenterRegionAdjacencyGraph::NodeIndexT NoBestNeighbor =
+    std::numeric_limits< teradar::segmenter::SegmenterRegionAdjacencyGraph::NodeIndexT >::max();
+
+  /*!
+    \brief Run a job on an engine worker, shifting the worker index by one
+    (the index 0 is run by the calling thread).
+    \param job The job, called with the shifted index.
+    \param workerIndex The engine worker index.
+  */
+  void RunShiftedWorkerJob( const teradar::segmenter::SegmenterEngine::JobT& job,
+    const unsigned int workerIndex )
+  {
+    job( workerIndex + 1 );
+  }
+
+  /*!
+    \brief Merger of the blocks borders segments statistics by the Wishart test.
+  */
+  class WishartStatisticsMerger :
+    public teradar::segmenter::SegmenterBorderStatisticsProvider::StatisticsMerger
+  {
+    public:
+      typedef teradar::segmenter::SegmenterBorderStatisticsProvider::SegmentStatistics Statistics;
+
+      typedef te::rp::SegmenterRegionGrowingSegment< teradar::segmenter::WishartFeatureType > SegmentT;
+
+      /*!
+        \brief Constructor.
+        \param featuresNumber The number of covariance matrix elements (input bands).
+        \param numberOfLooks The segmented raster number of looks.
+        \param enableAzimutalSimetry Enable the azimutal simetry model.
+        \param maxDissimilarity Pairs with higher dissimilarity are not merged.
+      */
+      WishartStatisticsMerger( const unsigned int featuresNumber, const double& numberOfLooks,
+        const bool enableAzimutalSimetry, const double& maxDissimilarity )
+        : m_merger( featuresNumber, numberOfLooks, enableAzimutalSimetry ),
+        m_maxDissimilarity( maxDissimilarity ),
+        m_segment1Features( m_merger.getSegmentFeaturesSize() ),
+        m_segment2Features( m_merger.getSegmentFeaturesSize() ),
+        m_previewFeatures( m_merger.getSegmentFeaturesSize() ) {
+        m_previewSegment.m_features = &m_previewFeatures[0];
+      }
+
+      //overload
+      bool shouldMerge( const Statistics& statistics1, const Statistics& statistics2 ) {
+        setSegment( statistics1, m_segment1Features, m_segment1 );
+        setSegment( statistics2, m_segment2Features, m_segment2 );
+
+        return ( m_merger.getDissimilarity( &m_segment1, &m_segment2, &m_previewSegment ) <=
+          m_maxDissimilarity );
+      }
+
+      //overload
+      void merge( Statistics& statistics1, const Statistics& statistics2 ) {
+        setSegment( statistics1, m_segment1Features, m_segment1 );
+        setSegment( statistics2, m_segment2Features, m_segment2 );
+
+        m_merger.getMergePreview( &m_segment1, &m_segment2, &m_previewSegment );
+
+        statistics1.m_size = m_previewSegment.m_size;
+        statistics1.m_xStart = m_previewSegment.m_xStart;
+        statistics1.m_yStart = m_previewSegment.m_yStart;
+        statistics1.m_xBound = m_previewSegment.m_xBound;
+        statistics1.m_yBound = m_previewSegment.m_yBound;
+        statistics1.m_features.assign( m_previewFeatures.begin(), m_previewFeatures.end() );
+      }
+
+    private:
+      /*!
+        \brief Fill a segment from its statistics.
+        \param statistics The segment statistics.
+        \param features The segment features buffer.
+        \param segment The segment.
+      */
+      static void setSegment( const Statistics& statistics,
+        std::vector< teradar::segmenter::WishartFeatureType >& features, SegmentT& segment ) {
+        std::copy( statistics.m_features.begin(), statistics.m_features.end(), features.begin() );
+
+        segment.m_size = statistics.m_size;
+        segment.m_xStart = statistics.m_xStart;
+        segment.m_yStart = statistics.m_yStart;
+        segment.m_xBound = statistics.m_xBound;
+        segment.m_yBound = statistics.m_yBound;
+        segment.m_features = &features[0];
+      }
+
+      teradar::segmenter::SegmenterRegionGrowingWishartMerger m_merger; //!< The Wishart test merger.
+
+      double m_maxDissimilarity; //!< Pairs with higher dissimilarity are not merged.
+
+      std::vector< teradar::segmenter::WishartFeatureType > m_segment1Features; //!< First segment features buffer.
+
+      std::vector< teradar::segmenter::WishartFeatureType > m_segment2Features; //!< Second segment features buffer.
+
+      std::vector< teradar::segmenter::WishartFeatureType > m_previewFeatures; //!< Merge preview features buffer.
+
+      SegmentT m_segment1; //!< First segment.
+
+      SegmentT m_segment2; //!< Second segment.
+
+      SegmentT m_previewSegment; //!< Merge preview segment.
+  };
 }
 
 namespace teradar {
@@ -49,6 +162,8 @@ namespace teradar {
         m_regionGrowingConfLevel = params.m_regionGrowingConfLevel;
         m_regionMergingLimit = params.m_regionMergingLimit;
         m_regionMergingConfLevel = params.m_regionMergingConfLevel;
+        m_mergingThreadsNumber = params.m_mergingThreadsNumber;
+        m_enableDissimilarityCache = params.m_enableDissimilarityCache;
         
         /*
         m_segmentsSimilarityThreshold = params.m_segmentsSimilarityThreshold;
@@ -67,12 +182,14 @@ namespace teradar {
         m_dataType = teradar::common::CovarianceMatrixT;
         m_enableAzimutalSimetry = false;
         m_enlLZero = 1.583;
-        m_compressionLevel = 1;
+        m_compressionLevel = 0;
         m_connectivityType = teradar::common::VonNeumannNT;
         m_regionGrowingLimit = 15;
         m_regionGrowingConfLevel = 99.9;
         m_regionMergingLimit = 1;
         m_regionMergingConfLevel = 99.9;
+        m_mergingThreadsNumber = 1;
+        m_enableDissimilarityCache = true;
 
         /*
         m_segmentsSimilarityThreshold = 0.05;
@@ -91,6 +208,17 @@ namespace teradar {
       SegmenterRegionGrowingWishartStrategy::SegmenterRegionGrowingWishartStrategy()
       {
         m_isInitialized = false;
+        m_lastActSegsListHeadPtr = 0;
+        m_lastBlockStartX = 0;
+        m_lastBlockStartY = 0;
+        m_lastFeaturesNumber = 0;
+        m_rejectionBound = 0;
+        m_rejectionBoundFeaturesNumber = 0;
+        m_segmentsPoolCapacity = 0;
+        m_segmentsPoolFeaturesSize = 0;
+        m_abortFlagPtr = 0;
+        m_maxThreadsNumber = 0;
+        m_mergeCandidatesCompactionSize = 0;
       }
 
       SegmenterRegionGrowingWishartStrategy::~SegmenterRegionGrowingWishartStrategy()
@@ -101,8 +229,16 @@ namespace teradar {
       bool SegmenterRegionGrowingWishartStrategy::initialize( te::rp::SegmenterStrategyParameters const* const strategyParams )
         throw(te::rp::Exception)
       {
+        // the segments pool and IDs matrix memory is kept, so a long-lived
+        // instance re-initialized for each job does not allocate it again
         m_isInitialized = false;
-        reset();
+        m_lastActSegsListHeadPtr = 0;
+        m_lastBlockStartX = 0;
+        m_lastBlockStartY = 0;
+        m_lastFeaturesNumber = 0;
+        m_rejectionBound = 0;
+        m_rejectionBoundFeaturesNumber = 0;
+        m_parameters.reset();
 
         SegmenterRegionGrowingWishartStrategy::Parameters const* paramsPtr =
           dynamic_cast<SegmenterRegionGrowingWishartStrategy::Parameters const*>(strategyParams);
@@ -116,7 +252,7 @@ namespace teradar {
           TERP_TRUE_OR_RETURN_FALSE( m_parameters.m_enlLZero > 1,
             "Invalid segmenter strategy parameter m_enlLZero" );
 
-          TERP_TRUE_OR_RETURN_FALSE( m_parameters.m_compressionLevel > 0,
+          TERP_TRUE_OR_RETURN_FALSE( m_parameters.m_compressionLevel >= 0,
             "Invalid segmenter strategy parameter m_compressionLevel" );
 
           TERP_TRUE_OR_RETURN_FALSE( m_parameters.m_regionGrowingConfLevel > 0,
@@ -137,6 +273,9 @@ namespace teradar {
           TERP_TRUE_OR_RETURN_FALSE( m_parameters.m_regionMergingLimit > 0,
             "Invalid segmenter strategy parameter m_regionMergingLimit" );
 
+          TERP_TRUE_OR_RETURN_FALSE( m_parameters.m_mergingThreadsNumber > 0,
+            "Invalid segmenter strategy parameter m_mergingThreadsNumber" );
+
           /*
           TERP_TRUE_OR_RETURN_FALSE( m_parameters.m_segmentsSimilarityThreshold >= 0.0 ,
             "Invalid segmenter strategy parameter m_segmentsSimilarityThreshold" )
@@ -153,8 +292,32 @@ namespace teradar {
       void SegmenterRegionGrowingWishartStrategy::reset()
       {
         m_isInitialized = false;
+        m_lastActSegsListHeadPtr = 0;
+        m_lastBlockStartX = 0;
+        m_lastBlockStartY = 0;
+        m_lastFeaturesNumber = 0;
+        m_rejectionBound = 0;
+        m_rejectionBoundFeaturesNumber = 0;
         m_segmentsPool.clear();
+        m_segmentsPoolCapacity = 0;
+        m_segmentsPoolFeaturesSize = 0;
         m_segmentsIdsMatrix.reset();
+        m_labelsParents.clear();
+        m_blockBandsValues.clear();
+        m_pixelsSegments.clear();
+        m_adjacencyGraph.clear();
+        m_roundsMergers.clear();
+        m_roundsPreviewSegments.reset();
+        m_roundsPreviewFeatures.clear();
+        m_roundSegments.clear();
+        m_roundBestNeighbors.clear();
+        m_roundPairs.clear();
+        m_mergingEnginePtr.reset();
+        m_mergingEngineCpus.clear();
+        m_abortFlagPtr = 0;
+        m_maxThreadsNumber = 0;
+        m_mergeCandidates.clear();
+        m_mergeCandidatesCompactionSize = 0;
         m_parameters.reset();
       }
 
@@ -173,19 +336,57 @@ namespace teradar {
       {
         TERP_TRUE_OR_RETURN_FALSE( m_isInitialized, "Instance not initialized" );
 
+        m_lastActSegsListHeadPtr = 0;
+
         unsigned int featuresNumber = (unsigned int)inputRasterBands.size();
 
+        TERP_TRUE_OR_RETURN_FALSE( ( !m_parameters.m_enableAzimutalSimetry ) || ( featuresNumber == 9 ),
+          "Azimutal simetry requires a 3x3 covariance matrix" );
+
+        // The input raster is the image compressed m_compressionLevel times,
+        // its ENL is higher than the ENL of the no compressed image
+        const double levelENL = teradar::common::ComputeCompressionLevelENL(
+          (unsigned int)m_parameters.m_compressionLevel, m_parameters.m_enlLZero );
+
         // Creating the merger instance
         std::auto_ptr< SegmenterRegionGrowingWishartMerger >
-          mergerPtr( new SegmenterRegionGrowingWishartMerger( featuresNumber, m_parameters.m_enlLZero ) );
+          mergerPtr( new SegmenterRegionGrowingWishartMerger( featuresNumber, levelENL,
+            m_parameters.m_enableAzimutalSimetry ) );
+
+        // Pairs above the highest confidence level are never merged before
+        // the minimum segment size step, they are rejected by their
+        // likelihood-ratio statistic. The bound only depends on the parameters
+        // and on the degrees of freedom, it is computed once.
+        if( featuresNumber != m_rejectionBoundFeaturesNumber ) {
+          m_rejectionBound = mergerPtr->getRejectionBound( std::max(
+            m_parameters.m_regionGrowingConfLevel, m_parameters.m_regionMergingConfLevel ) / 100.0 );
+          m_rejectionBoundFeaturesNumber = featuresNumber;
+        }
+
+        mergerPtr->setRejectionBound( m_rejectionBound );
 
         // Initiating the segments pool
         const unsigned int segmentFeaturesSize = mergerPtr->getSegmentFeaturesSize();
         
-        // The number of segments plus 3 (due 3 auxiliary segments
-        TERP_TRUE_OR_RETURN_FALSE( m_segmentsPool.initialize( 3 + (
-          block2ProcessInfo.m_height * block2ProcessInfo.m_width),
-          segmentFeaturesSize ), "Segments pool initiation error" );
+        // The number of segments plus 3 (due 3 auxiliary segments), the
+        // previous pool is reused when large enough (all used segments are
+        // fully re-initialized)
+        const unsigned int requiredPoolSegments = 3 + (
+          block2ProcessInfo.m_height * block2ProcessInfo.m_width);
+
+        if( ( requiredPoolSegments > m_segmentsPoolCapacity ) ||
+          ( segmentFeaturesSize != m_segmentsPoolFeaturesSize ) ) {
+          m_segmentsPoolCapacity = 0;
+          m_segmentsPoolFeaturesSize = 0;
+
+          TERP_TRUE_OR_RETURN_FALSE( m_segmentsPool.initialize( requiredPoolSegments,
+            segmentFeaturesSize ), "Segments pool initiation error" );
+
+          m_segmentsPoolCapacity = requiredPoolSegments;
+          m_segmentsPoolFeaturesSize = segmentFeaturesSize;
+        } else {
+          m_segmentsPool.resetUseCounter();
+        }
 
         //       {
         //         // checking alignment        
@@ -231,8 +432,9 @@ namespace teradar {
         // Initializing segments
         te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* actSegsListHeadPtr = 0;
 
-        TERP_TRUE_OR_RETURN_FALSE( initializeSegments( segmenterIdsManager,
-          block2ProcessInfo, inputRaster, inputRasterBands, &actSegsListHeadPtr ),
+        m_labelsParents.resize( block2ProcessInfo.m_height * block2ProcessInfo.m_width );
+
+        TERP_TRUE_OR_RETURN_FALSE( initializeSegments( *mergerPtr, block2ProcessInfo, inputRaster, inputRasterBands, &actSegsListHeadPtr ),
           "Segments initalization error" );
 
         TERP_TRUE_OR_RETURN_FALSE( actSegsListHeadPtr != 0, "Invalid active segments list header" );
@@ -243,10 +445,8 @@ namespace teradar {
         if( enableProgressInterface )
         {
           progressPtr.reset( new te::common::TaskProgress );
-          // @todo - etore - complete
-          /*
-          progressPtr->setTotalSteps( 2 + m_parameters.m_segmentsSimIncreaseSteps );
-          */
+          progressPtr->setTotalSteps( 2 + m_parameters.m_regionGrowingLimit +
+            m_parameters.m_regionMergingLimit );
           progressPtr->setMessage( "Segmentation" );
         }
         
@@ -255,108 +455,108 @@ namespace teradar {
 
         //////////////////////////////////////////////////////////
 
+        if( m_abortFlagPtr && m_abortFlagPtr->load( boost::memory_order_relaxed ) ) {
+          return false;
+        }
+
+        m_mergeCandidates.clear();
+        m_mergeCandidatesCompactionSize = 0;
+
+        const unsigned int threadsNumber = getMergingThreadsNumber();
+        const bool parallelMerging = ( threadsNumber > 1 );
+
+        if( parallelMerging ) {
+          // Rounds of mutual best neighbors merges, each thread has its own
+          // merger (it keeps intermediate values) and merge preview segment.
+          // The merging workers are kept alive between the rounds phases and
+          // the blocks. The workers inherit the affinity of the thread creating
+          // them, they are created again when it changes (e.g. a NUMA bound
+          // segmentation thread)
+
+          std::vector< unsigned int > threadCpus;
+          teradar::common::GetCurrentThreadCpus( threadCpus );
+
+          if( ( m_mergingEnginePtr.get() == 0 ) ||
+            ( m_mergingEnginePtr->getWorkersNumber() != ( threadsNumber - 1 ) ) ||
+            ( threadCpus != m_mergingEngineCpus ) ) {
+            m_mergingEnginePtr.reset();
+            m_mergingEnginePtr.reset( new SegmenterEngine( threadsNumber - 1 ) );
+            m_mergingEngineCpus = threadCpus;
+          }
+
+          m_roundsMergers.resize( threadsNumber );
+          m_roundsPreviewSegments.reset( new te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >[ threadsNumber ] );
+          m_roundsPreviewFeatures.resize( threadsNumber * segmentFeaturesSize );
+          m_roundBestNeighbors.resize( block2ProcessInfo.m_height * block2ProcessInfo.m_width );
+
+          for( unsigned int threadIdx = 0; threadIdx < threadsNumber; ++threadIdx ) {
+            m_roundsMergers[ threadIdx ].reset( new SegmenterRegionGrowingWishartMerger(
+              featuresNumber, levelENL, m_parameters.m_enableAzimutalSimetry ) );
+            m_roundsMergers[ threadIdx ]->setRejectionBound( m_rejectionBound );
+            m_roundsPreviewSegments[ threadIdx ].m_features = &m_roundsPreviewFeatures[
+              threadIdx * segmentFeaturesSize ];
+          }
+        } else {
+          // Best-first merging: all adjacent segments pairs are kept in a
+          // min-heap keyed by the Wishart dissimilarity, each merge only
+          // updates the candidates of the merged segment
+
+          for( te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* segmentPtr = actSegsListHeadPtr;
+            segmentPtr; segmentPtr = segmentPtr->m_nextActiveSegment ) {
+            pushMergeCandidates( segmentPtr, 0, true, *mergerPtr, auxSeg1Ptr );
+          }
+
+          std::make_heap( m_mergeCandidates.begin(), m_mergeCandidates.end(),
+            std::greater< MergeCandidate >() );
+          m_mergeCandidatesCompactionSize = std::max( (std::size_t)1024, m_mergeCandidates.size() );
+        }
+
         if( enableProgressInterface ) {
           if( !progressPtr->isActive() ) {
             return false;
           }
           progressPtr->pulse();
         }
-        
-        // Flush result to the output raster
-        {
-          unsigned int blkCol = 0;
-          te::rp::SegmenterSegmentsBlock::SegmentIdDataType* segmentsIdsLinePtr = 0;
 
-          for( unsigned int blkLine = 0; blkLine < block2ProcessInfo.m_height; ++blkLine ) {
-            segmentsIdsLinePtr = m_segmentsIdsMatrix[blkLine];
+        // STEP 1 - Region growing, the dissimilarity threshold grows over the
+        // cycles up to the growing confidence level
 
-            for( blkCol = 0; blkCol < block2ProcessInfo.m_width; ++blkCol ) {
-              if( segmentsIdsLinePtr[blkCol] ) {
-                outputRaster.setValue( blkCol + block2ProcessInfo.m_startX, blkLine
-                  + block2ProcessInfo.m_startY, segmentsIdsLinePtr[blkCol],
-                  outputRasterBand );
-              }
+        const te::rp::DissimilarityTypeT growingThreshold =
+          m_parameters.m_regionGrowingConfLevel / 100.0;
+        te::rp::DissimilarityTypeT cycleThreshold = 0;
+
+        for( unsigned int cycle = 1; cycle <= m_parameters.m_regionGrowingLimit; ++cycle ) {
+          cycleThreshold = growingThreshold * ((te::rp::DissimilarityTypeT)cycle) /
+            ((te::rp::DissimilarityTypeT)m_parameters.m_regionGrowingLimit);
+
+          if( !( parallelMerging ? mergeSegmentsInRounds( cycleThreshold, 0, &actSegsListHeadPtr ) :
+            mergeSegments( cycleThreshold, 0, *mergerPtr, auxSeg1Ptr, &actSegsListHeadPtr ) ) ) {
+            return false;
+          }
+
+          if( enableProgressInterface ) {
+            if( !progressPtr->isActive() ) {
+              return false;
             }
+            progressPtr->pulse();
           }
         }
-        
-        return true;
 
+        // STEP 2 - Region merging, from the growing up to the merging
+        // confidence level
 
+        const te::rp::DissimilarityTypeT mergingThreshold = std::max( growingThreshold,
+          m_parameters.m_regionMergingConfLevel / 100.0 );
 
+        for( unsigned int cycle = 1; cycle <= m_parameters.m_regionMergingLimit; ++cycle ) {
+          cycleThreshold = growingThreshold + ( mergingThreshold - growingThreshold ) *
+            ((te::rp::DissimilarityTypeT)cycle) /
+            ((te::rp::DissimilarityTypeT)m_parameters.m_regionMergingLimit);
 
-
-
-        
-        /* 
-        
-        // Globals
-        te::rp::DissimilarityTypeT minFoundDissimilarity = 0.0;
-        te::rp::DissimilarityTypeT maxFoundDissimilarity = 0.0;
-        
-        unsigned int totalMergesNumber = 0;
-        IterationCounterType globalMergeIterationsCounter = 1;
-
-        // STEP 1 - Merge of segments that are equal
-        if( enableProgressInterface ) {
-          if( !progressPtr->isActive() ) {
+          if( !( parallelMerging ? mergeSegmentsInRounds( cycleThreshold, 0, &actSegsListHeadPtr ) :
+            mergeSegments( cycleThreshold, 0, *mergerPtr, auxSeg1Ptr, &actSegsListHeadPtr ) ) ) {
             return false;
           }
-          progressPtr->pulse();
-        }
-
-        //TERP_LOGMSG( m_parameters.m_segmentsSimilarityThreshold );
-        //TERP_LOGMSG( rg::getActiveSegmentsNumber< rg::WishartFeatureType >( actSegsListHeadPtr ) );
-        
-        mergeSegments< WishartFeatureType >(
-          m_segmentsIdsMatrix,
-          0.0,
-          0,
-          segmenterIdsManager,
-          *mergerPtr,
-          false,
-          true,
-          auxSeg1Ptr,
-          auxSeg2Ptr,
-          auxSeg3Ptr,
-          minFoundDissimilarity,
-          maxFoundDissimilarity,
-          totalMergesNumber,
-          globalMergeIterationsCounter,
-          &actSegsListHeadPtr );
-
-        //TERP_LOGMSG( rg::getActiveSegmentsNumber< rg::WishartFeatureType >( actSegsListHeadPtr ) );
-
-        // STEP 2 - Main Segmentation loop
-        for( unsigned int segmentsSimIncreaseStep = 1; segmentsSimIncreaseStep <= m_parameters.m_segmentsSimIncreaseSteps; ++segmentsSimIncreaseStep ) {
-          const te::rp::DissimilarityTypeT disimilarityThreshold =
-            (te::rp::DissimilarityTypeT)segmentsSimIncreaseStep
-            *
-            (te::rp::DissimilarityTypeT)m_parameters.m_segmentsSimilarityThreshold
-            /
-            (te::rp::DissimilarityTypeT)m_parameters.m_segmentsSimIncreaseSteps;
-
-          //TERP_LOGMSG( segmentsSimIncreaseStep );
-          //TERP_LOGMSG( disimilarityThreshold )
-
-          mergeSegments< WishartFeatureType >(
-            m_segmentsIdsMatrix,
-            disimilarityThreshold,
-            0,
-            segmenterIdsManager,
-            *mergerPtr,
-            m_parameters.m_enableLocalMutualBestFitting,
-            m_parameters.m_enableSameIterationMerges,
-            auxSeg1Ptr,
-            auxSeg2Ptr,
-            auxSeg3Ptr,
-            minFoundDissimilarity,
-            maxFoundDissimilarity,
-            totalMergesNumber,
-            globalMergeIterationsCounter,
-            &actSegsListHeadPtr );
-
-          //TERP_LOGMSG( rg::getActiveSegmentsNumber< rg::WishartFeatureType >( actSegsListHeadPtr ) );
 
           if( enableProgressInterface ) {
             if( !progressPtr->isActive() ) {
@@ -365,30 +565,54 @@ namespace teradar {
             progressPtr->pulse();
           }
         }
-        
+
         // STEP 3 - Forcing the merge of too small segments
+
         if( m_parameters.m_minSegmentSize > 1 ) {
-          mergeSegments< WishartFeatureType >(
-            m_segmentsIdsMatrix,
-            std::numeric_limits< te::rp::DissimilarityTypeT >::max(),
-            m_parameters.m_minSegmentSize,
-            segmenterIdsManager,
-            *mergerPtr,
-            false,
-            true,
-            auxSeg1Ptr,
-            auxSeg2Ptr,
-            auxSeg3Ptr,
-            minFoundDissimilarity,
-            maxFoundDissimilarity,
-            totalMergesNumber,
-            globalMergeIterationsCounter,
-            &actSegsListHeadPtr );
-
-          //TERP_LOGMSG( rg::getActiveSegmentsNumber< rg::WishartFeatureType >( actSegsListHeadPtr ) );
+          cycleThreshold = std::numeric_limits< te::rp::DissimilarityTypeT >::max();
+
+          // the small segments merges are ranked by the real dissimilarities
+          mergerPtr->setRejectionBound( 0 );
+
+          for( std::size_t threadIdx = 0; threadIdx < m_roundsMergers.size(); ++threadIdx ) {
+            m_roundsMergers[ threadIdx ]->setRejectionBound( 0 );
+          }
+
+          if( !parallelMerging ) {
+            resolveRejectedCandidates( m_parameters.m_minSegmentSize, *mergerPtr, auxSeg1Ptr );
+          }
+
+          if( !( parallelMerging ? mergeSegmentsInRounds( cycleThreshold, m_parameters.m_minSegmentSize,
+            &actSegsListHeadPtr ) : mergeSegments( cycleThreshold, m_parameters.m_minSegmentSize,
+            *mergerPtr, auxSeg1Ptr, &actSegsListHeadPtr ) ) ) {
+            return false;
+          }
         }
 
-        */
+        m_mergeCandidates.clear();
+
+        TERP_TRUE_OR_RETURN_FALSE( resolveLabels( segmenterIdsManager, actSegsListHeadPtr ),
+          "Segments labels resolution error" );
+
+        if( enableProgressInterface ) {
+          if( !progressPtr->isActive() ) {
+            return false;
+          }
+          progressPtr->pulse();
+        }
+        
+        // Flush result to the output raster, whole raster blocks at once
+        TERP_TRUE_OR_RETURN_FALSE( teradar::common::WriteLabelsRegion( m_segmentsIdsMatrix,
+          block2ProcessInfo.m_startX, block2ProcessInfo.m_startY, outputRaster,
+          outputRasterBand ), "Output raster write error" );
+
+        // Keeping the segments for the blocks seams merging
+        m_lastActSegsListHeadPtr = actSegsListHeadPtr;
+        m_lastBlockStartX = block2ProcessInfo.m_startX;
+        m_lastBlockStartY = block2ProcessInfo.m_startY;
+        m_lastFeaturesNumber = segmentFeaturesSize;
+        
+        return true;
       }
 
       double SegmenterRegionGrowingWishartStrategy::getMemUsageEstimation(
@@ -399,11 +623,36 @@ namespace teradar {
 
         TERP_TRUE_OR_THROW( m_isInitialized, "Instance not initialized" );
 
-        // The features matrix inside the pool
-        double featuresSizeBytes = (double)(pixelsNumber * bandsToProcess * sizeof(WishartFeatureType));
-
-        return (double)(featuresSizeBytes + (pixelsNumber * (sizeof(te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >)
-          + (6 * sizeof(te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >*))))
+        // The features matrix inside the pool, n^2 doubles per Hermitian-packed
+        // n x n covariance matrix (one input band per matrix element), or 5
+        // doubles with azimutal simetry
+        double featuresSizeBytes = (double)pixelsNumber * sizeof(WishartFeatureType) *
+          ( ( m_parameters.m_enableAzimutalSimetry && ( bandsToProcess == 9 ) ) ? 5 : bandsToProcess );
+
+        // About 2 (4-neighborhood) or 4 (8-neighborhood) merge candidates per
+        // pixel plus the stale ones kept until the next heap compaction
+        double candidatesSizeBytes = (double)pixelsNumber *
+          ( ( m_parameters.m_connectivityType == teradar::common::MooreNT ) ? 8 : 4 ) *
+          sizeof(MergeCandidate);
+
+        // The region adjacency graph, with the dissimilarities cache for the
+        // parallel merging rounds
+        double adjacencyGraphSizeBytes = SegmenterRegionAdjacencyGraph::getMemUsageEstimation(
+          pixelsNumber, m_parameters.m_connectivityType, ( m_parameters.m_mergingThreadsNumber > 1 ) &&
+          m_parameters.m_enableDissimilarityCache );
+
+        // The labels union-find forest and, for the parallel merging rounds,
+        // the segments best neighbors
+        double labelsSizeBytes = (double)pixelsNumber * sizeof(unsigned int) *
+          ( ( m_parameters.m_mergingThreadsNumber > 1 ) ? 2 : 1 );
+
+        // The pixels segments, the graph nodes segments (the bands values
+        // strip is negligible)
+        double blockBuffersSizeBytes = (double)pixelsNumber *
+          sizeof(te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >*);
+
+        return (double)(featuresSizeBytes + candidatesSizeBytes + labelsSizeBytes + blockBuffersSizeBytes +
+          adjacencyGraphSizeBytes + (pixelsNumber * sizeof(te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >))
           + (pixelsNumber * sizeof(te::rp::SegmenterSegmentsBlock::SegmentIdDataType)));
       }
 
@@ -423,79 +672,652 @@ namespace teradar {
         return SegmenterStrategy::NoMerging;
       }
 
-      bool SegmenterRegionGrowingWishartStrategy::initializeSegments( te::rp::SegmenterIdsManager& segmenterIdsManager,
+      void SegmenterRegionGrowingWishartStrategy::setAbortFlag( boost::atomic< bool > const* abortFlagPtr )
+      {
+        m_abortFlagPtr = abortFlagPtr;
+      }
+
+      void SegmenterRegionGrowingWishartStrategy::setMaxThreadsNumber( const unsigned int maxThreadsNumber )
+      {
+        m_maxThreadsNumber = maxThreadsNumber;
+      }
+
+      unsigned int SegmenterRegionGrowingWishartStrategy::getMergingThreadsNumber() const
+      {
+        if( m_maxThreadsNumber ) {
+          return std::max( 1u, std::min( m_parameters.m_mergingThreadsNumber, m_maxThreadsNumber ) );
+        } else {
+          return std::max( 1u, m_parameters.m_mergingThreadsNumber );
+        }
+      }
+
+      void SegmenterRegionGrowingWishartStrategy::runMergingJob( const SegmenterEngine::JobT& job )
+      {
+        const unsigned int threadsNumber = (unsigned int)m_roundsMergers.size();
+
+        // without workers (or if they are busy), the calling thread runs all
+        // indexes, each index has its own range of the work
+        if( ( threadsNumber < 2 ) || ( m_mergingEnginePtr.get() == 0 ) ||
+          ( !m_mergingEnginePtr->start( boost::bind( RunShiftedWorkerJob, boost::cref( job ), _1 ),
+            threadsNumber - 1 ) ) ) {
+          for( unsigned int threadIdx = 0; threadIdx < threadsNumber; ++threadIdx ) {
+            job( threadIdx );
+          }
+
+          return;
+        }
+
+        job( 0 );
+
+        // the phase barrier
+        m_mergingEnginePtr->join();
+      }
+
+      bool SegmenterRegionGrowingWishartStrategy::getBorderSegmentsStatistics(
+        SegmentsStatisticsT& statistics ) const
+      {
+        statistics.clear();
+
+        TERP_TRUE_OR_RETURN_FALSE( m_lastActSegsListHeadPtr != 0, "No processed block" );
+
+        const unsigned int nLines = m_segmentsIdsMatrix.getLinesNumber();
+        const unsigned int nCols = m_segmentsIdsMatrix.getColumnsNumber();
+        unsigned int line = 0;
+        unsigned int col = 0;
+
+        // the ids of the segments touching the block borders
+
+        std::vector< te::rp::SegmenterSegmentsBlock::SegmentIdDataType > borderIds;
+        borderIds.reserve( 2 * ( nLines + nCols ) );
+
+        for( col = 0; col < nCols; ++col ) {
+          borderIds.push_back( m_segmentsIdsMatrix( 0, col ) );
+          borderIds.push_back( m_segmentsIdsMatrix( nLines - 1, col ) );
+        }
+
+        for( line = 0; line < nLines; ++line ) {
+          borderIds.push_back( m_segmentsIdsMatrix( line, 0 ) );
+          borderIds.push_back( m_segmentsIdsMatrix( line, nCols - 1 ) );
+        }
+
+        std::sort( borderIds.begin(), borderIds.end() );
+        borderIds.erase( std::unique( borderIds.begin(), borderIds.end() ), borderIds.end() );
+
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > const* segmentPtr =
+          m_lastActSegsListHeadPtr;
+
+        while( segmentPtr ) {
+          if( std::binary_search( borderIds.begin(), borderIds.end(), segmentPtr->m_id ) ) {
+            SegmentStatistics& segmentStatistics = statistics[segmentPtr->m_id];
+
+            segmentStatistics.m_size = segmentPtr->m_size;
+            segmentStatistics.m_xStart = m_lastBlockStartX + segmentPtr->m_xStart;
+            segmentStatistics.m_yStart = m_lastBlockStartY + segmentPtr->m_yStart;
+            segmentStatistics.m_xBound = m_lastBlockStartX + segmentPtr->m_xBound;
+            segmentStatistics.m_yBound = m_lastBlockStartY + segmentPtr->m_yBound;
+            segmentStatistics.m_features.assign( segmentPtr->m_features,
+              segmentPtr->m_features + m_lastFeaturesNumber );
+          }
+
+          segmentPtr = segmentPtr->m_nextActiveSegment;
+        }
+
+        return true;
+      }
+
+      SegmenterBorderStatisticsProvider::StatisticsMerger*
+        SegmenterRegionGrowingWishartStrategy::createStatisticsMerger(
+        const unsigned int bandsToProcess ) const
+      {
+        if( ( !m_isInitialized ) ||
+          ( m_parameters.m_enableAzimutalSimetry && ( bandsToProcess != 9 ) ) ) {
+          return 0;
+        }
+
+        return new WishartStatisticsMerger( bandsToProcess,
+          teradar::common::ComputeCompressionLevelENL(
+          (unsigned int)m_parameters.m_compressionLevel, m_parameters.m_enlLZero ),
+          m_parameters.m_enableAzimutalSimetry, m_parameters.m_regionMergingConfLevel / 100.0 );
+      }
+
+      bool SegmenterRegionGrowingWishartStrategy::MergeCandidate::operator>(
+        const MergeCandidate& other ) const
+      {
+        if( m_dissimilarity != other.m_dissimilarity ) {
+          return ( m_dissimilarity > other.m_dissimilarity );
+        }
+
+        // equal dissimilarities are ordered by the segments ids, so the
+        // merging order does not depend on the heap history
+        const te::rp::SegmenterSegmentsBlock::SegmentIdDataType minId =
+          std::min( m_segment1Ptr->m_id, m_segment2Ptr->m_id );
+        const te::rp::SegmenterSegmentsBlock::SegmentIdDataType otherMinId =
+          std::min( other.m_segment1Ptr->m_id, other.m_segment2Ptr->m_id );
+
+        if( minId != otherMinId ) {
+          return ( minId > otherMinId );
+        }
+
+        return ( std::max( m_segment1Ptr->m_id, m_segment2Ptr->m_id ) >
+          std::max( other.m_segment1Ptr->m_id, other.m_segment2Ptr->m_id ) );
+      }
+
+      void SegmenterRegionGrowingWishartStrategy::pushMergeCandidates(
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* segmentPtr,
+        const unsigned int minSegmentSize, const bool onlyHigherIds,
+        SegmenterRegionGrowingWishartMerger& merger,
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* auxSegPtr )
+      {
+        MergeCandidate candidate;
+        candidate.m_segment1Ptr = segmentPtr;
+        candidate.m_segment1Size = segmentPtr->m_size;
+
+        // active segments ids are their root pixels local ids, the graph nodes
+        const SegmenterRegionAdjacencyGraph::NodeIndexT node = segmentPtr->m_id - 1;
+        const unsigned int neighborsNumber = m_adjacencyGraph.getNeighborsNumber( node );
+        SegmenterRegionAdjacencyGraph::NodeIndexT const* neighborsPtr = m_adjacencyGraph.getNeighbors( node );
+
+        for( unsigned int neighborIdx = 0; neighborIdx < neighborsNumber; ++neighborIdx ) {
+          te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* neighborPtr =
+            m_pixelsSegments[ neighborsPtr[ neighborIdx ] ];
+
+          if( onlyHigherIds && ( neighborPtr->m_id < segmentPtr->m_id ) ) {
+            continue;
+          }
+
+          if( minSegmentSize && ( segmentPtr->m_size >= minSegmentSize ) &&
+            ( neighborPtr->m_size >= minSegmentSize ) ) {
+            continue;
+          }
+
+          candidate.m_segment2Ptr = neighborPtr;
+          candidate.m_segment2Size = neighborPtr->m_size;
+          candidate.m_dissimilarity = merger.getDissimilarity( segmentPtr, neighborPtr, auxSegPtr );
+
+          m_mergeCandidates.push_back( candidate );
+
+          // the initial candidates are heapified all at once by the caller
+          if( !onlyHigherIds ) {
+            std::push_heap( m_mergeCandidates.begin(), m_mergeCandidates.end(),
+              std::greater< MergeCandidate >() );
+          }
+        }
+      }
+
+      bool SegmenterRegionGrowingWishartStrategy::mergeSegments(
+        const te::rp::DissimilarityTypeT maxDissimilarity,
+        const unsigned int minSegmentSize,
+        SegmenterRegionGrowingWishartMerger& merger,
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* auxSegPtr,
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >** actSegsListHeadPtr )
+      {
+        std::greater< MergeCandidate > candidatesCompare;
+        unsigned int popsCounter = 0;
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* absorberPtr = 0;
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* absorbedPtr = 0;
+
+        while( !m_mergeCandidates.empty() ) {
+          const MergeCandidate& topCandidate = m_mergeCandidates.front();
+
+          // the remaining candidates stay for the next (higher) thresholds
+          if( ( minSegmentSize == 0 ) && ( topCandidate.m_dissimilarity > maxDissimilarity ) ) {
+            break;
+          }
+
+          absorberPtr = topCandidate.m_segment1Ptr;
+          absorbedPtr = topCandidate.m_segment2Ptr;
+
+          const bool isStale = ( absorberPtr->m_size != topCandidate.m_segment1Size ) ||
+            ( absorbedPtr->m_size != topCandidate.m_segment2Size );
+
+          std::pop_heap( m_mergeCandidates.begin(), m_mergeCandidates.end(), candidatesCompare );
+          m_mergeCandidates.pop_back();
+
+          if( ( ( ++popsCounter ) % 256 ) == 0 ) {
+            if( m_abortFlagPtr && m_abortFlagPtr->load( boost::memory_order_relaxed ) ) {
+              return false;
+            }
+          }
+
+          if( isStale ) {
+            continue;
+          }
+
+          if( minSegmentSize && ( absorberPtr->m_size >= minSegmentSize ) &&
+            ( absorbedPtr->m_size >= minSegmentSize ) ) {
+            continue;
+          }
+
+          // the larger segment absorbs the smaller one, fewer pixels are relabeled
+          if( absorbedPtr->m_size > absorberPtr->m_size ) {
+            std::swap( absorberPtr, absorbedPtr );
+          }
+
+          // the pair dissimilarity is already known, only the preview is needed
+          merger.getMergePreview( absorberPtr, absorbedPtr, auxSegPtr );
+          merger.mergeFeatures( absorberPtr, absorbedPtr, auxSegPtr );
+
+          removeAbsorbedSegment( absorberPtr, absorbedPtr, actSegsListHeadPtr );
+
+          // the absorber size changed, its old candidates are stale now
+          pushMergeCandidates( absorberPtr, minSegmentSize, false, merger, auxSegPtr );
+
+          if( m_mergeCandidates.size() > 2 * m_mergeCandidatesCompactionSize ) {
+            std::size_t validIdx = 0;
+
+            for( std::size_t candidateIdx = 0; candidateIdx < m_mergeCandidates.size(); ++candidateIdx ) {
+              const MergeCandidate& candidate = m_mergeCandidates[ candidateIdx ];
+
+              if( ( candidate.m_segment1Ptr->m_size == candidate.m_segment1Size ) &&
+                ( candidate.m_segment2Ptr->m_size == candidate.m_segment2Size ) ) {
+                m_mergeCandidates[ validIdx++ ] = candidate;
+              }
+            }
+
+            m_mergeCandidates.resize( validIdx );
+            std::make_heap( m_mergeCandidates.begin(), m_mergeCandidates.end(), candidatesCompare );
+            m_mergeCandidatesCompactionSize = std::max( (std::size_t)1024, m_mergeCandidates.size() );
+          }
+        }
+
+        return true;
+      }
+
+      void SegmenterRegionGrowingWishartStrategy::resolveRejectedCandidates(
+        const unsigned int minSegmentSize,
+        SegmenterRegionGrowingWishartMerger& merger,
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* auxSegPtr )
+      {
+        std::size_t validIdx = 0;
+
+        for( std::size_t candidateIdx = 0; candidateIdx < m_mergeCandidates.size(); ++candidateIdx ) {
+          MergeCandidate candidate = m_mergeCandidates[ candidateIdx ];
+
+          if( ( candidate.m_segment1Ptr->m_size != candidate.m_segment1Size ) ||
+            ( candidate.m_segment2Ptr->m_size != candidate.m_segment2Size ) ) {
+            continue;
+          }
+
+          // the segments sizes only grow, such pairs are never merged anymore
+          if( ( candidate.m_segment1Size >= minSegmentSize ) &&
+            ( candidate.m_segment2Size >= minSegmentSize ) ) {
+            continue;
+          }
+
+          if( candidate.m_dissimilarity == SegmenterRegionGrowingWishartMerger::getRejectedDissimilarity() ) {
+            candidate.m_dissimilarity = merger.getDissimilarity( candidate.m_segment1Ptr,
+              candidate.m_segment2Ptr, auxSegPtr );
+          }
+
+          m_mergeCandidates[ validIdx++ ] = candidate;
+        }
+
+        m_mergeCandidates.resize( validIdx );
+        std::make_heap( m_mergeCandidates.begin(), m_mergeCandidates.end(),
+          std::greater< MergeCandidate >() );
+        m_mergeCandidatesCompactionSize = std::max( (std::size_t)1024, m_mergeCandidates.size() );
+      }
+
+      void SegmenterRegionGrowingWishartStrategy::removeAbsorbedSegment(
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* absorberPtr,
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* absorbedPtr,
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >** actSegsListHeadPtr )
+      {
+        // active segments ids are their roots local ids, the pixels are
+        // relabeled once by resolveLabels
+        m_labelsParents[ absorbedPtr->m_id - 1 ] = absorberPtr->m_id - 1;
+
+        // moving the absorbed segment neighbors to the absorber
+        m_adjacencyGraph.merge( absorberPtr->m_id - 1, absorbedPtr->m_id - 1 );
+
+        // removing the absorbed segment from the active segments list
+        if( absorbedPtr->m_prevActiveSegment ) {
+          absorbedPtr->m_prevActiveSegment->m_nextActiveSegment = absorbedPtr->m_nextActiveSegment;
+        } else {
+          *actSegsListHeadPtr = absorbedPtr->m_nextActiveSegment;
+        }
+
+        if( absorbedPtr->m_nextActiveSegment ) {
+          absorbedPtr->m_nextActiveSegment->m_prevActiveSegment = absorbedPtr->m_prevActiveSegment;
+        }
+
+        absorbedPtr->m_prevActiveSegment = 0;
+        absorbedPtr->m_nextActiveSegment = 0;
+
+        // a null size invalidates all the absorbed segment candidates
+        absorbedPtr->m_size = 0;
+        absorbedPtr->disable();
+      }
+
+      bool SegmenterRegionGrowingWishartStrategy::mergeSegmentsInRounds(
+        const te::rp::DissimilarityTypeT maxDissimilarity,
+        const unsigned int minSegmentSize,
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >** actSegsListHeadPtr )
+      {
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* segmentPtr = 0;
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* neighborPtr = 0;
+        SegmenterRegionAdjacencyGraph::NodeIndexT node = 0;
+        SegmenterRegionAdjacencyGraph::NodeIndexT bestNode = 0;
+        std::size_t idx = 0;
+
+        while( true ) {
+          if( m_abortFlagPtr && m_abortFlagPtr->load( boost::memory_order_relaxed ) ) {
+            return false;
+          }
+
+          m_roundSegments.clear();
+
+          for( segmentPtr = *actSegsListHeadPtr; segmentPtr; segmentPtr = segmentPtr->m_nextActiveSegment ) {
+            m_roundSegments.push_back( segmentPtr );
+          }
+
+          runMergingJob( boost::bind( &SegmenterRegionGrowingWishartStrategy::findRoundBestNeighbors,
+            this, _1, maxDissimilarity, minSegmentSize ) );
+
+          // the mutual best neighbors pairs are disjoint, each one is taken
+          // from its lower id segment
+
+          m_roundPairs.clear();
+
+          for( idx = 0; idx < m_roundSegments.size(); ++idx ) {
+            segmentPtr = m_roundSegments[ idx ];
+            node = segmentPtr->m_id - 1;
+            bestNode = m_roundBestNeighbors[ node ];
+
+            if( ( bestNode == NoBestNeighbor ) || ( m_roundBestNeighbors[ bestNode ] != node ) ||
+              ( bestNode < node ) ) {
+              continue;
+            }
+
+            neighborPtr = m_pixelsSegments[ bestNode ];
+
+            // the larger segment absorbs the smaller one
+            if( neighborPtr->m_size > segmentPtr->m_size ) {
+              m_roundPairs.push_back( std::make_pair( neighborPtr, segmentPtr ) );
+            } else {
+              m_roundPairs.push_back( std::make_pair( segmentPtr, neighborPtr ) );
+            }
+          }
+
+          if( m_roundPairs.empty() ) {
+            break;
+          }
+
+          runMergingJob( boost::bind( &SegmenterRegionGrowingWishartStrategy::mergeRoundPairsFeatures,
+            this, _1 ) );
+
+          for( idx = 0; idx < m_roundPairs.size(); ++idx ) {
+            removeAbsorbedSegment( m_roundPairs[ idx ].first, m_roundPairs[ idx ].second,
+              actSegsListHeadPtr );
+          }
+        }
+
+        return true;
+      }
+
+      void SegmenterRegionGrowingWishartStrategy::findRoundBestNeighbors( const unsigned int threadIdx,
+        const te::rp::DissimilarityTypeT maxDissimilarity,
+        const unsigned int minSegmentSize )
+      {
+        const std::size_t threadsNumber = m_roundsMergers.size();
+        const std::size_t segmentsBegin = ( m_roundSegments.size() * threadIdx ) / threadsNumber;
+        const std::size_t segmentsEnd = ( m_roundSegments.size() * ( threadIdx + 1 ) ) / threadsNumber;
+
+        SegmenterRegionGrowingWishartMerger& merger = *m_roundsMergers[ threadIdx ];
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* previewSegPtr =
+          &m_roundsPreviewSegments[ threadIdx ];
+
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* segmentPtr = 0;
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* neighborPtr = 0;
+        SegmenterRegionAdjacencyGraph::NodeIndexT node = 0;
+        SegmenterRegionAdjacencyGraph::NodeIndexT bestNode = 0;
+        SegmenterRegionAdjacencyGraph::NodeIndexT const* neighborsPtr = 0;
+        SegmenterRegionAdjacencyGraph::EdgeCacheEntry* cachePtr = 0;
+        unsigned int nodeGeneration = 0;
+        unsigned int neighborGeneration = 0;
+        unsigned int neighborsNumber = 0;
+        unsigned int neighborIdx = 0;
+        MergeCandidate candidate;
+        MergeCandidate bestCandidate;
+
+        for( std::size_t segmentIdx = segmentsBegin; segmentIdx < segmentsEnd; ++segmentIdx ) {
+          segmentPtr = m_roundSegments[ segmentIdx ];
+          node = segmentPtr->m_id - 1;
+          bestNode = NoBestNeighbor;
+          neighborsNumber = m_adjacencyGraph.getNeighborsNumber( node );
+          neighborsPtr = m_adjacencyGraph.getNeighbors( node );
+          cachePtr = m_adjacencyGraph.getNeighborsCache( node );
+          nodeGeneration = m_adjacencyGraph.getGeneration( node );
+
+          for( neighborIdx = 0; neighborIdx < neighborsNumber; ++neighborIdx ) {
+            neighborPtr = m_pixelsSegments[ neighborsPtr[ neighborIdx ] ];
+
+            if( minSegmentSize && ( segmentPtr->m_size >= minSegmentSize ) &&
+              ( neighborPtr->m_size >= minSegmentSize ) ) {
+              continue;
+            }
+
+            // the lower id segment always comes first, so both segments of
+            // a pair get exactly the same dissimilarity
+            if( segmentPtr->m_id < neighborPtr->m_id ) {
+              candidate.m_segment1Ptr = segmentPtr;
+              candidate.m_segment2Ptr = neighborPtr;
+            } else {
+              candidate.m_segment1Ptr = neighborPtr;
+              candidate.m_segment2Ptr = segmentPtr;
+            }
+
+            if( cachePtr == 0 ) {
+              candidate.m_dissimilarity = merger.getDissimilarity( candidate.m_segment1Ptr,
+                candidate.m_segment2Ptr, previewSegPtr );
+            } else {
+              // the cached value is still valid if none of the segments
+              // absorbed another one since it was computed (each thread only
+              // touches its own segments cache entries)
+              neighborGeneration = m_adjacencyGraph.getGeneration( neighborsPtr[ neighborIdx ] );
+              SegmenterRegionAdjacencyGraph::EdgeCacheEntry& cacheEntry = cachePtr[ neighborIdx ];
+
+              // the rejected pairs are evaluated again by the minimum size
+              // step, without rejection bound
+              if( ( cacheEntry.m_nodeGeneration == nodeGeneration ) &&
+                ( cacheEntry.m_neighborGeneration == neighborGeneration ) &&
+                ( ( minSegmentSize == 0 ) || ( cacheEntry.m_value !=
+                SegmenterRegionGrowingWishartMerger::getRejectedDissimilarity() ) ) ) {
+                candidate.m_dissimilarity = cacheEntry.m_value;
+              } else {
+                candidate.m_dissimilarity = merger.getDissimilarity( candidate.m_segment1Ptr,
+                  candidate.m_segment2Ptr, previewSegPtr );
+
+                cacheEntry.m_value = candidate.m_dissimilarity;
+                cacheEntry.m_nodeGeneration = nodeGeneration;
+                cacheEntry.m_neighborGeneration = neighborGeneration;
+              }
+            }
+
+            if( ( minSegmentSize == 0 ) && ( candidate.m_dissimilarity > maxDissimilarity ) ) {
+              continue;
+            }
+
+            if( ( bestNode == NoBestNeighbor ) || ( bestCandidate > candidate ) ) {
+              bestCandidate = candidate;
+              bestNode = neighborsPtr[ neighborIdx ];
+            }
+          }
+
+          m_roundBestNeighbors[ node ] = bestNode;
+        }
+      }
+
+      void SegmenterRegionGrowingWishartStrategy::mergeRoundPairsFeatures( const unsigned int threadIdx )
+      {
+        const std::size_t threadsNumber = m_roundsMergers.size();
+        const std::size_t pairsBegin = ( m_roundPairs.size() * threadIdx ) / threadsNumber;
+        const std::size_t pairsEnd = ( m_roundPairs.size() * ( threadIdx + 1 ) ) / threadsNumber;
+
+        SegmenterRegionGrowingWishartMerger& merger = *m_roundsMergers[ threadIdx ];
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* previewSegPtr =
+          &m_roundsPreviewSegments[ threadIdx ];
+
+        // the pairs are disjoint, each thread only changes its pairs segments
+        for( std::size_t pairIdx = pairsBegin; pairIdx < pairsEnd; ++pairIdx ) {
+          merger.getMergePreview( m_roundPairs[ pairIdx ].first, m_roundPairs[ pairIdx ].second,
+            previewSegPtr );
+          merger.mergeFeatures( m_roundPairs[ pairIdx ].first, m_roundPairs[ pairIdx ].second,
+            previewSegPtr );
+        }
+      }
+
+      unsigned int SegmenterRegionGrowingWishartStrategy::findLabelRoot( const unsigned int pixelIdx )
+      {
+        unsigned int rootIdx = pixelIdx;
+
+        while( m_labelsParents[ rootIdx ] != rootIdx ) {
+          rootIdx = m_labelsParents[ rootIdx ];
+        }
+
+        unsigned int currIdx = pixelIdx;
+        unsigned int nextIdx = 0;
+
+        while( currIdx != rootIdx ) {
+          nextIdx = m_labelsParents[ currIdx ];
+          m_labelsParents[ currIdx ] = rootIdx;
+          currIdx = nextIdx;
+        }
+
+        return rootIdx;
+      }
+
+      bool SegmenterRegionGrowingWishartStrategy::resolveLabels(
+        te::rp::SegmenterIdsManager& segmenterIdsManager,
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* actSegsListHeadPtr )
+      {
+        const unsigned int nLines = m_segmentsIdsMatrix.getLinesNumber();
+        const unsigned int nCols = m_segmentsIdsMatrix.getColumnsNumber();
+        unsigned int line = 0;
+        unsigned int col = 0;
+        te::rp::SegmenterSegmentsBlock::SegmentIdDataType* idsLinePtr = 0;
+
+        // the unique ids are only acquired for the remaining segments
+
+        unsigned int segmentsNumber = 0;
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* segmentPtr = actSegsListHeadPtr;
+
+        while( segmentPtr ) {
+          ++segmentsNumber;
+          segmentPtr = segmentPtr->m_nextActiveSegment;
+        }
+
+        std::vector< te::rp::SegmenterSegmentsBlock::SegmentIdDataType > segmentsIds;
+
+        TERP_TRUE_OR_RETURN_FALSE( segmenterIdsManager.getNewIDs( segmentsNumber, segmentsIds ),
+          "Segments IDs acquisition error" );
+
+        // the roots pixels get the unique ids first, each one of the other
+        // pixels then copies the id of its root
+
+        unsigned int segmentIdx = 0;
+        unsigned int rootIdx = 0;
+        segmentPtr = actSegsListHeadPtr;
+
+        while( segmentPtr ) {
+          rootIdx = segmentPtr->m_id - 1;
+          segmentPtr->m_id = segmentsIds[ segmentIdx++ ];
+          m_segmentsIdsMatrix( rootIdx / nCols, rootIdx % nCols ) = segmentPtr->m_id;
+          segmentPtr = segmentPtr->m_nextActiveSegment;
+        }
+
+        for( line = 0; line < nLines; ++line ) {
+          idsLinePtr = m_segmentsIdsMatrix[ line ];
+
+          for( col = 0; col < nCols; ++col ) {
+            if( idsLinePtr[ col ] ) {
+              rootIdx = findLabelRoot( line * nCols + col );
+
+              if( rootIdx != ( line * nCols + col ) ) {
+                idsLinePtr[ col ] = m_segmentsIdsMatrix( rootIdx / nCols, rootIdx % nCols );
+              }
+            }
+          }
+        }
+
+        return true;
+      }
+
+      bool SegmenterRegionGrowingWishartStrategy::initializeSegments(
+        const SegmenterRegionGrowingWishartMerger& merger,
         const te::rp::SegmenterSegmentsBlock& block2ProcessInfo,
         const te::rst::Raster& inputRaster,
         const std::vector< unsigned int >& inputRasterBands,
         te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >** actSegsListHeadPtr )
       {
         const unsigned int inputRasterBandsSize = (unsigned int)inputRasterBands.size();
+        const unsigned int blkWidth = block2ProcessInfo.m_width;
+        const unsigned int blkHeight = block2ProcessInfo.m_height;
+
+        TERP_TRUE_OR_RETURN_FALSE( inputRasterBandsSize == merger.getCovarianceElementsNumber(),
+          "Invalid input raster bands number" );
 
         (*actSegsListHeadPtr) = 0;
 
+        // The block bands are read by strips of raster blocks lines, one
+        // locked raster access per raster block instead of one per pixel and
+        // band, and only a strip of unpacked complex values is kept
+        const int rasterBlockHeight = inputRaster.getBand( inputRasterBands[0] )->getProperty()->m_blkh;
+        const unsigned int stripLinesNumber = ( rasterBlockHeight > 0 ) ? (unsigned int)rasterBlockHeight : 64;
+        unsigned int stripStart = 0;
+        unsigned int stripBound = 0;
+        std::size_t stripPlaneSize = 0;
+
+        m_pixelsSegments.resize( ((std::size_t)blkWidth) * ((std::size_t)blkHeight) );
+
         // Initializing each segment
         unsigned int blkLine = 0;
         unsigned int blkCol = 0;
+        unsigned int pixelIdx = 0;
         te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* segmentPtr = 0;
-        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* neighborSegmentPtr = 0;
-        bool rasterValuesAreValid = true;
-        unsigned int inputRasterBandsIdx = 0;
-        std::complex< double > value = 0;
-        
-        const std::vector< std::complex< double > > dummyZeroesVector( inputRasterBandsSize, 0 );
-
-        std::list< te::rp::SegmenterSegmentsBlock::SegmentIdDataType > unusedLineSegmentIds;
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* prevActSegPtr = 0;
 
-        std::vector< te::rp::SegmenterSegmentsBlock::SegmentIdDataType > lineSegmentIds;
-        lineSegmentIds.reserve( block2ProcessInfo.m_width );
+        for( blkLine = 0; blkLine < blkHeight; ++blkLine ) {
+          // checked once per line, the wait bound is a block line processing time
+          if( m_abortFlagPtr && m_abortFlagPtr->load( boost::memory_order_relaxed ) ) {
+            return false;
+          }
 
-        std::vector< WishartFeatureType > rasterValues;
-        rasterValues.resize( inputRasterBandsSize, 0 );
+          if( blkLine == stripBound ) {
+            stripStart = blkLine;
+            stripBound = std::min( blkHeight, stripLinesNumber - ( ( block2ProcessInfo.m_startY +
+              stripStart ) % stripLinesNumber ) + stripStart );
+            stripPlaneSize = ((std::size_t)blkWidth) * ((std::size_t)( stripBound - stripStart ));
 
-        std::vector< te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* > usedSegPointers1( block2ProcessInfo.m_width, 0 );
-        std::vector< te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* > usedSegPointers2( block2ProcessInfo.m_width, 0 );
-        std::vector< te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* >* lastLineSegsPtrs = &usedSegPointers1;
-        std::vector< te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* >* currLineSegsPtrs = &usedSegPointers2;
+            m_blockBandsValues.resize( stripPlaneSize * inputRasterBandsSize );
 
-        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* prevActSegPtr = 0;
+            TERP_TRUE_OR_RETURN_FALSE( teradar::common::ReadBandsRegion( inputRaster, inputRasterBands,
+              block2ProcessInfo.m_startX, block2ProcessInfo.m_startY + stripStart, blkWidth,
+              stripBound - stripStart, &m_blockBandsValues[0] ), "Input raster read error" );
+          }
 
-        unsigned int rasterValuesIdx = 0;
+          for( blkCol = 0; blkCol < blkWidth; ++blkCol )  {
+            pixelIdx = blkLine * blkWidth + blkCol;
 
-        for( blkLine = 0; blkLine < block2ProcessInfo.m_height; ++blkLine ) {
-          segmenterIdsManager.getNewIDs( block2ProcessInfo.m_width, lineSegmentIds );
-          
-          for( blkCol = 0; blkCol < block2ProcessInfo.m_width; ++blkCol )  {
             if( (blkLine >= block2ProcessInfo.m_topCutOffProfile[blkCol])
               && (blkLine <= block2ProcessInfo.m_bottomCutOffProfile[blkCol])
               && (blkCol >= block2ProcessInfo.m_leftCutOffProfile[blkLine])
               && (blkCol <= block2ProcessInfo.m_rightCutOffProfile[blkLine]) ) {
-
-              rasterValuesAreValid = true;
-
-              for( inputRasterBandsIdx = 0; inputRasterBandsIdx < inputRasterBandsSize; ++inputRasterBandsIdx ) {
-                inputRaster.getValue( blkCol + block2ProcessInfo.m_startX, 
-                  blkLine + block2ProcessInfo.m_startY, 
-                  value,
-                  inputRasterBands[inputRasterBandsIdx] );
-
-                rasterValues[inputRasterBandsIdx] = (WishartFeatureType) value;
-              }
-            } else {
-              rasterValuesAreValid = false;
-            }
-            
-            // assotiating a segment object
-            if( rasterValuesAreValid ) {
               segmentPtr = m_segmentsPool.getNextSegment();
               assert( segmentPtr );
 
-              for( rasterValuesIdx = 0; rasterValuesIdx < inputRasterBandsSize; ++rasterValuesIdx ) {
-                segmentPtr->m_features[rasterValuesIdx] = rasterValues[rasterValuesIdx];
-              }
-
-              currLineSegsPtrs->operator[]( blkCol ) = segmentPtr;
-
-              segmentPtr->m_id = lineSegmentIds[blkCol];
+              // The covariance raster bands are in row order (the band
+              // row * order + col is the element ( row, col )), but the element
+              // ( row, col ) is read from the band col * order + row, as the
+              // complex features were always filled. The transposed Hermitian
+              // matrix is its conjugate, with the same (real) determinants, so
+              // the dissimilarities do not change.
+              merger.packCovariance( &m_blockBandsValues[0] + ( blkLine - stripStart ) * blkWidth + blkCol,
+                stripPlaneSize, segmentPtr->m_features );
+
+              // block local id, the pixel labels union-find node
+              segmentPtr->m_id = pixelIdx + 1;
+              m_labelsParents[ pixelIdx ] = pixelIdx;
               segmentPtr->m_size = 1;
               segmentPtr->m_xStart = blkCol;
               segmentPtr->m_xBound = blkCol + 1;
@@ -506,27 +1328,7 @@ namespace teradar {
               segmentPtr->m_nextActiveSegment = 0;
 
               m_segmentsIdsMatrix( blkLine, blkCol ) = segmentPtr->m_id;
-              
-              // updating the neighboorhood info
-              segmentPtr->removeAllNeighborSegmentsPtrs();
-
-              if( blkLine ) {
-                neighborSegmentPtr = lastLineSegsPtrs->operator[]( blkCol );
-
-                if( neighborSegmentPtr ) {
-                  segmentPtr->addNeighborSegmentPtr( neighborSegmentPtr );
-                  neighborSegmentPtr->addNeighborSegmentPtr( segmentPtr );
-                }
-              }
-
-              if( blkCol ) {
-                neighborSegmentPtr = currLineSegsPtrs->operator[]( blkCol - 1 );
-
-                if( neighborSegmentPtr ) {
-                  segmentPtr->addNeighborSegmentPtr( neighborSegmentPtr );
-                  neighborSegmentPtr->addNeighborSegmentPtr( segmentPtr );
-                }
-              }
+              m_pixelsSegments[ pixelIdx ] = segmentPtr;
 
               // Updating the active segments list header
               if( (*actSegsListHeadPtr) == 0 ) {
@@ -539,39 +1341,21 @@ namespace teradar {
               }
 
               prevActSegPtr = segmentPtr;
-            } else { // !rasterValueIsValid
+            } else {
               m_segmentsIdsMatrix( blkLine, blkCol ) = 0;
-              unusedLineSegmentIds.push_back( lineSegmentIds[blkCol] );
-              currLineSegsPtrs->operator[]( blkCol ) = 0;
+              m_pixelsSegments[ pixelIdx ] = 0;
             }
           }
-          
-          // Free unused IDs
-          if( !unusedLineSegmentIds.empty() ) {
-            segmenterIdsManager.addFreeIDs( unusedLineSegmentIds );
-            unusedLineSegmentIds.clear();
-          }
-
-          // Swapping the pointers to the vectors of used segment pointers
-          if( lastLineSegsPtrs == (&usedSegPointers1) ) {
-            lastLineSegsPtrs = &usedSegPointers2;
-            currLineSegsPtrs = &usedSegPointers1;
-          } else {
-            lastLineSegsPtrs = &usedSegPointers1;
-            currLineSegsPtrs = &usedSegPointers2;
-          }
         }
 
-        /* @todo - etore - remove 
-        std::cout << " M Lines : " << m_segmentsPool.getSegsMatrix().getLinesNumber() << std::endl;
-        std::cout << " M Cols : " << m_segmentsPool.getSegsMatrix( ).getColumnsNumber( ) << std::endl;
+        // Building the neighborhood info, the segments neighbors lists are not used
+        // The dissimilarities cache is only used by the merging rounds, the
+        // merge candidates heap already keeps each pair dissimilarity
+        TERP_TRUE_OR_RETURN_FALSE( m_adjacencyGraph.build( m_segmentsIdsMatrix,
+          m_parameters.m_connectivityType, ( getMergingThreadsNumber() > 1 ) &&
+          m_parameters.m_enableDissimilarityCache ),
+          "Region adjacency graph creation error" );
 
-        for( blkLine = 0; blkLine < m_segmentsPool.getSegsMatrix().getLinesNumber(); ++blkLine ) {
-          for( blkCol = 0; blkCol < m_segmentsPool.getSegsMatrix().getColumnsNumber(); ++blkCol )  {
-            std::cout << "M L: " << blkLine << " | C: " << blkCol  << " : " <<  m_segmentsPool.getSegsMatrix()[blkLine][blkCol].m_neighborSegmentsSize << std::endl;
-          }
-        }
-        */
         return true;
       }
       
@@ -15,6 +15,11 @@ TerraRadar is under development.
 
 // TerraRadar includes
 #include "config.hpp"
+#include "SegmenterAbortableStrategy.hpp"
+#include "SegmenterBorderStatisticsProvider.hpp"
+#include "SegmenterEngine.hpp"
+#include "SegmenterMultiThreadedStrategy.hpp"
+#include "SegmenterRegionAdjacencyGraph.hpp"
 
 #include "../common/RadarFunctions.hpp"
 #include "../common/Utils.hpp"
@@ -27,15 +32,30 @@ TerraRadar is under development.
 #include <terralib/rp/SegmenterStrategyFactory.h>
 #include <terralib/rp/SegmenterStrategy.h>
 
+// Boost includes
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/shared_ptr.hpp>
+
+// STL includes
+#include <map>
+#include <utility>
+#include <vector>
+
 namespace teradar {
   namespace segmenter {
-    typedef std::complex<double> WishartFeatureType;
+    /*! Segment feature type, an element of the Hermitian-packed covariance matrix */
+    typedef double WishartFeatureType;
+
+    class SegmenterRegionGrowingWishartMerger;
 
     /*!
       \class SegmenterRegionGrowingWishartStrategy
       \brief Raster region growing segmenter strategy.
     */
-    class TERADARSEGMEXPORT SegmenterRegionGrowingWishartStrategy : public te::rp::SegmenterStrategy
+    class TERADARSEGMEXPORT SegmenterRegionGrowingWishartStrategy : public te::rp::SegmenterStrategy,
+      public SegmenterAbortableStrategy, public SegmenterBorderStatisticsProvider,
+      public SegmenterMultiThreadedStrategy
     {
       public:
         /*!
@@ -78,11 +98,11 @@ namespace teradar {
 
             teradar::common::RadarDataType m_dataType; //!< Data type.
 
-            bool m_enableAzimutalSimetry; //!< If azimutal simetry should be used (default: false).
+            bool m_enableAzimutalSimetry; //!< If azimutal simetry should be used, only for 3x3 (HH, HV, VV) covariance matrices: the co-/cross-pol correlations are ignored and the segments keep 5 features (default: false).
 
             double m_enlLZero; //!< Equivalent number of looks of no compressed image (default - 1).
 
-            double m_compressionLevel; //!< Image compression level.
+            double m_compressionLevel; //!< Compression level of the input raster, relative to the image with m_enlLZero looks (default - 0).
 
             teradar::common::PixelConnectivityType m_connectivityType; //!< Pixel connectivity type.
 
@@ -93,6 +113,10 @@ namespace teradar {
             unsigned int m_regionMergingLimit; //<! Region merging limit, in cycles (default - 1).
 
             double m_regionMergingConfLevel; //!< Region merging confidence level, in percentage (default - 99,9).
+
+            unsigned int m_mergingThreadsNumber; //!< Number of threads merging the segments of each block. Above 1, the segments are merged by parallel rounds of mutual best neighbors merges instead of the best-first serial merging. Limited by setMaxThreadsNumber (default - 1).
+
+            bool m_enableDissimilarityCache; //!< If the parallel merging rounds keep the segments pairs dissimilarities until one of the segments is merged, instead of computing them again every round (default - true).
         };
 
         /*!
@@ -137,17 +161,195 @@ namespace teradar {
         //overload
         BlocksMergingMethod getBlocksMergingMethod() const;
 
+        /*!
+          \brief Return the statistics of the segments touching the borders of the
+          last processed block.
+          \details The statistics are taken from the segments features, so the
+          input raster is not read again. Only valid after a successful execute
+          call, before the next execute or reset call.
+          \param statistics The segments statistics (output), with raster coordinates.
+          \return true if OK, false on errors.
+        */
+        bool getBorderSegmentsStatistics( SegmentsStatisticsT& statistics ) const;
+
+        /*!
+          \brief Create a merger of the segments statistics.
+          \details The segments are merged if the Wishart test dissimilarity of
+          their mean covariance matrices is not above the region merging
+          confidence level.
+          \param bandsToProcess The number of processed input raster bands.
+          \return A new instance, owned by the caller, or null on errors.
+        */
+        StatisticsMerger* createStatisticsMerger( const unsigned int bandsToProcess ) const;
+
+        //overload
+        void setAbortFlag( boost::atomic< bool > const* abortFlagPtr );
+
+        //overload
+        void setMaxThreadsNumber( const unsigned int maxThreadsNumber );
+
       protected:
         /*!
-          \brief Initialize the segment objects container and the segment IDs container.
+          \class MergeCandidate
+          \brief A candidate merge of two adjacent segments.
+          \details The segments sizes at the candidate creation are kept. A
+          segment grows with each merge and absorbed segments get a null size,
+          so a candidate whose sizes differ from the current ones is stale and
+          is discarded when it reaches the heap top (lazy invalidation).
+         */
+        class MergeCandidate
+        {
+          public:
+            te::rp::DissimilarityTypeT m_dissimilarity; //!< The segments dissimilarity.
+
+            te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* m_segment1Ptr; //!< First segment.
+
+            te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* m_segment2Ptr; //!< Second segment.
+
+            unsigned int m_segment1Size; //!< First segment size at the candidate creation.
+
+            unsigned int m_segment2Size; //!< Second segment size at the candidate creation.
+
+            /*!
+              \brief Heap ordering, by dissimilarity and then by segments ids.
+            */
+            bool operator>( const MergeCandidate& other ) const;
+        };
+
+        /*!
+          \brief Push the merge candidates of a segment and each of its neighbors.
+          \param segmentPtr The segment.
+          \param minSegmentSize If not zero, only pairs with a segment smaller than it are pushed.
+          \param onlyHigherIds If true, only neighbors with higher ids are paired, so each pair is pushed once.
+          \param merger The merger used to compute the dissimilarities.
+          \param auxSegPtr An auxiliary segment, used as merge preview.
+         */
+        void pushMergeCandidates( te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* segmentPtr,
+          const unsigned int minSegmentSize, const bool onlyHigherIds,
+          SegmenterRegionGrowingWishartMerger& merger,
+          te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* auxSegPtr );
+
+        /*!
+          \brief Merge the segments, best candidates first.
+          \details Candidates are taken from the heap until its top dissimilarity
+          exceeds the threshold. Candidates that are still valid stay in the heap
+          for the next calls.
+          \param maxDissimilarity The dissimilarity threshold.
+          \param minSegmentSize If not zero, all candidates with a segment smaller than
+          it are merged, whatever the dissimilarity, and the other candidates are discarded.
+          \param merger The merger.
+          \param auxSegPtr An auxiliary segment, used as merge preview.
+          \param actSegsListHeadPtr A pointer the the active segments list head.
+          \return true if OK, false if aborted.
+         */
+        bool mergeSegments( const te::rp::DissimilarityTypeT maxDissimilarity,
+          const unsigned int minSegmentSize,
+          SegmenterRegionGrowingWishartMerger& merger,
+          te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* auxSegPtr,
+          te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >** actSegsListHeadPtr );
+
+        /*!
+          \brief Prepare the merge candidates heap for the minimum segment size step.
+          \details The stale candidates and the ones with both segments at least
+          @a minSegmentSize are discarded, the rejected candidates dissimilarities
+          are computed, and the heap is rebuilt.
+          \param minSegmentSize The minimum segment size.
+          \param merger The merger, without rejection bound.
+          \param auxSegPtr An auxiliary segment, used as merge preview.
+         */
+        void resolveRejectedCandidates( const unsigned int minSegmentSize,
+          SegmenterRegionGrowingWishartMerger& merger,
+          te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* auxSegPtr );
+
+        /*!
+          \brief Remove a segment absorbed by another one, after the features merge.
+          \details The labels forest, the adjacency graph and the active segments list are updated.
+          \param absorberPtr The absorber segment.
+          \param absorbedPtr The absorbed segment.
+          \param actSegsListHeadPtr A pointer the the active segments list head.
+         */
+        void removeAbsorbedSegment( te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* absorberPtr,
+          te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* absorbedPtr,
+          te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >** actSegsListHeadPtr );
+
+        /*!
+          \brief Merge the segments by rounds of mutual best neighbors merges, in parallel.
+          \details In each round, the best neighbor of each segment is found in
+          parallel. Segments that are the best neighbor of each other form disjoint
+          pairs, whose features are merged in parallel, then the labels, the
+          adjacency and the active segments list are updated serially, in the
+          active segments list order. The rounds stop when no pair is found. The
+          result does not depend on the threads number.
+          \param maxDissimilarity The dissimilarity threshold.
+          \param minSegmentSize If not zero, pairs with a segment smaller than it are merged
+          whatever the dissimilarity, and the other pairs are not merged.
+          \param actSegsListHeadPtr A pointer the the active segments list head.
+          \return true if OK, false if aborted.
+         */
+        bool mergeSegmentsInRounds( const te::rp::DissimilarityTypeT maxDissimilarity,
+          const unsigned int minSegmentSize,
+          te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >** actSegsListHeadPtr );
+
+        /*!
+          \brief Return the number of merging threads, the parameter limited by setMaxThreadsNumber.
+          \return The number of merging threads (at least 1).
+         */
+        unsigned int getMergingThreadsNumber() const;
+
+        /*!
+          \brief Run a merging rounds phase job by all merging threads and wait its end.
+          \details The calling thread runs the job with the thread index 0, the
+          merging engine workers run the other indexes.
+          \param job The job, called with each merging thread index.
+         */
+        void runMergingJob( const SegmenterEngine::JobT& job );
+
+        /*!
+          \brief Find the best neighbor of a range of the round segments.
+          \param threadIdx The thread index, the range index.
+          \param maxDissimilarity The dissimilarity threshold.
+          \param minSegmentSize If not zero, only neighbors forming a pair with a
+          segment smaller than it are considered, whatever the dissimilarity.
+         */
+        void findRoundBestNeighbors( const unsigned int threadIdx,
+          const te::rp::DissimilarityTypeT maxDissimilarity,
+          const unsigned int minSegmentSize );
+
+        /*!
+          \brief Merge the features of a range of the round pairs.
+          \param threadIdx The thread index, the range index.
+         */
+        void mergeRoundPairsFeatures( const unsigned int threadIdx );
+
+        /*!
+          \brief Return the root of a pixel in the labels union-find forest, compressing its path.
+          \param pixelIdx The block pixel index (line * width + column).
+          \return The root pixel index.
+         */
+        unsigned int findLabelRoot( const unsigned int pixelIdx );
+
+        /*!
+          \brief Replace the block local segments ids by unique segments ids, in the
+          active segments and in the segments IDs matrix.
           \param segmenterIdsManager A segments ids manager to acquire unique segments ids.
+          \param actSegsListHeadPtr The active segments list head.
+          \return true if OK, false on errors.
+         */
+        bool resolveLabels( te::rp::SegmenterIdsManager& segmenterIdsManager,
+          te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* actSegsListHeadPtr );
+
+        /*!
+          \brief Initialize the segment objects container and the segment IDs container.
+          \details Each segment gets the block local id of its pixel (pixel index + 1),
+          the unique ids are acquired by resolveLabels.
+          \param merger The merger, used to pack the pixels covariance matrices.
           \param block2ProcessInfo Info about the block to process.
           \param inputRaster The input raster.
           \param inputRasterBands Input raster bands to use.
           \param actSegsListHeadPtr A pointer the the active segments list head.
           \return true if OK, false on errors.
          */
-        bool initializeSegments( te::rp::SegmenterIdsManager& segmenterIdsManager,
+        bool initializeSegments( const SegmenterRegionGrowingWishartMerger& merger,
           const te::rp::SegmenterSegmentsBlock& block2ProcessInfo,
           const te::rst::Raster& inputRaster,
           const std::vector< unsigned int >& inputRasterBands,
@@ -173,10 +375,133 @@ namespace teradar {
          */
         te::rp::SegmenterRegionGrowingSegmentsPool< WishartFeatureType > m_segmentsPool;
 
+        /*!
+          \brief The number of segments allocated by the segments pool (default:0).
+         */
+        unsigned int m_segmentsPoolCapacity;
+
+        /*!
+          \brief The number of features of each segment allocated by the segments pool (default:0).
+         */
+        unsigned int m_segmentsPoolFeaturesSize;
+
         /*!
           \brief A internal segments IDs matrix that can be reused  on each strategy execution.
          */
         SegmentsIdsMatrixT m_segmentsIdsMatrix;
+
+        /*!
+          \brief The labels union-find forest, the parent pixel index of each block pixel.
+          \details While merging, the segments IDs matrix keeps the initial block local
+          ids and a merge only links the absorbed segment root pixel to the absorber one.
+         */
+        std::vector< unsigned int > m_labelsParents;
+
+        /*!
+          \brief The bands values of a block strip, band sequential, read at once by the segments initialization.
+         */
+        std::vector< std::complex< double > > m_blockBandsValues;
+
+        /*!
+          \brief The segment of each block pixel (null for pixels outside the block cut-off profiles).
+         */
+        std::vector< te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* > m_pixelsSegments;
+
+        /*!
+          \brief The segments adjacency, one node per block pixel (the segments local ids minus 1).
+         */
+        SegmenterRegionAdjacencyGraph m_adjacencyGraph;
+
+        /*!
+          \brief One merger per merging thread, used by the merging rounds.
+         */
+        std::vector< boost::shared_ptr< SegmenterRegionGrowingWishartMerger > > m_roundsMergers;
+
+        /*!
+          \brief The merging rounds workers, kept between the rounds phases and the execute calls (default:null).
+         */
+        boost::shared_ptr< SegmenterEngine > m_mergingEnginePtr;
+
+        /*!
+          \brief The processors of the thread that created the merging workers, their affinity (default:empty).
+         */
+        std::vector< unsigned int > m_mergingEngineCpus;
+
+        /*!
+          \brief One merge preview segment per merging thread, used by the merging rounds.
+         */
+        boost::scoped_array< te::rp::SegmenterRegionGrowingSegment< WishartFeatureType > > m_roundsPreviewSegments;
+
+        /*!
+          \brief The features of the merge preview segments.
+         */
+        std::vector< WishartFeatureType > m_roundsPreviewFeatures;
+
+        /*!
+          \brief The active segments of the current merging round.
+         */
+        std::vector< te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* > m_roundSegments;
+
+        /*!
+          \brief The best neighbor node of each graph node in the current merging round.
+         */
+        std::vector< SegmenterRegionAdjacencyGraph::NodeIndexT > m_roundBestNeighbors;
+
+        /*!
+          \brief The (absorber, absorbed) segments pairs of the current merging round.
+         */
+        std::vector< std::pair< te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >*,
+          te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* > > m_roundPairs;
+
+        /*!
+          \brief The active segments list head of the last processed block (default:0).
+         */
+        te::rp::SegmenterRegionGrowingSegment< WishartFeatureType >* m_lastActSegsListHeadPtr;
+
+        /*!
+          \brief The first raster column of the last processed block.
+         */
+        unsigned int m_lastBlockStartX;
+
+        /*!
+          \brief The first raster line of the last processed block.
+         */
+        unsigned int m_lastBlockStartY;
+
+        /*!
+          \brief The number of features of the last processed block segments.
+         */
+        unsigned int m_lastFeaturesNumber;
+
+        /*!
+          \brief The likelihood-ratio statistic bound of the merging confidence level (default:0).
+         */
+        double m_rejectionBound;
+
+        /*!
+          \brief The number of features m_rejectionBound was computed for (default:0 - not computed).
+         */
+        unsigned int m_rejectionBoundFeaturesNumber;
+
+        /*!
+          \brief A pointer to the flag that aborts the running execute call (default:0).
+         */
+        boost::atomic< bool > const* m_abortFlagPtr;
+
+        /*!
+          \brief The maximum number of threads of each execute call (default:0 - no limit).
+         */
+        unsigned int m_maxThreadsNumber;
+
+        /*!
+          \brief The merge candidates min-heap, its memory is reused on each strategy execution.
+         */
+        std::vector< MergeCandidate > m_mergeCandidates;
+
+        /*!
+          \brief The merge candidates heap size that triggers the removal of the stale candidates.
+         */
+        std::size_t m_mergeCandidatesCompactionSize;
       };
 
     /*!
@@ -32,6 +32,220 @@ TEST( InitMethods, loadTerralib )
   teradar::common::loadTerraLibDrivers();
 }
 
+namespace
+{
+  // Creates a single band "MEM" raster, each pixel value is ( column, line ).
+  te::rst::Raster* CreateSyntheticRaster( unsigned int cols, unsigned int rows )
+  {
+    std::vector<te::rst::BandProperty*> bandsProperties;
+    bandsProperties.push_back( new te::rst::BandProperty( 0, te::dt::CDOUBLE_TYPE ) );
+
+    std::map<std::string, std::string> rasterInfo;
+    te::rst::Raster* raster( te::rst::RasterFactory::make( "MEM",
+      new te::rst::Grid( cols, rows ), bandsProperties, rasterInfo ) );
+
+    for( unsigned int r = 0; r < rows; ++r ) {
+      for( unsigned int c = 0; c < cols; ++c ) {
+        raster->setValue( c, r, std::complex<double>( c, r ), 0 );
+      }
+    }
+
+    return raster;
+  }
+}
+
+TEST( MultiResolution, multilookFactorsTest )
+{
+  std::auto_ptr<te::rst::Raster> inputRaster( CreateSyntheticRaster( 8, 6 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  // 3 azimuth looks x 2 range looks boxcar
+  teradar::common::MultiResolution::Parameters boxcarParameters;
+  boxcarParameters.m_rowsFactor = 3;
+  boxcarParameters.m_colsFactor = 2;
+
+  teradar::common::MultiResolution boxcarMultiRes( *inputRaster, 1, boxcarParameters );
+
+  size_t rows = 0;
+  size_t cols = 0;
+  EXPECT_TRUE( boxcarMultiRes.getNumberOfLinesAndColumns( 1, rows, cols ) );
+  EXPECT_EQ( 2, rows );
+  EXPECT_EQ( 4, cols );
+
+  double eps = 1e-9;
+  std::complex<double> value;
+
+  boxcarMultiRes.getLevel( 1 )->getValue( 1, 1, value );
+  EXPECT_NEAR( value.real(), 2.5, eps );
+  EXPECT_NEAR( value.imag(), 4.0, eps );
+
+  // overlapped 1-2-1 window over columns, clipped at the borders
+  teradar::common::MultiResolution::Parameters weightedParameters;
+  weightedParameters.m_rowsFactor = 1;
+  weightedParameters.m_colsFactor = 1;
+  weightedParameters.m_colsWindowSize = 3;
+  weightedParameters.m_colsWeights.push_back( 1. );
+  weightedParameters.m_colsWeights.push_back( 2. );
+  weightedParameters.m_colsWeights.push_back( 1. );
+
+  teradar::common::MultiResolution weightedMultiRes( *inputRaster, 1, weightedParameters );
+
+  weightedMultiRes.getLevel( 1 )->getValue( 0, 2, value );
+  EXPECT_NEAR( value.real(), 1. / 3., eps );
+  EXPECT_NEAR( value.imag(), 2.0, eps );
+
+  weightedMultiRes.getLevel( 1 )->getValue( 4, 2, value );
+  EXPECT_NEAR( value.real(), 4.0, eps );
+
+  // windows smaller than the factors are not accepted
+  teradar::common::MultiResolution::Parameters invalidParameters;
+  invalidParameters.m_rowsWindowSize = 1;
+  EXPECT_FALSE( invalidParameters.isValid() );
+}
+
+TEST( MultiResolution, tilesTest )
+{
+  std::auto_ptr<te::rst::Raster> inputRaster( CreateSyntheticRaster( 50, 40 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  teradar::common::MultiResolution::Parameters parameters;
+  parameters.m_tileSize = 8;
+  parameters.m_maxCachedTiles = 4;
+
+  teradar::common::MultiResolution levelsMultiRes( *inputRaster, 3, parameters );
+
+  // without levels rasters, tiles are computed from the parent tiles
+  parameters.m_createLevels = false;
+  teradar::common::MultiResolution tilesMultiRes( *inputRaster, 3, parameters );
+  EXPECT_TRUE( tilesMultiRes.getLevel( 2 ) == NULL );
+
+  unsigned int tilesX = 0;
+  unsigned int tilesY = 0;
+  EXPECT_TRUE( tilesMultiRes.getNumberOfTiles( 2, tilesX, tilesY ) );
+  EXPECT_EQ( 2, tilesX );
+  EXPECT_EQ( 2, tilesY );
+
+  teradar::common::MultiResolution::TilePtr tile = tilesMultiRes.getTile( 2, 1, 1 );
+  ASSERT_TRUE( tile.get() != NULL );
+  EXPECT_EQ( 2, tile->m_rows );
+  EXPECT_EQ( 4, tile->m_cols );
+
+  double eps = 1e-9;
+  std::complex<double> value;
+
+  for( unsigned int r = 0; r < tile->m_rows; ++r ) {
+    for( unsigned int c = 0; c < tile->m_cols; ++c ) {
+      levelsMultiRes.getLevel( 2 )->getValue( tile->m_colStart + c, tile->m_rowStart + r, value );
+      EXPECT_NEAR( value.real(), tile->getBandValues( 0 )[ r * tile->m_cols + c ].real(), eps );
+      EXPECT_NEAR( value.imag(), tile->getBandValues( 0 )[ r * tile->m_cols + c ].imag(), eps );
+    }
+  }
+
+  // cached tiles are shared
+  EXPECT_TRUE( tilesMultiRes.getTile( 2, 1, 1 ) == tile );
+  EXPECT_TRUE( tilesMultiRes.getTile( 2, 2, 1 ).get() == NULL );
+}
+
+TEST( MultiResolution, updateTest )
+{
+  std::auto_ptr<te::rst::Raster> inputRaster( CreateSyntheticRaster( 40, 40 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  teradar::common::MultiResolution::Parameters parameters;
+  parameters.m_rowsWindowSize = 3;
+  parameters.m_colsWindowSize = 3;
+  parameters.m_tileSize = 4;
+
+  teradar::common::MultiResolution multiRes( *inputRaster, 3, parameters );
+
+  teradar::common::MultiResolution::TilePtr oldTile = multiRes.getTile( 3, 0, 0 );
+  ASSERT_TRUE( oldTile.get() != NULL );
+
+  // patch a level 0 region
+  for( unsigned int r = 10; r < 13; ++r ) {
+    for( unsigned int c = 20; c < 22; ++c ) {
+      inputRaster->setValue( c, r, std::complex<double>( 100., -100. ), 0 );
+    }
+  }
+
+  EXPECT_TRUE( multiRes.update( 20, 10, 22, 13 ) );
+  EXPECT_FALSE( multiRes.update( 20, 10, 41, 13 ) );
+
+  teradar::common::MultiResolution rebuiltMultiRes( *inputRaster, 3, parameters );
+
+  double eps = 1e-9;
+  std::complex<double> value;
+  std::complex<double> rebuiltValue;
+
+  for( size_t l = 1; l < 4; ++l ) {
+    size_t rows = 0;
+    size_t cols = 0;
+    EXPECT_TRUE( multiRes.getNumberOfLinesAndColumns( l, rows, cols ) );
+
+    for( unsigned int r = 0; r < rows; ++r ) {
+      for( unsigned int c = 0; c < cols; ++c ) {
+        multiRes.getLevel( l )->getValue( c, r, value );
+        rebuiltMultiRes.getLevel( l )->getValue( c, r, rebuiltValue );
+        EXPECT_NEAR( value.real(), rebuiltValue.real(), eps );
+        EXPECT_NEAR( value.imag(), rebuiltValue.imag(), eps );
+      }
+    }
+  }
+
+  // the dirty tile was discarded
+  teradar::common::MultiResolution::TilePtr newTile = multiRes.getTile( 3, 0, 0 );
+  EXPECT_TRUE( newTile != oldTile );
+
+  rebuiltMultiRes.getLevel( 3 )->getValue( 2, 1, rebuiltValue );
+  EXPECT_NEAR( newTile->getBandValues( 0 )[ 1 * newTile->m_cols + 2 ].real(),
+    rebuiltValue.real(), eps );
+}
+
+TEST( MultiResolution, arenaTest )
+{
+  std::auto_ptr<te::rst::Raster> inputRaster( CreateSyntheticRaster( 32, 16 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  teradar::common::MultiResolution::Parameters parameters;
+  boost::shared_ptr<teradar::common::MemoryArena> arena( new teradar::common::MemoryArena );
+
+  size_t capacity = 0;
+
+  // consecutive instances reuse the same arena memory
+  for( unsigned int i = 0; i < 3; ++i ) {
+    teradar::common::MultiResolution multiRes( *inputRaster, 2, parameters, arena );
+
+    EXPECT_TRUE( arena->getUsed() > 0 );
+
+    if( i == 0 ) {
+      capacity = arena->getCapacity();
+    }
+    EXPECT_EQ( capacity, arena->getCapacity() );
+
+    std::complex<double> value;
+    multiRes.getLevel( 2 )->getValue( 1, 1, value );
+    EXPECT_NEAR( value.real(), 5.5, 1e-9 );
+    EXPECT_NEAR( value.imag(), 5.5, 1e-9 );
+  }
+
+  // the levels memory was given back by the destructor
+  EXPECT_EQ( arena->getUsed(), 0 );
+
+  teradar::common::MemoryArena alignedArena;
+  EXPECT_TRUE( alignedArena.allocate( 8 ) == NULL );
+  EXPECT_TRUE( alignedArena.reserve( 1000 ) );
+
+  void* first = alignedArena.allocate( 10 );
+  void* second = alignedArena.allocate( 10, 64 );
+  EXPECT_TRUE( first != NULL );
+  EXPECT_TRUE( second != NULL );
+  EXPECT_EQ( ( (size_t)second ) % 64, 0 );
+  EXPECT_TRUE( alignedArena.allocate( alignedArena.getCapacity() ) == NULL );
+
+  alignedArena.release();
+  EXPECT_EQ( alignedArena.getCapacity(), 0 );
+}
+
 /*TEST( MultiResolution, basicTests )
 {
   // open the input raster
@@ -18,10 +18,21 @@ TerraRadar is under development.
 #include "Utils.hpp"
 
 // TerraLib includes
+#include <terralib/common/MatrixUtils.h>
 #include <terralib/common/TerraLib.h>
 #include <terralib/rp/Functions.h>
 #include <terralib/plugin.h>
 
+// Boost includes
+#include <boost/numeric/ublas/matrix.hpp>
+
+// STL includes
+#include <cmath>
+#include <complex>
+#include <map>
+#include <memory>
+#include <vector>
+
 // Gtest includes
 #include <gtest/gtest.h>
 
@@ -253,4 +264,149 @@ TEST( RadarFunctions, computeMinCompLevelENL )
   EXPECT_EQ( p2.first, 3 );
   EXPECT_EQ( p2.second, 7.65 );
 }
-*/
\ No newline at end of file
+*/
+
+namespace
+{
+  // Creates a single band "MEM" raster with the given values, in lines order.
+  te::rst::Raster* CreateComplexValuesRaster( const std::vector<std::complex<double> >& values,
+    unsigned int cols, unsigned int rows )
+  {
+    std::vector<te::rst::BandProperty*> bandsProperties;
+    bandsProperties.push_back( new te::rst::BandProperty( 0, te::dt::CDOUBLE_TYPE ) );
+
+    std::map<std::string, std::string> rasterInfo;
+    te::rst::Raster* raster( te::rst::RasterFactory::make( "MEM",
+      new te::rst::Grid( cols, rows ), bandsProperties, rasterInfo ) );
+
+    for( unsigned int r = 0; r < rows; ++r ) {
+      for( unsigned int c = 0; c < cols; ++c ) {
+        raster->setValue( c, r, values[ r * cols + c ], 0 );
+      }
+    }
+
+    return raster;
+  }
+
+  // Dual-pol S1 and S2 values of a 3 x 2 raster.
+  void GetDualPolValues( std::vector<std::complex<double> >& s1Values,
+    std::vector<std::complex<double> >& s2Values )
+  {
+    s1Values.clear();
+    s2Values.clear();
+
+    for( unsigned int idx = 0; idx < 6; ++idx ) {
+      s1Values.push_back( std::complex<double>( 1.0 + idx, 0.5 * idx - 1.0 ) );
+      s2Values.push_back( std::complex<double>( 0.3 * idx - 0.7, 2.0 - 0.25 * idx ) );
+    }
+  }
+}
+
+TEST( RadarFunctions, createDualPolCovarianceTest )
+{
+  std::vector<std::complex<double> > s1Values;
+  std::vector<std::complex<double> > s2Values;
+  GetDualPolValues( s1Values, s2Values );
+
+  std::auto_ptr<te::rst::Raster> s1Raster( CreateComplexValuesRaster( s1Values, 3, 2 ) );
+  std::auto_ptr<te::rst::Raster> s2Raster( CreateComplexValuesRaster( s2Values, 3, 2 ) );
+  ASSERT_TRUE( s1Raster.get() != NULL );
+  ASSERT_TRUE( s2Raster.get() != NULL );
+
+  std::vector<te::rst::Raster*> inputRasters;
+  inputRasters.push_back( s1Raster.get() );
+  inputRasters.push_back( s2Raster.get() );
+
+  std::vector<unsigned int> inputBands( 2, 0 );
+
+  std::auto_ptr<te::rst::Raster> covMatrixRaster;
+  std::map<std::string, std::string> covRasterInfo;
+
+  ASSERT_TRUE( teradar::common::CreateCovarianceRaster( inputRasters, inputBands, covRasterInfo, "MEM", covMatrixRaster ) );
+  ASSERT_TRUE( covMatrixRaster.get() != NULL );
+  ASSERT_EQ( 4, covMatrixRaster->getNumberOfBands() );
+  EXPECT_EQ( 2, covMatrixRaster->getNumberOfRows() );
+  EXPECT_EQ( 3, covMatrixRaster->getNumberOfColumns() );
+
+  double eps = 1e-9;
+  std::complex<double> value;
+
+  // all pixels, the last line and column included
+  for( unsigned int r = 0; r < 2; ++r ) {
+    for( unsigned int c = 0; c < 3; ++c ) {
+      const std::complex<double>& s1 = s1Values[ r * 3 + c ];
+      const std::complex<double>& s2 = s2Values[ r * 3 + c ];
+
+      // |S1|^2
+      covMatrixRaster->getBand( 0 )->getValue( c, r, value );
+      EXPECT_NEAR( value.real(), std::norm( s1 ), eps );
+      EXPECT_NEAR( value.imag(), 0.0, eps );
+
+      // S1.S2*
+      covMatrixRaster->getBand( 1 )->getValue( c, r, value );
+      EXPECT_NEAR( value.real(), ( s1 * std::conj( s2 ) ).real(), eps );
+      EXPECT_NEAR( value.imag(), ( s1 * std::conj( s2 ) ).imag(), eps );
+
+      // S2.S1*
+      covMatrixRaster->getBand( 2 )->getValue( c, r, value );
+      EXPECT_NEAR( value.real(), ( s2 * std::conj( s1 ) ).real(), eps );
+      EXPECT_NEAR( value.imag(), ( s2 * std::conj( s1 ) ).imag(), eps );
+
+      // |S2|^2
+      covMatrixRaster->getBand( 3 )->getValue( c, r, value );
+      EXPECT_NEAR( value.real(), std::norm( s2 ), eps );
+      EXPECT_NEAR( value.imag(), 0.0, eps );
+    }
+  }
+}
+
+TEST( RadarFunctions, dualPolCovarianceDeterminantTest )
+{
+  std::vector<std::complex<double> > s1Values;
+  std::vector<std::complex<double> > s2Values;
+  GetDualPolValues( s1Values, s2Values );
+
+  std::auto_ptr<te::rst::Raster> s1Raster( CreateComplexValuesRaster( s1Values, 3, 2 ) );
+  std::auto_ptr<te::rst::Raster> s2Raster( CreateComplexValuesRaster( s2Values, 3, 2 ) );
+  ASSERT_TRUE( s1Raster.get() != NULL );
+  ASSERT_TRUE( s2Raster.get() != NULL );
+
+  std::vector<te::rst::Raster*> inputRasters;
+  inputRasters.push_back( s1Raster.get() );
+  inputRasters.push_back( s2Raster.get() );
+
+  std::vector<unsigned int> inputBands( 2, 0 );
+
+  std::auto_ptr<te::rst::Raster> covMatrixRaster;
+  std::map<std::string, std::string> covRasterInfo;
+
+  ASSERT_TRUE( teradar::common::CreateCovarianceRaster( inputRasters, inputBands, covRasterInfo, "MEM", covMatrixRaster ) );
+  ASSERT_TRUE( covMatrixRaster.get() != NULL );
+
+  // the single pixel matrices are singular, the 6 pixels mean is not
+  boost::numeric::ublas::matrix<std::complex<double> > covMatrix( 2, 2 );
+  std::complex<double> value;
+
+  for( unsigned int bandIdx = 0; bandIdx < 4; ++bandIdx ) {
+    covMatrix( bandIdx / 2, bandIdx % 2 ) = 0.0;
+
+    for( unsigned int r = 0; r < 2; ++r ) {
+      for( unsigned int c = 0; c < 3; ++c ) {
+        covMatrixRaster->getBand( bandIdx )->getValue( c, r, value );
+        covMatrix( bandIdx / 2, bandIdx % 2 ) += value / 6.0;
+      }
+    }
+  }
+
+  std::complex<double> expectedDet;
+  ASSERT_TRUE( te::common::GetDeterminant< std::complex<double> >( covMatrix, expectedDet ) );
+
+  // C11 * C22 - |C12|^2
+  const double closedFormDet = covMatrix( 0, 0 ).real() * covMatrix( 1, 1 ).real() -
+    std::norm( covMatrix( 0, 1 ) );
+
+  double eps = 1e-9;
+  EXPECT_GT( closedFormDet, eps );
+  EXPECT_NEAR( closedFormDet, expectedDet.real(), eps * std::fabs( closedFormDet ) );
+  EXPECT_NEAR( 0.0, expectedDet.imag(), eps * std::fabs( closedFormDet ) );
+}
@@ -6,8 +6,8 @@ TerraRadar is under development.
 */
 
 /*!
-\file terraradar/tests/unittest/common/radarFunctions_unitTest.cpp
-\brief A test suite for the functions that handles Radar data.
+\file terraradar/tests/unittest/segmenter/multiLevelSegmenter_unitTest.cpp
+\brief A test suite for the MultiLevelSegmenter class.
 */
 #include "stdlib.h"
 // TerraRadar includes
@@ -16,6 +16,7 @@ TerraRadar is under development.
 #include "SegmenterRegionGrowingWishartStrategy.hpp"
 
 #include "BuildConfig.hpp"
+#include "CancellationToken.hpp"
 #include "Functions.hpp"
 #include "RadarFunctions.hpp"
 #include "Utils.hpp"
@@ -26,9 +27,155 @@ TerraRadar is under development.
 #include <terralib/common/TerraLib.h>
 #include <terralib/plugin.h>
 
+#include <terralib/raster.h>
+
+// Boost includes
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/numeric/ublas/matrix.hpp>
+#include <boost/shared_ptr.hpp>
+
+// STL includes
+#include <complex>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
 // Gtest includes
 #include <gtest/gtest.h>
 
+namespace
+{
+  // Creates a 9 bands (3 x 3 covariance matrix) "MEM" raster with a left
+  // half region and a right half region, both homogeneous.
+  te::rst::Raster* CreateTwoRegionsCovarianceRaster( const unsigned int cols, const unsigned int rows )
+  {
+    boost::numeric::ublas::matrix< std::complex< double > > matrix( 3, 3 );
+    matrix( 0, 0 ) = 1.0;
+    matrix( 0, 1 ) = std::complex< double >( 0.2, 0.1 );
+    matrix( 0, 2 ) = std::complex< double >( 0.1, -0.05 );
+    matrix( 1, 1 ) = 0.5;
+    matrix( 1, 2 ) = 0.0;
+    matrix( 2, 2 ) = 0.25;
+    matrix( 1, 0 ) = std::conj( matrix( 0, 1 ) );
+    matrix( 2, 0 ) = std::conj( matrix( 0, 2 ) );
+    matrix( 2, 1 ) = std::conj( matrix( 1, 2 ) );
+
+    std::vector< te::rst::BandProperty* > bandsProperties;
+
+    for( unsigned int bandIdx = 0; bandIdx < 9; ++bandIdx ) {
+      bandsProperties.push_back( new te::rst::BandProperty( bandIdx, te::dt::CDOUBLE_TYPE ) );
+    }
+
+    std::map< std::string, std::string > rasterInfo;
+    te::rst::Raster* raster( te::rst::RasterFactory::make( "MEM",
+      new te::rst::Grid( cols, rows ), bandsProperties, rasterInfo ) );
+
+    if( raster == 0 ) {
+      return 0;
+    }
+
+    for( unsigned int r = 0; r < rows; ++r ) {
+      for( unsigned int c = 0; c < cols; ++c ) {
+        const double scale = ( c < cols / 2 ) ? 1.0 : 100.0;
+
+        for( unsigned int bandIdx = 0; bandIdx < 9; ++bandIdx ) {
+          raster->setValue( c, r, matrix( bandIdx / 3, bandIdx % 3 ) * scale, bandIdx );
+        }
+      }
+    }
+
+    return raster;
+  }
+
+  // Single thread, single block, Wishart strategy parameters.
+  teradar::segmenter::MultiLevelSegmenter::InputParameters GetCovarianceInputParameters(
+    const te::rst::Raster& inputRaster, const double enlLZero )
+  {
+    teradar::segmenter::SegmenterRegionGrowingWishartStrategy::Parameters strategyParameters;
+    strategyParameters.m_minSegmentSize = 1;
+    strategyParameters.m_dataType = teradar::common::CovarianceMatrixT;
+    strategyParameters.m_enlLZero = enlLZero;
+    strategyParameters.m_compressionLevel = 0;
+    strategyParameters.m_connectivityType = teradar::common::VonNeumannNT;
+
+    teradar::segmenter::MultiLevelSegmenter::InputParameters algoInputParams;
+    algoInputParams.m_inputRasterPtr = &inputRaster;
+
+    for( unsigned int bandIdx = 0; bandIdx < 9; ++bandIdx ) {
+      algoInputParams.m_inputRasterBands.push_back( bandIdx );
+    }
+
+    algoInputParams.m_enableThreadedProcessing = false;
+    algoInputParams.m_enableBlockProcessing = false;
+    algoInputParams.m_strategyName = "RegionGrowingWishart";
+    algoInputParams.setSegStrategyParams( strategyParameters );
+
+    return algoInputParams;
+  }
+
+  // Executes the segmenter into a "MEM" raster, the labels are read in lines order
+  // when an output raster was created.
+  bool ExecuteSegmenter( const teradar::segmenter::MultiLevelSegmenter::InputParameters& algoInputParams,
+    teradar::segmenter::MultiLevelSegmenter::OutputParameters& algoOutputParams,
+    std::vector< unsigned int >& labels )
+  {
+    algoOutputParams.m_rType = "MEM";
+
+    teradar::segmenter::MultiLevelSegmenter algorithmInstance;
+
+    if( !algorithmInstance.initialize( algoInputParams ) ||
+      !algorithmInstance.execute( algoOutputParams ) ) {
+      return false;
+    }
+
+    labels.clear();
+
+    if( algoOutputParams.m_outputRasterPtr.get() == 0 ) {
+      return true;
+    }
+
+    const unsigned int rows = algoOutputParams.m_outputRasterPtr->getNumberOfRows();
+    const unsigned int cols = algoOutputParams.m_outputRasterPtr->getNumberOfColumns();
+    double value = 0;
+
+    labels.resize( rows * cols );
+
+    for( unsigned int r = 0; r < rows; ++r ) {
+      for( unsigned int c = 0; c < cols; ++c ) {
+        algoOutputParams.m_outputRasterPtr->getValue( c, r, value, 0 );
+        labels[ r * cols + c ] = (unsigned int)value;
+      }
+    }
+
+    return true;
+  }
+
+  // True if both labelings split the pixels into the same segments,
+  // whatever the segments IDs are.
+  bool HaveSamePartition( const std::vector< unsigned int >& labels1,
+    const std::vector< unsigned int >& labels2 )
+  {
+    if( labels1.size() != labels2.size() ) {
+      return false;
+    }
+
+    std::map< unsigned int, unsigned int > labels1To2;
+    std::map< unsigned int, unsigned int > labels2To1;
+
+    for( std::size_t idx = 0; idx < labels1.size(); ++idx ) {
+      if( ( labels1To2.insert( std::make_pair( labels1[ idx ], labels2[ idx ] ) ).first->second !=
+        labels2[ idx ] ) ||
+        ( labels2To1.insert( std::make_pair( labels2[ idx ], labels1[ idx ] ) ).first->second !=
+        labels1[ idx ] ) ) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
+
 /*TEST( MultiLevelSegmenter, xxxTest )
 {
   // Progress interface
@@ -102,4 +249,98 @@ TEST( EndMethods, finalizeTerralib )
   te::plugin::PluginManager::getInstance().unloadAll();
   TerraLib::getInstance().finalize();
   system("pause");
-}*/
\ No newline at end of file
+}*/
+
+TEST( MultiLevelSegmenter, multiLevelTest )
+{
+  std::auto_ptr< te::rst::Raster > inputRaster( CreateTwoRegionsCovarianceRaster( 32, 32 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  // a single look, so a coarser level is segmented first
+  teradar::segmenter::MultiLevelSegmenter::InputParameters algoInputParams =
+    GetCovarianceInputParameters( *inputRaster, 1.0 );
+
+  teradar::segmenter::MultiLevelSegmenter::OutputParameters singleLevelOutputParams;
+  std::vector< unsigned int > singleLevelLabels;
+  ASSERT_TRUE( ExecuteSegmenter( algoInputParams, singleLevelOutputParams, singleLevelLabels ) );
+
+  algoInputParams.m_enableMultiLevelProcessing = true;
+
+  teradar::segmenter::MultiLevelSegmenter::OutputParameters multiLevelOutputParams;
+  std::vector< unsigned int > multiLevelLabels;
+  ASSERT_TRUE( ExecuteSegmenter( algoInputParams, multiLevelOutputParams, multiLevelLabels ) );
+
+  EXPECT_EQ( teradar::segmenter::MultiLevelSegmenter::CompletedStatus,
+    multiLevelOutputParams.m_status );
+  ASSERT_EQ( 32u * 32u, multiLevelLabels.size() );
+  EXPECT_TRUE( HaveSamePartition( singleLevelLabels, multiLevelLabels ) );
+  EXPECT_NE( multiLevelLabels[ 0 ], multiLevelLabels[ 31 ] );
+}
+
+TEST( MultiLevelSegmenter, blocksSeamsMergingTest )
+{
+  std::auto_ptr< te::rst::Raster > inputRaster( CreateTwoRegionsCovarianceRaster( 32, 32 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  teradar::segmenter::MultiLevelSegmenter::InputParameters algoInputParams =
+    GetCovarianceInputParameters( *inputRaster, 16.0 );
+  algoInputParams.m_enableBlockProcessing = true;
+  algoInputParams.m_maxBlockSize = 8;
+  algoInputParams.m_blocksOverlapPercent = 0;
+  algoInputParams.m_enableBlocksSeamsMerging = true;
+
+  teradar::segmenter::MultiLevelSegmenter::OutputParameters algoOutputParams;
+  std::vector< unsigned int > labels;
+  ASSERT_TRUE( ExecuteSegmenter( algoInputParams, algoOutputParams, labels ) );
+  ASSERT_EQ( 32u * 32u, labels.size() );
+  EXPECT_GT( algoOutputParams.m_totalBlocksNumber, 1u );
+
+  // no segment boundary left along the blocks seams inside each region
+  for( unsigned int r = 0; r < 32; ++r ) {
+    for( unsigned int c = 0; c < 32; ++c ) {
+      EXPECT_EQ( labels[ ( c < 16 ) ? 0 : 16 ], labels[ r * 32 + c ] );
+    }
+  }
+
+  EXPECT_NE( labels[ 0 ], labels[ 16 ] );
+}
+
+TEST( MultiLevelSegmenter, cancelledTokenTest )
+{
+  std::auto_ptr< te::rst::Raster > inputRaster( CreateTwoRegionsCovarianceRaster( 32, 32 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  teradar::segmenter::MultiLevelSegmenter::InputParameters algoInputParams =
+    GetCovarianceInputParameters( *inputRaster, 16.0 );
+  algoInputParams.m_cancellationTokenPtr.reset( new teradar::common::CancellationToken );
+  algoInputParams.m_cancellationTokenPtr->cancel();
+
+  // a stopped execution is not an error, the output keeps the labels produced so far
+  teradar::segmenter::MultiLevelSegmenter::OutputParameters algoOutputParams;
+  std::vector< unsigned int > labels;
+  ASSERT_TRUE( ExecuteSegmenter( algoInputParams, algoOutputParams, labels ) );
+
+  EXPECT_EQ( teradar::segmenter::MultiLevelSegmenter::CancelledStatus, algoOutputParams.m_status );
+  ASSERT_TRUE( algoOutputParams.m_outputRasterPtr.get() != NULL );
+  EXPECT_EQ( 32u * 32u, labels.size() );
+  EXPECT_EQ( 0u, algoOutputParams.m_segmentedBlocksNumber );
+}
+
+TEST( MultiLevelSegmenter, pastDeadlineTest )
+{
+  std::auto_ptr< te::rst::Raster > inputRaster( CreateTwoRegionsCovarianceRaster( 32, 32 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  teradar::segmenter::MultiLevelSegmenter::InputParameters algoInputParams =
+    GetCovarianceInputParameters( *inputRaster, 16.0 );
+  algoInputParams.m_deadline = boost::posix_time::microsec_clock::universal_time() -
+    boost::posix_time::seconds( 1 );
+
+  teradar::segmenter::MultiLevelSegmenter::OutputParameters algoOutputParams;
+  std::vector< unsigned int > labels;
+  ASSERT_TRUE( ExecuteSegmenter( algoInputParams, algoOutputParams, labels ) );
+
+  EXPECT_EQ( teradar::segmenter::MultiLevelSegmenter::DeadlineExceededStatus, algoOutputParams.m_status );
+  ASSERT_TRUE( algoOutputParams.m_outputRasterPtr.get() != NULL );
+  EXPECT_EQ( 32u * 32u, labels.size() );
+}
@@ -0,0 +1,362 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+\file terraradar/tests/unittest/segmenter/segmenterRegionGrowingWishartMerger_unitTest.cpp
+\brief A test suite for the SegmenterRegionGrowingWishartMerger class.
+*/
+
+// TerraRadar includes
+#include "SegmenterRegionGrowingWishartMerger.hpp"
+
+// TerraLib includes
+#include <terralib/common/MatrixUtils.h>
+
+// Boost includes
+#include <boost/math/distributions/chi_squared.hpp>
+#include <boost/numeric/ublas/matrix.hpp>
+
+// STL includes
+#include <cmath>
+#include <complex>
+#include <vector>
+
+// Gtest includes
+#include <gtest/gtest.h>
+
+namespace
+{
+  // Exposes the merger protected methods to the tests.
+  class WishartMergerTester : public teradar::segmenter::SegmenterRegionGrowingWishartMerger
+  {
+    public:
+      WishartMergerTester( const unsigned int featuresNumber, const double& numberOfLooks,
+        const bool enableAzimutalSimetry = false )
+        : teradar::segmenter::SegmenterRegionGrowingWishartMerger( featuresNumber,
+          numberOfLooks, enableAzimutalSimetry )
+      {
+      }
+
+      using teradar::segmenter::SegmenterRegionGrowingWishartMerger::getClosedFormDeterminant;
+      using teradar::segmenter::SegmenterRegionGrowingWishartMerger::unpackCovariance;
+  };
+
+  // A non singular covariance matrix, A.A^H + I for a known complex matrix A.
+  boost::numeric::ublas::matrix< std::complex< double > > GetKnownCovariance(
+    const unsigned int order, const unsigned int seed )
+  {
+    boost::numeric::ublas::matrix< std::complex< double > > aMatrix( order, order );
+
+    for( unsigned int row = 0; row < order; ++row ) {
+      for( unsigned int col = 0; col < order; ++col ) {
+        aMatrix( row, col ) = std::complex< double >( 1.0 + 0.3 * ( ( 7 * row + 3 * col + seed ) % 5 ),
+          0.4 * ( (double)( ( row + 2 * col + seed ) % 3 ) - 1.0 ) );
+      }
+    }
+
+    boost::numeric::ublas::matrix< std::complex< double > > matrix( order, order );
+
+    for( unsigned int row = 0; row < order; ++row ) {
+      for( unsigned int col = 0; col < order; ++col ) {
+        matrix( row, col ) = ( row == col ) ? 1.0 : 0.0;
+
+        for( unsigned int idx = 0; idx < order; ++idx ) {
+          matrix( row, col ) += aMatrix( row, idx ) * std::conj( aMatrix( col, idx ) );
+        }
+      }
+    }
+
+    return matrix;
+  }
+
+  // The covariance matrix elements in the input bands order, the element
+  // ( row, col ) is the band col * order + row.
+  std::vector< std::complex< double > > GetBandsElements(
+    const boost::numeric::ublas::matrix< std::complex< double > >& matrix )
+  {
+    const unsigned int order = (unsigned int)matrix.size1();
+    std::vector< std::complex< double > > elements( order * order );
+
+    for( unsigned int row = 0; row < order; ++row ) {
+      for( unsigned int col = 0; col < order; ++col ) {
+        elements[ col * order + row ] = matrix( row, col );
+      }
+    }
+
+    return elements;
+  }
+
+  // The dissimilarity as computed before the features packing, from the
+  // full complex covariance matrices (the element ( row, col ) of a segment
+  // was its feature col * order + row).
+  double GetFullComplexDissimilarity( const std::vector< std::complex< double > >& segment1Elements,
+    const unsigned int segment1Size, const std::vector< std::complex< double > >& segment2Elements,
+    const unsigned int segment2Size, const double numberOfLooks )
+  {
+    const unsigned int order = (unsigned int)std::sqrt( (double)segment1Elements.size() );
+
+    boost::numeric::ublas::matrix< std::complex< double > > segment1Matrix( order, order );
+    boost::numeric::ublas::matrix< std::complex< double > > segment2Matrix( order, order );
+
+    for( unsigned int row = 0; row < order; ++row ) {
+      for( unsigned int col = 0; col < order; ++col ) {
+        segment1Matrix( row, col ) = segment1Elements[ col * order + row ];
+        segment2Matrix( row, col ) = segment2Elements[ col * order + row ];
+      }
+    }
+
+    boost::numeric::ublas::matrix< std::complex< double > > segmentUMatrix( segment1Matrix + segment2Matrix );
+
+    std::complex< double > seg1Det;
+    std::complex< double > seg2Det;
+    std::complex< double > segUDet;
+    te::common::GetDeterminant< std::complex< double > >( segment1Matrix, seg1Det );
+    te::common::GetDeterminant< std::complex< double > >( segment2Matrix, seg2Det );
+    te::common::GetDeterminant< std::complex< double > >( segmentUMatrix, segUDet );
+
+    const double n1 = segment1Size * numberOfLooks;
+    const double n2 = segment2Size * numberOfLooks;
+    const double nu = n1 + n2;
+
+    const double f = order * order;
+    const double ro = 1. - ( ( 2. * f - 1. ) / ( 6. * order ) ) * ( ( 1. / n1 ) + ( 1. / n2 ) - ( 1. / nu ) );
+    const double w2 = ( -f / 4. ) * std::pow( ( 1. - ( 1. / ro ) ), 2 ) + ( ( f * ( f - 1. ) ) / 24. ) *
+      ( ( 1. / std::pow( n2, 2 ) ) + ( 1. / std::pow( n1, 2 ) ) - ( 1. / std::pow( nu, 2 ) ) ) * ( 1. / std::pow( ro, 2 ) );
+    const double q1 = ( order * nu * std::log( nu ) ) - ( ( order * n2 * std::log( n2 ) ) + ( order * n1 * std::log( n1 ) ) );
+    const double Q = q1 + ( n2 * std::log( std::fabs( std::real( seg1Det ) ) ) ) +
+      ( n1 * std::log( std::fabs( std::real( seg2Det ) ) ) ) - ( nu * std::log( std::fabs( std::real( segUDet ) ) ) );
+    const double L = -2. * ro * Q;
+
+    double seg1Prob = 0.;
+    double seg2Prob = 0.;
+
+    if( L >= 0 ) {
+      seg1Prob = cdf( boost::math::chi_squared_distribution< double >( f ), L );
+      seg2Prob = cdf( boost::math::chi_squared_distribution< double >( f + 4 ), L );
+    }
+
+    return seg1Prob + w2 * ( seg2Prob - seg1Prob );
+  }
+}
+
+TEST( SegmenterRegionGrowingWishartMerger, closedFormDeterminantTest )
+{
+  // block-diagonal (azimutal simetry) HH, HV, VV covariance matrix
+  boost::numeric::ublas::matrix< std::complex< double > > matrix( 3, 3 );
+  matrix( 0, 0 ) = 4.0;
+  matrix( 0, 1 ) = 0.0;
+  matrix( 0, 2 ) = std::complex< double >( 1.5, -0.5 );
+  matrix( 1, 0 ) = 0.0;
+  matrix( 1, 1 ) = 0.7;
+  matrix( 1, 2 ) = 0.0;
+  matrix( 2, 0 ) = std::conj( matrix( 0, 2 ) );
+  matrix( 2, 1 ) = 0.0;
+  matrix( 2, 2 ) = 2.5;
+
+  std::complex< double > expectedDet;
+  ASSERT_TRUE( te::common::GetDeterminant< std::complex< double > >( matrix, expectedDet ) );
+
+  WishartMergerTester merger( 9, 1.0, true );
+  ASSERT_EQ( 5, merger.getSegmentFeaturesSize() );
+
+  const std::vector< std::complex< double > > elements = GetBandsElements( matrix );
+  std::vector< teradar::segmenter::WishartFeatureType > features( merger.getSegmentFeaturesSize() );
+  merger.packCovariance( &elements[0], 1, &features[0] );
+
+  // 0.7 * ( 4 * 2.5 - |1.5 - 0.5i|^2 )
+  EXPECT_NEAR( 0.7 * ( 10.0 - 2.5 ), merger.getClosedFormDeterminant( &features[0], 1e-8 ), 1e-9 );
+  EXPECT_NEAR( std::real( expectedDet ), merger.getClosedFormDeterminant( &features[0], 1e-8 ), 1e-9 );
+}
+
+TEST( SegmenterRegionGrowingWishartMerger, dualPolClosedFormDeterminantTest )
+{
+  // dual-pol 2 x 2 covariance matrix
+  const boost::numeric::ublas::matrix< std::complex< double > > matrix = GetKnownCovariance( 2, 3 );
+
+  std::complex< double > expectedDet;
+  ASSERT_TRUE( te::common::GetDeterminant< std::complex< double > >( matrix, expectedDet ) );
+
+  WishartMergerTester merger( 4, 1.0 );
+  ASSERT_EQ( 4, merger.getSegmentFeaturesSize() );
+
+  const std::vector< std::complex< double > > elements = GetBandsElements( matrix );
+  std::vector< teradar::segmenter::WishartFeatureType > features( merger.getSegmentFeaturesSize() );
+  merger.packCovariance( &elements[0], 1, &features[0] );
+
+  // C11 * C22 - |C12|^2
+  const double closedFormDet = std::real( matrix( 0, 0 ) ) * std::real( matrix( 1, 1 ) ) -
+    std::norm( matrix( 0, 1 ) );
+
+  EXPECT_NEAR( closedFormDet, merger.getClosedFormDeterminant( &features[0], 1e-8 ), 1e-9 );
+  EXPECT_NEAR( std::real( expectedDet ), merger.getClosedFormDeterminant( &features[0], 1e-8 ), 1e-9 );
+}
+
+TEST( SegmenterRegionGrowingWishartMerger, packUnpackTest )
+{
+  for( unsigned int order = 3; order <= 4; ++order ) {
+    const boost::numeric::ublas::matrix< std::complex< double > > matrix = GetKnownCovariance( order, 1 );
+
+    WishartMergerTester merger( order * order, 1.0 );
+    ASSERT_EQ( order * order, merger.getSegmentFeaturesSize() );
+
+    // interleaved elements, to check the stride
+    const std::vector< std::complex< double > > elements = GetBandsElements( matrix );
+    std::vector< std::complex< double > > stridedElements( 2 * elements.size() );
+
+    for( unsigned int elementIdx = 0; elementIdx < elements.size(); ++elementIdx ) {
+      stridedElements[ 2 * elementIdx ] = elements[ elementIdx ];
+    }
+
+    std::vector< teradar::segmenter::WishartFeatureType > features( merger.getSegmentFeaturesSize() );
+    merger.packCovariance( &stridedElements[0], 2, &features[0] );
+
+    boost::numeric::ublas::matrix< std::complex< double > > unpackedMatrix( order, order );
+    merger.unpackCovariance( &features[0], unpackedMatrix );
+
+    for( unsigned int row = 0; row < order; ++row ) {
+      for( unsigned int col = 0; col < order; ++col ) {
+        EXPECT_DOUBLE_EQ( std::real( matrix( row, col ) ), std::real( unpackedMatrix( row, col ) ) );
+        EXPECT_DOUBLE_EQ( std::imag( matrix( row, col ) ), std::imag( unpackedMatrix( row, col ) ) );
+      }
+    }
+
+    // Raster bands in row order are read transposed, the conjugate matrix,
+    // with the same determinant.
+    std::vector< std::complex< double > > rowOrderElements( order * order );
+
+    for( unsigned int row = 0; row < order; ++row ) {
+      for( unsigned int col = 0; col < order; ++col ) {
+        rowOrderElements[ row * order + col ] = matrix( row, col );
+      }
+    }
+
+    merger.packCovariance( &rowOrderElements[0], 1, &features[0] );
+    merger.unpackCovariance( &features[0], unpackedMatrix );
+
+    for( unsigned int row = 0; row < order; ++row ) {
+      for( unsigned int col = 0; col < order; ++col ) {
+        EXPECT_DOUBLE_EQ( std::real( matrix( col, row ) ), std::real( unpackedMatrix( row, col ) ) );
+        EXPECT_DOUBLE_EQ( std::imag( matrix( col, row ) ), std::imag( unpackedMatrix( row, col ) ) );
+      }
+    }
+
+    std::complex< double > matrixDet;
+    std::complex< double > unpackedMatrixDet;
+    ASSERT_TRUE( te::common::GetDeterminant< std::complex< double > >( matrix, matrixDet ) );
+    ASSERT_TRUE( te::common::GetDeterminant< std::complex< double > >( unpackedMatrix, unpackedMatrixDet ) );
+    EXPECT_NEAR( std::real( matrixDet ), std::real( unpackedMatrixDet ), 1e-9 * std::fabs( std::real( matrixDet ) ) );
+  }
+}
+
+TEST( SegmenterRegionGrowingWishartMerger, packedDissimilarityTest )
+{
+  const unsigned int segmentsSizes[][2] = { { 1, 1 }, { 3, 5 }, { 20, 7 } };
+
+  for( unsigned int order = 2; order <= 4; ++order ) {
+    const std::vector< std::complex< double > > segment1Elements = GetBandsElements( GetKnownCovariance( order, 1 ) );
+    const std::vector< std::complex< double > > segment2Elements = GetBandsElements( GetKnownCovariance( order, 2 ) );
+
+    WishartMergerTester merger( order * order, 4.0 );
+
+    std::vector< teradar::segmenter::WishartFeatureType > segment1Features( merger.getSegmentFeaturesSize() );
+    std::vector< teradar::segmenter::WishartFeatureType > segment2Features( merger.getSegmentFeaturesSize() );
+    std::vector< teradar::segmenter::WishartFeatureType > previewFeatures( merger.getSegmentFeaturesSize() );
+    merger.packCovariance( &segment1Elements[0], 1, &segment1Features[0] );
+    merger.packCovariance( &segment2Elements[0], 1, &segment2Features[0] );
+
+    te::rp::SegmenterRegionGrowingSegment< teradar::segmenter::WishartFeatureType > segment1;
+    te::rp::SegmenterRegionGrowingSegment< teradar::segmenter::WishartFeatureType > segment2;
+    te::rp::SegmenterRegionGrowingSegment< teradar::segmenter::WishartFeatureType > previewSegment;
+    segment1.m_features = &segment1Features[0];
+    segment2.m_features = &segment2Features[0];
+    previewSegment.m_features = &previewFeatures[0];
+    segment1.m_xStart = segment1.m_yStart = 0;
+    segment1.m_xBound = segment1.m_yBound = 1;
+    segment2.m_xStart = segment2.m_yStart = 1;
+    segment2.m_xBound = segment2.m_yBound = 2;
+
+    for( unsigned int sizesIdx = 0; sizesIdx < 3; ++sizesIdx ) {
+      segment1.m_size = segmentsSizes[ sizesIdx ][ 0 ];
+      segment2.m_size = segmentsSizes[ sizesIdx ][ 1 ];
+
+      const double expectedDissimilarity = GetFullComplexDissimilarity( segment1Elements, segment1.m_size,
+        segment2Elements, segment2.m_size, 4.0 );
+
+      EXPECT_NEAR( expectedDissimilarity, merger.getDissimilarity( &segment1, &segment2, &previewSegment ), 1e-9 );
+    }
+  }
+}
+
+TEST( SegmenterRegionGrowingWishartMerger, rejectionBoundTest )
+{
+  const double thresholds[] = { 0.5, 0.9, 0.99 };
+  const double numbersOfLooks[] = { 1.0, 4.0 };
+  const double segment2Scales[] = { 1.0, 1.05, 1.5 };
+  unsigned int rejectedNumber = 0;
+  unsigned int computedNumber = 0;
+
+  // 2 x 2, 3 x 3, 4 x 4 and 3 x 3 with azimutal simetry (order 5)
+  for( unsigned int order = 2; order <= 5; ++order ) {
+    const unsigned int matrixOrder = ( order == 5 ) ? 3 : order;
+
+    for( unsigned int looksIdx = 0; looksIdx < 2; ++looksIdx ) {
+      WishartMergerTester merger( matrixOrder * matrixOrder, numbersOfLooks[ looksIdx ], order == 5 );
+      WishartMergerTester boundedMerger( matrixOrder * matrixOrder, numbersOfLooks[ looksIdx ], order == 5 );
+
+      std::vector< teradar::segmenter::WishartFeatureType > segment1Features( merger.getSegmentFeaturesSize() );
+      std::vector< teradar::segmenter::WishartFeatureType > segment2Features( merger.getSegmentFeaturesSize() );
+      std::vector< teradar::segmenter::WishartFeatureType > previewFeatures( merger.getSegmentFeaturesSize() );
+
+      te::rp::SegmenterRegionGrowingSegment< teradar::segmenter::WishartFeatureType > segment1;
+      te::rp::SegmenterRegionGrowingSegment< teradar::segmenter::WishartFeatureType > segment2;
+      te::rp::SegmenterRegionGrowingSegment< teradar::segmenter::WishartFeatureType > previewSegment;
+      segment1.m_features = &segment1Features[0];
+      segment2.m_features = &segment2Features[0];
+      previewSegment.m_features = &previewFeatures[0];
+      segment1.m_xStart = segment1.m_yStart = 0;
+      segment1.m_xBound = segment1.m_yBound = 1;
+      segment2.m_xStart = segment2.m_yStart = 1;
+      segment2.m_xBound = segment2.m_yBound = 2;
+
+      const boost::numeric::ublas::matrix< std::complex< double > > matrix1 = GetKnownCovariance( matrixOrder, 1 );
+      const std::vector< std::complex< double > > segment1Elements = GetBandsElements( matrix1 );
+      merger.packCovariance( &segment1Elements[0], 1, &segment1Features[0] );
+
+      // from the same matrix (low L) to another one (high L)
+      for( unsigned int scaleIdx = 0; scaleIdx < 4; ++scaleIdx ) {
+        const std::vector< std::complex< double > > segment2Elements = ( scaleIdx < 3 ) ?
+          GetBandsElements( matrix1 * segment2Scales[ scaleIdx ] ) :
+          GetBandsElements( GetKnownCovariance( matrixOrder, 2 ) );
+        merger.packCovariance( &segment2Elements[0], 1, &segment2Features[0] );
+
+        for( unsigned int thresholdIdx = 0; thresholdIdx < 3; ++thresholdIdx ) {
+          const double threshold = thresholds[ thresholdIdx ];
+          boundedMerger.setRejectionBound( boundedMerger.getRejectionBound( threshold ) );
+
+          // the small segments sizes give w2 out of [0, 1]
+          for( segment1.m_size = 1; segment1.m_size <= 40; segment1.m_size += 3 ) {
+            for( segment2.m_size = 1; segment2.m_size <= 40; segment2.m_size += 5 ) {
+              const double dissimilarity = merger.getDissimilarity( &segment1, &segment2, &previewSegment );
+              const double boundedDissimilarity = boundedMerger.getDissimilarity( &segment1, &segment2, &previewSegment );
+
+              if( boundedDissimilarity == teradar::segmenter::SegmenterRegionGrowingWishartMerger::getRejectedDissimilarity() ) {
+                EXPECT_GT( dissimilarity, threshold );
+                ++rejectedNumber;
+              } else {
+                EXPECT_EQ( dissimilarity, boundedDissimilarity );
+                ++computedNumber;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  EXPECT_GT( rejectedNumber, 0 );
+  EXPECT_GT( computedNumber, 0 );
+}
@@ -0,0 +1,279 @@
+/*  Copyright (C) 2015 National Institute For Space Research (INPE) - Brazil.
+
+This file is part of the TerraRadar - a library and application for radar data manipulation.
+
+TerraRadar is under development.
+*/
+
+/*!
+\file terraradar/tests/unittest/segmenter/segmenterRegionGrowingWishartStrategy_unitTest.cpp
+\brief A test suite for the SegmenterRegionGrowingWishartStrategy class.
+*/
+
+// TerraRadar includes
+#include "MultiLevelSegmenter.hpp"
+#include "SegmenterRegionGrowingWishartStrategy.hpp"
+
+// TerraLib includes
+#include <terralib/raster.h>
+
+// Boost includes
+#include <boost/numeric/ublas/matrix.hpp>
+
+// STL includes
+#include <complex>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// Gtest includes
+#include <gtest/gtest.h>
+
+namespace
+{
+  // Creates a 9 bands (3 x 3 covariance matrix) "MEM" raster, each pixel
+  // covariance matrix is a known Hermitian matrix times the pixel scale.
+  te::rst::Raster* CreateScaledCovarianceRaster( const std::vector< double >& scales,
+    const unsigned int cols, const unsigned int rows )
+  {
+    boost::numeric::ublas::matrix< std::complex< double > > matrix( 3, 3 );
+    matrix( 0, 0 ) = 1.0;
+    matrix( 0, 1 ) = std::complex< double >( 0.2, 0.1 );
+    matrix( 0, 2 ) = std::complex< double >( 0.1, -0.05 );
+    matrix( 1, 1 ) = 0.5;
+    matrix( 1, 2 ) = 0.0;
+    matrix( 2, 2 ) = 0.25;
+    matrix( 1, 0 ) = std::conj( matrix( 0, 1 ) );
+    matrix( 2, 0 ) = std::conj( matrix( 0, 2 ) );
+    matrix( 2, 1 ) = std::conj( matrix( 1, 2 ) );
+
+    std::vector< te::rst::BandProperty* > bandsProperties;
+
+    for( unsigned int bandIdx = 0; bandIdx < 9; ++bandIdx ) {
+      bandsProperties.push_back( new te::rst::BandProperty( bandIdx, te::dt::CDOUBLE_TYPE ) );
+    }
+
+    std::map< std::string, std::string > rasterInfo;
+    te::rst::Raster* raster( te::rst::RasterFactory::make( "MEM",
+      new te::rst::Grid( cols, rows ), bandsProperties, rasterInfo ) );
+
+    if( raster == 0 ) {
+      return 0;
+    }
+
+    // the band row * 3 + col is the covariance matrix element ( row, col )
+    for( unsigned int r = 0; r < rows; ++r ) {
+      for( unsigned int c = 0; c < cols; ++c ) {
+        for( unsigned int bandIdx = 0; bandIdx < 9; ++bandIdx ) {
+          raster->setValue( c, r, matrix( bandIdx / 3, bandIdx % 3 ) * scales[ r * cols + c ], bandIdx );
+        }
+      }
+    }
+
+    return raster;
+  }
+
+  // The strategy parameters of the synthetic rasters, 16 looks (the
+  // segments of different regions are never merged).
+  teradar::segmenter::SegmenterRegionGrowingWishartStrategy::Parameters GetSyntheticStrategyParameters()
+  {
+    teradar::segmenter::SegmenterRegionGrowingWishartStrategy::Parameters strategyParameters;
+    strategyParameters.m_minSegmentSize = 1;
+    strategyParameters.m_dataType = teradar::common::CovarianceMatrixT;
+    strategyParameters.m_enlLZero = 16.0;
+    strategyParameters.m_compressionLevel = 0;
+    strategyParameters.m_connectivityType = teradar::common::VonNeumannNT;
+
+    return strategyParameters;
+  }
+
+  // Segments the raster as a single block, the labels are in lines order.
+  bool SegmentCovarianceRaster( const te::rst::Raster& inputRaster,
+    const teradar::segmenter::SegmenterRegionGrowingWishartStrategy::Parameters& strategyParameters,
+    std::vector< unsigned int >& labels )
+  {
+    teradar::segmenter::MultiLevelSegmenter::InputParameters algoInputParams;
+    algoInputParams.m_inputRasterPtr = &inputRaster;
+
+    for( unsigned int bandIdx = 0; bandIdx < 9; ++bandIdx ) {
+      algoInputParams.m_inputRasterBands.push_back( bandIdx );
+    }
+
+    algoInputParams.m_enableThreadedProcessing = false;
+    algoInputParams.m_enableBlockProcessing = false;
+    algoInputParams.m_strategyName = "RegionGrowingWishart";
+    algoInputParams.setSegStrategyParams( strategyParameters );
+
+    teradar::segmenter::MultiLevelSegmenter::OutputParameters algoOutputParams;
+    algoOutputParams.m_rType = "MEM";
+
+    teradar::segmenter::MultiLevelSegmenter algorithmInstance;
+
+    if( !algorithmInstance.initialize( algoInputParams ) ||
+      !algorithmInstance.execute( algoOutputParams ) ) {
+      return false;
+    }
+
+    const unsigned int rows = inputRaster.getNumberOfRows();
+    const unsigned int cols = inputRaster.getNumberOfColumns();
+    double value = 0;
+
+    labels.resize( rows * cols );
+
+    for( unsigned int r = 0; r < rows; ++r ) {
+      for( unsigned int c = 0; c < cols; ++c ) {
+        algoOutputParams.m_outputRasterPtr->getValue( c, r, value, 0 );
+        labels[ r * cols + c ] = (unsigned int)value;
+      }
+    }
+
+    return true;
+  }
+
+  unsigned int GetLabelsNumber( const std::vector< unsigned int >& labels )
+  {
+    return (unsigned int)std::set< unsigned int >( labels.begin(), labels.end() ).size();
+  }
+
+  // Four regions with small per-pixel variations, so the merges order
+  // depends on the dissimilarities.
+  std::vector< double > GetQuadrantsScales( const unsigned int cols, const unsigned int rows )
+  {
+    const double quadrantsScales[] = { 1.0, 3.0, 10.0, 30.0 };
+    std::vector< double > scales( rows * cols );
+
+    for( unsigned int r = 0; r < rows; ++r ) {
+      for( unsigned int c = 0; c < cols; ++c ) {
+        scales[ r * cols + c ] = quadrantsScales[ ( ( 2 * r ) / rows ) * 2 + ( ( 2 * c ) / cols ) ] *
+          ( 1.0 + 0.25 * (double)( ( 7 * r + 13 * c ) % 5 ) / 4.0 );
+      }
+    }
+
+    return scales;
+  }
+}
+
+TEST( SegmenterRegionGrowingWishartStrategy, twoRegionsTest )
+{
+  // left half and right half homogeneous regions
+  std::vector< double > scales( 8 * 8, 1.0 );
+
+  for( unsigned int r = 0; r < 8; ++r ) {
+    for( unsigned int c = 4; c < 8; ++c ) {
+      scales[ r * 8 + c ] = 100.0;
+    }
+  }
+
+  std::auto_ptr< te::rst::Raster > inputRaster( CreateScaledCovarianceRaster( scales, 8, 8 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  std::vector< unsigned int > labels;
+  ASSERT_TRUE( SegmentCovarianceRaster( *inputRaster, GetSyntheticStrategyParameters(), labels ) );
+
+  EXPECT_EQ( 2, GetLabelsNumber( labels ) );
+
+  for( unsigned int r = 0; r < 8; ++r ) {
+    for( unsigned int c = 0; c < 8; ++c ) {
+      EXPECT_EQ( labels[ ( c < 4 ) ? 0 : 4 ], labels[ r * 8 + c ] );
+    }
+  }
+
+  EXPECT_NE( labels[ 0 ], labels[ 4 ] );
+}
+
+TEST( SegmenterRegionGrowingWishartStrategy, minSegmentSizeTest )
+{
+  // a 2 x 2 region inside another one
+  std::vector< double > scales( 8 * 8, 1.0 );
+  scales[ 3 * 8 + 3 ] = scales[ 3 * 8 + 4 ] = scales[ 4 * 8 + 3 ] = scales[ 4 * 8 + 4 ] = 100.0;
+
+  std::auto_ptr< te::rst::Raster > inputRaster( CreateScaledCovarianceRaster( scales, 8, 8 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  teradar::segmenter::SegmenterRegionGrowingWishartStrategy::Parameters strategyParameters =
+    GetSyntheticStrategyParameters();
+
+  std::vector< unsigned int > labels;
+  ASSERT_TRUE( SegmentCovarianceRaster( *inputRaster, strategyParameters, labels ) );
+  EXPECT_EQ( 2, GetLabelsNumber( labels ) );
+
+  // the 4 pixels segment is smaller than the minimum size
+  strategyParameters.m_minSegmentSize = 5;
+  ASSERT_TRUE( SegmentCovarianceRaster( *inputRaster, strategyParameters, labels ) );
+  EXPECT_EQ( 1, GetLabelsNumber( labels ) );
+}
+
+TEST( SegmenterRegionGrowingWishartStrategy, connectivityTest )
+{
+  // a diagonal region, its pixels only touch each other by the corners
+  std::vector< double > scales( 6 * 6, 1.0 );
+
+  for( unsigned int idx = 0; idx < 6; ++idx ) {
+    scales[ idx * 6 + idx ] = 100.0;
+  }
+
+  std::auto_ptr< te::rst::Raster > inputRaster( CreateScaledCovarianceRaster( scales, 6, 6 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  teradar::segmenter::SegmenterRegionGrowingWishartStrategy::Parameters strategyParameters =
+    GetSyntheticStrategyParameters();
+
+  // 6 diagonal pixels, plus the triangles above and below the diagonal
+  std::vector< unsigned int > labels;
+  strategyParameters.m_connectivityType = teradar::common::VonNeumannNT;
+  ASSERT_TRUE( SegmentCovarianceRaster( *inputRaster, strategyParameters, labels ) );
+  EXPECT_EQ( 8, GetLabelsNumber( labels ) );
+
+  // the diagonal and both triangles are connected by the corners
+  strategyParameters.m_connectivityType = teradar::common::MooreNT;
+  ASSERT_TRUE( SegmentCovarianceRaster( *inputRaster, strategyParameters, labels ) );
+  EXPECT_EQ( 2, GetLabelsNumber( labels ) );
+  EXPECT_EQ( labels[ 0 ], labels[ 5 * 6 + 5 ] );
+  EXPECT_EQ( labels[ 1 ], labels[ 6 ] );
+}
+
+TEST( SegmenterRegionGrowingWishartStrategy, mergingThreadsTest )
+{
+  std::auto_ptr< te::rst::Raster > inputRaster( CreateScaledCovarianceRaster(
+    GetQuadrantsScales( 16, 16 ), 16, 16 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  teradar::segmenter::SegmenterRegionGrowingWishartStrategy::Parameters strategyParameters =
+    GetSyntheticStrategyParameters();
+  strategyParameters.m_minSegmentSize = 4;
+
+  std::vector< unsigned int > twoThreadsLabels;
+  strategyParameters.m_mergingThreadsNumber = 2;
+  ASSERT_TRUE( SegmentCovarianceRaster( *inputRaster, strategyParameters, twoThreadsLabels ) );
+
+  std::vector< unsigned int > fourThreadsLabels;
+  strategyParameters.m_mergingThreadsNumber = 4;
+  ASSERT_TRUE( SegmentCovarianceRaster( *inputRaster, strategyParameters, fourThreadsLabels ) );
+
+  EXPECT_TRUE( twoThreadsLabels == fourThreadsLabels );
+}
+
+TEST( SegmenterRegionGrowingWishartStrategy, dissimilarityCacheTest )
+{
+  std::auto_ptr< te::rst::Raster > inputRaster( CreateScaledCovarianceRaster(
+    GetQuadrantsScales( 16, 16 ), 16, 16 ) );
+  ASSERT_TRUE( inputRaster.get() != NULL );
+
+  // the cache is used by the merging rounds
+  teradar::segmenter::SegmenterRegionGrowingWishartStrategy::Parameters strategyParameters =
+    GetSyntheticStrategyParameters();
+  strategyParameters.m_minSegmentSize = 4;
+  strategyParameters.m_mergingThreadsNumber = 2;
+
+  std::vector< unsigned int > cachedLabels;
+  strategyParameters.m_enableDissimilarityCache = true;
+  ASSERT_TRUE( SegmentCovarianceRaster( *inputRaster, strategyParameters, cachedLabels ) );
+
+  std::vector< unsigned int > labels;
+  strategyParameters.m_enableDissimilarityCache = false;
+  ASSERT_TRUE( SegmentCovarianceRaster( *inputRaster, strategyParameters, labels ) );
+
+  EXPECT_TRUE( cachedLabels == labels );
+}